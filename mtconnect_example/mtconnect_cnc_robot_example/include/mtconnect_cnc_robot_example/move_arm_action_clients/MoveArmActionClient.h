@@ -19,6 +19,7 @@
 #define MOVEARMACTIONCLIENT_H_
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <arm_navigation_msgs/GetPlanningScene.h>
 #include <arm_navigation_msgs/SetPlanningSceneDiff.h>
 #include <planning_environment/models/collision_models.h>
@@ -26,12 +27,20 @@
 #include <actionlib/client/simple_action_client.h>
 #include <arm_navigation_msgs/MoveArmAction.h>
 #include <arm_navigation_msgs/SimplePoseConstraint.h>
+#include <arm_navigation_msgs/FilterJointTrajectoryWithConstraints.h>
+#include <control_msgs/FollowJointTrajectoryAction.h>
 #include <nav_msgs/Path.h>
 #include <tf/tf.h>
 #include <tf/transform_listener.h>
 #include <geometry_msgs/PoseArray.h>
 #include <boost/tuple/tuple.hpp>
+#include <boost/thread.hpp>
+#include <deque>
 #include <mtconnect_cnc_robot_example/utilities/utilities.h>
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/PlanningSceneMonitor.h>
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/MoveArmHandle.h>
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/PlannerPortfolio.h>
+#include <mtconnect_example_utils/discovery_manager.h>
 
 using namespace move_arm_utils;
 
@@ -40,7 +49,8 @@ namespace mtconnect_cnc_robot_example
 // aliases
 typedef actionlib::SimpleActionClient<arm_navigation_msgs::MoveArmAction> MoveArmClient;
 typedef boost::shared_ptr<MoveArmClient> MoveArmClientPtr;
-typedef boost::shared_ptr<planning_environment::CollisionModels> CollisionModelsPtr;
+typedef actionlib::SimpleActionClient<control_msgs::FollowJointTrajectoryAction> FollowTrajectoryClient;
+typedef boost::shared_ptr<FollowTrajectoryClient> FollowTrajectoryClientPtr;
 typedef boost::shared_ptr<planning_models::KinematicState> KinematicStatePtr;
 typedef boost::tuple<std::string,std::string,tf::Transform> CartesianGoal;
 class MoveArmActionClient;
@@ -52,15 +62,19 @@ static const std::string DEFAULT_MOVE_ARM_ACTION = "move_arm_action";
 static const std::string DEFAULT_PATH_PLANNER = "/ompl_planning/plan_kinematic_path";
 static const std::string DEFAULT_PLANNING_SCENE_DIFF_SERVICE = "/environment_server/set_planning_scene_diff";
 static const std::string DEFAULT_PLANNING_GROUPS_PARAMETER = "/robot_description_planning/groups";
+static const std::string DEFAULT_FILTER_TRAJECTORY_SERVICE = "filter_trajectory_with_constraints";
+static const std::string DEFAULT_FOLLOW_TRAJECTORY_ACTION = "joint_trajectory_action";
 static const int DEFAULT_PATH_PLANNING_ATTEMPTS = 2;
 static const double DEFAULT_PATH_PLANNING_TIME = 5.0f;
 static const double DEFAULT_ORIENTATION_TOLERANCE = 0.02f; //radians
 static const double DEFAULT_POSITION_TOLERANCE = 0.008f; // meters
 static const double DURATION_LOOP_PAUSE = 4.0f; // seconds
 static const double DURATION_WAIT_RESULT= 80.0f;
-static const double DURATION_TIMER_CYCLE = 2.0f;
 static const double DURATION_WAIT_SERVER = 5.0f;
+static const double DURATION_RESULT_POLL = 0.1f; // how often the executor checks for cancel requests
+static const double DURATION_STATISTICS_REPORT = 10.0f; // seconds between planner portfolio statistics reports
 static const int MAX_WAIT_ATTEMPTS = 20;
+static const std::string SUBSYSTEM_ROBOT = "robot"; // discovery subsystem of the arm servers
 
 // ros parameters
 static const std::string PARAM_ARM_GROUP = "arm_group";
@@ -71,25 +85,68 @@ static const std::string PARAM_TIP_KEY = "tip_link";
 class MoveArmActionClient
 {
 public:
-	MoveArmActionClient();
+	/*
+	 * Topics, actions and services are resolved in nh and the parameters are read from ph (i.e. the
+	 * node handles of a nodelet).  The callbacks go to a queue of this client, only run() spins it.
+	 */
+	MoveArmActionClient(const ros::NodeHandle &nh = ros::NodeHandle(),
+			const ros::NodeHandle &ph = ros::NodeHandle("~"));
 
 	virtual ~MoveArmActionClient();
 
 	virtual void run();
 
 	/*
-	 * Takes and array of poses where each pose is the desired tip link pose described in terms of the arm base
+	 * Takes and array of poses where each pose is the desired tip link pose described in terms of the arm base.
+	 * When wait_for_completion is false the whole sequence is queued and the handle is available
+	 * through getMoveArmHandle()
 	 */
 	virtual bool moveArm(const geometry_msgs::PoseArray &cartesian_poses,bool wait_for_completion = true);
 
+	/*
+	 * Queues the pose sequence on the executor thread and returns immediately.  Each pose must be
+	 * reached within pose_timeout.  Gated sequences wait for MoveArmHandle::openGate() before the arm
+	 * moves (see MoveArmHandle).
+	 */
+	virtual MoveArmHandlePtr moveArmAsync(const geometry_msgs::PoseArray &cartesian_poses,
+			const ros::Duration &pose_timeout = ros::Duration(DURATION_WAIT_RESULT), bool gated = false);
+
+	/*
+	 * Cancels the active pose sequence and every queued one.  With wait the call returns once the
+	 * executor let go of the move_arm goal of the active sequence, a goal sent afterwards can't be
+	 * canceled or preempted by it.
+	 */
+	virtual void cancelMoveArm(bool wait = false);
+
+	MoveArmHandlePtr getMoveArmHandle()
+	{
+		return move_arm_handle_;
+	}
+
 	virtual bool fetchParameters(std::string nameSpace = "");
 
-	virtual void timerCallback(const ros::TimerEvent &evnt);
+	/*
+	 * Replaces the cartesian trajectory and republishes its path visualization
+	 */
+	void setCartesianTrajectory(const CartesianTrajectory &cartesian_traj);
+
+	/*
+	 * Publishes the path of the current cartesian trajectory on the latched path topic, only needs to be
+	 * called when the trajectory changes.
+	 */
+	void publishPath();
 
 protected:
 
+	/*
+	 * Serves the arm start state from the planning scene monitor, the full planning scene is only
+	 * requested from the environment server when the monitor has gone stale.
+	 */
 	virtual bool getArmStartState(std::string group_name, arm_navigation_msgs::RobotState &robot_state);
 
+	virtual bool getArmStartState(std::string group_name, arm_navigation_msgs::RobotState &robot_state,
+			unsigned int &scene_version);
+
 	virtual bool setup();
 
 	bool getArmInfo(const planning_environment::CollisionModels *models,
@@ -99,20 +156,49 @@ protected:
 
 	bool getTrajectoryInArmSpace(const CartesianTrajectory &cartesian_traj,geometry_msgs::PoseArray &base_to_tip_poses);
 
+	// executor thread
+	void startExecutor();
+	void stopExecutor();
+	void executorLoop();
+	virtual MoveArmHandle::State executePoseSequence(const MoveArmHandlePtr &handle);
+
+	/*
+	 * Plans the current move_arm_goal_ and executes the plan directly on the joint trajectory action,
+	 * used instead of move_arm when a portfolio is configured or the handle is gated.  The planner
+	 * portfolio races the request when it is configured, otherwise the move_arm goal's planner service
+	 * is called.  A gated handle is planned and filtered before the gate, only execution waits for it.
+	 */
+	virtual MoveArmHandle::State executePlannedGoal(const MoveArmHandlePtr &handle);
+
+	/*
+	 * Publishes the portfolio statistics, runs on callback_queue_ rather than the executor thread
+	 */
+	void statisticsTimerCallback(const ros::TimerEvent &event);
+
 protected:
 
+	// node handles, both on callback_queue_
+	ros::CallbackQueue callback_queue_;
+	ros::NodeHandle nh_;
+	ros::NodeHandle ph_;
+
 	// ros action clients
 	MoveArmClientPtr move_arm_client_ptr_;
 
+	// derived clients add their servers before calling setup, which waits on all of them at once
+	mtconnect_example_utils::DiscoveryManager discovery_;
+
 	// ros service clients
-	ros::ServiceClient planning_scene_client_;
+	ros::ServiceClient filter_trajectory_client_;
+
+	// planner racing
+	PlannerPortfolio planner_portfolio_;
+	FollowTrajectoryClientPtr follow_trajectory_client_ptr_;
+	ros::Timer statistics_timer_;
 
 	// ros publishers
 	ros::Publisher path_pub_;
 
-	// ros timers
-	ros::Timer publish_timer_;
-
 	// ros messages
 	nav_msgs::Path path_msg_;
 
@@ -121,6 +207,7 @@ protected:
 
 	// arm info
 	CollisionModelsPtr collision_models_ptr_;
+	PlanningSceneMonitorPtr planning_scene_monitor_ptr_;
 	KinematicStatePtr arm_kinematic_state_ptr_;
 	std::string base_link_frame_id_;
 	std::string tip_link_frame_id_;
@@ -133,6 +220,15 @@ protected:
 	arm_navigation_msgs::MoveArmGoal move_arm_goal_;
 	arm_navigation_msgs::SimplePoseConstraint move_pose_constraint_;
 
+	// executor members
+	boost::thread executor_thread_;
+	boost::mutex executor_mutex_;
+	boost::condition_variable executor_condition_;
+	std::deque<MoveArmHandlePtr> executor_queue_;
+	MoveArmHandlePtr active_handle_;
+	MoveArmHandlePtr move_arm_handle_; // last sequence sent through moveArm
+	bool executor_running_;
+
 };
 
 }
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef MOVEARMHANDLE_H_
+#define MOVEARMHANDLE_H_
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseArray.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <vector>
+
+namespace mtconnect_cnc_robot_example
+{
+
+class MoveArmActionClient;
+class MoveArmHandle;
+typedef boost::shared_ptr<MoveArmHandle> MoveArmHandlePtr;
+
+/*
+ * Tracks a complete pose sequence sent through MoveArmActionClient::moveArmAsync.  The sequence
+ * runs on the client's executor thread; the handle can be polled, waited on, canceled or given
+ * continuations that run on the executor thread once the sequence finishes.
+ */
+class MoveArmHandle : public boost::enable_shared_from_this<MoveArmHandle>
+{
+	friend class MoveArmActionClient;
+
+public:
+
+	enum State
+	{
+		PENDING = 0,  // queued, waiting for the executor
+		ACTIVE,       // poses are being sent to move_arm
+		SUCCEEDED,    // every pose in the sequence was reached
+		FAILED,       // move_arm rejected or aborted one of the poses
+		CANCELED,     // cancel() was called before the sequence finished
+		TIMED_OUT     // a pose was not reached within the pose timeout
+	};
+
+	typedef boost::function<void (const MoveArmHandlePtr&)> Continuation;
+
+public:
+
+	/*
+	 * A gated handle is planned as soon as the executor reaches it but is not executed until openGate()
+	 * is called, which lets planning overlap with work the motion physically depends on.  Gated handles
+	 * are always planned ahead (see MoveArmActionClient::executePlannedGoal), never sent to move_arm.
+	 */
+	MoveArmHandle(const geometry_msgs::PoseArray &poses, const ros::Duration &pose_timeout, bool gated = false);
+
+	virtual ~MoveArmHandle();
+
+	State getState() const;
+
+	bool isDone() const;
+
+	bool succeeded() const;
+
+	/*
+	 * Index of the pose currently being executed (or the one that failed)
+	 */
+	unsigned int getCurrentPose() const;
+
+	/*
+	 * Blocks until the sequence finishes, a zero timeout waits forever.  Returns true only when the
+	 * sequence succeeded.  Must not be called from a continuation on a handle queued behind this one.
+	 */
+	bool wait(const ros::Duration &timeout = ros::Duration(0));
+
+	/*
+	 * Requests cancellation, the active move_arm goal is canceled by the executor.
+	 */
+	void cancel();
+
+	bool isCancelRequested() const;
+
+	/*
+	 * Allows a gated sequence to start moving the arm
+	 */
+	void openGate();
+
+	bool isGated() const
+	{
+		return gated_;
+	}
+
+	/*
+	 * Blocks until the gate is opened, returns false if the sequence was canceled first or the gate
+	 * stayed closed for longer than timeout (a caller that never opens the gate doesn't stall the executor)
+	 */
+	bool waitForGate(const ros::Duration &timeout);
+
+	/*
+	 * Registers a continuation, it runs immediately on the calling thread if the sequence has already finished.
+	 * Returns this handle so that continuations can be chained (i.e. handle->then(a)->then(b)), they
+	 * run in the order they were registered.
+	 */
+	MoveArmHandlePtr then(const Continuation &continuation);
+
+	static std::string stateToString(State state);
+
+protected:
+
+	void setActive(unsigned int pose_index);
+
+	/*
+	 * Stores the final state and returns the continuations that need to be invoked.
+	 */
+	std::vector<Continuation> setDone(State state);
+
+protected:
+
+	const geometry_msgs::PoseArray poses_;
+	const ros::Duration pose_timeout_;
+	const bool gated_;
+
+	mutable boost::mutex mutex_;
+	boost::condition_variable done_condition_;
+	boost::condition_variable gate_condition_;
+	State state_;
+	unsigned int current_pose_;
+	bool cancel_requested_;
+	bool gate_open_;
+	std::vector<Continuation> continuations_;
+};
+
+}
+#endif /* MOVEARMHANDLE_H_ */
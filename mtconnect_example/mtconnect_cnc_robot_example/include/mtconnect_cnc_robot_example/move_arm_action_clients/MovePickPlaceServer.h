@@ -25,6 +25,8 @@
 #include <object_manipulation_msgs/PlaceAction.h>
 #include <object_manipulation_msgs/GraspHandPostureExecutionAction.h>
 #include <actionlib/server/simple_action_server.h>
+#include <boost/thread.hpp>
+#include <deque>
 
 namespace mtconnect_cnc_robot_example
 {
@@ -43,12 +45,17 @@ typedef MoveArmPlaceServer::GoalHandle PlaceGoalHandle;
 static const std::string DEFAULT_PICKUP_ACTION = "pickup_action_service";
 static const std::string DEFAULT_PLACE_ACTION = "place_action_service";
 static const std::string DEFAULT_GRASP_ACTION = "grasp_action_service";
+static const std::string SUBSYSTEM_GRIPPER = "gripper";
 static const double DURATION_WAIT_GRASP_RESULT = 20.0f;
 
+// ros parameters
+static const std::string PARAM_OVERLAP_GRIPPER_MOTION = "overlap_gripper_motion";
+
 class MovePickPlaceServer: public MoveArmActionClient
 {
 public:
-	MovePickPlaceServer();
+	MovePickPlaceServer(const ros::NodeHandle &nh = ros::NodeHandle(),
+			const ros::NodeHandle &ph = ros::NodeHandle("~"));
 	virtual ~MovePickPlaceServer();
 
 	virtual void run();
@@ -63,6 +70,30 @@ protected:
 
 	virtual bool setup();
 
+	/*
+	 * Overlapped variants, the gripper pre-shape runs during the approach move and the move that
+	 * follows a grasp or release is planned while the gripper actuates.  The arm only waits on the
+	 * gripper where it physically has to.
+	 */
+	virtual bool moveArmThroughPickSequenceOverlapped(const object_manipulation_msgs::PickupGoal &pickup_goal);
+	virtual bool moveArmThroughPlaceSequenceOverlapped(const object_manipulation_msgs::PlaceGoal &place_goal);
+
+	bool waitForGraspResult(const std::string &step_name);
+
+	/*
+	 * True when the goal currently driving the arm has been canceled or preempted, the sequences
+	 * check it between steps.
+	 */
+	bool isPreemptRequested();
+
+	// goal executors, one thread per server so that the actionlib callbacks return immediately
+	void startExecutors();
+	void stopExecutors();
+	void pickupExecutorLoop();
+	void placeExecutorLoop();
+	void preemptAllGoals(std::vector<PickupGoalHandle> &pickup_goals,std::vector<PlaceGoalHandle> &place_goals);
+	void cancelQueuedGoals(std::vector<PickupGoalHandle> &pickup_goals,std::vector<PlaceGoalHandle> &place_goals);
+
 protected:
 
 	virtual void pickupGoalCallback(PickupGoalHandle goal);
@@ -85,9 +116,27 @@ protected:
 	MoveArmPickupServer::GoalHandle pickup_gh_;
 	MoveArmPlaceServer::GoalHandle place_gh_;
 
+	// goal executors
+	boost::thread pickup_executor_;
+	boost::thread place_executor_;
+	boost::mutex goal_mutex_;
+	boost::condition_variable goal_condition_;
+	boost::mutex arm_mutex_;
+	std::deque<PickupGoalHandle> pickup_queue_;
+	std::deque<PlaceGoalHandle> place_queue_;
+	bool executors_running_;
+	bool pickup_active_;
+	bool place_active_;
+	bool pickup_preempt_;
+	bool place_preempt_;
+	const bool *active_preempt_; // preempt flag of the goal holding the arm
+
 	// action clients
 	GraspActionClientPtr grasp_action_client_ptr_;
 
+	// ros parameters
+	bool overlap_gripper_motion_;
+
 //	PickupGoalInfo pickup_goal_;
 //	PlaceGoalInfo place_goal_;
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef PLANNERPORTFOLIO_H_
+#define PLANNERPORTFOLIO_H_
+
+#include <ros/ros.h>
+#include <arm_navigation_msgs/GetMotionPlan.h>
+#include <arm_navigation_msgs/MotionPlanRequest.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+namespace mtconnect_cnc_robot_example
+{
+
+// ros parameters
+static const std::string PARAM_PLANNER_PORTFOLIO = "planner_portfolio";
+static const std::string PARAM_PLANNER_STATISTICS = "planner_statistics";
+static const std::string PARAM_PLANNER_NAME_KEY = "name";
+static const std::string PARAM_PLANNER_SERVICE_KEY = "service";
+static const std::string PARAM_PLANNER_ID_KEY = "planner_id";
+static const std::string PARAM_PLANNER_TIME_KEY = "allowed_time";
+static const std::string PARAM_PLANNER_ATTEMPTS_KEY = "attempts";
+
+static const double DURATION_CANCEL_POLL = 0.05f; // how often a race checks whether the caller gave up
+
+/*
+ * One entry in the portfolio.  Racing only pays off when the entries point to planner services
+ * that can run concurrently (e.g. several ompl_planning nodes), a single node serializes requests.
+ */
+struct PlannerConfig
+{
+	std::string name_;
+	std::string service_;
+	std::string planner_id_;
+	double allowed_time_;
+	int attempts_;
+
+	bool parseParameters(XmlRpc::XmlRpcValue &param);
+};
+
+struct PlannerStatistics
+{
+	PlannerStatistics():
+		requests_(0),
+		completed_(0),
+		wins_(0),
+		failures_(0),
+		total_latency_(0),
+		max_latency_(0)
+	{
+	}
+
+	unsigned int requests_;  // counted when the request is sent to the planner
+	unsigned int completed_; // requests the planner returned from
+	unsigned int wins_;
+	unsigned int failures_;  // service call failed or no valid plan
+	double total_latency_;   // seconds, every completed request
+	double max_latency_;
+};
+
+/*
+ * Sends the same motion plan request to every configured planner at once and returns the first
+ * valid plan.  Service calls can't be interrupted, the remaining planners are abandoned and their
+ * late responses are only used to update the statistics.  Each planner has a worker thread of its
+ * own; a planner still busy with the request of an earlier race sits out the next one, so there is
+ * never more than one call per planner in flight.
+ */
+class PlannerPortfolio
+{
+public:
+
+	typedef boost::function<bool ()> CancelCheck;
+
+	PlannerPortfolio();
+
+	virtual ~PlannerPortfolio();
+
+	/*
+	 * Reads the portfolio list, an empty or missing list disables racing
+	 */
+	bool fetchParameters(std::string name_space = "~");
+
+	bool empty() const
+	{
+		return planners_.empty();
+	}
+
+	/*
+	 * Returns true when a planner produced a valid plan within the timeout, winner holds its index.
+	 * The race is abandoned as soon as is_canceled returns true (checked every DURATION_CANCEL_POLL).
+	 */
+	bool plan(const arm_navigation_msgs::MotionPlanRequest &request,
+			arm_navigation_msgs::GetMotionPlan::Response &response, const ros::Duration &timeout, int &winner,
+			const CancelCheck &is_canceled = CancelCheck());
+
+	/*
+	 * Writes win-rate and latency statistics to the parameter server and the log, does nothing when no
+	 * planner returned since the last report.  Makes several master calls, keep it off the motion path.
+	 */
+	void reportStatistics(std::string name_space = "~");
+
+	std::string statisticsToString();
+
+protected:
+
+	// shared between the caller and the planner threads, outlives the race when planners are late
+	struct Race
+	{
+		Race(): done_(false), winner_(-1), pending_(0)
+		{
+		}
+
+		boost::mutex mutex_;
+		boost::condition_variable condition_;
+		bool done_;
+		int winner_;
+		int pending_;
+		arm_navigation_msgs::GetMotionPlan::Response response_;
+	};
+	typedef boost::shared_ptr<Race> RacePtr;
+
+	struct StatisticsTable
+	{
+		boost::mutex mutex_;
+		std::vector<PlannerStatistics> stats_;
+	};
+	typedef boost::shared_ptr<StatisticsTable> StatisticsTablePtr;
+
+	// a planner's worker, race_ is set while it has a request
+	struct Worker
+	{
+		boost::shared_ptr<boost::thread> thread_;
+		RacePtr race_;
+		arm_navigation_msgs::MotionPlanRequest request_;
+	};
+
+	void startWorkers();
+
+	/*
+	 * Joins the workers, a worker waiting on a planner service returns once the call does
+	 */
+	void stopWorkers();
+
+	void workerLoop(int index);
+
+	void runPlanner(RacePtr race, int index, const arm_navigation_msgs::MotionPlanRequest &request);
+
+protected:
+
+	std::vector<PlannerConfig> planners_;
+	StatisticsTablePtr statistics_;
+	unsigned int reported_completed_; // completed requests at the last report, guarded by the statistics mutex
+
+	boost::mutex workers_mutex_;
+	boost::condition_variable workers_condition_;
+	std::vector<Worker> workers_;
+	bool workers_running_;
+};
+
+}
+#endif /* PLANNERPORTFOLIO_H_ */
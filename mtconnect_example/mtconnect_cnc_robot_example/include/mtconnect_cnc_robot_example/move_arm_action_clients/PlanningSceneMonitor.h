@@ -0,0 +1,165 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef PLANNINGSCENEMONITOR_H_
+#define PLANNINGSCENEMONITOR_H_
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <sensor_msgs/JointState.h>
+#include <arm_navigation_msgs/PlanningScene.h>
+#include <arm_navigation_msgs/RobotState.h>
+#include <arm_navigation_msgs/CollisionObject.h>
+#include <arm_navigation_msgs/AttachedCollisionObject.h>
+#include <arm_navigation_msgs/SetPlanningSceneDiff.h>
+#include <planning_environment/models/collision_models.h>
+#include <planning_environment/models/model_utils.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+
+namespace mtconnect_cnc_robot_example
+{
+
+class PlanningSceneMonitor;
+typedef boost::shared_ptr<PlanningSceneMonitor> PlanningSceneMonitorPtr;
+typedef boost::shared_ptr<planning_environment::CollisionModels> CollisionModelsPtr;
+
+// defaults and constants
+static const std::string DEFAULT_JOINT_STATES_TOPIC = "joint_states";
+static const std::string DEFAULT_COLLISION_OBJECT_TOPIC = "collision_object";
+static const std::string DEFAULT_ATTACHED_COLLISION_OBJECT_TOPIC = "attached_collision_object";
+static const std::string DEFAULT_ROBOT_DESCRIPTION = "robot_description";
+static const double DEFAULT_SCENE_STALE_TIMEOUT = 1.0f; // seconds without joint states before the scene is considered stale
+static const double DEFAULT_SCENE_SYNC_TIMEOUT = 5.0f; // seconds to wait for the planning scene diff service
+static const double JOINT_STATE_TOLERANCE = 1e-5f; // radians (or meters), smaller joint changes don't bump the version
+
+/*
+ * Keeps a local copy of the planning scene up to date from incremental updates (joint states
+ * and collision object diffs) so that arm start states can be served from memory.  The complete
+ * scene is requested from the environment server only once at startup, or again if the monitor
+ * stops receiving joint states.  Every change to the local scene bumps a version number which is
+ * returned alongside the start state.
+ */
+class PlanningSceneMonitor
+{
+public:
+	PlanningSceneMonitor(planning_environment::CollisionModels *models);
+
+	/*
+	 * Keeps the collision models alive for as long as the monitor exists
+	 */
+	PlanningSceneMonitor(CollisionModelsPtr models);
+
+	virtual ~PlanningSceneMonitor();
+
+	/*
+	 * Returns the started monitor shared by every arm client of the process (i.e. all the nodelets
+	 * loaded into one manager).  The robot model and collision models are loaded by the first caller
+	 * only, later callers get the same instance as long as one of them holds it.  A collision model
+	 * applies one planning scene at a time, which is why the monitor is shared along with it.  The
+	 * initial scene is requested outside of the process wide lock, a later caller may therefore get
+	 * a monitor that has no scene yet (see getRobotState).
+	 */
+	static PlanningSceneMonitorPtr getShared(const std::string &robot_description = DEFAULT_ROBOT_DESCRIPTION,
+			const std::string &planning_scene_service = "/environment_server/set_planning_scene_diff");
+
+	/*
+	 * Returns the collision models, empty unless the monitor owns them
+	 */
+	CollisionModelsPtr getCollisionModels() const
+	{
+		return owned_models_;
+	}
+
+	/*
+	 * Requests the full scene from the planning scene diff service and subscribes to the incremental
+	 * update topics, the updates are received on a thread of the monitor.
+	 */
+	bool start(const std::string &planning_scene_service = "/environment_server/set_planning_scene_diff");
+
+	/*
+	 * Requests the full scene again and replaces the local copy with it, fails if the service
+	 * doesn't come up within timeout seconds.
+	 */
+	bool resync(double timeout = DEFAULT_SCENE_SYNC_TIMEOUT);
+
+	/*
+	 * Fills robot_state with the current robot state of the local scene.  Returns false when the
+	 * scene has not been received yet or no joint states arrived within the stale timeout.
+	 */
+	bool getRobotState(arm_navigation_msgs::RobotState &robot_state, unsigned int &version);
+
+	bool isStale() const;
+
+	unsigned int getVersion() const;
+
+	void setStaleTimeout(double seconds);
+
+protected:
+
+	void jointStatesCallback(const sensor_msgs::JointStateConstPtr &msg);
+
+	void collisionObjectCallback(const arm_navigation_msgs::CollisionObjectConstPtr &msg);
+
+	void attachedCollisionObjectCallback(const arm_navigation_msgs::AttachedCollisionObjectConstPtr &msg);
+
+	/*
+	 * Applies the local scene message to the collision models, must be called with the lock held.
+	 */
+	bool applyScene();
+
+	/*
+	 * Pushes the latest joint values into the applied kinematic state, must be called with the lock held.
+	 */
+	void applyJointValues();
+
+protected:
+
+	planning_environment::CollisionModels *collision_models_;
+	CollisionModelsPtr owned_models_;
+
+	// the monitor is shared by arm clients that spin their own queues, it spins the updates itself
+	ros::CallbackQueue callback_queue_;
+	boost::shared_ptr<ros::AsyncSpinner> spinner_;
+
+	// ros service clients
+	ros::ServiceClient planning_scene_client_;
+
+	// ros subscribers
+	ros::Subscriber joint_states_sub_;
+	ros::Subscriber collision_object_sub_;
+	ros::Subscriber attached_collision_object_sub_;
+
+	// local scene
+	mutable boost::mutex scene_mutex_;
+	arm_navigation_msgs::PlanningScene planning_scene_;
+	planning_models::KinematicState *kinematic_state_;
+	std::map<std::string,double> joint_values_;
+	bool scene_received_;
+	bool scene_dirty_;   // collision objects changed, scene needs to be re-applied
+	bool joints_dirty_;  // joint values changed, kinematic state needs updating
+	ros::Time last_joint_update_;
+	double stale_timeout_;
+
+	// version bookkeeping
+	unsigned int version_;
+	unsigned int robot_state_version_;
+	arm_navigation_msgs::RobotState robot_state_;
+};
+
+}
+#endif /* PLANNINGSCENEMONITOR_H_ */
@@ -56,6 +56,9 @@
 #include <mtconnect_msgs/RobotSpindle.h>
 #include <mtconnect_msgs/RobotStates.h>
 #include <mtconnect_msgs/SetMTConnectState.h>
+#include <mtconnect_example_msgs/MaterialQueueStatus.h>
+#include <mtconnect_example_utils/material_request_queue.h>
+#include <mtconnect_example_utils/action_monitor.h>
 #include <control_msgs/FollowJointTrajectoryAction.h>
 
 // aliases
@@ -172,7 +175,8 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 
 	public:
 
-		StateMachine();
+		StateMachine(const ros::NodeHandle &nh = ros::NodeHandle(),
+				const ros::NodeHandle &ph = ros::NodeHandle("~"));
 		virtual ~StateMachine();
 
 		virtual void run();
@@ -190,10 +194,26 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 		void material_load_goalcb(/*const MaterialLoadServer::GoalConstPtr &gh*/);
 		void material_unload_goalcb(/*const MaterialUnloadServer::GoalConstPtr &gh*/);
 
+		/*
+		 * Material requests received while busy are queued and accepted from the READY state,
+		 * queue_material_request returns false when the request must be rejected instead.
+		 */
+		bool queue_material_request(const std::string &name);
+		bool admit_material_request();
+		void publish_material_queue();
+
+		/*
+		 * A task goal that runs past its deadline (see ActionMonitor) is a stall, the caller
+		 * raises the fault of the subsystem.  finish_task records the latency of a completed task.
+		 */
+		bool is_task_stalled();
+		void finish_task();
+
 		// wrappers for sending a goal to a move arm server
 		bool moveArm(const geometry_msgs::PoseArray &cartesian_poses)
 		{
-			MoveArmActionClient::moveArm(cartesian_poses,false);
+			// the whole sequence runs on the executor, progress is polled through move_arm_handle_
+			return MoveArmActionClient::moveArm(cartesian_poses,false);
 		}
 
 		bool moveArm(move_arm_utils::JointStateInfo &joint_info);
@@ -220,7 +240,12 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 		void cancel_active_action_goals();
 		void get_param_force_fault_flags();
 		bool get_param_fault_on_task_check(int task_id);
-		bool all_action_servers_connected();
+
+		/*
+		 * Checks the servers of the subsystems used by the current task sequence, servers of other
+		 * subsystems may still be missing (degraded mode)
+		 */
+		bool task_servers_connected();
 		bool check_arm_at_position(sensor_msgs::JointState &joints, double tolerance);
 
 		// subscriber callback
@@ -289,6 +314,7 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 		// topic publishers (ros bridge components wait for these topics)
 		ros::Publisher robot_states_pub_;
 		ros::Publisher robot_spindle_pub_;
+		ros::Publisher material_queue_pub_;
 
 		// topic subscribers
 		ros::Subscriber robot_status_sub_;
@@ -306,6 +332,13 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 		// robot state messages
 		mtconnect_msgs::RobotStates robot_state_msg_;
 		mtconnect_msgs::RobotSpindle robot_spindle_msg_;
+		mtconnect_example_msgs::MaterialQueueStatus material_queue_msg_;
+
+		// material requests waiting for the READY state
+		mtconnect_example_utils::MaterialRequestQueue material_queue_;
+
+		// task goal deadlines derived from the task latencies
+		mtconnect_example_utils::ActionMonitor action_monitor_;
 
 		// service req/res
 		mtconnect_msgs::SetMTConnectState mat_load_set_state_;
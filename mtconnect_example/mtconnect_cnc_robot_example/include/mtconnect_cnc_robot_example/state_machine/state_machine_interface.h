@@ -142,6 +142,11 @@ namespace mtconnect_cnc_robot_example {	namespace state_machine	{
 		void get_param_state_override(std::string name_space = "state_override")
 		{
 			ros::NodeHandle nh("~");
+			get_param_state_override(nh,name_space);
+		}
+
+		void get_param_state_override(ros::NodeHandle &nh,std::string name_space = "state_override")
+		{
 			int state = states::EMPTY;
 			if(nh.getParam(name_space,state) && state != states::EMPTY)
 			{
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef PARAMETER_LOADER_H_
+#define PARAMETER_LOADER_H_
+
+#include <mtconnect_cnc_robot_example/utilities/utilities.h>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <vector>
+
+namespace move_arm_utils
+{
+
+/*
+ * Fetches a whole parameter namespace from the master in a single call and decodes the typed
+ * parameter structs from the cached tree.  Decoded structs can be written to a binary snapshot;
+ * when a later startup finds a snapshot entry whose parameter hash matches the current value, the
+ * struct is deserialized from the snapshot instead of being parsed again.
+ */
+class ParameterLoader
+{
+public:
+
+	enum EntryType
+	{
+		CARTESIAN_TRAJECTORY = 1,
+		PICKUP_GOAL = 2,
+		PLACE_GOAL = 3,
+		JOINT_STATE = 4
+	};
+
+	/*
+	 * An empty name space loads the node's name space, keys are then resolved the same way as the
+	 * fetchParameters methods resolve them (private "~" keys included).
+	 */
+	ParameterLoader(std::string name_space = "");
+
+	/*
+	 * Fetches the name space, this is the only master call made by the loader
+	 */
+	bool load();
+
+	/*
+	 * Uses an already fetched name space tree instead of calling the master.  Loading again (i.e. on a
+	 * parameter reload) keeps the structs fetched so far, only structs whose parameters changed are
+	 * parsed again.
+	 */
+	bool load(const XmlRpc::XmlRpcValue &root);
+
+	bool getParam(const std::string &key, XmlRpc::XmlRpcValue &val);
+
+	bool getParam(const std::string &key, std::string &val);
+
+	bool getParam(const std::string &key, bool &val);
+
+	bool fetch(const std::string &key, CartesianTrajectory &val);
+
+	bool fetch(const std::string &key, PickupGoalInfo &val);
+
+	bool fetch(const std::string &key, PlaceGoalInfo &val);
+
+	bool fetch(const std::string &key, JointStateInfo &val);
+
+	/*
+	 * Reads snapshot entries, entries are only used if their hash still matches the parameters
+	 */
+	bool readSnapshot(const std::string &file_name);
+
+	/*
+	 * Writes every struct fetched so far, does nothing if all of them came from the snapshot
+	 */
+	bool writeSnapshot(const std::string &file_name);
+
+	/*
+	 * Structs decoded from the snapshot or an earlier load since the last load
+	 */
+	unsigned int getSnapshotHits()
+	{
+		return snapshot_hits_;
+	}
+
+	/*
+	 * Keys of the structs parsed from their parameters since the last load
+	 */
+	const std::vector<std::string>& getParsedKeys()
+	{
+		return parsed_keys_;
+	}
+
+	static boost::uint64_t hashValue(XmlRpc::XmlRpcValue &val);
+
+protected:
+
+	struct Entry
+	{
+		boost::uint32_t type_;
+		boost::uint64_t hash_;
+		std::vector<boost::uint8_t> data_;
+	};
+
+	void resolveNameSpace();
+
+	/*
+	 * Looks up an entry matching the key, type and hash of the current parameter value, entries of
+	 * an earlier load come first, then the snapshot.
+	 */
+	const Entry* findSnapshotEntry(const std::string &key, EntryType type, boost::uint64_t hash);
+
+	void storeEntry(const std::string &key, EntryType type, boost::uint64_t hash, const std::vector<boost::uint8_t> &data);
+
+protected:
+
+	std::string name_space_;
+	XmlRpc::XmlRpcValue root_;
+	bool loaded_;
+	std::map<std::string,Entry> snapshot_;   // entries read from file
+	std::map<std::string,Entry> fetched_;    // entries for the next snapshot
+	bool snapshot_dirty_;
+	unsigned int snapshot_hits_;
+	std::vector<std::string> parsed_keys_;
+};
+
+}
+
+#endif /* PARAMETER_LOADER_H_ */
@@ -33,6 +33,9 @@
 namespace move_arm_utils
 {
 
+// upper bound on the number of poses in a path visualization message
+static const unsigned int MAX_PATH_MARKER_POSES = 500;
+
 bool parsePoint(XmlRpc::XmlRpcValue &val, geometry_msgs::Point &point);
 
 bool parseOrientation(XmlRpc::XmlRpcValue &val, geometry_msgs::Quaternion &q);
@@ -72,7 +75,11 @@ public:
 
 	bool parseParameters(XmlRpc::XmlRpcValue &paramVal);
 
-	void getMarker(nav_msgs::Path &p);
+	/*
+	 * Rebuilds p from the cartesian points, long trajectories are subsampled down to max_poses
+	 * (the last point is always kept).
+	 */
+	void getMarker(nav_msgs::Path &p, unsigned int max_poses = MAX_PATH_MARKER_POSES) const;
 
 	bool fetchParameters(std::string nameSpace= "/cartesian_trajectory");
 
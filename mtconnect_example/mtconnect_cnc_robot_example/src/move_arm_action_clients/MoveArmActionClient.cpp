@@ -17,19 +17,52 @@
 
 #include <mtconnect_cnc_robot_example/move_arm_action_clients/MoveArmActionClient.h>
 #include <arm_navigation_msgs/utils.h>
+#include <boost/bind.hpp>
 
 using namespace mtconnect_cnc_robot_example;
 
-MoveArmActionClient::MoveArmActionClient()
-:
-	move_arm_client_ptr_()
+/*
+ * Waits for an action client goal in short slices so that cancel requests are honored promptly.
+ * Returns true once the goal finished, state is only set when the wait was cut short.
+ */
+template<class ClientPtr>
+static bool waitForGoal(ClientPtr client,const MoveArmHandlePtr &handle,const ros::Time &deadline,
+		MoveArmHandle::State &state)
 {
+	while(!client->waitForResult(ros::Duration(DURATION_RESULT_POLL)))
+	{
+		if(handle->isCancelRequested())
+		{
+			client->cancelGoal();
+			state = MoveArmHandle::CANCELED;
+			return false;
+		}
 
+		if(!ros::ok() || ros::Time::now() > deadline)
+		{
+			client->cancelGoal();
+			state = MoveArmHandle::TIMED_OUT;
+			return false;
+		}
+	}
+
+	return true;
 }
 
-MoveArmActionClient::~MoveArmActionClient()
+MoveArmActionClient::MoveArmActionClient(const ros::NodeHandle &nh, const ros::NodeHandle &ph)
+:
+	nh_(nh),
+	ph_(ph),
+	move_arm_client_ptr_(),
+	executor_running_(false)
 {
+	nh_.setCallbackQueue(&callback_queue_);
+	ph_.setCallbackQueue(&callback_queue_);
+}
 
+MoveArmActionClient::~MoveArmActionClient()
+{
+	stopExecutor();
 }
 
 void MoveArmActionClient::run()
@@ -41,7 +74,7 @@ void MoveArmActionClient::run()
 		return;
 	}
 
-	ros::AsyncSpinner spinner(2);
+	ros::AsyncSpinner spinner(2,&callback_queue_);
 	spinner.start();
 
 	// producing cartesian goals in term of arm base and tip link
@@ -65,114 +98,344 @@ void MoveArmActionClient::run()
  * Takes and array of poses where each pose is the desired tip link pose described in terms of the arm base
  */
 bool MoveArmActionClient::moveArm(const geometry_msgs::PoseArray &cartesian_poses, bool wait_for_completion)
+{
+	if(cartesian_poses.poses.empty())
+	{
+		return false;
+	}
+
+	move_arm_handle_ = moveArmAsync(cartesian_poses);
+	if(!wait_for_completion)
+	{
+		return true;
+	}
+
+	return move_arm_handle_->wait();
+}
+
+MoveArmHandlePtr MoveArmActionClient::moveArmAsync(const geometry_msgs::PoseArray &cartesian_poses,
+		const ros::Duration &pose_timeout, bool gated)
+{
+	MoveArmHandlePtr handle(new MoveArmHandle(cartesian_poses,pose_timeout,gated));
+	{
+		boost::mutex::scoped_lock lock(executor_mutex_);
+		executor_queue_.push_back(handle);
+	}
+	executor_condition_.notify_one();
+
+	ROS_INFO_STREAM(ros::this_node::getName()<<": Queued Cartesian Goal with "<<cartesian_poses.poses.size()<<" via points");
+	return handle;
+}
+
+void MoveArmActionClient::cancelMoveArm(bool wait)
+{
+	std::deque<MoveArmHandlePtr> queued;
+	MoveArmHandlePtr active;
+	{
+		boost::mutex::scoped_lock lock(executor_mutex_);
+		queued.swap(executor_queue_);
+		if(active_handle_)
+		{
+			active_handle_->cancel();
+			active = active_handle_;
+		}
+	}
+
+	// queued sequences never started, finishing them here
+	std::deque<MoveArmHandlePtr>::iterator i;
+	for(i = queued.begin(); i != queued.end(); i++)
+	{
+		std::vector<MoveArmHandle::Continuation> continuations = (*i)->setDone(MoveArmHandle::CANCELED);
+		for(unsigned int j = 0; j < continuations.size(); j++)
+		{
+			continuations[j](*i);
+		}
+	}
+
+	// the executor cancels the goal of the active sequence on its own thread
+	if(wait && active)
+	{
+		active->wait();
+	}
+}
+
+void MoveArmActionClient::startExecutor()
+{
+	boost::mutex::scoped_lock lock(executor_mutex_);
+	if(!executor_running_)
+	{
+		executor_running_ = true;
+		executor_thread_ = boost::thread(boost::bind(&MoveArmActionClient::executorLoop,this));
+	}
+}
+
+void MoveArmActionClient::stopExecutor()
+{
+	{
+		boost::mutex::scoped_lock lock(executor_mutex_);
+		if(!executor_running_)
+		{
+			return;
+		}
+		executor_running_ = false;
+	}
+
+	cancelMoveArm();
+	executor_condition_.notify_all();
+	executor_thread_.join();
+}
+
+void MoveArmActionClient::executorLoop()
+{
+	while(true)
+	{
+		MoveArmHandlePtr handle;
+		{
+			boost::mutex::scoped_lock lock(executor_mutex_);
+			while(executor_running_ && executor_queue_.empty())
+			{
+				executor_condition_.wait(lock);
+			}
+
+			if(!executor_running_)
+			{
+				break;
+			}
+
+			handle = executor_queue_.front();
+			executor_queue_.pop_front();
+			active_handle_ = handle;
+		}
+
+		MoveArmHandle::State state = executePoseSequence(handle);
+		{
+			boost::mutex::scoped_lock lock(executor_mutex_);
+			active_handle_.reset();
+		}
+
+		// continuations run outside of the lock so that they can queue new sequences
+		std::vector<MoveArmHandle::Continuation> continuations = handle->setDone(state);
+		for(unsigned int i = 0; i < continuations.size(); i++)
+		{
+			continuations[i](handle);
+		}
+	}
+}
+
+MoveArmHandle::State MoveArmActionClient::executePoseSequence(const MoveArmHandlePtr &handle)
 {
 	using namespace arm_navigation_msgs;
 
-	ROS_INFO_STREAM(ros::this_node::getName()<<": Sending Cartesian Goal with "<<cartesian_poses.poses.size()<<" via points");
-	bool success = !cartesian_poses.poses.empty();
-	std::vector<geometry_msgs::Pose>::const_iterator i;
-	for(i = cartesian_poses.poses.begin(); i != cartesian_poses.poses.end();i++)
+	const std::vector<geometry_msgs::Pose> &poses = handle->poses_.poses;
+	ROS_INFO_STREAM(ros::this_node::getName()<<": Sending Cartesian Goal with "<<poses.size()<<" via points");
+	if(poses.empty())
+	{
+		return MoveArmHandle::FAILED;
+	}
+
+	for(unsigned int i = 0; i < poses.size(); i++)
 	{
+		if(handle->isCancelRequested())
+		{
+			return MoveArmHandle::CANCELED;
+		}
+		handle->setActive(i);
+
 		// clearing goal
 		move_arm_goal_.motion_plan_request.goal_constraints.position_constraints.clear();
 		move_arm_goal_.motion_plan_request.goal_constraints.orientation_constraints.clear();
 		move_arm_goal_.motion_plan_request.goal_constraints.joint_constraints.clear();
 		move_arm_goal_.motion_plan_request.goal_constraints.visibility_constraints.clear();
 
-		//tf::poseTFToMsg(*i,move_pose_constraint_.pose);
-		move_pose_constraint_.pose = *i;
+		move_pose_constraint_.pose = poses[i];
 		arm_navigation_msgs::addGoalConstraintToMoveArmGoal(move_pose_constraint_,move_arm_goal_);
 
+		// move_arm plans and executes in one goal, the portfolio and gated handles (planned ahead of
+		// the gate) bypass it
+		if(!planner_portfolio_.empty() || handle->isGated())
+		{
+			MoveArmHandle::State state = executePlannedGoal(handle);
+			if(state != MoveArmHandle::SUCCEEDED)
+			{
+				return state;
+			}
+			continue;
+		}
+
 		// sending goal
 		move_arm_client_ptr_->sendGoal(move_arm_goal_);
 
-		if(!wait_for_completion)
+		MoveArmHandle::State state;
+		if(!waitForGoal(move_arm_client_ptr_,handle,ros::Time::now() + handle->pose_timeout_,state))
 		{
-			return success;
+			ROS_ERROR_STREAM(ros::this_node::getName()<<": Goal "<<MoveArmHandle::stateToString(state)<<" at via point "<<i);
+			return state;
 		}
 
-		success = move_arm_client_ptr_->waitForResult(ros::Duration(DURATION_WAIT_RESULT));
-		if(success)
+		if(actionlib::SimpleClientGoalState::SUCCEEDED == move_arm_client_ptr_->getState().state_)
 		{
-			success = actionlib::SimpleClientGoalState::SUCCEEDED == move_arm_client_ptr_->getState().state_;
-			if(success)
-			{
-				ROS_INFO_STREAM(ros::this_node::getName()<<": Goal Achieved");
-			}
-			else
-			{
-				ROS_ERROR_STREAM(ros::this_node::getName()<<": Goal Rejected with error flag: "
-						<<(unsigned int)move_arm_client_ptr_->getState().state_);
-				break;
-			}
+			ROS_INFO_STREAM(ros::this_node::getName()<<": Goal Achieved");
 		}
 		else
 		{
-			move_arm_client_ptr_->cancelGoal();
-			ROS_ERROR_STREAM(ros::this_node::getName()<<": Goal Failed with error flag: "
+			ROS_ERROR_STREAM(ros::this_node::getName()<<": Goal Rejected with error flag: "
 					<<(unsigned int)move_arm_client_ptr_->getState().state_);
-			break;
+			return MoveArmHandle::FAILED;
 		}
 	}
 
-	return success;
+	return MoveArmHandle::SUCCEEDED;
 }
 
-bool MoveArmActionClient::fetchParameters(std::string nameSpace)
+MoveArmHandle::State MoveArmActionClient::executePlannedGoal(const MoveArmHandlePtr &handle)
 {
-	ros::NodeHandle nh("~");
+	using namespace arm_navigation_msgs;
+
+	// planning from the locally tracked start state
+	MotionPlanRequest request = move_arm_goal_.motion_plan_request;
+	if(!getArmStartState(arm_group_,request.start_state))
+	{
+		return MoveArmHandle::FAILED;
+	}
+
+	GetMotionPlan::Response plan;
+	if(!planner_portfolio_.empty())
+	{
+		int winner;
+		ros::Duration planning_timeout = request.allowed_planning_time * DEFAULT_PATH_PLANNING_ATTEMPTS;
+		if(!planner_portfolio_.plan(request,plan,planning_timeout,winner,
+				boost::bind(&MoveArmHandle::isCancelRequested,handle.get())))
+		{
+			return handle->isCancelRequested() ? MoveArmHandle::CANCELED : MoveArmHandle::FAILED;
+		}
+	}
+	else
+	{
+		// single planner, the same service move_arm would have used
+		GetMotionPlan srv;
+		srv.request.motion_plan_request = request;
+		std::string planner_service = move_arm_goal_.planner_service_name.empty() ?
+				DEFAULT_PATH_PLANNER : move_arm_goal_.planner_service_name;
+		if(!ros::service::call(planner_service,srv) || srv.response.error_code.val != ArmNavigationErrorCodes::SUCCESS
+				|| srv.response.trajectory.joint_trajectory.points.empty())
+		{
+			ROS_ERROR_STREAM(ros::this_node::getName()<<": Planner '"<<planner_service<<"' produced no valid plan");
+			return handle->isCancelRequested() ? MoveArmHandle::CANCELED : MoveArmHandle::FAILED;
+		}
+		plan = srv.response;
+	}
+
+	// smoothing and time parameterization
+	FilterJointTrajectoryWithConstraints filter;
+	filter.request.trajectory = plan.trajectory.joint_trajectory;
+	filter.request.group_name = arm_group_;
+	filter.request.start_state = request.start_state;
+	filter.request.path_constraints = request.path_constraints;
+	filter.request.goal_constraints = request.goal_constraints;
+	filter.request.allowed_time = ros::Duration(DEFAULT_PATH_PLANNING_TIME);
+	if(!filter_trajectory_client_.call(filter) || filter.response.error_code.val != ArmNavigationErrorCodes::SUCCESS)
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Failed to filter planned trajectory");
+		return MoveArmHandle::FAILED;
+	}
+
+	// the plan is ready, holding execution until the gate opens
+	if(!handle->waitForGate(handle->pose_timeout_))
+	{
+		if(handle->isCancelRequested())
+		{
+			return MoveArmHandle::CANCELED;
+		}
+
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Gate was not opened within "<<handle->pose_timeout_.toSec()
+				<<" seconds, dropping the planned move");
+		return MoveArmHandle::TIMED_OUT;
+	}
+
+	// executing
+	control_msgs::FollowJointTrajectoryGoal goal;
+	goal.trajectory = filter.response.trajectory;
+	follow_trajectory_client_ptr_->sendGoal(goal);
+
+	MoveArmHandle::State state;
+	if(!waitForGoal(follow_trajectory_client_ptr_,handle,ros::Time::now() + handle->pose_timeout_,state))
+	{
+		return state;
+	}
 
-	bool success =  nh.getParam(PARAM_ARM_GROUP,arm_group_) && cartesian_traj_.fetchParameters();
+	if(actionlib::SimpleClientGoalState::SUCCEEDED != follow_trajectory_client_ptr_->getState().state_)
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Trajectory execution failed with error flag: "
+				<<(unsigned int)follow_trajectory_client_ptr_->getState().state_);
+		return MoveArmHandle::FAILED;
+	}
+
+	ROS_INFO_STREAM(ros::this_node::getName()<<": Goal Achieved");
+	return MoveArmHandle::SUCCEEDED;
+}
+
+bool MoveArmActionClient::fetchParameters(std::string nameSpace)
+{
+	bool success =  ph_.getParam(PARAM_ARM_GROUP,arm_group_) && cartesian_traj_.fetchParameters();
 	return success;
 }
 
-void MoveArmActionClient::timerCallback(const ros::TimerEvent &evnt)
+void MoveArmActionClient::setCartesianTrajectory(const CartesianTrajectory &cartesian_traj)
 {
-	// updating msg
+	cartesian_traj_ = cartesian_traj;
+	publishPath();
+}
+
+void MoveArmActionClient::statisticsTimerCallback(const ros::TimerEvent &event)
+{
+	planner_portfolio_.reportStatistics(ph_.getNamespace());
+}
+
+void MoveArmActionClient::publishPath()
+{
+	// rebuilt from scratch, the message never holds more than MAX_PATH_MARKER_POSES poses
 	cartesian_traj_.getMarker(path_msg_);
-	if(!path_msg_.poses.empty())
-	{
-		path_pub_.publish(path_msg_);
-	}
+	path_pub_.publish(path_msg_);
 }
 
 bool MoveArmActionClient::getArmStartState(std::string group_name, arm_navigation_msgs::RobotState &robot_state)
 {
-	using namespace arm_navigation_msgs;
+	unsigned int scene_version;
+	return getArmStartState(group_name,robot_state,scene_version);
+}
 
-	// calling set planning scene service
-	SetPlanningSceneDiff::Request planning_scene_req;
-	SetPlanningSceneDiff::Response planning_scene_res;
-	if(planning_scene_client_.call(planning_scene_req,planning_scene_res))
+bool MoveArmActionClient::getArmStartState(std::string group_name, arm_navigation_msgs::RobotState &robot_state,
+		unsigned int &scene_version)
+{
+	if(!planning_scene_monitor_ptr_)
 	{
-		ROS_INFO_STREAM(ros::this_node::getName()<<": call to set planning scene succeeded");
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": planning scene monitor has not been started");
+		return false;
 	}
-	else
+
+	if(planning_scene_monitor_ptr_->getRobotState(robot_state,scene_version))
+	{
+		return true;
+	}
+
+	// monitor is stale, falling back to a full planning scene request
+	ROS_WARN_STREAM(ros::this_node::getName()<<": planning scene monitor is stale, requesting full planning scene");
+	if(!planning_scene_monitor_ptr_->resync())
 	{
-		ROS_ERROR_STREAM(ros::this_node::getName()<<": call to set planning scene failed");
 		return false;
 	}
 
-	// updating robot kinematic state from planning scene
-	planning_models::KinematicState *st = collision_models_ptr_->setPlanningScene(planning_scene_res.planning_scene);
-	if(st == NULL)
+	if(!planning_scene_monitor_ptr_->getRobotState(robot_state,scene_version))
 	{
 		ROS_ERROR_STREAM(ros::this_node::getName()<<": Kinematic State for arm could not be retrieved from planning scene");
 		return false;
 	}
 
-	planning_environment::convertKinematicStateToRobotState(*st,
-														  ros::Time::now(),
-														  collision_models_ptr_->getWorldFrameId(),
-														  robot_state);
-
-	collision_models_ptr_->revertPlanningScene(st);
 	return true;
 }
 
 bool MoveArmActionClient::setup()
 {
-	ros::NodeHandle nh;
 	bool success = true;
 
 	if(!fetchParameters())
@@ -180,31 +443,38 @@ bool MoveArmActionClient::setup()
 		return false;
 	}
 
-	// setting up action client
-	move_arm_client_ptr_ = MoveArmClientPtr(new MoveArmClient(DEFAULT_MOVE_ARM_ACTION,true));
-	unsigned int attempts = 0;
-	while(attempts++ < MAX_WAIT_ATTEMPTS)
+	// setting up action client, the servers are discovered while the models load
+	move_arm_client_ptr_ = MoveArmClientPtr(new MoveArmClient(nh_,DEFAULT_MOVE_ARM_ACTION,true));
+	discovery_.addAction(DEFAULT_MOVE_ARM_ACTION,SUBSYSTEM_ROBOT,move_arm_client_ptr_);
+	discovery_.start();
+
+	// setting up planner racing, only used when a portfolio is configured
+	if(!planner_portfolio_.fetchParameters(ph_.getNamespace()))
 	{
-		ROS_WARN_STREAM(ros::this_node::getName()<<": waiting for "<<DEFAULT_MOVE_ARM_ACTION<<" server");
-		success = move_arm_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER));
-		if(success)
-		{
-			ROS_INFO_STREAM(ros::this_node::getName()<<": Found "<<DEFAULT_MOVE_ARM_ACTION<<" server");
-			break;
-		}
+		return false;
 	}
 
-	// setting up service clients
-	planning_scene_client_ = nh.serviceClient<arm_navigation_msgs::SetPlanningSceneDiff>(DEFAULT_PLANNING_SCENE_DIFF_SERVICE);
+	// planned execution, used by the portfolio and by gated moves
+	filter_trajectory_client_ = nh_.serviceClient<arm_navigation_msgs::FilterJointTrajectoryWithConstraints>(
+			DEFAULT_FILTER_TRAJECTORY_SERVICE);
+	follow_trajectory_client_ptr_ = FollowTrajectoryClientPtr(new FollowTrajectoryClient(nh_,DEFAULT_FOLLOW_TRAJECTORY_ACTION,true));
+	discovery_.addAction(DEFAULT_FOLLOW_TRAJECTORY_ACTION,SUBSYSTEM_ROBOT,follow_trajectory_client_ptr_,false);
 
-	// setting up ros publishers
-	path_pub_ = nh.advertise<nav_msgs::Path>(DEFAULT_PATH_MSG_TOPIC,1);
+	if(!planner_portfolio_.empty())
+	{
+		// statistics go to the parameter server off the motion path
+		statistics_timer_ = nh_.createTimer(ros::Duration(DURATION_STATISTICS_REPORT),
+				&MoveArmActionClient::statisticsTimerCallback,this);
+	}
 
-	// setting up ros timers
-	publish_timer_ = nh.createTimer(ros::Duration(DURATION_TIMER_CYCLE),&MoveArmActionClient::timerCallback,this);
+	// setting up ros publishers, the path is latched and only republished when the trajectory changes
+	path_pub_ = nh_.advertise<nav_msgs::Path>(DEFAULT_PATH_MSG_TOPIC,1,true);
+	publishPath();
 
-	// obtaining arm info
-	collision_models_ptr_ = CollisionModelsPtr(new planning_environment::CollisionModels("robot_description"));
+	// obtaining arm info, arm clients in the same process share the models and the local scene
+	planning_scene_monitor_ptr_ = PlanningSceneMonitor::getShared(DEFAULT_ROBOT_DESCRIPTION,
+			DEFAULT_PLANNING_SCENE_DIFF_SERVICE);
+	collision_models_ptr_ = planning_scene_monitor_ptr_->getCollisionModels();
 	getArmInfo(collision_models_ptr_.get(),arm_group_,base_link_frame_id_,tip_link_frame_id_);
 
 	// initializing move arm request members
@@ -223,6 +493,25 @@ bool MoveArmActionClient::setup()
 	move_pose_constraint_.absolute_pitch_tolerance = DEFAULT_ORIENTATION_TOLERANCE;
 	move_pose_constraint_.absolute_yaw_tolerance = DEFAULT_ORIENTATION_TOLERANCE;
 
+	// waiting for the servers of this and of the derived clients
+	if(!discovery_.isAllFound())
+	{
+		ROS_INFO_STREAM(ros::this_node::getName()<<": waiting for "<<discovery_.getMissingString());
+	}
+	if(!discovery_.waitForAll(ros::Duration(MAX_WAIT_ATTEMPTS * DURATION_WAIT_SERVER)))
+	{
+		ROS_WARN_STREAM(ros::this_node::getName()<<": servers not found: "<<discovery_.getMissingString());
+	}
+
+	if(!discovery_.isFound(DEFAULT_MOVE_ARM_ACTION))
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": "<<DEFAULT_MOVE_ARM_ACTION<<" server was not found");
+		success = false;
+	}
+
+	// pose sequences are executed on their own thread
+	startExecutor();
+
 	return success;
 }
 
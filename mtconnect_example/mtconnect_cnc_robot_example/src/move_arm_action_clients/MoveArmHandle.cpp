@@ -0,0 +1,180 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/MoveArmHandle.h>
+
+using namespace mtconnect_cnc_robot_example;
+
+MoveArmHandle::MoveArmHandle(const geometry_msgs::PoseArray &poses, const ros::Duration &pose_timeout, bool gated)
+:
+	poses_(poses),
+	pose_timeout_(pose_timeout),
+	gated_(gated),
+	state_(PENDING),
+	current_pose_(0),
+	cancel_requested_(false),
+	gate_open_(!gated)
+{
+
+}
+
+MoveArmHandle::~MoveArmHandle()
+{
+
+}
+
+MoveArmHandle::State MoveArmHandle::getState() const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return state_;
+}
+
+bool MoveArmHandle::isDone() const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return state_ != PENDING && state_ != ACTIVE;
+}
+
+bool MoveArmHandle::succeeded() const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return state_ == SUCCEEDED;
+}
+
+unsigned int MoveArmHandle::getCurrentPose() const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return current_pose_;
+}
+
+bool MoveArmHandle::wait(const ros::Duration &timeout)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	ros::Time deadline = ros::Time::now() + timeout;
+	while(state_ == PENDING || state_ == ACTIVE)
+	{
+		if(timeout.isZero())
+		{
+			done_condition_.wait(lock);
+		}
+		else
+		{
+			ros::Duration remaining = deadline - ros::Time::now();
+			if(remaining <= ros::Duration(0))
+			{
+				return false;
+			}
+			done_condition_.timed_wait(lock,boost::posix_time::milliseconds(remaining.toSec()*1000));
+		}
+	}
+
+	return state_ == SUCCEEDED;
+}
+
+void MoveArmHandle::cancel()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		cancel_requested_ = true;
+	}
+	gate_condition_.notify_all();
+}
+
+bool MoveArmHandle::isCancelRequested() const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return cancel_requested_;
+}
+
+void MoveArmHandle::openGate()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		gate_open_ = true;
+	}
+	gate_condition_.notify_all();
+}
+
+bool MoveArmHandle::waitForGate(const ros::Duration &timeout)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout.toSec()*1000);
+	while(!gate_open_ && !cancel_requested_)
+	{
+		if(!gate_condition_.timed_wait(lock,deadline))
+		{
+			return gate_open_ && !cancel_requested_;
+		}
+	}
+
+	return !cancel_requested_;
+}
+
+MoveArmHandlePtr MoveArmHandle::then(const Continuation &continuation)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if(state_ == PENDING || state_ == ACTIVE)
+		{
+			continuations_.push_back(continuation);
+			return shared_from_this();
+		}
+	}
+
+	// already done
+	continuation(shared_from_this());
+	return shared_from_this();
+}
+
+std::string MoveArmHandle::stateToString(State state)
+{
+	switch(state)
+	{
+	case PENDING:
+		return "PENDING";
+	case ACTIVE:
+		return "ACTIVE";
+	case SUCCEEDED:
+		return "SUCCEEDED";
+	case FAILED:
+		return "FAILED";
+	case CANCELED:
+		return "CANCELED";
+	case TIMED_OUT:
+		return "TIMED_OUT";
+	}
+
+	return "UNKNOWN";
+}
+
+void MoveArmHandle::setActive(unsigned int pose_index)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	state_ = ACTIVE;
+	current_pose_ = pose_index;
+}
+
+std::vector<MoveArmHandle::Continuation> MoveArmHandle::setDone(State state)
+{
+	std::vector<Continuation> continuations;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		state_ = state;
+		continuations.swap(continuations_);
+	}
+	done_condition_.notify_all();
+	return continuations;
+}
@@ -17,16 +17,33 @@
 
 #include <mtconnect_cnc_robot_example/move_arm_action_clients/MovePickPlaceServer.h>
 #include <boost/bind.hpp>
+#include <algorithm>
 
 // aliases
 typedef actionlib::SimpleClientGoalState GoalState;
 
 using namespace mtconnect_cnc_robot_example;
 
-MovePickPlaceServer::MovePickPlaceServer() :
-	MoveArmActionClient(),
+// continuation that keeps a queued move from running after the move it depends on failed
+static void cancelOnFailure(const MoveArmHandlePtr &done, MoveArmHandlePtr next)
+{
+	if(!done->succeeded())
+	{
+		next->cancel();
+	}
+}
+
+MovePickPlaceServer::MovePickPlaceServer(const ros::NodeHandle &nh, const ros::NodeHandle &ph) :
+	MoveArmActionClient(nh,ph),
 	pickup_gh_(),
-	place_gh_()
+	place_gh_(),
+	executors_running_(false),
+	pickup_active_(false),
+	place_active_(false),
+	pickup_preempt_(false),
+	place_preempt_(false),
+	active_preempt_(NULL),
+	overlap_gripper_motion_(false)
 {
 	// TODO Auto-generated constructor stub
 
@@ -34,7 +51,7 @@ MovePickPlaceServer::MovePickPlaceServer() :
 
 MovePickPlaceServer::~MovePickPlaceServer()
 {
-	// TODO Auto-generated destructor stub
+	stopExecutors();
 }
 
 void MovePickPlaceServer::run()
@@ -44,16 +61,18 @@ void MovePickPlaceServer::run()
 		return;
 	}
 
-	ros::AsyncSpinner spinner(2);
+	// only the queue of this server, other servers in a nodelet manager spin their own
+	ros::AsyncSpinner spinner(2,&callback_queue_);
 	spinner.start();
 
 	// starting servers;
 	arm_pickup_server_ptr_->start();
 	arm_place_server_ptr_->start();
 
+	// interruptible, a nodelet stops the loop when it is unloaded
 	while(ros::ok())
 	{
-		ros::Duration(DURATION_LOOP_PAUSE).sleep();
+		boost::this_thread::sleep(boost::posix_time::milliseconds(DURATION_LOOP_PAUSE * 1000));
 	}
 }
 
@@ -79,8 +98,8 @@ void MovePickPlaceServer::run()
 
 bool MovePickPlaceServer::fetchParameters(std::string name_space)
 {
-	ros::NodeHandle nh("~");
-	bool success =  nh.getParam(PARAM_ARM_GROUP,arm_group_);
+	bool success =  ph_.getParam(PARAM_ARM_GROUP,arm_group_);
+	ph_.param(PARAM_OVERLAP_GRIPPER_MOTION,overlap_gripper_motion_,false);
 	if(success)
 	{
 		ROS_INFO_STREAM("Successfully read setup parameters");
@@ -95,46 +114,49 @@ bool MovePickPlaceServer::fetchParameters(std::string name_space)
 
 bool MovePickPlaceServer::setup()
 {
-	int wait_attempts = 0;
-	ros::NodeHandle nh;
+	// setting up grasp action client, discovered together with the move arm servers
+	ROS_INFO_STREAM("Setting up grasp client");
+	grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(nh_,DEFAULT_GRASP_ACTION,true));
+	discovery_.addAction(DEFAULT_GRASP_ACTION,SUBSYSTEM_GRIPPER,grasp_action_client_ptr_);
 
 	if(!MoveArmActionClient::setup())
 	{
 		return false;
 	}
 
+	if(!discovery_.isFound(DEFAULT_GRASP_ACTION))
+	{
+		ROS_ERROR_STREAM("Grasp action service was not found");
+		return false;
+	}
+
 	// setting up pickup server
 	ROS_INFO_STREAM("Setting up pickup server");
-	arm_pickup_server_ptr_  = MoveArmPickupServerPtr(new MoveArmPickupServer(nh,DEFAULT_PICKUP_ACTION,
+	arm_pickup_server_ptr_  = MoveArmPickupServerPtr(new MoveArmPickupServer(nh_,DEFAULT_PICKUP_ACTION,
 			boost::bind(&MovePickPlaceServer::pickupGoalCallback,this, _1),
 			boost::bind(&MovePickPlaceServer::pickupCancelCallback,this,_1),
 			false));
 
 	// setting up place server
 	ROS_INFO_STREAM("Setting up place server");
-	arm_place_server_ptr_  = MoveArmPlaceServerPtr(new MoveArmPlaceServer(nh,DEFAULT_PLACE_ACTION,
+	arm_place_server_ptr_  = MoveArmPlaceServerPtr(new MoveArmPlaceServer(nh_,DEFAULT_PLACE_ACTION,
 			boost::bind(&MovePickPlaceServer::placeGoalCallback,this, _1),
 			boost::bind(&MovePickPlaceServer::placeCancelCallback,this,_1),
 			false));
 
-	// setting up grasp action client
-	ROS_INFO_STREAM("Setting up grasp client");
-	grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(DEFAULT_GRASP_ACTION,true));
-	while(!grasp_action_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER)))
-	{
-		ROS_WARN_STREAM("Waiting for grasp action server "<<DEFAULT_GRASP_ACTION);
-		if(wait_attempts++ > MAX_WAIT_ATTEMPTS)
-		{
-			ROS_ERROR_STREAM("Grasp action service was not found");
-			return false;
-		}
-	}
+	// goals are executed off the actionlib callback threads
+	startExecutors();
 
 	return true;
 }
 
 bool MovePickPlaceServer::moveArmThroughPickSequence(const object_manipulation_msgs::PickupGoal &pickup_goal)
 {
+	if(overlap_gripper_motion_)
+	{
+		return moveArmThroughPickSequenceOverlapped(pickup_goal);
+	}
+
 	// declaring cartesian path and grasp moves
 	geometry_msgs::PoseArray pick_pose_sequence;
 	geometry_msgs::PoseArray temp_pick_sequence;
@@ -159,20 +181,14 @@ bool MovePickPlaceServer::moveArmThroughPickSequence(const object_manipulation_m
 	// requesting gripper pre-grasp move
 	grasp_goal.goal = GraspGoal::PRE_GRASP;
 	grasp_action_client_ptr_->sendGoal(grasp_goal);
-	if(grasp_action_client_ptr_->waitForResult(ros::Duration(DURATION_WAIT_GRASP_RESULT)))
-	{
-		ROS_INFO_STREAM(ros::this_node::getName()<<": Pre-graps Gripper Move Achieved");
-	}
-	else
+	if(isPreemptRequested() || !waitForGraspResult("Pre-grasp"))
 	{
-		ROS_ERROR_STREAM(ros::this_node::getName()<<": Pre-grasp Gripper Move Rejected with error flag: "
-								<<(unsigned int)grasp_action_client_ptr_->getState().state_);
 		return false;
 	}
 
 	// moving arm to pick pose
 	temp_pick_sequence.poses.assign(1,*(pick_pose_sequence.poses.begin() + 1));
-	if(moveArm(temp_pick_sequence))
+	if(!isPreemptRequested() && moveArm(temp_pick_sequence))
 	{
 		ROS_INFO_STREAM(ros::this_node::getName()<<": Pick Arm Move Achieved");
 	}
@@ -185,20 +201,14 @@ bool MovePickPlaceServer::moveArmThroughPickSequence(const object_manipulation_m
 	// requesting gripper grasp move
 	grasp_goal.goal = GraspGoal::GRASP;
 	grasp_action_client_ptr_->sendGoal(grasp_goal);
-	if(grasp_action_client_ptr_->waitForResult(ros::Duration(DURATION_WAIT_GRASP_RESULT)))
-	{
-		ROS_INFO_STREAM(ros::this_node::getName()<<": Grasp Gripper Move Achieved");
-	}
-	else
+	if(isPreemptRequested() || !waitForGraspResult("Grasp"))
 	{
-		ROS_ERROR_STREAM(ros::this_node::getName()<<": Grasp Gripper Move Rejected with error flag: "
-								<<(unsigned int)grasp_action_client_ptr_->getState().state_);
 		return false;
 	}
 
 	// moving arm to lift pose
 	temp_pick_sequence.poses.assign(1,pick_pose_sequence.poses.back());
-	if(moveArm(temp_pick_sequence))
+	if(!isPreemptRequested() && moveArm(temp_pick_sequence))
 	{
 		ROS_INFO_STREAM(ros::this_node::getName()<<": Lift Arm Moves Achieved");
 	}
@@ -213,6 +223,11 @@ bool MovePickPlaceServer::moveArmThroughPickSequence(const object_manipulation_m
 
 bool MovePickPlaceServer::moveArmThroughPlaceSequence(const object_manipulation_msgs::PlaceGoal &place_goal)
 {
+	if(overlap_gripper_motion_)
+	{
+		return moveArmThroughPlaceSequenceOverlapped(place_goal);
+	}
+
 	// declaring cartesian path and grasp moves
 	geometry_msgs::PoseArray place_pose_sequence;
 	geometry_msgs::PoseArray temp_place_sequence;
@@ -237,20 +252,130 @@ bool MovePickPlaceServer::moveArmThroughPlaceSequence(const object_manipulation_
 	// requesting gripper release move
 	grasp_goal.goal = GraspGoal::RELEASE;
 	grasp_action_client_ptr_->sendGoal(grasp_goal);
-	if(grasp_action_client_ptr_->waitForResult(ros::Duration(DURATION_WAIT_GRASP_RESULT)))
+	if(isPreemptRequested() || !waitForGraspResult("Release"))
+	{
+		return false;
+	}
+
+	// moving arm to retreat pose
+	temp_place_sequence.poses.assign(1,place_pose_sequence.poses.back());
+	if(!isPreemptRequested() && moveArm(temp_place_sequence))
 	{
-		ROS_INFO_STREAM(ros::this_node::getName()<<": Release Gripper Move Achieved");
+		ROS_INFO_STREAM(ros::this_node::getName()<<": Retreat Arm Move Achieved");
 	}
 	else
 	{
-		ROS_ERROR_STREAM(ros::this_node::getName()<<": Release Gripper Move Rejected with error flag: "
-								<<(unsigned int)grasp_action_client_ptr_->getState().state_);
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Retreat Arm Move Failed");
 		return false;
 	}
 
-	// moving arm to retreat pose
-	temp_place_sequence.poses.assign(1,place_pose_sequence.poses.back());
+	return true;
+}
+
+bool MovePickPlaceServer::moveArmThroughPickSequenceOverlapped(const object_manipulation_msgs::PickupGoal &pickup_goal)
+{
+	// declaring cartesian path and grasp moves
+	geometry_msgs::PoseArray pick_pose_sequence;
+	geometry_msgs::PoseArray temp_pick_sequence;
+	GraspGoal grasp_goal;
+
+	// initializing arm path and grasp
+	createPickupMoveSequence(pickup_goal,pick_pose_sequence);
+	grasp_goal.grasp = pickup_goal.desired_grasps[0]; // this might not be needed
+
+	// pre-grasp arm move and gripper pre-shape are independent, both start now
+	temp_pick_sequence.poses.assign(1,pick_pose_sequence.poses.front());
+	MoveArmHandlePtr pre_grasp_move = moveArmAsync(temp_pick_sequence);
+	grasp_goal.goal = GraspGoal::PRE_GRASP;
+	grasp_action_client_ptr_->sendGoal(grasp_goal);
+
+	// pick move is queued behind the pre-grasp move, it may only descend once the gripper is open
+	temp_pick_sequence.poses.assign(1,*(pick_pose_sequence.poses.begin() + 1));
+	MoveArmHandlePtr pick_move = moveArmAsync(temp_pick_sequence,ros::Duration(DURATION_WAIT_RESULT),true);
+	pre_grasp_move->then(boost::bind(&cancelOnFailure,_1,pick_move));
+
+	if(!waitForGraspResult("Pre-grasp"))
+	{
+		cancelMoveArm();
+		return false;
+	}
+	pick_move->openGate();
+
+	if(pre_grasp_move->wait() && pick_move->wait())
+	{
+		ROS_INFO_STREAM(ros::this_node::getName()<<": Pre-grasp and Pick Arm Moves Achieved");
+	}
+	else
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Pre-grasp and Pick Arm Moves Failed");
+		cancelMoveArm();
+		return false;
+	}
+
+	// lift move is planned and filtered while the gripper closes (gated moves are always planned ahead),
+	// it executes once the grasp succeeded
+	grasp_goal.goal = GraspGoal::GRASP;
+	grasp_action_client_ptr_->sendGoal(grasp_goal);
+	temp_pick_sequence.poses.assign(1,pick_pose_sequence.poses.back());
+	MoveArmHandlePtr lift_move = moveArmAsync(temp_pick_sequence,ros::Duration(DURATION_WAIT_RESULT),true);
+
+	if(!waitForGraspResult("Grasp"))
+	{
+		lift_move->cancel();
+		return false;
+	}
+	lift_move->openGate();
+
+	if(lift_move->wait())
+	{
+		ROS_INFO_STREAM(ros::this_node::getName()<<": Lift Arm Moves Achieved");
+	}
+	else
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Lift Arm Move Failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool MovePickPlaceServer::moveArmThroughPlaceSequenceOverlapped(const object_manipulation_msgs::PlaceGoal &place_goal)
+{
+	// declaring cartesian path and grasp moves
+	geometry_msgs::PoseArray place_pose_sequence;
+	geometry_msgs::PoseArray temp_place_sequence;
+	GraspGoal grasp_goal;
+
+	// initializing arm path and grasp
+	createPlaceMoveSequence(place_goal,place_pose_sequence);
+	grasp_goal.grasp = place_goal.grasp; // this might not be needed
+
+	// moving arm through approach and place poses
+	temp_place_sequence.poses.assign(place_pose_sequence.poses.begin(), place_pose_sequence.poses.end()-1);
 	if(moveArm(temp_place_sequence))
+	{
+		ROS_INFO_STREAM(ros::this_node::getName()<<": Approach and Place Arm Moves Achieved");
+	}
+	else
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Approach and Place Arm Moves Failed");
+		return false;
+	}
+
+	// retreat move is planned and filtered while the gripper opens, it executes once the release succeeded
+	grasp_goal.goal = GraspGoal::RELEASE;
+	grasp_action_client_ptr_->sendGoal(grasp_goal);
+	temp_place_sequence.poses.assign(1,place_pose_sequence.poses.back());
+	MoveArmHandlePtr retreat_move = moveArmAsync(temp_place_sequence,ros::Duration(DURATION_WAIT_RESULT),true);
+
+	if(!waitForGraspResult("Release"))
+	{
+		retreat_move->cancel();
+		return false;
+	}
+	retreat_move->openGate();
+
+	if(retreat_move->wait())
 	{
 		ROS_INFO_STREAM(ros::this_node::getName()<<": Retreat Arm Move Achieved");
 	}
@@ -263,125 +388,339 @@ bool MovePickPlaceServer::moveArmThroughPlaceSequence(const object_manipulation_
 	return true;
 }
 
-void MovePickPlaceServer::pickupGoalCallback(PickupGoalHandle gh)
+bool MovePickPlaceServer::waitForGraspResult(const std::string &step_name)
 {
-	const object_manipulation_msgs::PickupGoal &goal = *(gh.getGoal());
-	object_manipulation_msgs::PickupResult res;
+	// waiting in short slices so that a cancel takes effect within one poll period
+	ros::Time deadline = ros::Time::now() + ros::Duration(DURATION_WAIT_GRASP_RESULT);
+	bool finished = false;
+	while(!finished && !isPreemptRequested() && ros::Time::now() < deadline)
+	{
+		finished = grasp_action_client_ptr_->waitForResult(ros::Duration(DURATION_RESULT_POLL));
+	}
 
-	// comparing goal handles
-	if(gh.getGoalStatus().status == GoalState::ACTIVE && pickup_gh_ == gh)
+	if(finished && grasp_action_client_ptr_->getState() == GoalState::SUCCEEDED)
 	{
-		// goal already being handled, ignoring
-		ROS_WARN_STREAM("Pickup goal is already being processed, ignoring request");
-		return;
+		ROS_INFO_STREAM(ros::this_node::getName()<<": "<<step_name<<" Gripper Move Achieved");
+		return true;
 	}
 
-	// canceling current goals first
-	pickup_gh_.getGoalStatus().status == GoalState::ACTIVE ? pickupCancelCallback(pickup_gh_): (void)NULL ;
-	place_gh_.getGoalStatus().status == GoalState::ACTIVE ? placeCancelCallback(place_gh_) :(void) NULL ;
+	ROS_ERROR_STREAM(ros::this_node::getName()<<": "<<step_name<<" Gripper Move Rejected with error flag: "
+							<<(unsigned int)grasp_action_client_ptr_->getState().state_);
+	grasp_action_client_ptr_->cancelGoal();
+	return false;
+}
 
-	// storing goal
-	pickup_gh_ = gh;
-	gh.setAccepted("accepted");
+bool MovePickPlaceServer::isPreemptRequested()
+{
+	boost::mutex::scoped_lock lock(goal_mutex_);
+	return active_preempt_ != NULL && *active_preempt_;
+}
 
-	// processing goal
-	if(moveArmThroughPickSequence(goal))
+void MovePickPlaceServer::startExecutors()
+{
+	boost::mutex::scoped_lock lock(goal_mutex_);
+	executors_running_ = true;
+	pickup_executor_ = boost::thread(boost::bind(&MovePickPlaceServer::pickupExecutorLoop,this));
+	place_executor_ = boost::thread(boost::bind(&MovePickPlaceServer::placeExecutorLoop,this));
+}
+
+void MovePickPlaceServer::stopExecutors()
+{
 	{
-		res.manipulation_result.value = res.manipulation_result.SUCCESS;
-		gh.setSucceeded(res,"Succeeded");
+		boost::mutex::scoped_lock lock(goal_mutex_);
+		if(!executors_running_)
+		{
+			return;
+		}
+		executors_running_ = false;
+		pickup_preempt_ = true;
+		place_preempt_ = true;
 	}
-	else
+
+	goal_condition_.notify_all();
+	cancelMoveArm();
+	pickup_executor_.join();
+	place_executor_.join();
+}
+
+void MovePickPlaceServer::preemptAllGoals(std::vector<PickupGoalHandle> &pickup_goals,
+		std::vector<PlaceGoalHandle> &place_goals)
+{
+	// must be called with the goal lock held, queued goals were never started and are returned
+	// so that the caller can cancel them once the lock is released
+	pickup_goals.insert(pickup_goals.end(),pickup_queue_.begin(),pickup_queue_.end());
+	place_goals.insert(place_goals.end(),place_queue_.begin(),place_queue_.end());
+	pickup_queue_.clear();
+	place_queue_.clear();
+
+	// running goals stop at the next step
+	if(pickup_active_ || place_active_)
 	{
-		res.manipulation_result.value = res.manipulation_result.FAILED;
-		gh.setAborted(res,"Failed");
+		pickup_preempt_ = pickup_active_;
+		place_preempt_ = place_active_;
+		cancelMoveArm();
+		grasp_action_client_ptr_->cancelGoal();
 	}
 }
 
-void MovePickPlaceServer::pickupCancelCallback(PickupGoalHandle gh)
+void MovePickPlaceServer::cancelQueuedGoals(std::vector<PickupGoalHandle> &pickup_goals,
+		std::vector<PlaceGoalHandle> &place_goals)
 {
-	object_manipulation_msgs::PickupResult res;
+	object_manipulation_msgs::PickupResult pickup_res;
+	object_manipulation_msgs::PlaceResult place_res;
+	pickup_res.manipulation_result.value = pickup_res.manipulation_result.CANCELLED;
+	place_res.manipulation_result.value = place_res.manipulation_result.CANCELLED;
 
-	// comparing goal handles
-	if(pickup_gh_ == gh && gh.getGoalStatus().status == GoalState::ACTIVE)
+	for(unsigned int i = 0; i < pickup_goals.size(); i++)
 	{
-		// goal already being handled, ignoring
+		pickup_goals[i].setCanceled(pickup_res,"Preempted");
+	}
+
+	for(unsigned int i = 0; i < place_goals.size(); i++)
+	{
+		place_goals[i].setCanceled(place_res,"Preempted");
+	}
+}
 
-		// checking state of current move arm goal
-		if(move_arm_client_ptr_->getState().state_ == GoalState::ACTIVE)
+/*
+ * Goal handles lock their action server, they are never touched while holding goal_mutex_ since the
+ * action server callbacks take goal_mutex_ with the action server lock held.
+ */
+void MovePickPlaceServer::pickupExecutorLoop()
+{
+	object_manipulation_msgs::PickupResult res;
+	while(true)
+	{
+		PickupGoalHandle gh;
 		{
-			// cancel goal and send new one
-			move_arm_client_ptr_->cancelGoal();
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			while(executors_running_ && pickup_queue_.empty())
+			{
+				goal_condition_.wait(lock);
+			}
+
+			if(!executors_running_)
+			{
+				break;
+			}
+
+			gh = pickup_queue_.front();
+			pickup_queue_.pop_front();
+			pickup_gh_ = gh;
+			pickup_active_ = true;
+			pickup_preempt_ = false;
 		}
+		gh.setAccepted("accepted");
 
-		// checking state of grasp goal
-		if(grasp_action_client_ptr_->getState().state_ == GoalState::ACTIVE)
+		// only one sequence may drive the arm at a time
+		bool success = false;
 		{
-			grasp_action_client_ptr_->cancelGoal();
+			boost::mutex::scoped_lock arm_lock(arm_mutex_);
+			{
+				boost::mutex::scoped_lock lock(goal_mutex_);
+				active_preempt_ = &pickup_preempt_;
+			}
+
+			success = !isPreemptRequested() && moveArmThroughPickSequence(*(gh.getGoal()));
+
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			active_preempt_ = NULL;
 		}
 
-		res.manipulation_result.value = res.manipulation_result.CANCELLED;
-		gh.setCanceled(res,"Canceled");
+		bool preempted;
+		{
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			preempted = pickup_preempt_;
+			pickup_active_ = false;
+		}
 
+		if(preempted)
+		{
+			res.manipulation_result.value = res.manipulation_result.CANCELLED;
+			gh.setCanceled(res,"Canceled");
+		}
+		else if(success)
+		{
+			res.manipulation_result.value = res.manipulation_result.SUCCESS;
+			gh.setSucceeded(res,"Succeeded");
+		}
+		else
+		{
+			res.manipulation_result.value = res.manipulation_result.FAILED;
+			gh.setAborted(res,"Failed");
+		}
 	}
 }
 
-void MovePickPlaceServer::placeGoalCallback(PlaceGoalHandle gh)
+void MovePickPlaceServer::placeExecutorLoop()
 {
-	const object_manipulation_msgs::PlaceGoal &goal = *(gh.getGoal());
 	object_manipulation_msgs::PlaceResult res;
+	while(true)
+	{
+		PlaceGoalHandle gh;
+		{
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			while(executors_running_ && place_queue_.empty())
+			{
+				goal_condition_.wait(lock);
+			}
+
+			if(!executors_running_)
+			{
+				break;
+			}
+
+			gh = place_queue_.front();
+			place_queue_.pop_front();
+			place_gh_ = gh;
+			place_active_ = true;
+			place_preempt_ = false;
+		}
+		gh.setAccepted("accepted");
+
+		// only one sequence may drive the arm at a time
+		bool success = false;
+		{
+			boost::mutex::scoped_lock arm_lock(arm_mutex_);
+			{
+				boost::mutex::scoped_lock lock(goal_mutex_);
+				active_preempt_ = &place_preempt_;
+			}
+
+			success = !isPreemptRequested() && moveArmThroughPlaceSequence(*(gh.getGoal()));
+
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			active_preempt_ = NULL;
+		}
 
-	// comparing handles
-	// comparing goal handles
-	if(gh.getGoalStatus().status == GoalState::ACTIVE && place_gh_ == gh)
+		bool preempted;
+		{
+			boost::mutex::scoped_lock lock(goal_mutex_);
+			preempted = place_preempt_;
+			place_active_ = false;
+		}
+
+		if(preempted)
+		{
+			res.manipulation_result.value = res.manipulation_result.CANCELLED;
+			gh.setCanceled(res,"Canceled");
+		}
+		else if(success)
+		{
+			res.manipulation_result.value = res.manipulation_result.SUCCESS;
+			gh.setSucceeded(res,"Succeeded");
+		}
+		else
+		{
+			res.manipulation_result.value = res.manipulation_result.FAILED;
+			gh.setAborted(res,"Failed");
+		}
+	}
+}
+
+void MovePickPlaceServer::pickupGoalCallback(PickupGoalHandle gh)
+{
+	std::vector<PickupGoalHandle> pickup_goals;
+	std::vector<PlaceGoalHandle> place_goals;
 	{
-		// goal already being handled, ignoring
-		ROS_WARN_STREAM("Place goal is already being processed, ignoring request");
-		return;
+		boost::mutex::scoped_lock lock(goal_mutex_);
+
+		// comparing goal handles
+		if(pickup_active_ && pickup_gh_ == gh)
+		{
+			// goal already being handled, ignoring
+			ROS_WARN_STREAM("Pickup goal is already being processed, ignoring request");
+			return;
+		}
+
+		// canceling current goals first, then handing the new one to the executor
+		preemptAllGoals(pickup_goals,place_goals);
+		pickup_queue_.push_back(gh);
 	}
 
-	// canceling current goals first
-	pickup_gh_.getGoalStatus().status == GoalState::ACTIVE ? pickupCancelCallback(pickup_gh_): (void)NULL ;
-	place_gh_.getGoalStatus().status == GoalState::ACTIVE ? placeCancelCallback(place_gh_) : (void)NULL ;
+	goal_condition_.notify_all();
+	cancelQueuedGoals(pickup_goals,place_goals);
+}
+
+void MovePickPlaceServer::pickupCancelCallback(PickupGoalHandle gh)
+{
+	object_manipulation_msgs::PickupResult res;
+	bool queued = false;
+	{
+		boost::mutex::scoped_lock lock(goal_mutex_);
 
-	// storing goal
-	place_gh_ = gh;
-	gh.setAccepted("accepted");
+		// goal still queued
+		std::deque<PickupGoalHandle>::iterator i = std::find(pickup_queue_.begin(),pickup_queue_.end(),gh);
+		if(i != pickup_queue_.end())
+		{
+			pickup_queue_.erase(i);
+			queued = true;
+		}
+		else if(pickup_active_ && pickup_gh_ == gh)
+		{
+			// goal running, the executor reports the cancellation once the current step stops
+			pickup_preempt_ = true;
+			cancelMoveArm();
+			grasp_action_client_ptr_->cancelGoal();
+		}
+	}
 
-	// processing goal
-	if(moveArmThroughPlaceSequence(goal))
+	if(queued)
 	{
-		res.manipulation_result.value = res.manipulation_result.SUCCESS;
-		gh.setSucceeded(res,"Succeeded");
+		res.manipulation_result.value = res.manipulation_result.CANCELLED;
+		gh.setCanceled(res,"Canceled");
 	}
-	else
+}
+
+void MovePickPlaceServer::placeGoalCallback(PlaceGoalHandle gh)
+{
+	std::vector<PickupGoalHandle> pickup_goals;
+	std::vector<PlaceGoalHandle> place_goals;
 	{
-		res.manipulation_result.value = res.manipulation_result.FAILED;
-		gh.setAborted(res,"Failed");
+		boost::mutex::scoped_lock lock(goal_mutex_);
+
+		// comparing goal handles
+		if(place_active_ && place_gh_ == gh)
+		{
+			// goal already being handled, ignoring
+			ROS_WARN_STREAM("Place goal is already being processed, ignoring request");
+			return;
+		}
+
+		// canceling current goals first, then handing the new one to the executor
+		preemptAllGoals(pickup_goals,place_goals);
+		place_queue_.push_back(gh);
 	}
+
+	goal_condition_.notify_all();
+	cancelQueuedGoals(pickup_goals,place_goals);
 }
 
 void MovePickPlaceServer::placeCancelCallback(PlaceGoalHandle gh)
 {
 	object_manipulation_msgs::PlaceResult res;
-
-	// comparing goal handles
-	if(place_gh_ == gh && gh.getGoalStatus().status == GoalState::ACTIVE)
+	bool queued = false;
 	{
-		// goal already being handled, ignoring
+		boost::mutex::scoped_lock lock(goal_mutex_);
 
-		// checking state of current move arm goal
-		if(move_arm_client_ptr_->getState().state_ == GoalState::ACTIVE)
+		// goal still queued
+		std::deque<PlaceGoalHandle>::iterator i = std::find(place_queue_.begin(),place_queue_.end(),gh);
+		if(i != place_queue_.end())
 		{
-			// cancel goal and send new one
-			move_arm_client_ptr_->cancelGoal();
+			place_queue_.erase(i);
+			queued = true;
 		}
-
-		// checking state of grasp goal
-		if(grasp_action_client_ptr_->getState().state_ == GoalState::ACTIVE)
+		else if(place_active_ && place_gh_ == gh)
 		{
+			// goal running, the executor reports the cancellation once the current step stops
+			place_preempt_ = true;
+			cancelMoveArm();
 			grasp_action_client_ptr_->cancelGoal();
 		}
+	}
 
+	if(queued)
+	{
 		res.manipulation_result.value = res.manipulation_result.CANCELLED;
 		gh.setCanceled(res,"Canceled");
 	}
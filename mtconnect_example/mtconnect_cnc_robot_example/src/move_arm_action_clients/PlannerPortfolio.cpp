@@ -0,0 +1,332 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/PlannerPortfolio.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <sstream>
+#include <algorithm>
+
+using namespace mtconnect_cnc_robot_example;
+
+bool PlannerConfig::parseParameters(XmlRpc::XmlRpcValue &param)
+{
+	if(param.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+			!param.hasMember(PARAM_PLANNER_SERVICE_KEY))
+	{
+		return false;
+	}
+
+	service_ = static_cast<std::string>(param[PARAM_PLANNER_SERVICE_KEY]);
+	planner_id_ = param.hasMember(PARAM_PLANNER_ID_KEY) ? static_cast<std::string>(param[PARAM_PLANNER_ID_KEY]) : "";
+	name_ = param.hasMember(PARAM_PLANNER_NAME_KEY) ? static_cast<std::string>(param[PARAM_PLANNER_NAME_KEY]) : "";
+	allowed_time_ = param.hasMember(PARAM_PLANNER_TIME_KEY) ? static_cast<double>(param[PARAM_PLANNER_TIME_KEY]) : 0;
+	attempts_ = param.hasMember(PARAM_PLANNER_ATTEMPTS_KEY) ? static_cast<int>(param[PARAM_PLANNER_ATTEMPTS_KEY]) : 1;
+	return true;
+}
+
+PlannerPortfolio::PlannerPortfolio()
+:
+	statistics_(new StatisticsTable()),
+	reported_completed_(0),
+	workers_running_(false)
+{
+
+}
+
+PlannerPortfolio::~PlannerPortfolio()
+{
+	stopWorkers();
+}
+
+bool PlannerPortfolio::fetchParameters(std::string name_space)
+{
+	ros::NodeHandle nh(name_space);
+	XmlRpc::XmlRpcValue val;
+
+	stopWorkers();
+	planners_.clear();
+	if(!nh.getParam(PARAM_PLANNER_PORTFOLIO,val))
+	{
+		return true; // racing disabled
+	}
+
+	if(val.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": '"<<PARAM_PLANNER_PORTFOLIO<<"' parameter must be a list");
+		return false;
+	}
+
+	for(int i = 0; i < val.size(); i++)
+	{
+		PlannerConfig config;
+		if(!config.parseParameters(val[i]))
+		{
+			ROS_ERROR_STREAM(ros::this_node::getName()<<": Parsing error in planner portfolio entry "<<i);
+			planners_.clear();
+			return false;
+		}
+
+		// names are used as parameter keys for the statistics
+		if(config.name_.empty())
+		{
+			std::stringstream ss;
+			ss<<"planner_"<<i;
+			config.name_ = ss.str();
+		}
+		planners_.push_back(config);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(statistics_->mutex_);
+		statistics_->stats_.assign(planners_.size(),PlannerStatistics());
+		reported_completed_ = 0;
+	}
+	startWorkers();
+
+	ROS_INFO_STREAM(ros::this_node::getName()<<": Racing "<<planners_.size()<<" planners per motion request");
+	return true;
+}
+
+void PlannerPortfolio::startWorkers()
+{
+	boost::mutex::scoped_lock lock(workers_mutex_);
+	workers_running_ = true;
+	workers_.assign(planners_.size(),Worker());
+	for(unsigned int i = 0; i < workers_.size(); i++)
+	{
+		workers_[i].thread_ = boost::shared_ptr<boost::thread>(
+				new boost::thread(boost::bind(&PlannerPortfolio::workerLoop,this,i)));
+	}
+}
+
+void PlannerPortfolio::stopWorkers()
+{
+	std::vector<Worker> workers;
+	{
+		boost::mutex::scoped_lock lock(workers_mutex_);
+		workers_running_ = false;
+		workers = workers_;
+	}
+	workers_condition_.notify_all();
+
+	for(unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i].thread_->join();
+	}
+
+	boost::mutex::scoped_lock lock(workers_mutex_);
+	workers_.clear();
+}
+
+bool PlannerPortfolio::plan(const arm_navigation_msgs::MotionPlanRequest &request,
+		arm_navigation_msgs::GetMotionPlan::Response &response, const ros::Duration &timeout, int &winner,
+		const CancelCheck &is_canceled)
+{
+	RacePtr race(new Race());
+
+	// idle planners get the request, the workers pick it up once the lock is released
+	{
+		boost::mutex::scoped_lock lock(workers_mutex_);
+		boost::mutex::scoped_lock stats_lock(statistics_->mutex_);
+		for(unsigned int i = 0; i < workers_.size(); i++)
+		{
+			if(workers_[i].race_)
+			{
+				ROS_WARN_STREAM(ros::this_node::getName()<<": Planner '"<<planners_[i].name_
+						<<"' is still busy with an earlier request, leaving it out of this race");
+				continue;
+			}
+
+			workers_[i].race_ = race;
+			workers_[i].request_ = request;
+			race->pending_++;
+			if(i < statistics_->stats_.size())
+			{
+				statistics_->stats_[i].requests_++;
+			}
+		}
+	}
+	workers_condition_.notify_all();
+
+	// waking up regularly so that a canceled caller doesn't wait for the planners
+	boost::mutex::scoped_lock lock(race->mutex_);
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout.toSec() * 1000);
+	boost::posix_time::milliseconds poll(DURATION_CANCEL_POLL * 1000);
+	bool canceled = false;
+	while(!race->done_ && race->pending_ > 0)
+	{
+		boost::system_time now = boost::get_system_time();
+		if(now >= deadline)
+		{
+			break;
+		}
+
+		race->condition_.timed_wait(lock,std::min(deadline,now + poll));
+		if(!race->done_ && is_canceled && is_canceled())
+		{
+			canceled = true;
+			break;
+		}
+	}
+
+	// closing the race, planners that return from now on are ignored
+	race->done_ = true;
+	winner = race->winner_;
+	if(canceled)
+	{
+		ROS_INFO_STREAM(ros::this_node::getName()<<": Planning race canceled");
+		winner = -1;
+		return false;
+	}
+
+	if(winner < 0)
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": No planner in the portfolio produced a valid plan");
+		return false;
+	}
+
+	response = race->response_;
+	ROS_INFO_STREAM(ros::this_node::getName()<<": Planner '"<<planners_[winner].name_<<"' won the planning race");
+	return true;
+}
+
+void PlannerPortfolio::workerLoop(int index)
+{
+	using namespace arm_navigation_msgs;
+
+	while(true)
+	{
+		RacePtr race;
+		MotionPlanRequest request;
+		{
+			boost::mutex::scoped_lock lock(workers_mutex_);
+			while(workers_running_ && !workers_[index].race_)
+			{
+				workers_condition_.wait(lock);
+			}
+
+			if(!workers_running_)
+			{
+				break;
+			}
+			race = workers_[index].race_;
+			request = workers_[index].request_;
+		}
+
+		runPlanner(race,index,request);
+
+		boost::mutex::scoped_lock lock(workers_mutex_);
+		workers_[index].race_.reset();
+	}
+}
+
+void PlannerPortfolio::runPlanner(RacePtr race, int index, const arm_navigation_msgs::MotionPlanRequest &request)
+{
+	using namespace arm_navigation_msgs;
+
+	const PlannerConfig &config = planners_[index];
+	GetMotionPlan srv;
+	srv.request.motion_plan_request = request;
+	srv.request.motion_plan_request.planner_id = config.planner_id_;
+	if(config.allowed_time_ > 0)
+	{
+		srv.request.motion_plan_request.allowed_planning_time = ros::Duration(config.allowed_time_);
+	}
+	srv.request.motion_plan_request.num_planning_attempts = config.attempts_;
+
+	ros::WallTime start = ros::WallTime::now();
+	bool success = ros::service::call(config.service_,srv) &&
+			srv.response.error_code.val == ArmNavigationErrorCodes::SUCCESS &&
+			!srv.response.trajectory.joint_trajectory.points.empty();
+	double latency = (ros::WallTime::now() - start).toSec();
+
+	bool won = false;
+	{
+		boost::mutex::scoped_lock lock(race->mutex_);
+		race->pending_--;
+		if(success && !race->done_)
+		{
+			race->done_ = true;
+			race->winner_ = index;
+			race->response_ = srv.response;
+			won = true;
+		}
+	}
+	race->condition_.notify_all();
+
+	boost::mutex::scoped_lock lock(statistics_->mutex_);
+	if(index < (int)statistics_->stats_.size())
+	{
+		PlannerStatistics &stats = statistics_->stats_[index];
+		stats.completed_++;
+		stats.wins_ += won ? 1 : 0;
+		stats.failures_ += success ? 0 : 1;
+		stats.total_latency_ += latency;
+		stats.max_latency_ = std::max(stats.max_latency_,latency);
+	}
+}
+
+void PlannerPortfolio::reportStatistics(std::string name_space)
+{
+	ros::NodeHandle nh(name_space);
+	std::vector<PlannerStatistics> stats;
+	{
+		boost::mutex::scoped_lock lock(statistics_->mutex_);
+		unsigned int completed = 0;
+		for(unsigned int i = 0; i < statistics_->stats_.size(); i++)
+		{
+			completed += statistics_->stats_[i].completed_;
+		}
+		if(completed == reported_completed_)
+		{
+			return;
+		}
+		reported_completed_ = completed;
+		stats = statistics_->stats_;
+	}
+
+	for(unsigned int i = 0; i < stats.size() && i < planners_.size(); i++)
+	{
+		std::string prefix = PARAM_PLANNER_STATISTICS + "/" + planners_[i].name_ + "/";
+		double mean = stats[i].completed_ > 0 ? stats[i].total_latency_ / stats[i].completed_ : 0;
+		nh.setParam(prefix + "requests",(int)stats[i].requests_);
+		nh.setParam(prefix + "wins",(int)stats[i].wins_);
+		nh.setParam(prefix + "failures",(int)stats[i].failures_);
+		nh.setParam(prefix + "mean_latency",mean);
+		nh.setParam(prefix + "max_latency",stats[i].max_latency_);
+	}
+
+	ROS_INFO_STREAM(ros::this_node::getName()<<statisticsToString());
+}
+
+std::string PlannerPortfolio::statisticsToString()
+{
+	std::stringstream ss;
+	boost::mutex::scoped_lock lock(statistics_->mutex_);
+
+	ss<<"\nPlanner Portfolio Statistics";
+	for(unsigned int i = 0; i < statistics_->stats_.size() && i < planners_.size(); i++)
+	{
+		const PlannerStatistics &stats = statistics_->stats_[i];
+		double mean = stats.completed_ > 0 ? stats.total_latency_ / stats.completed_ : 0;
+		double win_rate = stats.requests_ > 0 ? double(stats.wins_) / stats.requests_ : 0;
+		ss<<"\n\t"<<planners_[i].name_<<": requests "<<stats.requests_<<", win rate "<<win_rate
+				<<", failures "<<stats.failures_<<", mean latency "<<mean<<" s, max latency "<<stats.max_latency_<<" s";
+	}
+
+	return ss.str();
+}
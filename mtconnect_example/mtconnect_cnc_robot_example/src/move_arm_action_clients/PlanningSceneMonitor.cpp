@@ -0,0 +1,420 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/PlanningSceneMonitor.h>
+#include <arm_navigation_msgs/CollisionObjectOperation.h>
+#include <boost/weak_ptr.hpp>
+#include <cmath>
+
+using namespace mtconnect_cnc_robot_example;
+
+static const std::string ALL_OBJECTS = "all";
+
+// monitors shared within the process, keyed by robot description
+static boost::mutex shared_monitors_mutex;
+static std::map<std::string, boost::weak_ptr<PlanningSceneMonitor> > shared_monitors;
+
+// removes every object with a matching id, "all" removes every object
+template<class T>
+static void removeById(std::vector<T> &objects, const std::string &id)
+{
+	typename std::vector<T>::iterator i = objects.begin();
+	while(i != objects.end())
+	{
+		if(id == ALL_OBJECTS || i->id == id)
+		{
+			i = objects.erase(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+static void removeAttachedById(std::vector<arm_navigation_msgs::AttachedCollisionObject> &objects,
+		const std::string &link_name, const std::string &id)
+{
+	std::vector<arm_navigation_msgs::AttachedCollisionObject>::iterator i = objects.begin();
+	while(i != objects.end())
+	{
+		bool link_match = (link_name == ALL_OBJECTS) || (i->link_name == link_name);
+		bool id_match = (id == ALL_OBJECTS) || (i->object.id == id);
+		if(link_match && id_match)
+		{
+			i = objects.erase(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+PlanningSceneMonitor::PlanningSceneMonitor(planning_environment::CollisionModels *models)
+:
+	collision_models_(models),
+	kinematic_state_(NULL),
+	scene_received_(false),
+	scene_dirty_(false),
+	joints_dirty_(false),
+	last_joint_update_(0),
+	stale_timeout_(DEFAULT_SCENE_STALE_TIMEOUT),
+	version_(0),
+	robot_state_version_(0)
+{
+
+}
+
+PlanningSceneMonitor::PlanningSceneMonitor(CollisionModelsPtr models)
+:
+	collision_models_(models.get()),
+	owned_models_(models),
+	kinematic_state_(NULL),
+	scene_received_(false),
+	scene_dirty_(false),
+	joints_dirty_(false),
+	last_joint_update_(0),
+	stale_timeout_(DEFAULT_SCENE_STALE_TIMEOUT),
+	version_(0),
+	robot_state_version_(0)
+{
+
+}
+
+PlanningSceneMonitor::~PlanningSceneMonitor()
+{
+	if(spinner_)
+	{
+		spinner_->stop();
+	}
+
+	boost::mutex::scoped_lock lock(scene_mutex_);
+	if(kinematic_state_ != NULL)
+	{
+		collision_models_->revertPlanningScene(kinematic_state_);
+		kinematic_state_ = NULL;
+	}
+}
+
+PlanningSceneMonitorPtr PlanningSceneMonitor::getShared(const std::string &robot_description,
+		const std::string &planning_scene_service)
+{
+	PlanningSceneMonitorPtr monitor;
+	{
+		// later callers wait here while the first one loads the models
+		boost::mutex::scoped_lock lock(shared_monitors_mutex);
+		monitor = shared_monitors[robot_description].lock();
+		if(monitor)
+		{
+			ROS_INFO_STREAM(ros::this_node::getName()<<": sharing the loaded "<<robot_description<<" collision models");
+			return monitor;
+		}
+
+		CollisionModelsPtr models(new planning_environment::CollisionModels(robot_description));
+		monitor = PlanningSceneMonitorPtr(new PlanningSceneMonitor(models));
+		shared_monitors[robot_description] = monitor;
+	}
+
+	// tracking planning scene locally, the full scene is requested only once here (outside of the
+	// process wide lock, a missing environment server must not hold up the other arm clients)
+	if(!monitor->start(planning_scene_service))
+	{
+		ROS_WARN_STREAM(ros::this_node::getName()<<": planning scene monitor could not get initial scene, will retry on first request");
+	}
+	return monitor;
+}
+
+bool PlanningSceneMonitor::start(const std::string &planning_scene_service)
+{
+	ros::NodeHandle nh;
+	nh.setCallbackQueue(&callback_queue_);
+
+	{
+		boost::mutex::scoped_lock lock(scene_mutex_);
+		planning_scene_client_ = nh.serviceClient<arm_navigation_msgs::SetPlanningSceneDiff>(planning_scene_service);
+	}
+
+	// incremental updates
+	joint_states_sub_ = nh.subscribe(DEFAULT_JOINT_STATES_TOPIC,1,
+			&PlanningSceneMonitor::jointStatesCallback,this);
+	collision_object_sub_ = nh.subscribe(DEFAULT_COLLISION_OBJECT_TOPIC,100,
+			&PlanningSceneMonitor::collisionObjectCallback,this);
+	attached_collision_object_sub_ = nh.subscribe(DEFAULT_ATTACHED_COLLISION_OBJECT_TOPIC,100,
+			&PlanningSceneMonitor::attachedCollisionObjectCallback,this);
+	if(!spinner_)
+	{
+		spinner_ = boost::shared_ptr<ros::AsyncSpinner>(new ros::AsyncSpinner(1,&callback_queue_));
+		spinner_->start();
+	}
+
+	// full scene, requested once
+	return resync();
+}
+
+bool PlanningSceneMonitor::resync(double timeout)
+{
+	using namespace arm_navigation_msgs;
+
+	ros::ServiceClient client;
+	{
+		boost::mutex::scoped_lock lock(scene_mutex_);
+		client = planning_scene_client_;
+	}
+
+	// the call itself can't time out, waiting for the service bounds the common case (no server)
+	if(!client.waitForExistence(ros::Duration(timeout)))
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": planning scene service '"<<client.getService()
+				<<"' not available after "<<timeout<<" seconds");
+		return false;
+	}
+
+	// an empty diff returns the complete scene
+	SetPlanningSceneDiff::Request planning_scene_req;
+	SetPlanningSceneDiff::Response planning_scene_res;
+	if(!client.call(planning_scene_req,planning_scene_res))
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": call to set planning scene failed");
+		return false;
+	}
+
+	boost::mutex::scoped_lock lock(scene_mutex_);
+	planning_scene_ = planning_scene_res.planning_scene;
+
+	const sensor_msgs::JointState &js = planning_scene_.robot_state.joint_state;
+	joint_values_.clear();
+	for(unsigned int i = 0; i < js.name.size() && i < js.position.size(); i++)
+	{
+		joint_values_[js.name[i]] = js.position[i];
+	}
+
+	scene_received_ = true;
+	scene_dirty_ = true;
+	last_joint_update_ = ros::Time::now();
+	version_++;
+
+	ROS_INFO_STREAM(ros::this_node::getName()<<": planning scene synchronized, version "<<version_);
+	return applyScene();
+}
+
+bool PlanningSceneMonitor::getRobotState(arm_navigation_msgs::RobotState &robot_state, unsigned int &version)
+{
+	boost::mutex::scoped_lock lock(scene_mutex_);
+
+	if(!scene_received_)
+	{
+		return false;
+	}
+
+	if((ros::Time::now() - last_joint_update_).toSec() > stale_timeout_)
+	{
+		return false;
+	}
+
+	if(scene_dirty_ && !applyScene())
+	{
+		return false;
+	}
+
+	if(joints_dirty_)
+	{
+		applyJointValues();
+	}
+
+	// only convert when something changed since the last request
+	if(robot_state_version_ != version_)
+	{
+		planning_environment::convertKinematicStateToRobotState(*kinematic_state_,
+															  ros::Time::now(),
+															  collision_models_->getWorldFrameId(),
+															  robot_state_);
+		robot_state_version_ = version_;
+	}
+
+	robot_state = robot_state_;
+	version = robot_state_version_;
+	return true;
+}
+
+bool PlanningSceneMonitor::isStale() const
+{
+	boost::mutex::scoped_lock lock(scene_mutex_);
+	return !scene_received_ || (ros::Time::now() - last_joint_update_).toSec() > stale_timeout_;
+}
+
+unsigned int PlanningSceneMonitor::getVersion() const
+{
+	boost::mutex::scoped_lock lock(scene_mutex_);
+	return version_;
+}
+
+void PlanningSceneMonitor::setStaleTimeout(double seconds)
+{
+	boost::mutex::scoped_lock lock(scene_mutex_);
+	stale_timeout_ = seconds;
+}
+
+void PlanningSceneMonitor::jointStatesCallback(const sensor_msgs::JointStateConstPtr &msg)
+{
+	boost::mutex::scoped_lock lock(scene_mutex_);
+
+	// sensor noise alone doesn't change the scene
+	bool changed = false;
+	for(unsigned int i = 0; i < msg->name.size() && i < msg->position.size(); i++)
+	{
+		std::map<std::string,double>::iterator j = joint_values_.find(msg->name[i]);
+		if(j == joint_values_.end() || std::fabs(j->second - msg->position[i]) > JOINT_STATE_TOLERANCE)
+		{
+			joint_values_[msg->name[i]] = msg->position[i];
+			changed = true;
+		}
+	}
+
+	last_joint_update_ = ros::Time::now();
+	if(changed)
+	{
+		joints_dirty_ = true;
+		version_++;
+	}
+}
+
+void PlanningSceneMonitor::collisionObjectCallback(const arm_navigation_msgs::CollisionObjectConstPtr &msg)
+{
+	using namespace arm_navigation_msgs;
+
+	boost::mutex::scoped_lock lock(scene_mutex_);
+
+	switch(msg->operation.operation)
+	{
+	case CollisionObjectOperation::ADD:
+		removeById(planning_scene_.collision_objects,msg->id);
+		planning_scene_.collision_objects.push_back(*msg);
+		break;
+
+	case CollisionObjectOperation::REMOVE:
+		removeById(planning_scene_.collision_objects,msg->id);
+		break;
+
+	default:
+		ROS_WARN_STREAM(ros::this_node::getName()<<": unsupported collision object operation "
+				<<(int)msg->operation.operation<<" for object '"<<msg->id<<"'");
+		return;
+	}
+
+	scene_dirty_ = true;
+	version_++;
+}
+
+void PlanningSceneMonitor::attachedCollisionObjectCallback(const arm_navigation_msgs::AttachedCollisionObjectConstPtr &msg)
+{
+	using namespace arm_navigation_msgs;
+
+	boost::mutex::scoped_lock lock(scene_mutex_);
+
+	const std::string &id = msg->object.id;
+	switch(msg->object.operation.operation)
+	{
+	case CollisionObjectOperation::ADD:
+		removeAttachedById(planning_scene_.attached_collision_objects,msg->link_name,id);
+		planning_scene_.attached_collision_objects.push_back(*msg);
+		break;
+
+	case CollisionObjectOperation::ATTACH_AND_REMOVE_AS_OBJECT:
+		{
+			// the attached object takes the geometry of the world object when none is given
+			AttachedCollisionObject attached = *msg;
+			std::vector<CollisionObject>::iterator i;
+			for(i = planning_scene_.collision_objects.begin(); i != planning_scene_.collision_objects.end(); i++)
+			{
+				if(i->id == id)
+				{
+					if(attached.object.shapes.empty())
+					{
+						attached.object.header = i->header;
+						attached.object.shapes = i->shapes;
+						attached.object.poses = i->poses;
+					}
+					break;
+				}
+			}
+			removeById(planning_scene_.collision_objects,id);
+			removeAttachedById(planning_scene_.attached_collision_objects,msg->link_name,id);
+			planning_scene_.attached_collision_objects.push_back(attached);
+		}
+		break;
+
+	case CollisionObjectOperation::DETACH_AND_ADD_AS_OBJECT:
+		{
+			std::vector<AttachedCollisionObject>::iterator i;
+			for(i = planning_scene_.attached_collision_objects.begin(); i != planning_scene_.attached_collision_objects.end(); i++)
+			{
+				if(i->object.id == id)
+				{
+					CollisionObject obj = i->object;
+					obj.operation.operation = CollisionObjectOperation::ADD;
+					removeById(planning_scene_.collision_objects,id);
+					planning_scene_.collision_objects.push_back(obj);
+					break;
+				}
+			}
+			removeAttachedById(planning_scene_.attached_collision_objects,msg->link_name,id);
+		}
+		break;
+
+	case CollisionObjectOperation::REMOVE:
+		removeAttachedById(planning_scene_.attached_collision_objects,msg->link_name,id);
+		break;
+
+	default:
+		return;
+	}
+
+	scene_dirty_ = true;
+	version_++;
+}
+
+bool PlanningSceneMonitor::applyScene()
+{
+	if(kinematic_state_ != NULL)
+	{
+		collision_models_->revertPlanningScene(kinematic_state_);
+		kinematic_state_ = NULL;
+	}
+
+	kinematic_state_ = collision_models_->setPlanningScene(planning_scene_);
+	if(kinematic_state_ == NULL)
+	{
+		ROS_ERROR_STREAM(ros::this_node::getName()<<": Kinematic State for arm could not be retrieved from planning scene");
+		return false;
+	}
+
+	scene_dirty_ = false;
+
+	// the scene message may hold older joint values than the ones received since
+	joints_dirty_ = true;
+	applyJointValues();
+	return true;
+}
+
+void PlanningSceneMonitor::applyJointValues()
+{
+	if(kinematic_state_ != NULL)
+	{
+		kinematic_state_->setKinematicState(joint_values_);
+	}
+	joints_dirty_ = false;
+}
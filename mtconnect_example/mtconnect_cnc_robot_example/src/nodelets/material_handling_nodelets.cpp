@@ -0,0 +1,71 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/thread.hpp>
+#include <mtconnect_cnc_robot_example/move_arm_action_clients/MovePickPlaceServer.h>
+#include <mtconnect_cnc_robot_example/state_machine/state_machine.h>
+
+namespace mtconnect_cnc_robot_example
+{
+
+/*
+ * Runs the blocking run() of a server on its own thread so that onInit returns while the server
+ * waits for its action servers.  Each server spins its own callback queue (the manager's spinner
+ * never runs its callbacks) and reads its parameters from the private namespace of the nodelet.
+ * Servers loaded into the same manager exchange messages by pointer and share the collision
+ * models (see PlanningSceneMonitor::getShared).
+ */
+template<class T>
+class RunLoopNodelet : public nodelet::Nodelet
+{
+public:
+	virtual ~RunLoopNodelet()
+	{
+		if(thread_)
+		{
+			thread_->interrupt();
+			thread_->join();
+		}
+	}
+
+protected:
+	virtual void onInit()
+	{
+		server_ = boost::shared_ptr<T>(new T(getNodeHandle(),getPrivateNodeHandle()));
+		thread_ = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&T::run, server_.get())));
+	}
+
+protected:
+	boost::shared_ptr<T> server_;
+	boost::shared_ptr<boost::thread> thread_;
+};
+
+class MovePickPlaceNodelet : public RunLoopNodelet<MovePickPlaceServer>
+{
+};
+
+class StateMachineNodelet : public RunLoopNodelet<state_machine::StateMachine>
+{
+};
+
+}
+
+PLUGINLIB_DECLARE_CLASS(mtconnect_cnc_robot_example, MovePickPlaceNodelet,
+		mtconnect_cnc_robot_example::MovePickPlaceNodelet, nodelet::Nodelet)
+PLUGINLIB_DECLARE_CLASS(mtconnect_cnc_robot_example, StateMachineNodelet,
+		mtconnect_cnc_robot_example::StateMachineNodelet, nodelet::Nodelet)
@@ -41,7 +41,7 @@ public:
 			return;
 		}
 
-		ros::AsyncSpinner spinner(2);
+		ros::AsyncSpinner spinner(2,&callback_queue_);
 		spinner.start();
 
 		ROS_INFO_STREAM("Cycling through pick and place moves");
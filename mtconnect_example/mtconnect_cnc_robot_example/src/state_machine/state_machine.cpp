@@ -15,6 +15,7 @@
  */
 
 #include <mtconnect_cnc_robot_example/state_machine/state_machine.h>
+#include <mtconnect_cnc_robot_example/utilities/parameter_loader.h>
 #include <ros/topic.h>
 // params
 static const std::string PARAM_ARM_GROUP = "arm_group";
@@ -36,6 +37,14 @@ static const std::string PARAM_FORCE_GRIPPER_FAULT = "force_gripper_fault";
 static const std::string PARAM_FORCE_FAULT_ON_TASK = "force_fault_on_task";
 static const std::string PARAM_TASK_DESCRIPTION = "task_description";
 static const std::string PARAM_USE_TASK_MOTION = "use_task_motion";
+static const std::string PARAM_PARAMETER_SNAPSHOT = "parameter_snapshot";
+static const std::string PARAM_MATERIAL_QUEUE_DEPTH = "material_queue_depth";
+static const std::string PARAM_MATERIAL_LOAD_PRIORITY = "material_load_priority";
+static const std::string PARAM_MATERIAL_UNLOAD_PRIORITY = "material_unload_priority";
+static const std::string PARAM_MATERIAL_MAX_WAIT = "material_max_wait";
+static const std::string PARAM_ACTION_DEADLINE_FACTOR = "action_deadline_factor";
+static const std::string PARAM_ACTION_DEADLINE_DEFAULT = "action_deadline_default";
+static const std::string PARAM_ACTION_DEADLINE_SAMPLES = "action_deadline_samples";
 
 // default
 static const std::string DEFAULT_MOVE_ARM_ACTION = "move_arm_action";
@@ -54,18 +63,24 @@ static const std::string DEFAULT_ROBOT_STATES_TOPIC = "robot_states";
 static const std::string DEFAULT_ROBOT_SPINDLE_TOPIC = "robot_spindle";
 static const std::string DEFAULT_ROBOT_STATUS_TOPIC = "robot_status";
 static const std::string DEFAULT_JOINT_STATE_TOPIC = "joint_states";
+static const std::string DEFAULT_MATERIAL_QUEUE_TOPIC = "material_queue_status";
 static const std::string DEFAULT_EXTERNAL_COMMAND_SERVICE = "external_command";
 static const std::string DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE = "/MaterialLoad/set_mtconnect_state";
 static const std::string DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE = "/MaterialUnload/set_mtconnect_state";
 static const std::string DEFAULT_TRAJECTORY_FILTER_SERVICE = "filter_trajectory_with_constraints";
 
 static const std::string CNC_ACTION_ACTIVE_FLAG = "ACTIVE";
+
+// discovery subsystems (the arm servers are in SUBSYSTEM_ROBOT)
+static const std::string SUBSYSTEM_CNC = "cnc";
+static const std::string SUBSYSTEM_GRIPPER = "gripper";
+static const std::string SUBSYSTEM_VISE = "vise";
+
 static const double DEFAULT_JOINT_ERROR_TOLERANCE = 0.01f; // radians
 static const int DEFAULT_PATH_PLANNING_ATTEMPTS = 2;
 static const std::string DEFAULT_PATH_PLANNER = "/ompl_planning/plan_kinematic_path";
 static const double DURATION_LOOP_PAUSE = 0.5f;
 static const double DURATION_TIMER_INTERVAL = 4.0f;
-static const double DURATION_WAIT_SERVER = 2.0f;
 static const double DURATION_PLANNING_TIME = 5.0f;
 static const double DURATION_WAIT_RESULT = 40.0f;
 static const double DURATION_PATH_COMPLETION = 2.0f;
@@ -74,9 +89,9 @@ static const double DURATION_JOINT_MESSAGE_TIMEOUT = 10.0f;
 
 using namespace mtconnect_cnc_robot_example::state_machine;
 
-StateMachine::StateMachine()
+StateMachine::StateMachine(const ros::NodeHandle &nh, const ros::NodeHandle &ph) :
+	MoveArmActionClient(nh,ph)
 {
-	// TODO Auto-generated constructor stub
 
 }
 
@@ -87,29 +102,46 @@ StateMachine::~StateMachine()
 
 bool StateMachine::fetch_parameters(std::string name_space)
 {
-	ros::NodeHandle ph("~");
-	return ph.getParam(PARAM_TASK_DESCRIPTION, task_desc_) &&
-	                ph.getParam(PARAM_USE_TASK_MOTION, use_task_desc_motion) &&
-	                ph.getParam(PARAM_ARM_GROUP,arm_group_) &&
-			material_load_pickup_goal_.fetchParameters(PARAM_LOAD_PICKUP_GOAL) &&
-			material_unload_place_goal_.fetchParameters(PARAM_UNLOAD_PLACE_GOAL) &&
-			joint_home_pos_.fetchParameters(PARAM_JOINT_HOME_POSITION) &&
-			joint_wait_pos_.fetchParameters(PARAM_JOINT_WAIT_POSITION) &&
-			traj_approach_cnc_.fetchParameters(PARAM_TRAJ_APPROACH_CNC) &&
-			traj_enter_cnc_.fetchParameters(PARAM_TRAJ_ENTER_CNC) &&
-			traj_move_to_chuck_.fetchParameters(PARAM_TRAJ_MOVE_TO_CHUCK) &&
-			traj_retreat_from_chuck_.fetchParameters(PARAM_TRAJ_RETREAT_FROM_CHUCK) &&
-			traj_exit_cnc_.fetchParameters(PARAM_TRAJ_EXIT_CNC) &&
-			traj_arbitrary_move_.fetchParameters(PARAM_TRAJ_ARBITRARY_MOVE);
-	return true;
+	// all parameters are read from a single fetch of the node's name space
+	move_arm_utils::ParameterLoader loader;
+	std::string snapshot_file = "";
+	if(!loader.load())
+	{
+		return false;
+	}
+
+	loader.getParam(ph_.resolveName(PARAM_PARAMETER_SNAPSHOT),snapshot_file);
+	if(!snapshot_file.empty())
+	{
+		loader.readSnapshot(snapshot_file);
+	}
+
+	bool success = loader.getParam(ph_.resolveName(PARAM_TASK_DESCRIPTION), task_desc_) &&
+			loader.getParam(ph_.resolveName(PARAM_USE_TASK_MOTION), use_task_desc_motion) &&
+			loader.getParam(ph_.resolveName(PARAM_ARM_GROUP),arm_group_) &&
+			loader.fetch(PARAM_LOAD_PICKUP_GOAL,material_load_pickup_goal_) &&
+			loader.fetch(PARAM_UNLOAD_PLACE_GOAL,material_unload_place_goal_) &&
+			loader.fetch(PARAM_JOINT_HOME_POSITION,joint_home_pos_) &&
+			loader.fetch(PARAM_JOINT_WAIT_POSITION,joint_wait_pos_) &&
+			loader.fetch(PARAM_TRAJ_APPROACH_CNC,traj_approach_cnc_) &&
+			loader.fetch(PARAM_TRAJ_ENTER_CNC,traj_enter_cnc_) &&
+			loader.fetch(PARAM_TRAJ_MOVE_TO_CHUCK,traj_move_to_chuck_) &&
+			loader.fetch(PARAM_TRAJ_RETREAT_FROM_CHUCK,traj_retreat_from_chuck_) &&
+			loader.fetch(PARAM_TRAJ_EXIT_CNC,traj_exit_cnc_) &&
+			loader.fetch(PARAM_TRAJ_ARBITRARY_MOVE,traj_arbitrary_move_);
+
+	if(success && !snapshot_file.empty())
+	{
+		ROS_INFO_STREAM("Decoded "<<loader.getSnapshotHits()<<" parameter structs from snapshot '"<<snapshot_file<<"'");
+		loader.writeSnapshot(snapshot_file);
+	}
+
+	return success;
 }
 bool StateMachine::setup()
 {
 	using namespace industrial_msgs;
 
-	ros::NodeHandle nh;
-	int wait_attempts = 0;
-
 	if(fetch_parameters())
 	{
 		ROS_INFO_STREAM("Read all parameters successfully");
@@ -127,46 +159,92 @@ bool StateMachine::setup()
           return false;
 	}
 
-	// initializing move arm client
+	// initializing action service clients
+	move_pickup_client_ptr_ = MovePickupClientPtr(new MovePickupClient(nh_,DEFAULT_PICKUP_ACTION,true));
+	move_place_client_ptr_ = MovePlaceClientPtr(new MovePlaceClient(nh_,DEFAULT_PLACE_ACTION,true));
+	open_door_client_ptr_ =CncOpenDoorClientPtr(new CncOpenDoorClient(nh_,DEFAULT_CNC_OPEN_DOOR_ACTION,true));
+	close_door_client_ptr_ =CncCloseDoorClientPtr(new CncCloseDoorClient(nh_,DEFAULT_CNC_CLOSE_DOOR_ACTION,true));
+	open_chuck_client_ptr_ =CncOpenChuckClientPtr(new CncOpenChuckClient(nh_,DEFAULT_CNC_OPEN_CHUCK_ACTION,true));
+	close_chuck_client_ptr_ =CncCloseChuckClientPtr(new CncCloseChuckClient(nh_,DEFAULT_CNC_CLOSE_CHUCK_ACTION,true));
+	grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(nh_,DEFAULT_GRASP_ACTION,true));
+	vise_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(nh_,DEFAULT_VISE_ACTION,true));
+	joint_traj_client_ptr_ = JointTractoryClientPtr(new JointTractoryClient(nh_,DEFAULT_JOINT_TRAJ_ACTION,true));
+
+	// cnc/robot servers are discovered along with the move arm server
+	discovery_.addAction(DEFAULT_PICKUP_ACTION,SUBSYSTEM_ROBOT,move_pickup_client_ptr_);
+	discovery_.addAction(DEFAULT_PLACE_ACTION,SUBSYSTEM_ROBOT,move_place_client_ptr_);
+	discovery_.addAction(DEFAULT_JOINT_TRAJ_ACTION,SUBSYSTEM_ROBOT,joint_traj_client_ptr_);
+	discovery_.addAction(DEFAULT_CNC_OPEN_DOOR_ACTION,SUBSYSTEM_CNC,open_door_client_ptr_);
+	discovery_.addAction(DEFAULT_CNC_CLOSE_DOOR_ACTION,SUBSYSTEM_CNC,close_door_client_ptr_);
+	discovery_.addAction(DEFAULT_CNC_OPEN_CHUCK_ACTION,SUBSYSTEM_CNC,open_chuck_client_ptr_);
+	discovery_.addAction(DEFAULT_CNC_CLOSE_CHUCK_ACTION,SUBSYSTEM_CNC,close_chuck_client_ptr_);
+	discovery_.addAction(DEFAULT_GRASP_ACTION,SUBSYSTEM_GRIPPER,grasp_action_client_ptr_);
+	discovery_.addAction(DEFAULT_VISE_ACTION,SUBSYSTEM_VISE,vise_action_client_ptr_);
+
+	// initializing move arm client, waits for all servers at once
 	if(!MoveArmActionClient::setup())
 	{
 		ROS_ERROR_STREAM("Failed to initialize MoveArmActionClient");
 		return false;
 	}
 
+	if(!discovery_.isSubsystemFound(SUBSYSTEM_ROBOT))
+	{
+		ROS_ERROR_STREAM("One or more robot action servers were not found ("<<discovery_.getMissingString()<<"), exiting");
+		return false;
+	}
+
+	if(!discovery_.isAllFound())
+	{
+		ROS_WARN_STREAM("Starting in degraded mode, tasks that need the missing servers fault until they are found: "
+				<<discovery_.getMissingString());
+	}
+
 	// initializing action service servers
-	material_load_server_ptr_ = MaterialLoadServerPtr(new MaterialLoadServer(nh,DEFAULT_MATERIAL_LOAD_ACTION,false));
+	material_load_server_ptr_ = MaterialLoadServerPtr(new MaterialLoadServer(nh_,DEFAULT_MATERIAL_LOAD_ACTION,false));
 	material_load_server_ptr_->registerGoalCallback(boost::bind(&StateMachine::material_load_goalcb,this));
-	material_unload_server_ptr_ = MaterialUnloadServerPtr(new  MaterialUnloadServer(nh,DEFAULT_MATERIAL_UNLOAD_ACTION,false));
+	material_unload_server_ptr_ = MaterialUnloadServerPtr(new  MaterialUnloadServer(nh_,DEFAULT_MATERIAL_UNLOAD_ACTION,false));
 	material_unload_server_ptr_->registerGoalCallback(boost::bind(&StateMachine::material_unload_goalcb,this));
 
-	// initializing action service clients
-	move_pickup_client_ptr_ = MovePickupClientPtr(new MovePickupClient(DEFAULT_PICKUP_ACTION,true));
-	move_place_client_ptr_ = MovePlaceClientPtr(new MovePlaceClient(DEFAULT_PLACE_ACTION,true));
-	open_door_client_ptr_ =CncOpenDoorClientPtr(new CncOpenDoorClient(DEFAULT_CNC_OPEN_DOOR_ACTION,true));
-	close_door_client_ptr_ =CncCloseDoorClientPtr(new CncCloseDoorClient(DEFAULT_CNC_CLOSE_DOOR_ACTION,true));
-	open_chuck_client_ptr_ =CncOpenChuckClientPtr(new CncOpenChuckClient(DEFAULT_CNC_OPEN_CHUCK_ACTION,true));
-	close_chuck_client_ptr_ =CncCloseChuckClientPtr(new CncCloseChuckClient(DEFAULT_CNC_CLOSE_CHUCK_ACTION,true));
-	grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(DEFAULT_GRASP_ACTION,true));
-	vise_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(DEFAULT_VISE_ACTION,true));
-	joint_traj_client_ptr_ = JointTractoryClientPtr(new JointTractoryClient(DEFAULT_JOINT_TRAJ_ACTION,true));
-
 	// initializing publishers
-	robot_states_pub_ = nh.advertise<mtconnect_msgs::RobotStates>(DEFAULT_ROBOT_STATES_TOPIC,1);
-	robot_spindle_pub_ = nh.advertise<mtconnect_msgs::RobotSpindle>(DEFAULT_ROBOT_SPINDLE_TOPIC,1);
+	robot_states_pub_ = nh_.advertise<mtconnect_msgs::RobotStates>(DEFAULT_ROBOT_STATES_TOPIC,1);
+	robot_spindle_pub_ = nh_.advertise<mtconnect_msgs::RobotSpindle>(DEFAULT_ROBOT_SPINDLE_TOPIC,1);
+	material_queue_pub_ = nh_.advertise<mtconnect_example_msgs::MaterialQueueStatus>(DEFAULT_MATERIAL_QUEUE_TOPIC,1);
+
+	// material request queue, unloads go first by default since the cnc must be emptied before a load
+	int queue_depth, load_priority, unload_priority;
+	double max_wait;
+	ph_.param(PARAM_MATERIAL_QUEUE_DEPTH,queue_depth,mtconnect_example_utils::DEFAULT_MATERIAL_QUEUE_DEPTH);
+	ph_.param(PARAM_MATERIAL_LOAD_PRIORITY,load_priority,0);
+	ph_.param(PARAM_MATERIAL_UNLOAD_PRIORITY,unload_priority,1);
+	ph_.param(PARAM_MATERIAL_MAX_WAIT,max_wait,mtconnect_example_utils::DEFAULT_MATERIAL_MAX_WAIT);
+	material_queue_.setMaxDepth(queue_depth);
+	material_queue_.setMaxWait(max_wait);
+	material_queue_.setPriority(DEFAULT_MATERIAL_LOAD_ACTION,load_priority);
+	material_queue_.setPriority(DEFAULT_MATERIAL_UNLOAD_ACTION,unload_priority);
+
+	// task deadlines, the default applies until enough latencies are known (zero disables)
+	double deadline_factor, deadline_default;
+	int deadline_samples;
+	ph_.param(PARAM_ACTION_DEADLINE_FACTOR,deadline_factor,mtconnect_example_utils::DEFAULT_DEADLINE_FACTOR);
+	ph_.param(PARAM_ACTION_DEADLINE_DEFAULT,deadline_default,mtconnect_example_utils::DEFAULT_ACTION_DEADLINE);
+	ph_.param(PARAM_ACTION_DEADLINE_SAMPLES,deadline_samples,mtconnect_example_utils::DEFAULT_DEADLINE_SAMPLES);
+	action_monitor_.setDeadlineFactor(deadline_factor);
+	action_monitor_.setDefaultDeadline(deadline_default);
+	action_monitor_.setMinSamples(deadline_samples);
 
 	// initializing subscribers
-	robot_status_sub_ = nh.subscribe(DEFAULT_ROBOT_STATUS_TOPIC,1,&StateMachine::ros_status_subs_cb,this);
+	robot_status_sub_ = nh_.subscribe(DEFAULT_ROBOT_STATUS_TOPIC,1,&StateMachine::ros_status_subs_cb,this);
 
 	// initializing servers
-	external_command_srv_ = nh.advertiseService(DEFAULT_EXTERNAL_COMMAND_SERVICE,&StateMachine::external_command_cb,this);
+	external_command_srv_ = nh_.advertiseService(DEFAULT_EXTERNAL_COMMAND_SERVICE,&StateMachine::external_command_cb,this);
 
 	// initializing clients
-	material_load_set_state_client_ = nh.serviceClient<mtconnect_msgs::SetMTConnectState>(DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE);
-	material_unload_set_state_client_ = nh.serviceClient<mtconnect_msgs::SetMTConnectState>(DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE);
+	material_load_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE);
+	material_unload_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE);
 
 	trajectory_filter_client_ =
-	    nh.serviceClient<arm_navigation_msgs::FilterJointTrajectoryWithConstraints>(
+	    nh_.serviceClient<arm_navigation_msgs::FilterJointTrajectoryWithConstraints>(
 	        DEFAULT_TRAJECTORY_FILTER_SERVICE);
 
 	// initializing service client messages
@@ -193,7 +271,7 @@ bool StateMachine::setup()
 	move_arm_joint_goal_.motion_plan_request.expected_path_duration = ros::Duration(DURATION_PATH_COMPLETION);
 
 	// initializing timers
-	robot_topics_timer_ = nh.createTimer(ros::Duration(DURATION_TIMER_INTERVAL),
+	robot_topics_timer_ = nh_.createTimer(ros::Duration(DURATION_TIMER_INTERVAL),
 			&StateMachine::publish_robot_topics_timercb,this,false,false);
 
 	// initializing material load/unload tasks lists
@@ -274,29 +352,6 @@ bool StateMachine::setup()
                             ((int)JM_PICK_TO_HOME)
                             ((int)MATERIAL_UNLOAD_END);
 
-	// waiting for robot related service servers
-	while(	ros::ok() && (
-			(!move_arm_client_ptr_->isServerConnected() && !move_arm_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!move_pickup_client_ptr_->isServerConnected() && !move_pickup_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!move_place_client_ptr_->isServerConnected() && !move_place_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!grasp_action_client_ptr_->isServerConnected() && !grasp_action_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!vise_action_client_ptr_->isServerConnected() && !vise_action_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!open_door_client_ptr_->isServerConnected() && !open_door_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!close_door_client_ptr_->isServerConnected() && !close_door_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!open_chuck_client_ptr_->isServerConnected() && !open_chuck_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!close_chuck_client_ptr_->isServerConnected() && !close_chuck_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER))) ||
-			(!joint_traj_client_ptr_->isServerConnected() && !joint_traj_client_ptr_->waitForServer(ros::Duration(DURATION_WAIT_SERVER)))
-	                ))
-	{
-		if(wait_attempts++ > MAX_WAIT_ATTEMPTS)
-		{
-			ROS_ERROR_STREAM("One or more action cnc/robot servers were not found, exiting");
-			return false;
-		}
-		ROS_WARN_STREAM("Waiting for cnc/robot action servers");
-		ros::Duration(DURATION_WAIT_SERVER).sleep();
-	}
-
 	// starting timers and action servers
 	robot_topics_timer_.start();
 	material_load_server_ptr_->start();
@@ -307,7 +362,6 @@ bool StateMachine::setup()
 
 void StateMachine::run()
 {
-	ros::NodeHandle nh;
 	set_active_state(states::STARTUP);
 
 	int last_state = states::EMPTY;
@@ -315,13 +369,15 @@ void StateMachine::run()
 	print_current_state();
 	while(ros::ok() && process_transition())
 	{
-		ros::spinOnce();
+		// a nodelet stops the loop when it is unloaded
+		boost::this_thread::interruption_point();
+		callback_queue_.callAvailable();
 
 		// getting force fault parameters
 		get_param_force_fault_flags();
 
 		// getting externally entered state
-		get_param_state_override();
+		get_param_state_override(ph_);
 
 		// printing new state info
 		active_state = get_active_state();
@@ -337,7 +393,7 @@ bool StateMachine::run_next_task()
 {
 	using namespace mtconnect_cnc_robot_example::state_machine::tasks;
 
-	if(!all_action_servers_connected())
+	if(!task_servers_connected())
 	{
 		ROS_WARN_STREAM("One or more action servers are not ready, aborting task");
 		current_task_sequence_.clear();
@@ -377,6 +433,9 @@ bool StateMachine::run_task(int task_id)
 	open_chuck_goal.open_chuck = CNC_ACTION_ACTIVE_FLAG;
 	close_chuck_goal.close_chuck = CNC_ACTION_ACTIVE_FLAG;
 
+	// timing every task, only the ones with goals are checked against their deadline
+	action_monitor_.start(TASK_MAP[task_id],ros::Time::now().toSec());
+
 	// clearing cartesian pose array
 	cartesian_poses_.poses.clear();
 	switch(task_id)
@@ -546,11 +605,36 @@ void StateMachine::cancel_active_material_requests()
 		material_unload_server_ptr_->setAborted(res,res.unload_state);
 		ROS_INFO_STREAM("Material Unload goal aborted");
 	}
+
+	// queued goals are still pending, they must be accepted before they can be aborted
+	std::string name;
+	double waited;
+	while(material_queue_.pop(ros::Time::now().toSec(),name,waited))
+	{
+		if(name == DEFAULT_MATERIAL_LOAD_ACTION && material_load_server_ptr_->isNewGoalAvailable())
+		{
+			MaterialLoadServer::Result res;
+			res.load_state= "Failed";
+			material_load_server_ptr_->acceptNewGoal();
+			material_load_server_ptr_->setAborted(res,res.load_state);
+			ROS_INFO_STREAM("Queued Material Load goal aborted");
+		}
+		else if(name == DEFAULT_MATERIAL_UNLOAD_ACTION && material_unload_server_ptr_->isNewGoalAvailable())
+		{
+			MaterialUnloadServer::Result res;
+			res.unload_state = "Failed";
+			material_unload_server_ptr_->acceptNewGoal();
+			material_unload_server_ptr_->setAborted(res,res.unload_state);
+			ROS_INFO_STREAM("Queued Material Unload goal aborted");
+		}
+	}
+	publish_material_queue();
 }
 
 void StateMachine::cancel_active_action_goals()
 {
 	move_pickup_client_ptr_->cancelAllGoals();
+	cancelMoveArm();
 	move_arm_client_ptr_->cancelAllGoals();
 	move_place_client_ptr_->cancelAllGoals();
 	joint_traj_client_ptr_->cancelAllGoals();
@@ -564,25 +648,68 @@ void StateMachine::cancel_active_action_goals()
 	vise_action_client_ptr_->cancelAllGoals();
 }
 
-bool StateMachine::all_action_servers_connected()
+bool StateMachine::task_servers_connected()
 {
+	using namespace mtconnect_cnc_robot_example::state_machine::tasks;
+
+	// collecting the subsystems used by the sequence
+	bool robot = false, cnc = false, gripper = false, vise = false;
+	for(unsigned int i = 0; i < current_task_sequence_.size(); i++)
+	{
+		switch(current_task_sequence_[i])
+		{
+		case CNC_OPEN_DOOR:
+		case CNC_CLOSE_DOOR:
+		case CNC_OPEN_CHUCK:
+		case CNC_CLOSE_CHUCK:
+			cnc = true;
+			break;
+
+		case VISE_OPEN:
+		case VISE_CLOSE:
+			vise = true;
+			break;
+
+		case GRIPPER_OPEN:
+		case GRIPPER_CLOSE:
+			gripper = true;
+			break;
+
+		case NO_TASK:
+		case MATERIAL_LOAD_START:
+		case MATERIAL_LOAD_END:
+		case MATERIAL_UNLOAD_START:
+		case MATERIAL_UNLOAD_END:
+		case TEST_TASK_START:
+		case TEST_TASK_END:
+			break;
+
+		default:
+			robot = true;
+			break;
+		}
+	}
+
 	// action clients
-	if(!(move_pickup_client_ptr_->isServerConnected() && move_place_client_ptr_->isServerConnected()&&
+	if(robot && !(move_pickup_client_ptr_->isServerConnected() && move_place_client_ptr_->isServerConnected()&&
 			move_arm_client_ptr_->isServerConnected() && joint_traj_client_ptr_->isServerConnected()))
 	{
 		set_active_state(states::ROBOT_FAULT);
 		return false;
 	}
 
-	if(!(open_door_client_ptr_->isServerConnected() &&	close_door_client_ptr_->isServerConnected() &&
+	if(cnc && !(open_door_client_ptr_->isServerConnected() &&	close_door_client_ptr_->isServerConnected() &&
 			open_chuck_client_ptr_->isServerConnected() && close_chuck_client_ptr_->isServerConnected()))
 	{
+		ROS_ERROR_STREAM("Cnc action servers are not connected, missing: "<<discovery_.getMissingString());
 		set_active_state(states::CNC_FAULT);
 		return false;
 	}
 
-	if(!grasp_action_client_ptr_->isServerConnected() && !vise_action_client_ptr_->isServerConnected())
+	if((gripper && !grasp_action_client_ptr_->isServerConnected()) ||
+			(vise && !vise_action_client_ptr_->isServerConnected()))
 	{
+		ROS_ERROR_STREAM("Gripper/vise action servers are not connected, missing: "<<discovery_.getMissingString());
 		set_active_state(states::GRIPPER_FAULT);
 		return false;
 	}
@@ -600,6 +727,12 @@ bool StateMachine::on_startup()
 
 bool StateMachine::on_ready()
 {
+	// requests that arrived while busy are taken before the cnc is told the robot is ready again
+	if(admit_material_request())
+	{
+		return true;
+	}
+
 	// communicating ready state with service call
 	if(!mat_load_set_state_.response.accepted)
 	{
@@ -771,6 +904,23 @@ bool StateMachine::on_robot_moving()
 	        {
 	          state = joint_traj_client_ptr_->getState().state_;
 	        }
+	        else if(move_arm_handle_)
+	        {
+	          // cartesian pose sequence running on the move arm executor
+	          switch(move_arm_handle_->getState())
+	          {
+	          case MoveArmHandle::PENDING:
+	          case MoveArmHandle::ACTIVE:
+	            state = actionlib::SimpleClientGoalState::ACTIVE;
+	            break;
+	          case MoveArmHandle::SUCCEEDED:
+	            state = actionlib::SimpleClientGoalState::SUCCEEDED;
+	            break;
+	          default:
+	            state = actionlib::SimpleClientGoalState::ABORTED;
+	            break;
+	          }
+	        }
 	        else
 	        {
 	          state = move_arm_client_ptr_->getState().state_;
@@ -781,10 +931,16 @@ bool StateMachine::on_robot_moving()
 	// examining state
 	switch(state)
 	{
+	case actionlib::SimpleClientGoalState::PENDING:
 	case actionlib::SimpleClientGoalState::ACTIVE:
+		if(is_task_stalled())
+		{
+			set_active_state(states::ROBOT_FAULT);
+		}
 		break;
 
 	case actionlib::SimpleClientGoalState::SUCCEEDED:
+		finish_task();
 		run_next_task();
 		break;
 
@@ -792,6 +948,7 @@ bool StateMachine::on_robot_moving()
 	case actionlib::SimpleClientGoalState::REJECTED:
 	case actionlib::SimpleClientGoalState::ABORTED:
 
+		action_monitor_.cancel(tasks::TASK_MAP[current_task_sequence_[current_task_index_]]);
 		set_active_state(states::ROBOT_FAULT);
 		break;
 	}
@@ -838,10 +995,16 @@ bool StateMachine::on_cnc_moving()
 	// examining state
 	switch(state)
 	{
+	case actionlib::SimpleClientGoalState::PENDING:
 	case actionlib::SimpleClientGoalState::ACTIVE:
+		if(is_task_stalled())
+		{
+			set_active_state(states::CNC_FAULT);
+		}
 		break;
 
 	case actionlib::SimpleClientGoalState::SUCCEEDED:
+		finish_task();
 		run_next_task();
 		break;
 
@@ -849,6 +1012,7 @@ bool StateMachine::on_cnc_moving()
 	case actionlib::SimpleClientGoalState::REJECTED:
 	case actionlib::SimpleClientGoalState::ABORTED:
 
+		action_monitor_.cancel(tasks::TASK_MAP[current_task_sequence_[current_task_index_]]);
 		set_active_state(states::CNC_FAULT);
 		break;
 	}
@@ -885,10 +1049,16 @@ bool StateMachine::on_gripper_moving()
 	// examining state
 	switch(state)
 	{
+	case actionlib::SimpleClientGoalState::PENDING:
 	case actionlib::SimpleClientGoalState::ACTIVE:
+		if(is_task_stalled())
+		{
+			set_active_state(states::GRIPPER_FAULT);
+		}
 		break;
 
 	case actionlib::SimpleClientGoalState::SUCCEEDED:
+		finish_task();
 		run_next_task();
 		break;
 
@@ -896,6 +1066,7 @@ bool StateMachine::on_gripper_moving()
 	case actionlib::SimpleClientGoalState::REJECTED:
 	case actionlib::SimpleClientGoalState::ABORTED:
 
+		action_monitor_.cancel(tasks::TASK_MAP[current_task_sequence_[current_task_index_]]);
 		set_active_state(states::GRIPPER_FAULT);
 		break;
 	}
@@ -903,6 +1074,32 @@ bool StateMachine::on_gripper_moving()
 	return true;
 }
 
+bool StateMachine::is_task_stalled()
+{
+	const std::string &task = tasks::TASK_MAP[current_task_sequence_[current_task_index_]];
+	double now = ros::Time::now().toSec();
+	if(!action_monitor_.isExpired(task,now))
+	{
+		return false;
+	}
+
+	ROS_ERROR_STREAM("Task "<<task<<" stalled, no result after "<<action_monitor_.getElapsed(task,now)
+			<<" s (deadline: "<<action_monitor_.getDeadline(task)<<" s, samples: "
+			<<action_monitor_.getSampleCount(task)<<")");
+	action_monitor_.cancel(task);
+	return true;
+}
+
+void StateMachine::finish_task()
+{
+	const std::string &task = tasks::TASK_MAP[current_task_sequence_[current_task_index_]];
+	if(action_monitor_.isStarted(task))
+	{
+		double latency = action_monitor_.finish(task,ros::Time::now().toSec());
+		ROS_DEBUG_STREAM("Task "<<task<<" completed in "<<latency<<" s");
+	}
+}
+
 bool StateMachine::on_robot_fault()
 {
 	cancel_active_material_requests();
@@ -927,7 +1124,7 @@ bool StateMachine::on_gripper_fault()
 // fault handling related methods
 void StateMachine::get_param_force_fault_flags()
 {
-	ros::NodeHandle nh("~");
+	ros::NodeHandle &nh = ph_;
 
 	bool force_robot_fault, force_cnc_fault, force_gripper_fault;
 	if(nh.getParam(PARAM_FORCE_ROBOT_FAULT,force_robot_fault) && force_robot_fault)
@@ -955,7 +1152,7 @@ void StateMachine::get_param_force_fault_flags()
 
 bool StateMachine::get_param_fault_on_task_check(int task_id)
 {
-	ros::NodeHandle nh("~");
+	ros::NodeHandle &nh = ph_;
 	int fault_on_task_id;
 
 	// check task id match
@@ -980,8 +1177,7 @@ bool StateMachine::check_arm_at_position(sensor_msgs::JointState &joints, double
 	int joint_index = 0;
 
 	// listening for joint state topic
-	ros::NodeHandle nh;
-	actual_joints_ptr = ros::topic::waitForMessage<sensor_msgs::JointState>(DEFAULT_JOINT_STATE_TOPIC,nh
+	actual_joints_ptr = ros::topic::waitForMessage<sensor_msgs::JointState>(DEFAULT_JOINT_STATE_TOPIC,nh_
 			,ros::Duration(DURATION_JOINT_MESSAGE_TIMEOUT));
 
 	if(actual_joints_ptr.get() != NULL /*null pointer*/)
@@ -1032,21 +1228,112 @@ bool StateMachine::check_arm_at_position(sensor_msgs::JointState &joints, double
 void StateMachine::material_load_goalcb(/*const MaterialLoadServer::GoalConstPtr &gh*/)
 {
 
-	if(get_active_state()== states::READY)
+	if(get_active_state()== states::READY && material_queue_.empty())
 	{
 		material_load_server_ptr_->acceptNewGoal();
 		set_active_state(states::MATERIAL_LOAD_STARTED);
 	}
+	else if(!queue_material_request(DEFAULT_MATERIAL_LOAD_ACTION))
+	{
+		MaterialLoadServer::Result res;
+		res.load_state= "Failed";
+		material_load_server_ptr_->acceptNewGoal();
+		material_load_server_ptr_->setAborted(res,res.load_state);
+	}
 
 }
 
 void StateMachine::material_unload_goalcb(/*const MaterialUnloadServer::GoalConstPtr &gh*/)
 {
-	if(get_active_state()== states::READY)
+	if(get_active_state()== states::READY && material_queue_.empty())
 	{
 		material_unload_server_ptr_->acceptNewGoal();
 		set_active_state(states::MATERIAL_UNLOAD_STARTED);
 	}
+	else if(!queue_material_request(DEFAULT_MATERIAL_UNLOAD_ACTION))
+	{
+		MaterialUnloadServer::Result res;
+		res.unload_state = "Failed";
+		material_unload_server_ptr_->acceptNewGoal();
+		material_unload_server_ptr_->setAborted(res,res.unload_state);
+	}
+}
+
+bool StateMachine::queue_material_request(const std::string &name)
+{
+	// faults need an external reset, requests are rejected so that the cnc does not wait on them
+	int state = get_active_state();
+	if(state == states::ROBOT_FAULT || state == states::CNC_FAULT || state == states::GRIPPER_FAULT)
+	{
+		ROS_WARN_STREAM("Rejecting "<<name<<" request in state "<<states::STATE_MAP[state]);
+		return false;
+	}
+
+	if(!material_queue_.push(name,ros::Time::now().toSec()))
+	{
+		ROS_WARN_STREAM("Material request queue full ("<<material_queue_.getMaxDepth()<<"), rejecting "<<name);
+		return false;
+	}
+
+	ROS_INFO_STREAM("Queued "<<name<<" request in state "<<states::STATE_MAP[state]<<", queue depth: "
+			<<material_queue_.size());
+	publish_material_queue();
+	return true;
+}
+
+bool StateMachine::admit_material_request()
+{
+	std::string name;
+	double waited;
+	bool admitted = false;
+	while(!admitted && material_queue_.pop(ros::Time::now().toSec(),name,waited))
+	{
+		if(name == DEFAULT_MATERIAL_LOAD_ACTION && material_load_server_ptr_->isNewGoalAvailable())
+		{
+			material_load_server_ptr_->acceptNewGoal();
+			if(material_load_server_ptr_->isPreemptRequested())
+			{
+				ROS_INFO_STREAM("Queued material load request was canceled");
+				material_load_server_ptr_->setPreempted();
+				continue;
+			}
+			ROS_INFO_STREAM("Accepting queued material load request, waited "<<waited<<" sec");
+			set_active_state(states::MATERIAL_LOAD_STARTED);
+			admitted = true;
+		}
+		else if(name == DEFAULT_MATERIAL_UNLOAD_ACTION && material_unload_server_ptr_->isNewGoalAvailable())
+		{
+			material_unload_server_ptr_->acceptNewGoal();
+			if(material_unload_server_ptr_->isPreemptRequested())
+			{
+				ROS_INFO_STREAM("Queued material unload request was canceled");
+				material_unload_server_ptr_->setPreempted();
+				continue;
+			}
+			ROS_INFO_STREAM("Accepting queued material unload request, waited "<<waited<<" sec");
+			set_active_state(states::MATERIAL_UNLOAD_STARTED);
+			admitted = true;
+		}
+		else
+		{
+			ROS_WARN_STREAM("Queued "<<name<<" request no longer pending, dropping it");
+		}
+		publish_material_queue();
+	}
+
+	return admitted;
+}
+
+void StateMachine::publish_material_queue()
+{
+	ros::Time now = ros::Time::now();
+	material_queue_msg_.header.stamp = now;
+	material_queue_msg_.depth = material_queue_.size();
+	material_queue_msg_.max_depth = material_queue_.getMaxDepth();
+	material_queue_msg_.requests = material_queue_.getNames(now.toSec());
+	material_queue_msg_.oldest_wait = ros::Duration(material_queue_.getOldestWait(now.toSec()));
+	material_queue_msg_.last_wait = ros::Duration(material_queue_.getLastWait());
+	material_queue_pub_.publish(material_queue_msg_);
 }
 
 void StateMachine::ros_status_subs_cb(const industrial_msgs::RobotStatusConstPtr &msg)
@@ -1106,6 +1393,7 @@ void StateMachine::publish_robot_topics_timercb(const ros::TimerEvent &evnt)
 	// publishing
 	robot_states_pub_.publish(robot_state_msg_);
 	robot_spindle_pub_.publish(robot_spindle_msg_);
+	publish_material_queue();
 }
 
 // move arm method
@@ -1116,7 +1404,10 @@ bool StateMachine::moveArm(move_arm_utils::JointStateInfo &joint_info)
 	joint_info.toJointConstraints(DEFAULT_JOINT_ERROR_TOLERANCE,DEFAULT_JOINT_ERROR_TOLERANCE,
 			move_arm_joint_goal_.motion_plan_request.goal_constraints.joint_constraints);
 
-	// sending goal
+	// sending goal, joint goals bypass the pose sequence executor which must not hold a goal of
+	// its own on the same client (sending would silently preempt it)
+	cancelMoveArm(true);
+	move_arm_handle_.reset();
 	move_arm_client_ptr_->sendGoal(move_arm_joint_goal_);
 	return true;
 }
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_cnc_robot_example/utilities/parameter_loader.h>
+#include <ros/serialization.h>
+#include <geometry_msgs/PoseArray.h>
+#include <fstream>
+#include <cstdio>
+#include <iterator>
+
+using namespace move_arm_utils;
+
+static const std::string SNAPSHOT_MAGIC = "MTPS";
+static const boost::uint32_t SNAPSHOT_VERSION = 1;
+
+// appends the ros serialized form of v to buf
+template<class T>
+static void appendBlob(std::vector<boost::uint8_t> &buf, const T &v)
+{
+  boost::uint32_t len = ros::serialization::serializationLength(v);
+  size_t offset = buf.size();
+  buf.resize(offset + len);
+  if (len > 0)
+  {
+    ros::serialization::OStream stream(&buf[offset], len);
+    ros::serialization::serialize(stream, v);
+  }
+}
+
+// reads v from buf starting at offset, offset is moved past the value
+template<class T>
+static bool readBlob(std::vector<boost::uint8_t> &buf, size_t &offset, T &v)
+{
+  if (offset >= buf.size())
+  {
+    return false;
+  }
+
+  try
+  {
+    ros::serialization::IStream stream(&buf[offset], buf.size() - offset);
+    ros::serialization::deserialize(stream, v);
+    offset = buf.size() - stream.getLength();
+  }
+  catch (ros::serialization::StreamOverrunException &e)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+ParameterLoader::ParameterLoader(std::string name_space) :
+    name_space_(name_space),
+    loaded_(false),
+    snapshot_dirty_(false),
+    snapshot_hits_(0)
+{
+}
+
+bool ParameterLoader::load()
+{
+  resolveNameSpace();
+
+  XmlRpc::XmlRpcValue root;
+  if (!ros::param::get(name_space_, root))
+  {
+    loaded_ = false;
+    ROS_ERROR_STREAM(ros::this_node::getName()<<": Failed to fetch parameter name space '"<<name_space_<<"'");
+    return false;
+  }
+  return load(root);
+}
+
+bool ParameterLoader::load(const XmlRpc::XmlRpcValue &root)
+{
+  resolveNameSpace();
+
+  root_ = root;
+  loaded_ = root_.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+  snapshot_hits_ = 0;
+  parsed_keys_.clear();
+  if (!loaded_)
+  {
+    ROS_ERROR_STREAM(ros::this_node::getName()<<": Parameter name space '"<<name_space_<<"' is not a struct");
+  }
+  return loaded_;
+}
+
+void ParameterLoader::resolveNameSpace()
+{
+  if (name_space_.empty())
+  {
+    name_space_ = ros::this_node::getNamespace();
+  }
+  name_space_ = ros::names::resolve(name_space_);
+}
+
+bool ParameterLoader::getParam(const std::string &key, XmlRpc::XmlRpcValue &val)
+{
+  std::string full_key = ros::names::resolve(key);
+
+  // keys outside of the loaded name space need their own master call
+  std::string prefix = name_space_ == "/" ? "/" : name_space_ + "/";
+  if (!loaded_ || full_key.compare(0, prefix.size(), prefix) != 0)
+  {
+    return ros::param::get(full_key, val);
+  }
+
+  // walking down the cached tree
+  XmlRpc::XmlRpcValue *node = &root_;
+  std::string relative = full_key.substr(prefix.size());
+  size_t start = 0;
+  while (start < relative.size())
+  {
+    size_t end = relative.find('/', start);
+    if (end == std::string::npos)
+    {
+      end = relative.size();
+    }
+
+    std::string member = relative.substr(start, end - start);
+    if (node->getType() != XmlRpc::XmlRpcValue::TypeStruct || !node->hasMember(member))
+    {
+      return false;
+    }
+    node = &((*node)[member]);
+    start = end + 1;
+  }
+
+  val = *node;
+  return true;
+}
+
+bool ParameterLoader::getParam(const std::string &key, std::string &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param) || param.getType() != XmlRpc::XmlRpcValue::TypeString)
+  {
+    return false;
+  }
+
+  val = static_cast<std::string>(param);
+  return true;
+}
+
+bool ParameterLoader::getParam(const std::string &key, bool &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param) || param.getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+  {
+    return false;
+  }
+
+  val = static_cast<bool>(param);
+  return true;
+}
+
+bool ParameterLoader::fetch(const std::string &key, CartesianTrajectory &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param))
+  {
+    ROS_ERROR_STREAM(ros::this_node::getName()<<": Parsing error in cartesian_trajectory parameter");
+    return false;
+  }
+
+  boost::uint64_t hash = hashValue(param);
+  const Entry *entry = findSnapshotEntry(key, CARTESIAN_TRAJECTORY, hash);
+  geometry_msgs::PoseArray poses;
+  if (entry != NULL)
+  {
+    std::vector<boost::uint8_t> data = entry->data_;
+    size_t offset = 0;
+    if (readBlob(data, offset, val.arm_group_) && readBlob(data, offset, val.frame_id_)
+        && readBlob(data, offset, val.link_name_) && readBlob(data, offset, poses))
+    {
+      val.cartesian_points_.resize(poses.poses.size());
+      for (unsigned int i = 0; i < poses.poses.size(); i++)
+      {
+        tf::poseMsgToTF(poses.poses[i], val.cartesian_points_[i]);
+      }
+      snapshot_hits_++;
+      storeEntry(key, CARTESIAN_TRAJECTORY, hash, entry->data_);
+      return true;
+    }
+  }
+
+  if (!val.parseParameters(param))
+  {
+    return false;
+  }
+  parsed_keys_.push_back(key);
+
+  std::vector<boost::uint8_t> data;
+  appendBlob(data, val.arm_group_);
+  appendBlob(data, val.frame_id_);
+  appendBlob(data, val.link_name_);
+  poses.poses.resize(val.cartesian_points_.size());
+  for (unsigned int i = 0; i < val.cartesian_points_.size(); i++)
+  {
+    tf::poseTFToMsg(val.cartesian_points_[i], poses.poses[i]);
+  }
+  appendBlob(data, poses);
+  storeEntry(key, CARTESIAN_TRAJECTORY, hash, data);
+  snapshot_dirty_ = true;
+  return true;
+}
+
+bool ParameterLoader::fetch(const std::string &key, PickupGoalInfo &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param))
+  {
+    return false;
+  }
+
+  boost::uint64_t hash = hashValue(param);
+  const Entry *entry = findSnapshotEntry(key, PICKUP_GOAL, hash);
+  object_manipulation_msgs::PickupGoal &goal = val;
+  if (entry != NULL)
+  {
+    std::vector<boost::uint8_t> data = entry->data_;
+    size_t offset = 0;
+    if (readBlob(data, offset, goal))
+    {
+      snapshot_hits_++;
+      storeEntry(key, PICKUP_GOAL, hash, entry->data_);
+      return true;
+    }
+  }
+
+  if (!val.parseParameters(param))
+  {
+    return false;
+  }
+  parsed_keys_.push_back(key);
+
+  std::vector<boost::uint8_t> data;
+  appendBlob(data, goal);
+  storeEntry(key, PICKUP_GOAL, hash, data);
+  snapshot_dirty_ = true;
+  return true;
+}
+
+bool ParameterLoader::fetch(const std::string &key, PlaceGoalInfo &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param))
+  {
+    return false;
+  }
+
+  boost::uint64_t hash = hashValue(param);
+  const Entry *entry = findSnapshotEntry(key, PLACE_GOAL, hash);
+  object_manipulation_msgs::PlaceGoal &goal = val;
+  if (entry != NULL)
+  {
+    std::vector<boost::uint8_t> data = entry->data_;
+    size_t offset = 0;
+    if (readBlob(data, offset, goal))
+    {
+      snapshot_hits_++;
+      storeEntry(key, PLACE_GOAL, hash, entry->data_);
+      return true;
+    }
+  }
+
+  if (!val.parseParameters(param))
+  {
+    return false;
+  }
+  parsed_keys_.push_back(key);
+
+  std::vector<boost::uint8_t> data;
+  appendBlob(data, goal);
+  storeEntry(key, PLACE_GOAL, hash, data);
+  snapshot_dirty_ = true;
+  return true;
+}
+
+bool ParameterLoader::fetch(const std::string &key, JointStateInfo &val)
+{
+  XmlRpc::XmlRpcValue param;
+  if (!getParam(key, param))
+  {
+    return false;
+  }
+
+  boost::uint64_t hash = hashValue(param);
+  const Entry *entry = findSnapshotEntry(key, JOINT_STATE, hash);
+  sensor_msgs::JointState &joints = val;
+  if (entry != NULL)
+  {
+    std::vector<boost::uint8_t> data = entry->data_;
+    size_t offset = 0;
+    if (readBlob(data, offset, val.arm_group) && readBlob(data, offset, joints))
+    {
+      snapshot_hits_++;
+      storeEntry(key, JOINT_STATE, hash, entry->data_);
+      return true;
+    }
+  }
+
+  if (!val.parseParameters(param))
+  {
+    return false;
+  }
+  parsed_keys_.push_back(key);
+
+  std::vector<boost::uint8_t> data;
+  appendBlob(data, val.arm_group);
+  appendBlob(data, joints);
+  storeEntry(key, JOINT_STATE, hash, data);
+  snapshot_dirty_ = true;
+  return true;
+}
+
+bool ParameterLoader::readSnapshot(const std::string &file_name)
+{
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    ROS_INFO_STREAM(ros::this_node::getName()<<": No parameter snapshot found at '"<<file_name<<"'");
+    return false;
+  }
+
+  std::vector<boost::uint8_t> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  size_t offset = 0;
+  std::string magic;
+  boost::uint32_t version, count;
+  if (!readBlob(buf, offset, magic) || magic != SNAPSHOT_MAGIC || !readBlob(buf, offset, version)
+      || version != SNAPSHOT_VERSION || !readBlob(buf, offset, count))
+  {
+    ROS_WARN_STREAM(ros::this_node::getName()<<": Ignoring unrecognized parameter snapshot '"<<file_name<<"'");
+    return false;
+  }
+
+  snapshot_.clear();
+  for (unsigned int i = 0; i < count; i++)
+  {
+    std::string key;
+    Entry entry;
+    if (!readBlob(buf, offset, key) || !readBlob(buf, offset, entry.type_) || !readBlob(buf, offset, entry.hash_)
+        || !readBlob(buf, offset, entry.data_))
+    {
+      ROS_WARN_STREAM(ros::this_node::getName()<<": Parameter snapshot '"<<file_name<<"' is truncated, ignoring it");
+      snapshot_.clear();
+      return false;
+    }
+    snapshot_[key] = entry;
+  }
+
+  return true;
+}
+
+bool ParameterLoader::writeSnapshot(const std::string &file_name)
+{
+  if (!snapshot_dirty_)
+  {
+    return true;
+  }
+
+  std::vector<boost::uint8_t> buf;
+  appendBlob(buf, SNAPSHOT_MAGIC);
+  appendBlob(buf, SNAPSHOT_VERSION);
+  appendBlob(buf, (boost::uint32_t)fetched_.size());
+  std::map<std::string, Entry>::iterator i;
+  for (i = fetched_.begin(); i != fetched_.end(); i++)
+  {
+    appendBlob(buf, i->first);
+    appendBlob(buf, i->second.type_);
+    appendBlob(buf, i->second.hash_);
+    appendBlob(buf, i->second.data_);
+  }
+
+  // writing to a temporary file first so that a crash never leaves a partial snapshot behind
+  std::string temp_name = file_name + ".tmp";
+  std::ofstream file(temp_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file || !file.write(reinterpret_cast<const char*>(buf.empty() ? NULL : &buf[0]), buf.size()))
+  {
+    ROS_WARN_STREAM(ros::this_node::getName()<<": Failed to write parameter snapshot '"<<file_name<<"'");
+    return false;
+  }
+  file.close();
+
+  if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+  {
+    ROS_WARN_STREAM(ros::this_node::getName()<<": Failed to write parameter snapshot '"<<file_name<<"'");
+    return false;
+  }
+
+  snapshot_dirty_ = false;
+  return true;
+}
+
+boost::uint64_t ParameterLoader::hashValue(XmlRpc::XmlRpcValue &val)
+{
+  // FNV-1a over the xml form, struct members are kept sorted by XmlRpcValue so it is stable
+  std::string xml = val.toXml();
+  boost::uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < xml.size(); i++)
+  {
+    hash ^= static_cast<boost::uint8_t>(xml[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+const ParameterLoader::Entry* ParameterLoader::findSnapshotEntry(const std::string &key, EntryType type,
+                                                                 boost::uint64_t hash)
+{
+  // unchanged since the last load
+  std::map<std::string, Entry>::const_iterator i = fetched_.find(key);
+  if (i != fetched_.end() && i->second.type_ == (boost::uint32_t)type && i->second.hash_ == hash)
+  {
+    return &(i->second);
+  }
+
+  i = snapshot_.find(key);
+  if (i == snapshot_.end() || i->second.type_ != (boost::uint32_t)type || i->second.hash_ != hash)
+  {
+    return NULL;
+  }
+  return &(i->second);
+}
+
+void ParameterLoader::storeEntry(const std::string &key, EntryType type, boost::uint64_t hash,
+                                 const std::vector<boost::uint8_t> &data)
+{
+  Entry &entry = fetched_[key];
+  entry.type_ = type;
+  entry.hash_ = hash;
+  entry.data_ = data;
+}
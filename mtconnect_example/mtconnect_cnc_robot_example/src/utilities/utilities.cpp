@@ -18,6 +18,7 @@
 #include <mtconnect_task_parser/task_parser.h>
 #include <boost/tuple/tuple.hpp>
 #include "boost/make_shared.hpp"
+#include <algorithm>
 
 using namespace move_arm_utils;
 
@@ -241,20 +242,30 @@ bool CartesianTrajectory::parseParameters(XmlRpc::XmlRpcValue &paramVal)
   return success;
 }
 
-void CartesianTrajectory::getMarker(nav_msgs::Path &p)
+void CartesianTrajectory::getMarker(nav_msgs::Path &p, unsigned int max_poses) const
 {
   p.header.frame_id = frame_id_;
   p.header.stamp = ros::Time(0.0f);
+  p.poses.clear();
   geometry_msgs::PoseStamped poseSt;
 
   // initializing pose stamped object
   poseSt.header.frame_id = frame_id_;
   poseSt.header.stamp = ros::Time(0.0f);
 
-  std::vector<tf::Transform>::iterator i;
-  for (i = cartesian_points_.begin(); i != cartesian_points_.end(); i++)
+  if (cartesian_points_.empty() || max_poses == 0)
   {
-    tf::poseTFToMsg(*i, poseSt.pose);
+    return;
+  }
+
+  // picking evenly spaced points when the trajectory is longer than the bound
+  unsigned int count = cartesian_points_.size();
+  unsigned int num_poses = std::min(count, max_poses);
+  p.poses.reserve(num_poses);
+  for (unsigned int i = 0; i < num_poses; i++)
+  {
+    unsigned int index = (num_poses == 1) ? count - 1 : (i * (count - 1)) / (num_poses - 1);
+    tf::poseTFToMsg(cartesian_points_[index], poseSt.pose);
     p.poses.push_back(poseSt);
   }
 
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "mtconnect_cnc_robot_example/utilities/utilities.h"
+#include "mtconnect_cnc_robot_example/utilities/parameter_loader.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+
+using namespace move_arm_utils;
+
+static void makeTrajectory(CartesianTrajectory &traj, unsigned int num_points)
+{
+  traj.frame_id_ = "world_frame";
+  traj.cartesian_points_.clear();
+  for (unsigned int i = 0; i < num_points; i++)
+  {
+    traj.cartesian_points_.push_back(tf::Transform(tf::Quaternion::getIdentity(), tf::Vector3(i, 0, 0)));
+  }
+}
+
+TEST(CartesianTrajectory, marker_follows_trajectory_changes)
+{
+  // the action client keeps one path message and rebuilds it whenever setCartesianTrajectory
+  // replaces the trajectory, short and long trajectories alternate here
+  CartesianTrajectory short_traj, long_traj;
+  makeTrajectory(short_traj, 10);
+  makeTrajectory(long_traj, 5 * MAX_PATH_MARKER_POSES + 3);
+
+  nav_msgs::Path path;
+  long_traj.getMarker(path);
+  size_t capacity = path.poses.capacity();
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    const CartesianTrajectory &traj = (i % 2 == 0) ? short_traj : long_traj;
+    traj.getMarker(path);
+    ASSERT_EQ(std::min<size_t>(traj.cartesian_points_.size(), MAX_PATH_MARKER_POSES), path.poses.size());
+  }
+
+  // storage is reused, the message never grows past the bound
+  EXPECT_EQ(capacity, path.poses.capacity());
+  EXPECT_EQ("world_frame", path.header.frame_id);
+}
+
+TEST(CartesianTrajectory, marker_size_is_bounded)
+{
+  CartesianTrajectory traj;
+  nav_msgs::Path path;
+  makeTrajectory(traj, 5 * MAX_PATH_MARKER_POSES + 3);
+
+  traj.getMarker(path);
+  ASSERT_EQ(MAX_PATH_MARKER_POSES, path.poses.size());
+
+  // end points are kept when subsampling
+  EXPECT_DOUBLE_EQ(0.0, path.poses.front().pose.position.x);
+  EXPECT_DOUBLE_EQ(5 * MAX_PATH_MARKER_POSES + 2, path.poses.back().pose.position.x);
+
+  traj.getMarker(path, 1);
+  ASSERT_EQ(1u, path.poses.size());
+  EXPECT_DOUBLE_EQ(5 * MAX_PATH_MARKER_POSES + 2, path.poses.back().pose.position.x);
+}
+
+TEST(CartesianTrajectory, marker_empty_trajectory)
+{
+  CartesianTrajectory traj;
+  nav_msgs::Path path;
+  makeTrajectory(traj, 4);
+  traj.getMarker(path);
+  ASSERT_EQ(4u, path.poses.size());
+
+  // a previously filled message is cleared
+  traj.cartesian_points_.clear();
+  traj.getMarker(path);
+  EXPECT_TRUE(path.poses.empty());
+}
+
+TEST(ParameterLoader, hash_tracks_parameter_changes)
+{
+  XmlRpc::XmlRpcValue a, b;
+  a["frame_id"] = "world_frame";
+  a["points"][0] = 1.0;
+  b["points"][0] = 1.0;
+  b["frame_id"] = "world_frame";
+
+  // member insertion order does not matter
+  EXPECT_EQ(ParameterLoader::hashValue(a), ParameterLoader::hashValue(b));
+
+  b["points"][0] = 1.5;
+  EXPECT_NE(ParameterLoader::hashValue(a), ParameterLoader::hashValue(b));
+}
+
+static void setJoint(XmlRpc::XmlRpcValue &root, const std::string &key, double position)
+{
+  root[key]["joints"][0]["name"] = "joint_1";
+  root[key]["joints"][0]["position"] = position;
+}
+
+static void fetchPositions(ParameterLoader &loader, JointStateInfo &home, JointStateInfo &wait)
+{
+  ASSERT_TRUE(loader.fetch("/loader_test/joint_home_position", home));
+  ASSERT_TRUE(loader.fetch("/loader_test/joint_wait_position", wait));
+}
+
+TEST(ParameterLoader, reload_parses_only_changed_params)
+{
+  XmlRpc::XmlRpcValue root;
+  setJoint(root, "joint_home_position", 0.0);
+  setJoint(root, "joint_wait_position", 1.0);
+
+  ParameterLoader loader("/loader_test");
+  JointStateInfo home, wait;
+  ASSERT_TRUE(loader.load(root));
+  fetchPositions(loader, home, wait);
+  EXPECT_EQ(2u, loader.getParsedKeys().size());
+  EXPECT_EQ(0u, loader.getSnapshotHits());
+
+  // unchanged reload, nothing is parsed again
+  ASSERT_TRUE(loader.load(root));
+  fetchPositions(loader, home, wait);
+  EXPECT_TRUE(loader.getParsedKeys().empty());
+  EXPECT_EQ(2u, loader.getSnapshotHits());
+  EXPECT_DOUBLE_EQ(1.0, wait.position[0]);
+
+  // only the changed parameter is parsed again
+  setJoint(root, "joint_wait_position", 2.0);
+  ASSERT_TRUE(loader.load(root));
+  fetchPositions(loader, home, wait);
+  ASSERT_EQ(1u, loader.getParsedKeys().size());
+  EXPECT_EQ("/loader_test/joint_wait_position", loader.getParsedKeys()[0]);
+  EXPECT_EQ(1u, loader.getSnapshotHits());
+  EXPECT_DOUBLE_EQ(0.0, home.position[0]);
+  EXPECT_DOUBLE_EQ(2.0, wait.position[0]);
+}
+
+TEST(ParameterLoader, snapshot_skips_unchanged_params)
+{
+  const std::string file_name = "/tmp/parameter_loader_utest.snapshot";
+  XmlRpc::XmlRpcValue root;
+  setJoint(root, "joint_home_position", 0.0);
+  setJoint(root, "joint_wait_position", 1.0);
+
+  ParameterLoader first("/loader_test");
+  JointStateInfo home, wait;
+  ASSERT_TRUE(first.load(root));
+  fetchPositions(first, home, wait);
+  ASSERT_TRUE(first.writeSnapshot(file_name));
+
+  // a later startup decodes everything from the snapshot
+  ParameterLoader second("/loader_test");
+  JointStateInfo snapshot_home, snapshot_wait;
+  ASSERT_TRUE(second.readSnapshot(file_name));
+  ASSERT_TRUE(second.load(root));
+  fetchPositions(second, snapshot_home, snapshot_wait);
+  EXPECT_TRUE(second.getParsedKeys().empty());
+  EXPECT_EQ(2u, second.getSnapshotHits());
+  EXPECT_EQ(wait.name, snapshot_wait.name);
+  EXPECT_EQ(wait.position, snapshot_wait.position);
+
+  // a changed parameter invalidates its own entry only
+  setJoint(root, "joint_home_position", 0.5);
+  ParameterLoader third("/loader_test");
+  ASSERT_TRUE(third.readSnapshot(file_name));
+  ASSERT_TRUE(third.load(root));
+  fetchPositions(third, snapshot_home, snapshot_wait);
+  ASSERT_EQ(1u, third.getParsedKeys().size());
+  EXPECT_EQ("/loader_test/joint_home_position", third.getParsedKeys()[0]);
+  EXPECT_DOUBLE_EQ(0.5, snapshot_home.position[0]);
+
+  std::remove(file_name.c_str());
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
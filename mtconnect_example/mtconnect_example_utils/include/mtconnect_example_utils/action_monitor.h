@@ -0,0 +1,131 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef ACTION_MONITOR_H_
+#define ACTION_MONITOR_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread/mutex.hpp>
+
+namespace mtconnect_example_utils
+{
+
+static const double DEFAULT_DEADLINE_FACTOR = 3.0;
+static const double DEFAULT_ACTION_DEADLINE = 60.0; // seconds, until enough latencies are known
+static const double DEFAULT_MIN_DEADLINE = 2.0; // seconds
+static const int DEFAULT_DEADLINE_SAMPLES = 10;
+static const int ACTION_LATENCY_HISTORY = 100;
+static const double DEADLINE_PERCENTILE = 0.99;
+
+/**
+ * \brief Times action goals and detects the ones that stalled.
+ *
+ * Every action (by name) keeps its latest latencies, from the goal being sent to its result.
+ * Once enough latencies are known the deadline of an action is its 99th percentile latency
+ * times the deadline factor (never less than the min deadline), before that the default
+ * deadline applies.  A zero deadline disables stall detection.  Times are in seconds
+ * (i.e. ros::Time::toSec()), the monitor itself does not read a clock.  The monitor may be
+ * used from several threads (i.e. results reported from action client done callbacks).
+ */
+class ActionMonitor
+{
+public:
+  ActionMonitor();
+
+  void setDeadlineFactor(double factor);
+
+  void setDefaultDeadline(double deadline);
+
+  void setMinDeadline(double deadline);
+
+  void setMinSamples(int samples);
+
+  /**
+   * \brief A goal was sent, timing starts over if one was already running
+   */
+  void start(const std::string &action, double now);
+
+  /**
+   * \brief The goal completed, its latency is recorded
+   *
+   * \return the latency, zero if the action wasn't started
+   */
+  double finish(const std::string &action, double now);
+
+  /**
+   * \brief The goal sent at start completed (i.e. reported by its done callback)
+   *
+   * The latency is recorded even if another goal of the action was started since, timing of
+   * the newer goal goes on.
+   *
+   * \return the latency
+   */
+  double finish(const std::string &action, double start, double now);
+
+  /**
+   * \brief Stops timing without recording a latency (i.e. failed or canceled goals)
+   */
+  void cancel(const std::string &action);
+
+  bool isStarted(const std::string &action) const;
+
+  /**
+   * \brief True if the action was started and its deadline passed
+   */
+  bool isExpired(const std::string &action, double now) const;
+
+  double getElapsed(const std::string &action, double now) const;
+
+  double getDeadline(const std::string &action) const;
+
+  /**
+   * \brief Latency percentile (0 to 1) of the recorded latencies, zero if none
+   */
+  double getPercentile(const std::string &action, double percentile) const;
+
+  int getSampleCount(const std::string &action) const;
+
+protected:
+  struct Timing
+  {
+    Timing() : started_(false), start_(0.0), next_(0) {}
+
+    bool started_;
+    double start_;
+    std::vector<double> latencies_; // ring of the latest latencies
+    size_t next_;
+  };
+
+  // unlocked helpers, the public methods hold the mutex
+  const Timing* find(const std::string &action) const;
+  void record(Timing &timing, double latency);
+  double deadline(const Timing *timing) const;
+  static double percentile(const Timing &timing, double percentile);
+
+  mutable boost::mutex mutex_;
+
+  double factor_;
+  double default_deadline_;
+  double min_deadline_;
+  int min_samples_;
+  std::map<std::string, Timing> timings_;
+};
+
+}
+
+#endif /* ACTION_MONITOR_H_ */
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef DISCOVERY_MANAGER_H_
+#define DISCOVERY_MANAGER_H_
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace mtconnect_example_utils
+{
+
+static const double DEFAULT_DISCOVERY_PERIOD = 1.0; // seconds
+
+/**
+ * \brief Waits for remote action servers and services concurrently.
+ *
+ * Every dependency is waited on by a thread of its own, discovery takes as long as the
+ * slowest server instead of the sum of all of them.  Dependencies are grouped by subsystem
+ * (i.e. "cnc" or "gripper") so that the subsystems that are present can be used while the
+ * others are still being waited on.  A dependency that was found stays found, it's up to
+ * the caller to check the connection before using it.
+ */
+class DiscoveryManager
+{
+public:
+  /**
+   * \brief Blocks until the dependency is available or the timeout expires
+   *
+   * \return true if available
+   */
+  typedef boost::function<bool(const ros::Duration&)> WaitFunction;
+
+  /**
+   * \param period longest wait of a single discovery attempt (bounds the time stop() takes)
+   */
+  DiscoveryManager(double period = DEFAULT_DISCOVERY_PERIOD);
+
+  ~DiscoveryManager();
+
+  /**
+   * \brief Adds a dependency, discovery begins right away if the manager was started
+   *
+   * \param required optional dependencies are discovered but not waited on by waitForAll
+   */
+  void add(const std::string &name, const std::string &subsystem, WaitFunction wait, bool required = true);
+
+  /**
+   * \brief Adds an actionlib client (SimpleActionClient or ActionClient)
+   */
+  template<class Client>
+  void addAction(const std::string &name, const std::string &subsystem, boost::shared_ptr<Client> client,
+                 bool required = true)
+  {
+    add(name, subsystem, boost::bind(&Client::waitForServer, client, _1), required);
+  }
+
+  void addService(const std::string &name, const std::string &subsystem, const ros::ServiceClient &client,
+                  bool required = true);
+
+  /**
+   * \brief Starts discovering every dependency (non-blocking)
+   */
+  void start();
+
+  void stop();
+
+  /**
+   * \brief Starts discovery if needed and blocks until every required dependency is found
+   *
+   * \param timeout zero waits forever
+   * \return true if all required dependencies were found
+   */
+  bool waitForAll(const ros::Duration &timeout);
+
+  /**
+   * \brief True if every dependency with the given name was found
+   */
+  bool isFound(const std::string &name);
+
+  /**
+   * \brief True if every dependency of the subsystem was found
+   */
+  bool isSubsystemFound(const std::string &subsystem);
+
+  bool isAllFound();
+
+  std::vector<std::string> getMissing();
+
+  std::vector<std::string> getMissingSubsystems();
+
+  /**
+   * \brief Comma separated list of the missing dependencies, i.e. "vise_action_service (vise)"
+   */
+  std::string getMissingString();
+
+protected:
+  struct Dependency
+  {
+    std::string name_;
+    std::string subsystem_;
+    WaitFunction wait_;
+    bool required_;
+    bool found_;
+  };
+  typedef boost::shared_ptr<Dependency> DependencyPtr;
+
+  void discover(DependencyPtr dependency);
+
+  bool isRunning();
+
+  bool isRequiredFound();
+
+  double period_;
+  std::vector<DependencyPtr> dependencies_;
+  std::vector<boost::shared_ptr<boost::thread> > threads_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  bool running_;
+};
+
+}
+
+#endif /* DISCOVERY_MANAGER_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef MATERIAL_REQUEST_QUEUE_H_
+#define MATERIAL_REQUEST_QUEUE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace mtconnect_example_utils
+{
+
+static const int DEFAULT_MATERIAL_QUEUE_DEPTH = 2;
+static const double DEFAULT_MATERIAL_MAX_WAIT = 120.0; // seconds
+static const double SERVICE_TIME_FILTER = 0.3; // weight of the newest sample
+
+/**
+ * \brief Holds the material requests that arrive while the robot is busy.
+ *
+ * Requests are identified by name (i.e. the action they came from).  A request that is
+ * already queued is not queued twice, it keeps its original place and arrival time since
+ * the action server only ever holds the latest goal of each action.  The highest priority
+ * request is admitted first.  Requests of equal priority are ordered by predicted completion,
+ * the request's predicted service time less the time it has waited, so short jobs go first
+ * while old requests catch up (arrival order when no service times are known).  A request
+ * that waited longer than the max wait is admitted before any other, no request starves.
+ * Times are in seconds (i.e. ros::Time::toSec()), the queue itself does not read a clock.
+ */
+class MaterialRequestQueue
+{
+public:
+  /**
+   * \param max_depth number of requests that may wait, zero disables queuing
+   */
+  MaterialRequestQueue(int max_depth = DEFAULT_MATERIAL_QUEUE_DEPTH);
+
+  void setMaxDepth(int max_depth);
+
+  int getMaxDepth() const
+  {
+    return max_depth_;
+  }
+
+  /**
+   * \brief Sets the priority of a request, higher priorities are admitted first (default 0)
+   */
+  void setPriority(const std::string &name, int priority);
+
+  /**
+   * \brief Requests waiting longer than this are admitted first, oldest first (zero disables)
+   */
+  void setMaxWait(double max_wait);
+
+  /**
+   * \brief Updates the predicted service time of a request from a measured one (filtered)
+   */
+  void recordServiceTime(const std::string &name, double service_time);
+
+  /**
+   * \brief Predicted service time of a request (zero until one was recorded)
+   */
+  double getServiceTime(const std::string &name) const;
+
+  /**
+   * \brief Queues a request
+   *
+   * \return false if the queue is full, true if queued or already queued
+   */
+  bool push(const std::string &name, double stamp);
+
+  /**
+   * \brief Removes the highest priority request
+   *
+   * \param name name of the admitted request
+   * \param waited time the admitted request spent in the queue
+   * \return false if the queue is empty
+   */
+  bool pop(double now, std::string &name, double &waited);
+
+  /**
+   * \brief Removes a request without admitting it (i.e. canceled or aborted)
+   *
+   * \return true if the request was queued
+   */
+  bool remove(const std::string &name);
+
+  bool contains(const std::string &name) const;
+
+  void clear();
+
+  bool empty() const
+  {
+    return requests_.empty();
+  }
+
+  int size() const
+  {
+    return static_cast<int>(requests_.size());
+  }
+
+  /**
+   * \brief Queued request names in admission order
+   */
+  std::vector<std::string> getNames(double now) const;
+
+  /**
+   * \brief Time the longest waiting request has spent in the queue (zero if empty)
+   */
+  double getOldestWait(double now) const;
+
+  /**
+   * \brief Time the last admitted request spent in the queue
+   */
+  double getLastWait() const
+  {
+    return last_wait_;
+  }
+
+protected:
+  struct Request
+  {
+    std::string name_;
+    double stamp_;
+  };
+
+  int getPriority(const std::string &name) const;
+
+  /**
+   * \brief Index of the next request to admit (queue must not be empty)
+   */
+  size_t next(double now) const;
+
+  /**
+   * \brief Predicted service time less the time waited, lower is admitted first
+   */
+  double getCompletion(const Request &request, double now) const;
+
+  int max_depth_;
+  double max_wait_;
+  double last_wait_;
+  std::vector<Request> requests_;
+  std::map<std::string, int> priorities_;
+  std::map<std::string, double> service_times_;
+};
+
+}
+
+#endif /* MATERIAL_REQUEST_QUEUE_H_ */
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_example_utils/action_monitor.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace mtconnect_example_utils;
+
+ActionMonitor::ActionMonitor() :
+    factor_(DEFAULT_DEADLINE_FACTOR), default_deadline_(DEFAULT_ACTION_DEADLINE), min_deadline_(DEFAULT_MIN_DEADLINE),
+    min_samples_(DEFAULT_DEADLINE_SAMPLES)
+{
+}
+
+void ActionMonitor::setDeadlineFactor(double factor)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  factor_ = factor;
+}
+
+void ActionMonitor::setDefaultDeadline(double deadline)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  default_deadline_ = deadline;
+}
+
+void ActionMonitor::setMinDeadline(double deadline)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  min_deadline_ = deadline;
+}
+
+void ActionMonitor::setMinSamples(int samples)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  min_samples_ = samples;
+}
+
+void ActionMonitor::start(const std::string &action, double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Timing &timing = timings_[action];
+  timing.started_ = true;
+  timing.start_ = now;
+}
+
+double ActionMonitor::finish(const std::string &action, double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::map<std::string, Timing>::iterator it = timings_.find(action);
+  if (it == timings_.end() || !it->second.started_)
+  {
+    return 0.0;
+  }
+
+  double latency = now - it->second.start_;
+  record(it->second, latency);
+  it->second.started_ = false;
+  return latency;
+}
+
+double ActionMonitor::finish(const std::string &action, double start, double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Timing &timing = timings_[action];
+  double latency = now - start;
+  record(timing, latency);
+  if (timing.started_ && timing.start_ == start)
+  {
+    timing.started_ = false;
+  }
+  return latency;
+}
+
+void ActionMonitor::cancel(const std::string &action)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::map<std::string, Timing>::iterator it = timings_.find(action);
+  if (it != timings_.end())
+  {
+    it->second.started_ = false;
+  }
+}
+
+bool ActionMonitor::isStarted(const std::string &action) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const Timing *timing = find(action);
+  return timing && timing->started_;
+}
+
+bool ActionMonitor::isExpired(const std::string &action, double now) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const Timing *timing = find(action);
+  double limit = deadline(timing);
+  return limit > 0.0 && timing && timing->started_ && now - timing->start_ > limit;
+}
+
+double ActionMonitor::getElapsed(const std::string &action, double now) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const Timing *timing = find(action);
+  return timing && timing->started_ ? now - timing->start_ : 0.0;
+}
+
+double ActionMonitor::getDeadline(const std::string &action) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return deadline(find(action));
+}
+
+double ActionMonitor::getPercentile(const std::string &action, double percentile) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const Timing *timing = find(action);
+  return timing ? ActionMonitor::percentile(*timing, percentile) : 0.0;
+}
+
+int ActionMonitor::getSampleCount(const std::string &action) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const Timing *timing = find(action);
+  return timing ? static_cast<int>(timing->latencies_.size()) : 0;
+}
+
+const ActionMonitor::Timing* ActionMonitor::find(const std::string &action) const
+{
+  std::map<std::string, Timing>::const_iterator it = timings_.find(action);
+  return it == timings_.end() ? NULL : &it->second;
+}
+
+void ActionMonitor::record(Timing &timing, double latency)
+{
+  if (timing.latencies_.size() < static_cast<size_t>(ACTION_LATENCY_HISTORY))
+  {
+    timing.latencies_.push_back(latency);
+  }
+  else
+  {
+    timing.latencies_[timing.next_] = latency;
+    timing.next_ = (timing.next_ + 1) % ACTION_LATENCY_HISTORY;
+  }
+}
+
+double ActionMonitor::deadline(const Timing *timing) const
+{
+  int samples = timing ? static_cast<int>(timing->latencies_.size()) : 0;
+  if (samples < min_samples_ || factor_ <= 0.0)
+  {
+    return default_deadline_;
+  }
+  return std::max(percentile(*timing, DEADLINE_PERCENTILE) * factor_, min_deadline_);
+}
+
+double ActionMonitor::percentile(const Timing &timing, double percentile)
+{
+  if (timing.latencies_.empty())
+  {
+    return 0.0;
+  }
+
+  // nearest rank
+  std::vector<double> latencies(timing.latencies_);
+  size_t rank = static_cast<size_t>(std::ceil(percentile * latencies.size()));
+  size_t index = rank > 0 ? rank - 1 : 0;
+  std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+  return latencies[index];
+}
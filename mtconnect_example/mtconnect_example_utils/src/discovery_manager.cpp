@@ -0,0 +1,232 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_example_utils/discovery_manager.h>
+#include <algorithm>
+#include <sstream>
+
+using namespace mtconnect_example_utils;
+
+DiscoveryManager::DiscoveryManager(double period) :
+    period_(period), running_(false)
+{
+}
+
+DiscoveryManager::~DiscoveryManager()
+{
+  stop();
+}
+
+void DiscoveryManager::add(const std::string &name, const std::string &subsystem, WaitFunction wait,
+                           bool required)
+{
+  DependencyPtr dependency(new Dependency());
+  dependency->name_ = name;
+  dependency->subsystem_ = subsystem;
+  dependency->wait_ = wait;
+  dependency->required_ = required;
+  dependency->found_ = false;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  dependencies_.push_back(dependency);
+  if (running_)
+  {
+    threads_.push_back(
+        boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&DiscoveryManager::discover, this,
+                                                                       dependency))));
+  }
+}
+
+void DiscoveryManager::addService(const std::string &name, const std::string &subsystem,
+                                  const ros::ServiceClient &client, bool required)
+{
+  add(name, subsystem, boost::bind(&ros::ServiceClient::waitForExistence, client, _1), required);
+}
+
+void DiscoveryManager::start()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (running_)
+  {
+    return;
+  }
+
+  running_ = true;
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (!dependencies_[i]->found_)
+    {
+      threads_.push_back(
+          boost::shared_ptr<boost::thread>(
+              new boost::thread(boost::bind(&DiscoveryManager::discover, this, dependencies_[i]))));
+    }
+  }
+}
+
+void DiscoveryManager::stop()
+{
+  std::vector<boost::shared_ptr<boost::thread> > threads;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+    threads.swap(threads_);
+    condition_.notify_all();
+  }
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+  }
+}
+
+bool DiscoveryManager::waitForAll(const ros::Duration &timeout)
+{
+  start();
+
+  boost::system_time deadline = boost::get_system_time()
+      + boost::posix_time::milliseconds(static_cast<long>(timeout.toSec() * 1000.0));
+  boost::mutex::scoped_lock lock(mutex_);
+  while (running_ && !isRequiredFound() && ros::ok())
+  {
+    // woken up whenever a dependency is found, the timed wait also covers ros shutting down
+    boost::system_time next = boost::get_system_time()
+        + boost::posix_time::milliseconds(static_cast<long>(period_ * 1000.0));
+    if (timeout.toSec() > 0.0)
+    {
+      if (boost::get_system_time() >= deadline)
+      {
+        break;
+      }
+      next = std::min(next, deadline);
+    }
+    condition_.timed_wait(lock, next);
+  }
+
+  return isRequiredFound();
+}
+
+bool DiscoveryManager::isFound(const std::string &name)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (dependencies_[i]->name_ == name && !dependencies_[i]->found_)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DiscoveryManager::isSubsystemFound(const std::string &subsystem)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (dependencies_[i]->subsystem_ == subsystem && !dependencies_[i]->found_)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DiscoveryManager::isAllFound()
+{
+  return getMissing().empty();
+}
+
+std::vector<std::string> DiscoveryManager::getMissing()
+{
+  std::vector<std::string> missing;
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (!dependencies_[i]->found_)
+    {
+      missing.push_back(dependencies_[i]->name_);
+    }
+  }
+  return missing;
+}
+
+std::vector<std::string> DiscoveryManager::getMissingSubsystems()
+{
+  std::vector<std::string> missing;
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    const std::string &subsystem = dependencies_[i]->subsystem_;
+    if (!dependencies_[i]->found_ && std::find(missing.begin(), missing.end(), subsystem) == missing.end())
+    {
+      missing.push_back(subsystem);
+    }
+  }
+  return missing;
+}
+
+std::string DiscoveryManager::getMissingString()
+{
+  std::stringstream ss;
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (!dependencies_[i]->found_)
+    {
+      if (!ss.str().empty())
+      {
+        ss << ", ";
+      }
+      ss << dependencies_[i]->name_ << " (" << dependencies_[i]->subsystem_ << ")";
+    }
+  }
+  return ss.str();
+}
+
+void DiscoveryManager::discover(DependencyPtr dependency)
+{
+  ros::Duration period(period_);
+  while (isRunning() && ros::ok())
+  {
+    if (dependency->wait_(period))
+    {
+      ROS_INFO_STREAM("Discovered " << dependency->name_ << " (" << dependency->subsystem_ << ")");
+      boost::mutex::scoped_lock lock(mutex_);
+      dependency->found_ = true;
+      condition_.notify_all();
+      return;
+    }
+  }
+}
+
+bool DiscoveryManager::isRunning()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return running_;
+}
+
+bool DiscoveryManager::isRequiredFound()
+{
+  // called with the mutex held
+  for (size_t i = 0; i < dependencies_.size(); i++)
+  {
+    if (dependencies_[i]->required_ && !dependencies_[i]->found_)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_example_utils/material_request_queue.h>
+
+using namespace mtconnect_example_utils;
+
+MaterialRequestQueue::MaterialRequestQueue(int max_depth) :
+    max_depth_(max_depth), max_wait_(DEFAULT_MATERIAL_MAX_WAIT), last_wait_(0.0)
+{
+}
+
+void MaterialRequestQueue::setMaxDepth(int max_depth)
+{
+  max_depth_ = max_depth;
+}
+
+void MaterialRequestQueue::setPriority(const std::string &name, int priority)
+{
+  priorities_[name] = priority;
+}
+
+void MaterialRequestQueue::setMaxWait(double max_wait)
+{
+  max_wait_ = max_wait;
+}
+
+void MaterialRequestQueue::recordServiceTime(const std::string &name, double service_time)
+{
+  std::map<std::string, double>::iterator it = service_times_.find(name);
+  if (it == service_times_.end())
+  {
+    service_times_[name] = service_time;
+  }
+  else
+  {
+    it->second += SERVICE_TIME_FILTER * (service_time - it->second);
+  }
+}
+
+double MaterialRequestQueue::getServiceTime(const std::string &name) const
+{
+  std::map<std::string, double>::const_iterator it = service_times_.find(name);
+  return it == service_times_.end() ? 0.0 : it->second;
+}
+
+bool MaterialRequestQueue::push(const std::string &name, double stamp)
+{
+  if (contains(name))
+  {
+    return true;
+  }
+
+  if (size() >= max_depth_)
+  {
+    return false;
+  }
+
+  Request request;
+  request.name_ = name;
+  request.stamp_ = stamp;
+  requests_.push_back(request);
+  return true;
+}
+
+bool MaterialRequestQueue::pop(double now, std::string &name, double &waited)
+{
+  if (requests_.empty())
+  {
+    return false;
+  }
+
+  size_t index = next(now);
+  name = requests_[index].name_;
+  waited = now - requests_[index].stamp_;
+  last_wait_ = waited;
+  requests_.erase(requests_.begin() + index);
+  return true;
+}
+
+bool MaterialRequestQueue::remove(const std::string &name)
+{
+  for (size_t i = 0; i < requests_.size(); i++)
+  {
+    if (requests_[i].name_ == name)
+    {
+      requests_.erase(requests_.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MaterialRequestQueue::contains(const std::string &name) const
+{
+  for (size_t i = 0; i < requests_.size(); i++)
+  {
+    if (requests_[i].name_ == name)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MaterialRequestQueue::clear()
+{
+  requests_.clear();
+}
+
+std::vector<std::string> MaterialRequestQueue::getNames(double now) const
+{
+  MaterialRequestQueue remaining(*this);
+  std::vector<std::string> names;
+  std::string name;
+  double waited;
+  while (remaining.pop(now, name, waited))
+  {
+    names.push_back(name);
+  }
+  return names;
+}
+
+double MaterialRequestQueue::getOldestWait(double now) const
+{
+  double oldest = 0.0;
+  for (size_t i = 0; i < requests_.size(); i++)
+  {
+    if (now - requests_[i].stamp_ > oldest)
+    {
+      oldest = now - requests_[i].stamp_;
+    }
+  }
+  return oldest;
+}
+
+int MaterialRequestQueue::getPriority(const std::string &name) const
+{
+  std::map<std::string, int>::const_iterator it = priorities_.find(name);
+  return it == priorities_.end() ? 0 : it->second;
+}
+
+size_t MaterialRequestQueue::next(double now) const
+{
+  // requests are kept in arrival order, the first starved request wins
+  if (max_wait_ > 0.0)
+  {
+    for (size_t i = 0; i < requests_.size(); i++)
+    {
+      if (now - requests_[i].stamp_ >= max_wait_)
+      {
+        return i;
+      }
+    }
+  }
+
+  // otherwise the highest priority, then the earliest predicted completion (ties in arrival order)
+  size_t best = 0;
+  for (size_t i = 1; i < requests_.size(); i++)
+  {
+    int priority = getPriority(requests_[i].name_);
+    int best_priority = getPriority(requests_[best].name_);
+    if (priority > best_priority
+        || (priority == best_priority && getCompletion(requests_[i], now) < getCompletion(requests_[best], now)))
+    {
+      best = i;
+    }
+  }
+  return best;
+}
+
+double MaterialRequestQueue::getCompletion(const Request &request, double now) const
+{
+  return getServiceTime(request.name_) - (now - request.stamp_);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "mtconnect_example_utils/discovery_manager.h"
+#include "mtconnect_example_utils/material_request_queue.h"
+#include "mtconnect_example_utils/action_monitor.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace mtconnect_example_utils;
+
+/*
+ * Stands in for a server that appears after the given delay (negative never appears)
+ */
+class DelayedServer
+{
+public:
+  DelayedServer(double delay) :
+      delay_(delay), start_(ros::WallTime::now())
+  {
+  }
+
+  bool operator()(const ros::Duration &timeout)
+  {
+    double remaining = delay_ - (ros::WallTime::now() - start_).toSec();
+    if (delay_ < 0.0 || remaining > timeout.toSec())
+    {
+      ros::WallDuration(timeout.toSec()).sleep();
+      return false;
+    }
+    ros::WallDuration(std::max(remaining, 0.0)).sleep();
+    return true;
+  }
+
+protected:
+  double delay_;
+  ros::WallTime start_;
+};
+
+TEST(DiscoveryManager, concurrent_discovery)
+{
+  DiscoveryManager discovery(0.1);
+  discovery.add("joint_trajectory_action", "robot", DelayedServer(0.3));
+  discovery.add("cnc_open_door_action", "cnc", DelayedServer(0.3));
+  discovery.add("cnc_close_door_action", "cnc", DelayedServer(0.3));
+  discovery.add("gripper_action_service", "gripper", DelayedServer(0.3));
+
+  // waiting in turn would take the sum of the delays
+  ros::WallTime start = ros::WallTime::now();
+  EXPECT_TRUE(discovery.waitForAll(ros::Duration(5.0)));
+  EXPECT_GT(0.9, (ros::WallTime::now() - start).toSec());
+  EXPECT_TRUE(discovery.isAllFound());
+  EXPECT_TRUE(discovery.getMissing().empty());
+}
+
+TEST(DiscoveryManager, missing_subsystems)
+{
+  DiscoveryManager discovery(0.1);
+  discovery.add("joint_trajectory_action", "robot", DelayedServer(0.0));
+  discovery.add("cnc_open_door_action", "cnc", DelayedServer(0.0));
+  discovery.add("vise_action_service", "vise", DelayedServer(-1.0));
+  discovery.add("filter_trajectory_with_constraints", "robot", DelayedServer(-1.0), false);
+
+  EXPECT_FALSE(discovery.waitForAll(ros::Duration(0.5)));
+  EXPECT_TRUE(discovery.isSubsystemFound("cnc"));
+  EXPECT_FALSE(discovery.isSubsystemFound("robot"));
+  EXPECT_FALSE(discovery.isSubsystemFound("vise"));
+  EXPECT_TRUE(discovery.isFound("joint_trajectory_action"));
+  EXPECT_FALSE(discovery.isFound("vise_action_service"));
+
+  ASSERT_EQ(2u, discovery.getMissing().size());
+  EXPECT_EQ("vise_action_service", discovery.getMissing()[0]);
+  ASSERT_EQ(2u, discovery.getMissingSubsystems().size());
+  EXPECT_EQ("vise", discovery.getMissingSubsystems()[0]);
+  EXPECT_EQ("robot", discovery.getMissingSubsystems()[1]);
+  EXPECT_EQ("vise_action_service (vise), filter_trajectory_with_constraints (robot)",
+            discovery.getMissingString());
+
+  // optional dependencies are not waited on, late ones are still discovered
+  discovery.add("cnc_close_door_action", "cnc", DelayedServer(0.2), false);
+  DiscoveryManager optional(0.1);
+  optional.add("joint_trajectory_action", "robot", DelayedServer(0.0));
+  optional.add("filter_trajectory_with_constraints", "robot", DelayedServer(-1.0), false);
+  EXPECT_TRUE(optional.waitForAll(ros::Duration(5.0)));
+  EXPECT_FALSE(optional.isAllFound());
+
+  ros::WallDuration(0.5).sleep();
+  EXPECT_TRUE(discovery.isFound("cnc_close_door_action"));
+  discovery.stop();
+}
+
+
+TEST(MaterialRequestQueue, priority_and_dedup)
+{
+  MaterialRequestQueue queue(2);
+  queue.setPriority("material_unload_action", 1);
+
+  std::string name;
+  double waited;
+  EXPECT_FALSE(queue.pop(0.0, name, waited));
+
+  // a repeated request keeps its place and arrival time
+  EXPECT_TRUE(queue.push("material_load_action", 1.0));
+  EXPECT_TRUE(queue.push("material_load_action", 2.0));
+  EXPECT_EQ(1, queue.size());
+  EXPECT_DOUBLE_EQ(4.0, queue.getOldestWait(5.0));
+
+  EXPECT_TRUE(queue.push("material_unload_action", 3.0));
+  EXPECT_FALSE(queue.push("other_action", 3.0));
+  EXPECT_EQ(2, queue.size());
+
+  // higher priority first, even though it arrived last
+  ASSERT_EQ(2u, queue.getNames(5.0).size());
+  EXPECT_EQ("material_unload_action", queue.getNames(5.0)[0]);
+  ASSERT_TRUE(queue.pop(5.0, name, waited));
+  EXPECT_EQ("material_unload_action", name);
+  EXPECT_DOUBLE_EQ(2.0, waited);
+  EXPECT_DOUBLE_EQ(2.0, queue.getLastWait());
+
+  ASSERT_TRUE(queue.pop(6.0, name, waited));
+  EXPECT_EQ("material_load_action", name);
+  EXPECT_DOUBLE_EQ(5.0, waited);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_DOUBLE_EQ(0.0, queue.getOldestWait(6.0));
+}
+
+TEST(MaterialRequestQueue, fifo_remove_and_disable)
+{
+  MaterialRequestQueue queue(3);
+  queue.push("a", 1.0);
+  queue.push("b", 2.0);
+  queue.push("c", 3.0);
+
+  EXPECT_TRUE(queue.remove("b"));
+  EXPECT_FALSE(queue.remove("b"));
+  EXPECT_FALSE(queue.contains("b"));
+
+  std::string name;
+  double waited;
+  ASSERT_TRUE(queue.pop(4.0, name, waited));
+  EXPECT_EQ("a", name);
+  ASSERT_TRUE(queue.pop(4.0, name, waited));
+  EXPECT_EQ("c", name);
+
+  // a zero depth restores the reject-when-busy behavior
+  queue.setMaxDepth(0);
+  EXPECT_FALSE(queue.push("a", 5.0));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(MaterialRequestQueue, machine_scheduling)
+{
+  MaterialRequestQueue queue(4);
+  queue.setMaxWait(60.0);
+
+  // cnc2 loads take 20 sec, cnc1 loads 50 sec (filtered towards the newest sample)
+  queue.recordServiceTime("cnc1/material_load_action", 40.0);
+  queue.recordServiceTime("cnc1/material_load_action", 73.33333333);
+  EXPECT_NEAR(50.0, queue.getServiceTime("cnc1/material_load_action"), 1e-6);
+  queue.recordServiceTime("cnc2/material_load_action", 20.0);
+  EXPECT_DOUBLE_EQ(0.0, queue.getServiceTime("cnc3/material_load_action"));
+
+  // the shorter job goes first unless the longer one waited for the difference
+  queue.push("cnc1/material_load_action", 0.0);
+  queue.push("cnc2/material_load_action", 10.0);
+  ASSERT_EQ(2u, queue.getNames(11.0).size());
+  EXPECT_EQ("cnc2/material_load_action", queue.getNames(11.0)[0]);
+  EXPECT_EQ("cnc1/material_load_action", queue.getNames(11.0)[1]);
+
+  // unknown service times fall back to arrival order
+  queue.push("cnc3/material_load_action", 11.0);
+  queue.push("cnc4/material_load_action", 12.0);
+  queue.remove("cnc1/material_load_action");
+  queue.remove("cnc2/material_load_action");
+  EXPECT_EQ("cnc3/material_load_action", queue.getNames(13.0)[0]);
+
+  // a request past the max wait goes before a higher priority one
+  queue.clear();
+  queue.setPriority("cnc2/material_unload_action", 1);
+  queue.push("cnc1/material_load_action", 0.0);
+  queue.push("cnc2/material_unload_action", 30.0);
+  std::string name;
+  double waited;
+  ASSERT_TRUE(queue.pop(40.0, name, waited));
+  EXPECT_EQ("cnc2/material_unload_action", name);
+  queue.push("cnc2/material_unload_action", 50.0);
+  ASSERT_TRUE(queue.pop(61.0, name, waited));
+  EXPECT_EQ("cnc1/material_load_action", name);
+  EXPECT_DOUBLE_EQ(61.0, waited);
+}
+
+TEST(ActionMonitor, deadlines_from_latencies)
+{
+  ActionMonitor monitor;
+  monitor.setDeadlineFactor(2.0);
+  monitor.setDefaultDeadline(30.0);
+  monitor.setMinSamples(10);
+
+  // the default deadline applies until enough latencies are known
+  monitor.start("door", 0.0);
+  EXPECT_TRUE(monitor.isStarted("door"));
+  EXPECT_FALSE(monitor.isExpired("door", 30.0));
+  EXPECT_TRUE(monitor.isExpired("door", 31.0));
+  EXPECT_FALSE(monitor.isExpired("chuck", 100.0));
+  monitor.cancel("door");
+  EXPECT_FALSE(monitor.isExpired("door", 31.0));
+  EXPECT_EQ(0, monitor.getSampleCount("door"));
+  EXPECT_DOUBLE_EQ(0.0, monitor.finish("door", 40.0));
+
+  // 1 to 10 sec latencies, p99 x factor
+  for (int i = 1; i <= 10; i++)
+  {
+    monitor.start("door", 100.0 * i);
+    EXPECT_DOUBLE_EQ(i, monitor.finish("door", 100.0 * i + i));
+  }
+  EXPECT_EQ(10, monitor.getSampleCount("door"));
+  EXPECT_DOUBLE_EQ(5.0, monitor.getPercentile("door", 0.5));
+  EXPECT_DOUBLE_EQ(10.0, monitor.getPercentile("door", 0.99));
+  EXPECT_DOUBLE_EQ(20.0, monitor.getDeadline("door"));
+  monitor.start("door", 2000.0);
+  EXPECT_FALSE(monitor.isExpired("door", 2020.0));
+  EXPECT_TRUE(monitor.isExpired("door", 2020.5));
+  EXPECT_DOUBLE_EQ(20.5, monitor.getElapsed("door", 2020.5));
+  EXPECT_DOUBLE_EQ(30.0, monitor.getDeadline("chuck"));
+
+  // the history is a ring, the oldest latencies drop out
+  for (int i = 0; i < ACTION_LATENCY_HISTORY; i++)
+  {
+    monitor.start("door", 0.0);
+    monitor.finish("door", 0.1);
+  }
+  EXPECT_EQ(ACTION_LATENCY_HISTORY, monitor.getSampleCount("door"));
+  EXPECT_DOUBLE_EQ(0.1, monitor.getPercentile("door", 0.99));
+  EXPECT_DOUBLE_EQ(DEFAULT_MIN_DEADLINE, monitor.getDeadline("door"));
+
+  // a zero default disables stall detection
+  monitor.setDefaultDeadline(0.0);
+  monitor.start("chuck", 0.0);
+  EXPECT_FALSE(monitor.isExpired("chuck", 1e6));
+}
+
+TEST(ActionMonitor, finish_from_done_callback)
+{
+  ActionMonitor monitor;
+  monitor.setMinSamples(1);
+
+  // a goal reported done is timed from its own start, even after it was pre-empted
+  monitor.start("move", 0.0);
+  monitor.start("move", 5.0);
+  EXPECT_DOUBLE_EQ(6.0, monitor.finish("move", 0.0, 6.0));
+  EXPECT_TRUE(monitor.isStarted("move"));
+  EXPECT_DOUBLE_EQ(1.0, monitor.getElapsed("move", 6.0));
+
+  // the goal in flight completes
+  EXPECT_DOUBLE_EQ(2.0, monitor.finish("move", 5.0, 7.0));
+  EXPECT_FALSE(monitor.isStarted("move"));
+  EXPECT_EQ(2, monitor.getSampleCount("move"));
+
+  // latencies are recorded even if the action was never polled
+  EXPECT_DOUBLE_EQ(3.0, monitor.finish("door", 10.0, 13.0));
+  EXPECT_EQ(1, monitor.getSampleCount("door"));
+  EXPECT_FALSE(monitor.isStarted("door"));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
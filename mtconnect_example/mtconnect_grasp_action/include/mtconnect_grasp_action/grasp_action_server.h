@@ -0,0 +1,64 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef GRASP_ACTION_SERVER_H_
+#define GRASP_ACTION_SERVER_H_
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <mtconnect_grasp_action/gripper_link.h>
+
+class GraspExecutionAction;
+class LinkDiagnostics;
+
+namespace mtconnect_cnc_robot_example
+{
+
+namespace gripper_message
+{
+
+/**
+ * \brief The gripper link with its diagnostics and grasp action server(s)
+ *
+ * Used by the grasp_action_server node and by the grasp action nodelet, which passes its own
+ * private node handle (parameters, action and link status service are resolved in it).
+ */
+class GraspActionServer
+{
+public:
+  GraspActionServer();
+
+  ~GraspActionServer();
+
+  /**
+   * \brief Reads the parameters, starts the link and the action servers
+   *
+   * \param nh private node handle
+   * \return true on success, false otherwise.
+   */
+  bool init(ros::NodeHandle &nh);
+
+protected:
+  GripperLink link_;
+  boost::shared_ptr<LinkDiagnostics> diagnostics_;
+  std::vector<boost::shared_ptr<GraspExecutionAction> > actions_;
+};
+
+}
+}
+
+#endif /* GRASP_ACTION_SERVER_H_ */
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef GRIPPER_LINK_H
+#define GRIPPER_LINK_H
+
+#include <ros/ros.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/function.hpp>
+#include <deque>
+#include <map>
+#include <set>
+#include <simple_message/socket/tcp_client.h>
+#include <mtconnect_grasp_action/gripper_message.h>
+
+namespace mtconnect_cnc_robot_example
+{
+namespace gripper_message
+{
+
+static const double DEFAULT_RECONNECT_MIN_DELAY = 0.5f; // seconds
+static const double DEFAULT_RECONNECT_MAX_DELAY = 8.0f; // seconds
+static const double DEFAULT_REQUEST_TIMEOUT = 30.0f; // seconds
+static const int DEFAULT_MAX_OUTSTANDING = 8;
+static const int RECEIVE_POLL_PERIOD = 100; // milliseconds
+static const int NEGOTIATION_TIMEOUT = 2000; // milliseconds
+static const int FRAME_RECEIVE_TIMEOUT = 1000; // milliseconds from the first to the last byte of a frame
+static const int RTT_HISTOGRAM_BUCKETS = 16;  // bucket i counts round trips under 2^i ms, the last one the rest
+
+/**
+ * \brief Link telemetry, counters accumulate from the start of the link.
+ *
+ * Updated under the link lock by the I/O threads without allocating, only recording an
+ * error copies its message.
+ */
+struct GripperLinkStatistics
+{
+  GripperLinkStatistics();
+
+  /**
+   * \brief Returns an upper bound (ms) for the given fraction (0-1) of the round trips
+   */
+  double rttPercentile(double fraction) const;
+
+  void addRtt(double seconds);
+
+  bool connected_;
+  unsigned int connects_;            // successful connections, the first one included
+  unsigned int connect_failures_;
+  unsigned int disconnects_;
+  unsigned int requests_sent_;
+  unsigned int replies_received_;
+  unsigned int failure_replies_;
+  unsigned int unmatched_replies_;
+  unsigned int timeouts_;
+  unsigned long long bytes_out_;
+  unsigned long long bytes_in_;
+
+  unsigned int rtt_histogram_[RTT_HISTOGRAM_BUCKETS];
+  unsigned int rtt_count_;
+  double rtt_sum_;                   // seconds
+  double rtt_min_;
+  double rtt_max_;
+
+  ros::WallTime last_send_;
+  ros::WallTime last_receive_;
+  ros::WallTime last_error_time_;
+  std::string last_error_;
+};
+
+/**
+ * \brief TcpClient that exchanges raw gripper frames.  Frames are encoded by GripperCodec,
+ * the simple_message byte array (and its link time byte order) is not involved.
+ */
+class GripperSocket : public industrial::tcp_client::TcpClient
+{
+public:
+
+  /**
+   * \brief Returns true if data (or a hang up) is waiting on the socket
+   */
+  bool waitReceive(int timeout_ms);
+
+  bool sendFrame(const boost::uint8_t *frame);
+
+  /**
+   * \brief Reads a complete frame, returns false on a socket error or if the frame isn't
+   * complete within timeout_ms (a stalled peer or half dropped connection)
+   */
+  bool receiveFrame(boost::uint8_t *frame, int timeout_ms = FRAME_RECEIVE_TIMEOUT);
+
+  /**
+   * \brief Closes the socket, init() creates a new one without closing the old one
+   */
+  void closeSocket();
+};
+
+/**
+ * \brief Owns the TCP connection to the controller gripper program.
+ *
+ * Requests are tagged with a sequence number and several of them may be in flight
+ * at once, replies are matched to their request by the echoed sequence number in
+ * whatever order the controller sends them.  Requests for different devices (gripper
+ * and vise) can share one connection.
+ *
+ * Requests are sent from a writer thread and replies are read on a reader thread.  A
+ * completion is invoked from the reader thread when its reply arrives, and from the
+ * writer thread when its request times out or the link stops, so completions must be
+ * thread safe.  Each completion is invoked at most once.  While the link is down the
+ * writer reconnects with an exponential backoff and requests that are not completed
+ * within their timeout fail.  A frame that doesn't arrive completely within
+ * FRAME_RECEIVE_TIMEOUT drops the connection, the reader never blocks on a stalled peer.
+ *
+ * The wire byte order is fixed or, with ByteOrderTypes::AUTO, negotiated on connect by
+ * sending an INIT request and checking which order the reply decodes in.  Controllers that
+ * don't understand the request never reply, the next connection then tries the other order.
+ */
+class GripperLink
+{
+public:
+
+  /**
+   * \brief Called with true if the controller replied with success
+   */
+  typedef boost::function<void(bool)> Completion;
+
+  /**
+   * \brief Identifies a posted request until it completes
+   */
+  typedef unsigned long RequestId;
+
+  GripperLink();
+
+  ~GripperLink();
+
+  /**
+   * \brief Sets the connection parameters, the link is not opened until start() is called
+   */
+  void init(const std::string &ip_address, int port_number);
+
+  void setReconnectDelays(double min_delay, double max_delay);
+
+  void setRequestTimeout(double timeout);
+
+  /**
+   * \brief Sets the number of requests that may await a reply at the same time
+   */
+  void setMaxOutstanding(int max_outstanding);
+
+  void setByteOrder(ByteOrderType order);
+
+  /**
+   * \brief Returns the byte order in use, AUTO until negotiation succeeded
+   */
+  ByteOrderType getByteOrder();
+
+  /**
+   * \brief Starts the I/O threads, the connection is established (and reestablished) by the writer
+   */
+  void start();
+
+  void stop();
+
+  /**
+   * \brief Queues an operation for a device, returns immediately.
+   *
+   * \param device the operation is addressed to
+   * \param operation gripper operation to send
+   * \param completion invoked from the reader (reply) or the writer (timeout, stop) thread,
+   * never while the link lock is held
+   * \return id that can be passed to cancel()
+   */
+  RequestId post(GripperDeviceType device, GripperOperationType operation, Completion completion);
+
+  RequestId post(GripperOperationType operation, Completion completion)
+  {
+    return post(GripperDeviceTypes::GRIPPER, operation, completion);
+  }
+
+  /**
+   * \brief Withdraws a request, its completion is not invoked.
+   *
+   * A request that was already sent is interrupted by a STOP request for its device, sent
+   * ahead of anything queued, and its late reply is discarded.
+   *
+   * \return false if the request already completed (or its completion is being invoked)
+   */
+  bool cancel(RequestId id);
+
+  bool isConnected();
+
+  /**
+   * \brief Copies the current telemetry
+   */
+  void getStatistics(GripperLinkStatistics &stats);
+
+protected:
+
+  struct Request
+  {
+    RequestId id_;
+    GripperDeviceType device_;
+    GripperOperationType operation_;
+    Completion completion_;
+    ros::WallTime deadline_;
+    ros::WallTime sent_;
+  };
+
+  /**
+   * \brief Records the last error, the link lock must not be held
+   */
+  void recordError(const std::string &error);
+
+  void writeLoop();
+
+  void readLoop();
+
+  /**
+   * \brief Attempts a single connection, returns false if it failed
+   */
+  bool connect();
+
+  /**
+   * \brief Finds the controller byte order on a fresh connection, returns false if it failed
+   */
+  bool negotiate();
+
+  /**
+   * \brief Waits on the link condition, returns false if the link was stopped meanwhile
+   */
+  bool waitFor(double seconds);
+
+  /**
+   * \brief Completes all expired requests (queued or in flight) as failures
+   */
+  void expireRequests();
+
+  /**
+   * \brief Moves the requests still in flight back to the front of the queue
+   */
+  void requeueOutstanding();
+
+protected:
+
+  GripperSocket client_;
+  std::string ip_address_;
+  int port_number_;
+  double reconnect_min_delay_;
+  double reconnect_max_delay_;
+  double request_timeout_;
+  int max_outstanding_;
+  ByteOrderType order_;            // order in use, AUTO until negotiated
+  ByteOrderType candidate_order_;  // next order tried by negotiation
+
+  boost::thread write_thread_;
+  boost::thread read_thread_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque<Request> queue_;
+  std::map<industrial::shared_types::shared_int, Request> outstanding_;
+  std::set<industrial::shared_types::shared_int> cancelled_;  // sent requests whose reply is discarded
+  industrial::shared_types::shared_int next_sequence_;
+  RequestId next_request_id_;
+  bool running_;
+  bool connected_;
+  bool receiving_;
+  GripperLinkStatistics stats_;
+};
+
+}
+}
+
+#endif /* GRIPPER_LINK_H */
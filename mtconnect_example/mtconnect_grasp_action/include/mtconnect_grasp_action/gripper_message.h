@@ -17,9 +17,11 @@
 #ifndef GRIPPER_MESSAGE_H
 #define GRIPPER_MESSAGE_H
 
-#include "simple_message/typed_message.h"
 #include "simple_message/simple_message.h"
 #include "simple_message/shared_types.h"
+#include <boost/cstdint.hpp>
+#include <cstring>
+#include <string>
 
 
 namespace mtconnect_cnc_robot_example
@@ -37,13 +39,58 @@ namespace GripperOperationTypes
     INVALID = 0,
     INIT,
     OPEN,
-    CLOSE
+    CLOSE,
+    STOP     // interrupts the operation in progress on the device
   };
 }
 typedef GripperOperationTypes::GripperOperationType GripperOperationType;
 
 /**
- * \brief Class encapsulated longhorn robot gripper message.
+ * \brief Enumeration of devices sharing a multiplexed gripper channel
+ */
+namespace GripperDeviceTypes
+{
+  enum GripperDeviceType
+  {
+    GRIPPER = 0,
+    VISE
+  };
+}
+typedef GripperDeviceTypes::GripperDeviceType GripperDeviceType;
+
+/**
+ * \brief Enumeration of wire byte orders
+ */
+namespace ByteOrderTypes
+{
+  enum ByteOrderType
+  {
+    NATIVE = 0, // host order (what simple_message writes)
+    SWAPPED,    // reversed host order (what simple_message_bswap writes)
+    AUTO        // negotiated with the controller when connecting
+  };
+}
+typedef ByteOrderTypes::ByteOrderType ByteOrderType;
+
+/**
+ * \brief The operation, device and sequence number share the single command field:
+ * cmd = operation + DEVICE_SCALE * device + SEQUENCE_SCALE * sequence.  The controller
+ * echoes the command in its reply, a zero device and sequence is the original format.
+ */
+static const industrial::shared_types::shared_int GRIPPER_DEVICE_SCALE = 16;
+static const industrial::shared_types::shared_int GRIPPER_SEQUENCE_SCALE = 256;
+static const industrial::shared_types::shared_int GRIPPER_MAX_SEQUENCE = 65535;
+
+/**
+ * \brief A gripper frame is a simple message: length prefix, message type, comm type,
+ * reply code and the command field (5 integers)
+ */
+static const unsigned int GRIPPER_FRAME_SIZE = 5 * sizeof(industrial::shared_types::shared_int);
+static const industrial::shared_types::shared_int GRIPPER_FRAME_LENGTH = 4 * sizeof(industrial::shared_types::shared_int);
+static const industrial::shared_types::shared_int GRIPPER_MSG_TYPE = industrial::simple_message::StandardMsgTypes::SWRI_MSG_BEGIN;
+
+/**
+ * \brief Class encapsulating the robot gripper message.
  */
 //* GripperMessage
 /**
@@ -52,39 +99,35 @@ typedef GripperOperationTypes::GripperOperationType GripperOperationType;
  * THIS CLASS IS NOT THREAD-SAFE
  *
  */
-
-class GripperMessage : public industrial::typed_message::TypedMessage
-
+class GripperMessage
 {
 public:
   /**
    * \brief Default constructor
    *
-   * This method creates an empty message.
+   * This method creates an empty request.
    *
    */
   GripperMessage(void);
+
   /**
-   * \brief Destructor
-   *
-   */
-  ~GripperMessage(void);
-  /**
-   * \brief Initializes message from a simple message
+   * \brief Initializes a request for the gripper (original, untagged format)
    *
-   * \param simple message to construct from
+   * \param gripper operation enumeration
    *
-   * \return true if message successfully initialized, otherwise false
    */
-  bool init(industrial::simple_message::SimpleMessage & msg);
+  void init(GripperOperationType operation);
 
   /**
-   * \brief Initializes message from a joint trajectory point structure
+   * \brief Initializes a sequence tagged request for a multiplexed channel
    *
    * \param gripper operation enumeration
+   * \param device the operation is addressed to
+   * \param sequence number echoed by the controller reply
    *
    */
-  void init(GripperOperationType operation);
+  void init(GripperOperationType operation, GripperDeviceType device,
+            industrial::shared_types::shared_int sequence);
 
   /**
    * \brief Initializes a new message
@@ -92,22 +135,129 @@ public:
    */
   void init();
 
-  // Overrides - SimpleSerialize
-  bool load(industrial::byte_array::ByteArray *buffer);
-  bool unload(industrial::byte_array::ByteArray *buffer);
-
-  unsigned int byteLength()
+  /**
+   * \brief Command field as sent on the wire
+   */
+  industrial::shared_types::shared_int getCommand() const
   {
-    return sizeof(industrial::shared_types::shared_int(operation_));
+    return operation_ + GRIPPER_DEVICE_SCALE * device_ + GRIPPER_SEQUENCE_SCALE * sequence_;
   }
 
+  /**
+   * \brief Splits a command field into operation, device and sequence
+   */
+  void setCommand(industrial::shared_types::shared_int cmd);
+
   GripperOperationType operation_;
+  GripperDeviceType device_;
+  industrial::shared_types::shared_int sequence_;
+  industrial::shared_types::shared_int comm_type_;
+  industrial::shared_types::shared_int reply_code_;
+};
+
+/**
+ * \brief Converts a 32 bit value between host and wire order
+ */
+template<ByteOrderType ORDER>
+struct ByteOrderTraits;
+
+template<>
+struct ByteOrderTraits<ByteOrderTypes::NATIVE>
+{
+  static boost::uint32_t convert(boost::uint32_t value)
+  {
+    return value;
+  }
+};
+
+template<>
+struct ByteOrderTraits<ByteOrderTypes::SWAPPED>
+{
+  static boost::uint32_t convert(boost::uint32_t value)
+  {
+    return (value >> 24) | ((value >> 8) & 0x0000FF00) | ((value << 8) & 0x00FF0000) | (value << 24);
+  }
+};
+
+/**
+ * \brief Serializes gripper messages to/from frames of GRIPPER_FRAME_SIZE bytes in the byte
+ * order given by the template parameter.  The native order compiles down to plain copies.
+ */
+template<ByteOrderType ORDER>
+class GripperCodec
+{
+public:
+
+  static void serialize(const GripperMessage &msg, boost::uint8_t *frame)
+  {
+    store(GRIPPER_FRAME_LENGTH, frame);
+    store(GRIPPER_MSG_TYPE, frame + 4);
+    store(msg.comm_type_, frame + 8);
+    store(msg.reply_code_, frame + 12);
+    store(msg.getCommand(), frame + 16);
+  }
+
+  /**
+   * \brief Returns false if the frame header is not a gripper message in this byte order
+   */
+  static bool deserialize(const boost::uint8_t *frame, GripperMessage &msg)
+  {
+    if (!matches(frame))
+    {
+      return false;
+    }
+
+    msg.comm_type_ = fetch(frame + 8);
+    msg.reply_code_ = fetch(frame + 12);
+    msg.setCommand(fetch(frame + 16));
+    return true;
+  }
+
+  static bool matches(const boost::uint8_t *frame)
+  {
+    return fetch(frame) == GRIPPER_FRAME_LENGTH && fetch(frame + 4) == GRIPPER_MSG_TYPE;
+  }
 
 private:
 
+  static void store(industrial::shared_types::shared_int value, boost::uint8_t *dst)
+  {
+    boost::uint32_t raw = ByteOrderTraits<ORDER>::convert(static_cast<boost::uint32_t>(value));
+    std::memcpy(dst, &raw, sizeof(raw));
+  }
 
+  static industrial::shared_types::shared_int fetch(const boost::uint8_t *src)
+  {
+    boost::uint32_t raw;
+    std::memcpy(&raw, src, sizeof(raw));
+    return static_cast<industrial::shared_types::shared_int>(ByteOrderTraits<ORDER>::convert(raw));
+  }
 };
 
+/**
+ * \brief Serializes with the codec matching a byte order chosen at runtime
+ *
+ * \return false if the order is AUTO
+ */
+bool serializeGripperMessage(ByteOrderType order, const GripperMessage &msg, boost::uint8_t *frame);
+
+/**
+ * \brief Deserializes with the codec matching a byte order chosen at runtime
+ *
+ * \return false if the order is AUTO or the frame is not a gripper message in that order
+ */
+bool deserializeGripperMessage(ByteOrderType order, const boost::uint8_t *frame, GripperMessage &msg);
+
+/**
+ * \brief Returns the byte order a frame was written in, AUTO if it is not a gripper message
+ */
+ByteOrderType detectByteOrder(const boost::uint8_t *frame);
+
+/**
+ * \brief Parses "native", "swapped" or "auto", returns false for anything else
+ */
+bool parseByteOrder(const std::string &str, ByteOrderType &order);
+
 }
 }
 
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <mtconnect_grasp_action/grasp_action_server.h>
+
+namespace mtconnect_cnc_robot_example
+{
+
+namespace gripper_message
+{
+
+/**
+ * \brief Grasp action server nodelet, the goals of clients in the same manager (i.e. the pick
+ * place server) are passed by pointer
+ */
+class GraspActionNodelet : public nodelet::Nodelet
+{
+protected:
+  virtual void onInit()
+  {
+    // the link connects on its own thread, nothing here blocks the manager
+    server_.reset(new GraspActionServer());
+    if (!server_->init(getPrivateNodeHandle()))
+    {
+      NODELET_ERROR("Grasp action server failed to initialize");
+    }
+  }
+
+  boost::shared_ptr<GraspActionServer> server_;
+};
+
+}
+}
+
+PLUGINLIB_DECLARE_CLASS(mtconnect_grasp_action, GraspActionNodelet,
+                        mtconnect_cnc_robot_example::gripper_message::GraspActionNodelet, nodelet::Nodelet)
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+
+#include <ros/ros.h>
+#include <actionlib/server/action_server.h>
+
+#include <object_manipulation_msgs/GraspHandPostureExecutionAction.h>
+#include <object_manipulation_msgs/GraspHandPostureExecutionGoal.h>
+#include <mtconnect_grasp_action/gripper_message.h>
+#include <mtconnect_grasp_action/gripper_link.h>
+#include <mtconnect_grasp_action/grasp_action_server.h>
+#include <mtconnect_example_msgs/GripperLinkStatus.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <sstream>
+
+using namespace object_manipulation_msgs;
+using namespace actionlib;
+using namespace mtconnect_cnc_robot_example::gripper_message;
+
+static const std::string PARAM_IP_ADDRESS = "ip_address";
+static const std::string PARAM_PORT_NUMBER = "port_number";
+static const std::string PARAM_RECONNECT_MIN_DELAY = "reconnect_min_delay";
+static const std::string PARAM_RECONNECT_MAX_DELAY = "reconnect_max_delay";
+static const std::string PARAM_REQUEST_TIMEOUT = "request_timeout";
+static const std::string PARAM_MULTIPLEXED = "multiplexed";
+static const std::string PARAM_MAX_OUTSTANDING = "max_outstanding";
+static const std::string PARAM_BYTE_ORDER = "byte_order";
+static const std::string PARAM_DIAGNOSTICS_PERIOD = "diagnostics_period";
+
+static const std::string GRIPPER_ACTION = "grasp_execution_action";
+static const std::string VISE_ACTION = "vise_execution_action";
+static const std::string DIAGNOSTICS_TOPIC = "/diagnostics";
+static const std::string LINK_STATUS_SERVICE = "link_status";
+static const double DEFAULT_DIAGNOSTICS_PERIOD = 1.0f; // seconds
+
+class GraspExecutionAction
+{
+private:
+  typedef ActionServer<GraspHandPostureExecutionAction> GEAS;
+  typedef GEAS::GoalHandle GoalHandle;
+public:
+  GraspExecutionAction(ros::NodeHandle &n, GripperLink *link,
+                       GripperDeviceType device = GripperDeviceTypes::GRIPPER,
+                       std::string action_name = GRIPPER_ACTION) :
+    node_(n),
+    action_server_(node_, action_name,
+                   boost::bind(&GraspExecutionAction::goalCB, this, _1),
+                   boost::bind(&GraspExecutionAction::cancelCB, this, _1),
+                   false)
+  {
+    // the link connects on its own thread, the server does not wait for the controller
+    link_ = link;
+    device_ = device;
+    active_.reset(new ActiveGoal());
+    action_server_.start();
+    
+    ROS_INFO("Grasp execution action '%s' started", action_name.c_str());
+  }
+
+  ~GraspExecutionAction()
+  {
+  }
+
+private:
+
+
+  void goalCB(GoalHandle gh)
+  {
+    ROS_DEBUG("Received grasping goal");
+
+    switch(gh.getGoal()->goal)
+    {
+      case GraspHandPostureExecutionGoal::PRE_GRASP:
+
+        gh.setAccepted();
+        ROS_WARN("Pre-grasp is not supported by this gripper");
+        gh.setSucceeded();
+        break;
+
+      case GraspHandPostureExecutionGoal::GRASP:
+        gh.setAccepted();
+        ROS_INFO("Executing a gripper grasp");
+        execute(gh, GripperOperationTypes::CLOSE);
+        break;
+
+      case GraspHandPostureExecutionGoal::RELEASE:
+        gh.setAccepted();
+        ROS_INFO("Executing a gripper release");
+        execute(gh, GripperOperationTypes::OPEN);
+        break;
+
+      default:
+        gh.setRejected();
+        break;
+
+    }
+  }
+
+  /*
+   * The goal whose request is on the link.  Shared with the completions so that a late
+   * completion never touches a destroyed server.
+   */
+  struct ActiveGoal
+  {
+    ActiveGoal() : active_(false), id_(0) {}
+
+    boost::mutex mutex_;
+    bool active_;
+    GoalHandle gh_;
+    GripperLink::RequestId id_;
+  };
+  typedef boost::shared_ptr<ActiveGoal> ActiveGoalPtr;
+
+  /*
+   * Preempts the active goal (if any) and sends the request of the new one
+   */
+  void execute(GoalHandle gh, GripperOperationType operation)
+  {
+    boost::mutex::scoped_lock lock(active_->mutex_);
+    preemptActive();
+
+    // queued behind the stop of the preempted goal
+    active_->id_ = link_->post(device_, operation, boost::bind(&GraspExecutionAction::completeGoal, active_, gh, _1));
+    active_->gh_ = gh;
+    active_->active_ = true;
+  }
+
+  /*
+   * Interrupts the active goal, expects the active goal lock to be held
+   */
+  void preemptActive()
+  {
+    // a request that can't be withdrawn is completing, its completion finishes the goal
+    if(active_->active_ && link_->cancel(active_->id_))
+    {
+      ROS_WARN("Gripper goal preempted, stopping the gripper");
+      active_->gh_.setCanceled();
+    }
+    active_->active_ = false;
+  }
+
+  /*
+   * Invoked from the link reader thread once the controller replies, or from the writer thread
+   * when the request times out or the link stops
+   */
+  static void completeGoal(ActiveGoalPtr active, GoalHandle gh, bool success)
+  {
+    {
+      boost::mutex::scoped_lock lock(active->mutex_);
+      if(active->active_ && active->gh_ == gh)
+      {
+        active->active_ = false;
+      }
+    }
+
+    if(success)
+    {
+      ROS_INFO("Robot gripper returned success");
+      gh.setSucceeded();
+    }
+    else
+    {
+      ROS_ERROR("Robot gripper returned failure");
+      gh.setCanceled();
+    }
+  }
+
+  void cancelCB(GoalHandle gh)
+  {
+    boost::mutex::scoped_lock lock(active_->mutex_);
+    if(active_->active_ && active_->gh_ == gh)
+    {
+      preemptActive();
+    }
+  }
+
+
+  ros::NodeHandle node_;
+  GEAS action_server_;
+
+  GripperLink *link_;
+  GripperDeviceType device_;
+  ActiveGoalPtr active_;
+
+};
+typedef boost::shared_ptr<GraspExecutionAction> GraspExecutionActionPtr;
+
+/*
+ * Publishes the gripper link telemetry on /diagnostics and answers link status queries
+ */
+class LinkDiagnostics
+{
+public:
+  LinkDiagnostics(ros::NodeHandle &n, GripperLink *link, double period) :
+    link_(link)
+  {
+    name_ = n.getNamespace() + ": gripper link";
+    diagnostics_pub_ = n.advertise<diagnostic_msgs::DiagnosticArray>(DIAGNOSTICS_TOPIC, 1);
+    status_server_ = n.advertiseService(LINK_STATUS_SERVICE, &LinkDiagnostics::statusCB, this);
+    timer_ = n.createTimer(ros::Duration(period), &LinkDiagnostics::publishCB, this);
+  }
+
+private:
+
+  template<typename T>
+  static void addValue(diagnostic_msgs::DiagnosticStatus &status, const std::string &key, const T &value)
+  {
+    std::stringstream ss;
+    diagnostic_msgs::KeyValue kv;
+    ss<<value;
+    kv.key = key;
+    kv.value = ss.str();
+    status.values.push_back(kv);
+  }
+
+  static std::string age(const ros::WallTime &t, const ros::WallTime &now)
+  {
+    std::stringstream ss;
+    if (t.isZero())
+    {
+      ss<<"never";
+    }
+    else
+    {
+      ss<<(now - t).toSec()<<" s ago";
+    }
+    return ss.str();
+  }
+
+  void fillStatus(diagnostic_msgs::DiagnosticStatus &status)
+  {
+    GripperLinkStatistics stats;
+    ros::WallTime now = ros::WallTime::now();
+    link_->getStatistics(stats);
+
+    status.name = name_;
+    status.hardware_id = "gripper controller";
+    if (!stats.connected_)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status.message = "Disconnected";
+    }
+    else if (stats.timeouts_ > 0 || stats.failure_replies_ > 0)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Connected, requests have failed";
+    }
+    else
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "Connected";
+    }
+
+    addValue(status, "Connects", stats.connects_);
+    addValue(status, "Connect failures", stats.connect_failures_);
+    addValue(status, "Disconnects", stats.disconnects_);
+    addValue(status, "Requests sent", stats.requests_sent_);
+    addValue(status, "Replies received", stats.replies_received_);
+    addValue(status, "Failure replies", stats.failure_replies_);
+    addValue(status, "Unmatched replies", stats.unmatched_replies_);
+    addValue(status, "Timeouts", stats.timeouts_);
+    addValue(status, "Bytes out", stats.bytes_out_);
+    addValue(status, "Bytes in", stats.bytes_in_);
+    addValue(status, "Last send", age(stats.last_send_, now));
+    addValue(status, "Last receive", age(stats.last_receive_, now));
+
+    if (stats.rtt_count_ > 0)
+    {
+      addValue(status, "RTT min (ms)", stats.rtt_min_ * 1000);
+      addValue(status, "RTT mean (ms)", stats.rtt_sum_ / stats.rtt_count_ * 1000);
+      addValue(status, "RTT max (ms)", stats.rtt_max_ * 1000);
+      addValue(status, "RTT p50 (ms, bound)", stats.rttPercentile(0.5));
+      addValue(status, "RTT p90 (ms, bound)", stats.rttPercentile(0.9));
+      addValue(status, "RTT p99 (ms, bound)", stats.rttPercentile(0.99));
+
+      // bucket upper bounds double, starting at 1 ms
+      std::stringstream ss;
+      for (int i = 0; i < RTT_HISTOGRAM_BUCKETS; i++)
+      {
+        ss<<(i > 0 ? " " : "")<<stats.rtt_histogram_[i];
+      }
+      addValue(status, "RTT histogram (<1, <2, <4 ... ms)", ss.str());
+    }
+
+    if (!stats.last_error_.empty())
+    {
+      addValue(status, "Last error", stats.last_error_ + " (" + age(stats.last_error_time_, now) + ")");
+    }
+  }
+
+  void publishCB(const ros::TimerEvent &)
+  {
+    diagnostic_msgs::DiagnosticArray array;
+    array.header.stamp = ros::Time::now();
+    array.status.resize(1);
+    fillStatus(array.status[0]);
+    diagnostics_pub_.publish(array);
+  }
+
+  bool statusCB(mtconnect_example_msgs::GripperLinkStatus::Request &req,
+                mtconnect_example_msgs::GripperLinkStatus::Response &res)
+  {
+    fillStatus(res.status);
+    return true;
+  }
+
+  GripperLink *link_;
+  std::string name_;
+  ros::Publisher diagnostics_pub_;
+  ros::ServiceServer status_server_;
+  ros::Timer timer_;
+};
+
+GraspActionServer::GraspActionServer()
+{
+}
+
+GraspActionServer::~GraspActionServer()
+{
+  // no completion may reach the servers once they are gone
+  link_.stop();
+  actions_.clear();
+  diagnostics_.reset();
+}
+
+bool GraspActionServer::init(ros::NodeHandle &nh)
+{
+  std::string ip_address;
+  int port_number;
+  double min_delay, max_delay, request_timeout, diagnostics_period;
+  int max_outstanding;
+  bool multiplexed;
+  std::string byte_order_str;
+  ByteOrderType byte_order;
+
+  // reading parameters and proceeding
+  if(!nh.getParam(PARAM_IP_ADDRESS,ip_address) || !nh.getParam(PARAM_PORT_NUMBER,port_number))
+  {
+    ROS_ERROR("Missing 'ip_address' and 'port_number' private parameters");
+    return false;
+  }
+
+  nh.param(PARAM_RECONNECT_MIN_DELAY,min_delay,DEFAULT_RECONNECT_MIN_DELAY);
+  nh.param(PARAM_RECONNECT_MAX_DELAY,max_delay,DEFAULT_RECONNECT_MAX_DELAY);
+  nh.param(PARAM_REQUEST_TIMEOUT,request_timeout,DEFAULT_REQUEST_TIMEOUT);
+  nh.param(PARAM_MAX_OUTSTANDING,max_outstanding,DEFAULT_MAX_OUTSTANDING);
+  nh.param(PARAM_MULTIPLEXED,multiplexed,false);
+  nh.param(PARAM_BYTE_ORDER,byte_order_str,std::string("native"));
+  nh.param(PARAM_DIAGNOSTICS_PERIOD,diagnostics_period,DEFAULT_DIAGNOSTICS_PERIOD);
+  if(!parseByteOrder(byte_order_str,byte_order))
+  {
+    ROS_ERROR("Invalid 'byte_order' parameter '%s', expected native, swapped or auto", byte_order_str.c_str());
+    return false;
+  }
+
+  ROS_INFO("Grasp action connecting to IP address: %s and port: %i", ip_address.c_str(),port_number);
+  link_.init(ip_address, port_number);
+  link_.setReconnectDelays(min_delay, max_delay);
+  link_.setRequestTimeout(request_timeout);
+  link_.setMaxOutstanding(max_outstanding);
+  link_.setByteOrder(byte_order);
+  link_.start();
+  diagnostics_.reset(new LinkDiagnostics(nh, &link_, diagnostics_period));
+
+  if(multiplexed)
+  {
+    // gripper and vise share the connection to the multiplexing controller program
+    actions_.push_back(GraspExecutionActionPtr(new GraspExecutionAction(nh, &link_, GripperDeviceTypes::GRIPPER,
+                                                                        GRIPPER_ACTION)));
+    actions_.push_back(GraspExecutionActionPtr(new GraspExecutionAction(nh, &link_, GripperDeviceTypes::VISE,
+                                                                        VISE_ACTION)));
+  }
+  else
+  {
+    actions_.push_back(GraspExecutionActionPtr(new GraspExecutionAction(nh, &link_)));
+  }
+  return true;
+}
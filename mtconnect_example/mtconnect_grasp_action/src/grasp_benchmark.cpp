@@ -0,0 +1,256 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Drives a grasp execution action server with back to back goals (normally against the
+ * gripper emulator) and reports round trip percentiles, throughput and the longest stall
+ * between completions, which is dominated by reconnects when the emulator drops connections.
+ * The gripper message codec is timed first in both byte orders, it needs no server.
+ */
+
+#include "mtconnect_grasp_action/gripper_message.h"
+
+#include <ros/ros.h>
+#include <actionlib/client/action_client.h>
+#include <object_manipulation_msgs/GraspHandPostureExecutionAction.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace object_manipulation_msgs;
+using namespace actionlib;
+using namespace mtconnect_cnc_robot_example::gripper_message;
+
+static const std::string PARAM_ACTION_NAME = "action_name";
+static const std::string PARAM_GOALS = "goals";
+static const std::string PARAM_CONCURRENCY = "concurrency";
+static const std::string PARAM_SERVER_TIMEOUT = "server_timeout";
+static const std::string PARAM_CODEC_ITERATIONS = "codec_iterations";
+
+static const std::string DEFAULT_ACTION_NAME = "grasp_execution_action";
+static const int DEFAULT_GOALS = 200;
+static const int DEFAULT_CONCURRENCY = 1;
+static const double DEFAULT_SERVER_TIMEOUT = 10.0f; // seconds
+static const int DEFAULT_CODEC_ITERATIONS = 1000000; // per byte order, 0 skips the codec benchmark
+
+/*
+ * Serializes and deserializes a message iterations times, returns the average in ns per round
+ * trip and counts the messages that came back unchanged.
+ */
+template<ByteOrderType ORDER>
+static double benchmarkCodec(int iterations, int &round_trips)
+{
+  GripperMessage msg, out;
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  round_trips = 0;
+
+  ros::WallTime start = ros::WallTime::now();
+  for (int i = 0; i < iterations; i++)
+  {
+    msg.init(GripperOperationTypes::CLOSE, GripperDeviceTypes::VISE, i % GRIPPER_MAX_SEQUENCE);
+    GripperCodec<ORDER>::serialize(msg, frame);
+    if (GripperCodec<ORDER>::deserialize(frame, out) && out.getCommand() == msg.getCommand()
+        && out.comm_type_ == msg.comm_type_ && out.reply_code_ == msg.reply_code_)
+    {
+      round_trips++;
+    }
+  }
+
+  return (ros::WallTime::now() - start).toNSec() / double(iterations);
+}
+
+static void reportCodec(int iterations)
+{
+  int native_round_trips, swapped_round_trips;
+  double native = benchmarkCodec<ByteOrderTypes::NATIVE>(iterations, native_round_trips);
+  double swapped = benchmarkCodec<ByteOrderTypes::SWAPPED>(iterations, swapped_round_trips);
+
+  ROS_INFO_STREAM("\nGripper Codec Results"<<"\n\titerations: "<<iterations
+      <<"\n\tserialize + deserialize: native "<<native<<" ns, swapped "<<swapped<<" ns");
+  if (native_round_trips != iterations || swapped_round_trips != iterations)
+  {
+    ROS_ERROR_STREAM("Gripper codec round trips changed the message, native "<<native_round_trips
+        <<" and swapped "<<swapped_round_trips<<" of "<<iterations<<" intact");
+  }
+}
+
+class GraspBenchmark
+{
+public:
+
+  typedef ActionClient<GraspHandPostureExecutionAction> GEAC;
+  typedef GEAC::GoalHandle GoalHandle;
+
+  GraspBenchmark(ros::NodeHandle &nh, const std::string &action_name, int goals, int concurrency) :
+      client_(nh, action_name),
+      goals_(goals),
+      concurrency_(concurrency),
+      sent_(0),
+      completed_(0),
+      failed_(0),
+      in_flight_(0),
+      longest_gap_(0)
+  {
+    handles_.reserve(goals_);
+    rtts_.reserve(goals_);
+  }
+
+  bool run(double server_timeout)
+  {
+    if (!client_.waitForActionServerToStart(ros::Duration(server_timeout)))
+    {
+      ROS_ERROR_STREAM("Grasp action server did not start within "<<server_timeout<<" s");
+      return false;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    start_ = last_completion_ = ros::WallTime::now();
+    while (ros::ok() && completed_ < goals_)
+    {
+      // keeping the requested number of goals in flight, alternating grasp and release
+      if (sent_ < goals_ && in_flight_ < concurrency_)
+      {
+        GraspHandPostureExecutionGoal goal;
+        goal.goal = (sent_ % 2 == 0) ? GraspHandPostureExecutionGoal::GRASP : GraspHandPostureExecutionGoal::RELEASE;
+        sent_++;
+        in_flight_++;
+
+        // the client lock is taken by sendGoal, so ours must not be held meanwhile
+        lock.unlock();
+        GoalHandle gh = client_.sendGoal(
+            goal, boost::bind(&GraspBenchmark::transitionCB, this, _1, ros::WallTime::now()));
+        lock.lock();
+        handles_.push_back(gh);
+        continue;
+      }
+
+      condition_.timed_wait(lock, boost::posix_time::milliseconds(100));
+    }
+    finish_ = ros::WallTime::now();
+
+    return completed_ == goals_;
+  }
+
+  void report()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::stringstream ss;
+    double elapsed = (finish_ - start_).toSec();
+
+    ss<<"\nGrasp Benchmark Results"<<"\n\tgoals: "<<completed_<<" of "<<goals_<<" ("<<failed_<<" failed)"
+        <<"\n\tconcurrency: "<<concurrency_;
+    if (elapsed > 0)
+    {
+      ss<<"\n\tthroughput: "<<completed_ / elapsed<<" goals/s";
+    }
+
+    if (!rtts_.empty())
+    {
+      std::sort(rtts_.begin(), rtts_.end());
+      ss<<"\n\tround trip (ms): p50 "<<percentile(0.5) * 1000<<", p90 "<<percentile(0.9) * 1000<<", p99 "
+          <<percentile(0.99) * 1000<<", max "<<rtts_.back() * 1000;
+    }
+    ss<<"\n\tlongest stall between completions (reconnect): "<<longest_gap_ * 1000<<" ms";
+
+    ROS_INFO_STREAM(ss.str());
+  }
+
+protected:
+
+  void transitionCB(GoalHandle gh, ros::WallTime sent_at)
+  {
+    if (gh.getCommState() != CommState::DONE)
+    {
+      return;
+    }
+
+    ros::WallTime now = ros::WallTime::now();
+    boost::mutex::scoped_lock lock(mutex_);
+    rtts_.push_back((now - sent_at).toSec());
+    longest_gap_ = std::max(longest_gap_, (now - last_completion_).toSec());
+    last_completion_ = now;
+    if (gh.getTerminalState() != TerminalState::SUCCEEDED)
+    {
+      failed_++;
+    }
+    completed_++;
+    in_flight_--;
+    condition_.notify_all();
+  }
+
+  double percentile(double p)
+  {
+    unsigned int index = std::min(rtts_.size() - 1, (size_t)(p * rtts_.size()));
+    return rtts_[index];
+  }
+
+protected:
+
+  GEAC client_;
+  int goals_;
+  int concurrency_;
+
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::vector<GoalHandle> handles_;  // kept until the end, dropping a handle stops its callbacks
+  std::vector<double> rtts_;
+  int sent_;
+  int completed_;
+  int failed_;
+  int in_flight_;
+  ros::WallTime start_;
+  ros::WallTime finish_;
+  ros::WallTime last_completion_;
+  double longest_gap_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "grasp_benchmark");
+  ros::NodeHandle nh;
+  ros::NodeHandle ph("~");
+  std::string action_name;
+  int goals, concurrency, codec_iterations;
+  double server_timeout;
+
+  ph.param(PARAM_ACTION_NAME, action_name, DEFAULT_ACTION_NAME);
+  ph.param(PARAM_GOALS, goals, DEFAULT_GOALS);
+  ph.param(PARAM_CONCURRENCY, concurrency, DEFAULT_CONCURRENCY);
+  ph.param(PARAM_SERVER_TIMEOUT, server_timeout, DEFAULT_SERVER_TIMEOUT);
+  ph.param(PARAM_CODEC_ITERATIONS, codec_iterations, DEFAULT_CODEC_ITERATIONS);
+
+  if (codec_iterations > 0)
+  {
+    reportCodec(codec_iterations);
+  }
+
+  // client callbacks run on the spinner while the main thread sends goals
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  GraspBenchmark benchmark(nh, action_name, goals, std::max(1, concurrency));
+  if (!benchmark.run(server_timeout))
+  {
+    ROS_WARN("Grasp benchmark did not complete all goals");
+  }
+  benchmark.report();
+
+  spinner.stop();
+  return 0;
+}
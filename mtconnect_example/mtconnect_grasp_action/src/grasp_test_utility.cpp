@@ -15,25 +15,67 @@
  */
 
 
-#include <simple_message/smpl_msg_connection.h>
-#include <simple_message/simple_message.h>
-#include <simple_message/socket/tcp_client.h>
-#include <mtconnect_grasp_action/gripper_message.h>
+#include <ros/ros.h>
+#include <mtconnect_grasp_action/gripper_link.h>
+#include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
 using namespace std;
-using namespace industrial::smpl_msg_connection;
-using namespace industrial::simple_message;
 using namespace mtconnect_cnc_robot_example::gripper_message;
 
+/*
+ * Blocks until the link completes a single request
+ */
+class Reply
+{
+public:
+  Reply() : done_(false), success_(false) {}
+
+  void complete(bool success)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    done_ = true;
+    success_ = success;
+    condition_.notify_all();
+  }
+
+  bool wait()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    while(!done_)
+    {
+      condition_.wait(lock);
+    }
+    return success_;
+  }
+
+private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  bool done_;
+  bool success_;
+};
+
+static bool execute(GripperLink &link, GripperDeviceType device, GripperOperationType operation)
+{
+  Reply reply;
+  link.post(device, operation, boost::bind(&Reply::complete, &reply, _1));
+  return reply.wait();
+}
 
 int main(int argc, char** argv)
 {
 	std::string ip_address;
 	int port_number;
 	std::stringstream ss;
+
+	// only needed for the time and logging facilities used by the link
+	ros::Time::init();
 	
-	if(argc == 3)  // expects ip_address and port_number
+	ByteOrderType byte_order = ByteOrderTypes::NATIVE;
+	bool valid_args = (argc == 3) || (argc == 4 && parseByteOrder(argv[3], byte_order));
+	
+	if(valid_args)  // expects ip_address, port_number and an optional byte order
 	{
 
 		// parsing arguments
@@ -41,20 +83,15 @@ int main(int argc, char** argv)
 		ss<<argv[2];
 		if(!(ss >> port_number))
 		{
-			ROS_ERROR("Could not read port number, usage: grasp_utility <robot ip address> <port number>");
+			ROS_ERROR("Could not read port number, usage: grasp_utility <robot ip address> <port number> [native|swapped|auto]");
 		}
 		else
 		{
 			ROS_INFO("Grasp action connecting to IP address: %s and port: %i", ip_address.c_str(),port_number);
-			industrial::tcp_client::TcpClient robot;
-			robot.init(const_cast<char*>(ip_address.c_str()), port_number);
-			if(!robot.makeConnect())
-			{
-				ROS_ERROR_STREAM("Failed to connect, exiting");
-				return 0;
-			}
-
-			cout << "Grasp client connected" << endl;;
+			GripperLink link;
+			link.init(ip_address, port_number);
+			link.setByteOrder(byte_order);
+			link.start();
 
 			int i = 0;
 			while (true)
@@ -62,37 +99,47 @@ int main(int argc, char** argv)
 			  cout << "Grasp Utility" << endl
 				 << "1. INIT" << endl
 				 << "2. CLOSE" << endl
-				 << "3. OPEN" << endl;
+				 << "3. OPEN" << endl
+				 << "4. CLOSE VISE (multiplexed port only)" << endl
+				 << "5. OPEN VISE (multiplexed port only)" << endl
+				 << "6. CLOSE GRIPPER AND VISE (multiplexed port only)" << endl;
 			  cin >> i;
 
-			  GripperMessage gMsg;
-			  SimpleMessage request;
-			  SimpleMessage reply;
-
 			  switch(i)
 			  {
 			  case 1:
-				  gMsg.init(GripperOperationTypes::INIT);
-				  gMsg.toRequest(request);
-				  robot.sendAndReceiveMsg(request, reply);
-				  cout << "Gripper initialized" << endl;
+				  cout << "Gripper init " << (execute(link, GripperDeviceTypes::GRIPPER, GripperOperationTypes::INIT) ? "succeeded" : "failed") << endl;
 			    break;
 
 			  case 2:
-			    gMsg.init(GripperOperationTypes::CLOSE);
-			    gMsg.toRequest(request);
-			    cout << "Message length: " << request.getMsgLength() << endl;
-			    robot.sendAndReceiveMsg(request, reply);
-			    cout << "Gripper closed" << endl;
+			    cout << "Gripper close " << (execute(link, GripperDeviceTypes::GRIPPER, GripperOperationTypes::CLOSE) ? "succeeded" : "failed") << endl;
 			    break;
 
 			  case 3:
-			    gMsg.init(GripperOperationTypes::OPEN);
-			    gMsg.toRequest(request);
-			    robot.sendAndReceiveMsg(request, reply);
-			    cout << "Gripper opened" << endl;
+			    cout << "Gripper open " << (execute(link, GripperDeviceTypes::GRIPPER, GripperOperationTypes::OPEN) ? "succeeded" : "failed") << endl;
 			    break;
 
+			  case 4:
+			    cout << "Vise close " << (execute(link, GripperDeviceTypes::VISE, GripperOperationTypes::CLOSE) ? "succeeded" : "failed") << endl;
+			    break;
+
+			  case 5:
+			    cout << "Vise open " << (execute(link, GripperDeviceTypes::VISE, GripperOperationTypes::OPEN) ? "succeeded" : "failed") << endl;
+			    break;
+
+			  case 6:
+			  {
+			    // both requests are in flight at the same time
+			    Reply gripper_reply, vise_reply;
+			    ros::WallTime start = ros::WallTime::now();
+			    link.post(GripperDeviceTypes::GRIPPER, GripperOperationTypes::CLOSE, boost::bind(&Reply::complete, &gripper_reply, _1));
+			    link.post(GripperDeviceTypes::VISE, GripperOperationTypes::CLOSE, boost::bind(&Reply::complete, &vise_reply, _1));
+			    bool success = gripper_reply.wait() & vise_reply.wait();
+			    cout << "Gripper and vise close " << (success ? "succeeded" : "failed") << " in "
+			        << (ros::WallTime::now() - start).toSec() << " s" << endl;
+			    break;
+			  }
+
 			  default:
 			    return 0;
 			  }
@@ -101,12 +148,8 @@ int main(int argc, char** argv)
 	}
 	else
 	{
-		ROS_ERROR("Missing command line arguments, usage: grasp_utility <robot ip address>< port number>");
+		ROS_ERROR("Missing command line arguments, usage: grasp_utility <robot ip address> <port number> [native|swapped|auto]");
 	}
 
   return 0;
 }
-
-
-
-
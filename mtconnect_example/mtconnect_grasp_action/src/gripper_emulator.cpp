@@ -0,0 +1,354 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Emulates the controller side of the gripper connection (gripper.kl, vise.kl and grp_mux.kl)
+ * so that the grasp action server can be exercised without a robot.  Actuation delay, jitter,
+ * failure replies and dropped connections are configurable.
+ */
+
+#include <ros/ros.h>
+#include <mtconnect_grasp_action/gripper_message.h>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace mtconnect_cnc_robot_example::gripper_message;
+using namespace industrial::simple_message;
+
+static const std::string PARAM_PORT_NUMBER = "port_number";
+static const std::string PARAM_BYTE_ORDER = "byte_order";
+static const std::string PARAM_ACTUATION_DELAY = "actuation_delay";
+static const std::string PARAM_ACTUATION_JITTER = "actuation_jitter";
+static const std::string PARAM_FAILURE_PROBABILITY = "failure_probability";
+static const std::string PARAM_DROP_PROBABILITY = "drop_probability";
+static const std::string PARAM_SERIAL = "serial";
+
+static const int DEFAULT_PORT_NUMBER = 11010;
+static const double DEFAULT_ACTUATION_DELAY = 0.5f; // seconds (DELAY 500 in gripper.kl)
+static const int POLL_PERIOD = 100; // milliseconds
+static const int NUM_DEVICES = 2;
+
+class GripperEmulator
+{
+public:
+
+  GripperEmulator() :
+      port_number_(DEFAULT_PORT_NUMBER),
+      order_(ByteOrderTypes::AUTO),
+      actuation_delay_(DEFAULT_ACTUATION_DELAY),
+      actuation_jitter_(0),
+      failure_probability_(0),
+      drop_probability_(0),
+      serial_(false),
+      listen_fd_(-1),
+      random_(generator_, boost::uniform_real<>(0, 1)),
+      requests_(0),
+      failures_(0),
+      drops_(0)
+  {
+  }
+
+  ~GripperEmulator()
+  {
+    if (listen_fd_ >= 0)
+    {
+      close(listen_fd_);
+    }
+  }
+
+  bool setup()
+  {
+    ros::NodeHandle ph("~");
+    std::string order_str;
+
+    ph.param(PARAM_PORT_NUMBER, port_number_, DEFAULT_PORT_NUMBER);
+    ph.param(PARAM_BYTE_ORDER, order_str, std::string("auto"));
+    ph.param(PARAM_ACTUATION_DELAY, actuation_delay_, DEFAULT_ACTUATION_DELAY);
+    ph.param(PARAM_ACTUATION_JITTER, actuation_jitter_, 0.0);
+    ph.param(PARAM_FAILURE_PROBABILITY, failure_probability_, 0.0);
+    ph.param(PARAM_DROP_PROBABILITY, drop_probability_, 0.0);
+    ph.param(PARAM_SERIAL, serial_, false);
+
+    if (!parseByteOrder(order_str, order_))
+    {
+      ROS_ERROR_STREAM("Invalid '"<<PARAM_BYTE_ORDER<<"' parameter '"<<order_str<<"', expected native, swapped or auto");
+      return false;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_number_);
+    if (listen_fd_ < 0 || bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 1) != 0)
+    {
+      ROS_ERROR_STREAM("Gripper emulator failed to listen on port "<<port_number_);
+      return false;
+    }
+
+    ROS_INFO_STREAM("Gripper emulator listening on port "<<port_number_<<" ("<<(serial_ ? "serial" : "multiplexed")
+                    <<", delay "<<actuation_delay_<<" s, jitter "<<actuation_jitter_<<" s, failure p "
+                    <<failure_probability_<<", drop p "<<drop_probability_<<")");
+    return true;
+  }
+
+  void run()
+  {
+    ros::WallTime dropped_at;
+    bool dropped = false;
+
+    while (ros::ok())
+    {
+      struct pollfd fds;
+      fds.fd = listen_fd_;
+      fds.events = POLLIN;
+      if (poll(&fds, 1, POLL_PERIOD) <= 0)
+      {
+        continue;
+      }
+
+      int client_fd = accept(listen_fd_, NULL, NULL);
+      if (client_fd < 0)
+      {
+        continue;
+      }
+
+      if (dropped)
+      {
+        double reconnect = (ros::WallTime::now() - dropped_at).toSec();
+        reconnect_times_.push_back(reconnect);
+        ROS_INFO_STREAM("Gripper emulator client reconnected after "<<reconnect<<" s");
+      }
+      else
+      {
+        ROS_INFO_STREAM("Gripper emulator client connected");
+      }
+
+      dropped = serve(client_fd);
+      dropped_at = ros::WallTime::now();
+      close(client_fd);
+    }
+
+    report();
+  }
+
+protected:
+
+  struct Pending
+  {
+    bool active_;
+    GripperMessage reply_;
+    ros::WallTime due_;
+  };
+
+  /*
+   * Serves one client, returns true if the connection was dropped on purpose
+   */
+  bool serve(int fd)
+  {
+    Pending pending[NUM_DEVICES];
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+      pending[i].active_ = false;
+    }
+    ByteOrderType order = order_;
+
+    while (ros::ok())
+    {
+      // sleeping until the next reply is due or a request arrives
+      int timeout = POLL_PERIOD;
+      ros::WallTime now = ros::WallTime::now();
+      for (int i = 0; i < NUM_DEVICES; i++)
+      {
+        if (pending[i].active_)
+        {
+          timeout = std::min(timeout, std::max(0, int((pending[i].due_ - now).toSec() * 1000)));
+        }
+      }
+
+      struct pollfd fds;
+      fds.fd = fd;
+      fds.events = POLLIN;
+      if (poll(&fds, 1, timeout) > 0)
+      {
+        boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+        if (recv(fd, frame, GRIPPER_FRAME_SIZE, MSG_WAITALL) != (int)GRIPPER_FRAME_SIZE)
+        {
+          ROS_INFO_STREAM("Gripper emulator client disconnected");
+          return false;
+        }
+
+        // like the KAREL programs, auto answers in whatever order the request came in
+        if (order_ == ByteOrderTypes::AUTO)
+        {
+          order = detectByteOrder(frame);
+        }
+
+        GripperMessage request;
+        if (!deserializeGripperMessage(order, frame, request) || request.comm_type_ != CommTypes::SERVICE_REQUEST)
+        {
+          ROS_WARN_STREAM("Gripper emulator received an invalid request, ignoring it");
+          continue;
+        }
+
+        requests_++;
+        if (random_() < drop_probability_)
+        {
+          ROS_WARN_STREAM("Gripper emulator dropping the connection");
+          drops_++;
+          return true;
+        }
+
+        int device = request.device_ < NUM_DEVICES ? request.device_ : 0;
+        if (pending[device].active_)
+        {
+          // a stop cuts the operation in progress short
+          if (request.operation_ == GripperOperationTypes::STOP)
+          {
+            pending[device].reply_.reply_code_ = ReplyTypes::FAILURE;
+          }
+
+          if (!sendReply(fd, order, pending[device]))
+          {
+            return false;
+          }
+        }
+
+        Pending &p = pending[device];
+        p.active_ = true;
+        p.reply_ = request;
+        p.reply_.comm_type_ = CommTypes::SERVICE_REPLY;
+        p.reply_.reply_code_ = ReplyTypes::SUCCESS;
+        p.due_ = ros::WallTime::now();
+        switch (request.operation_)
+        {
+          case GripperOperationTypes::OPEN:
+          case GripperOperationTypes::CLOSE:
+            p.due_ += ros::WallDuration(actuationDelay());
+            if (random_() < failure_probability_)
+            {
+              p.reply_.reply_code_ = ReplyTypes::FAILURE;
+              failures_++;
+            }
+            break;
+          case GripperOperationTypes::INIT:
+          case GripperOperationTypes::STOP:
+            break;
+          default:
+            p.reply_.reply_code_ = ReplyTypes::FAILURE;
+            break;
+        }
+
+        // the single device programs block while actuating
+        if (serial_)
+        {
+          ros::WallDuration(std::max(0.0, (p.due_ - ros::WallTime::now()).toSec())).sleep();
+        }
+      }
+
+      now = ros::WallTime::now();
+      for (int i = 0; i < NUM_DEVICES; i++)
+      {
+        if (pending[i].active_ && pending[i].due_ <= now && !sendReply(fd, order, pending[i]))
+        {
+          return false;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  bool sendReply(int fd, ByteOrderType order, Pending &pending)
+  {
+    boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+    pending.active_ = false;
+    serializeGripperMessage(order == ByteOrderTypes::AUTO ? ByteOrderTypes::NATIVE : order, pending.reply_, frame);
+    return send(fd, frame, GRIPPER_FRAME_SIZE, MSG_NOSIGNAL) == (int)GRIPPER_FRAME_SIZE;
+  }
+
+  double actuationDelay()
+  {
+    return std::max(0.0, actuation_delay_ + (2 * random_() - 1) * actuation_jitter_);
+  }
+
+  void report()
+  {
+    std::stringstream ss;
+    ss<<"\nGripper Emulator Statistics"<<"\n\trequests: "<<requests_<<"\n\tfailure replies: "<<failures_
+        <<"\n\tdropped connections: "<<drops_;
+
+    if (!reconnect_times_.empty())
+    {
+      std::sort(reconnect_times_.begin(), reconnect_times_.end());
+      double total = 0;
+      for (unsigned int i = 0; i < reconnect_times_.size(); i++)
+      {
+        total += reconnect_times_[i];
+      }
+      ss<<"\n\treconnect time: mean "<<total / reconnect_times_.size()<<" s, max "<<reconnect_times_.back()<<" s";
+    }
+
+    ROS_INFO_STREAM(ss.str());
+  }
+
+protected:
+
+  int port_number_;
+  ByteOrderType order_;
+  double actuation_delay_;
+  double actuation_jitter_;
+  double failure_probability_;
+  double drop_probability_;
+  bool serial_;
+  int listen_fd_;
+
+  boost::mt19937 generator_;
+  boost::variate_generator<boost::mt19937&, boost::uniform_real<> > random_;
+
+  unsigned int requests_;
+  unsigned int failures_;
+  unsigned int drops_;
+  std::vector<double> reconnect_times_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "gripper_emulator");
+  ros::NodeHandle nh;
+
+  GripperEmulator emulator;
+  if (emulator.setup())
+  {
+    emulator.run();
+  }
+
+  return 0;
+}
@@ -0,0 +1,681 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_grasp_action/gripper_link.h>
+#include <simple_message/simple_message.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace industrial::simple_message;
+using namespace industrial::shared_types;
+
+namespace mtconnect_cnc_robot_example
+{
+namespace gripper_message
+{
+
+bool GripperSocket::waitReceive(int timeout_ms)
+{
+  struct pollfd fds;
+  fds.fd = this->getSockHandle();
+  fds.events = POLLIN;
+  fds.revents = 0;
+
+  return poll(&fds, 1, timeout_ms) > 0;
+}
+
+bool GripperSocket::sendFrame(const boost::uint8_t *frame)
+{
+  unsigned int sent = 0;
+  while (sent < GRIPPER_FRAME_SIZE)
+  {
+    int rc = send(this->getSockHandle(), frame + sent, GRIPPER_FRAME_SIZE - sent, MSG_NOSIGNAL);
+    if (rc <= 0)
+    {
+      return false;
+    }
+    sent += rc;
+  }
+  return true;
+}
+
+bool GripperSocket::receiveFrame(boost::uint8_t *frame, int timeout_ms)
+{
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout_ms / 1000.0);
+  unsigned int received = 0;
+  while (received < GRIPPER_FRAME_SIZE)
+  {
+    // recv only runs on a readable socket, a partial frame can't block it
+    int remaining = static_cast<int>((deadline - ros::WallTime::now()).toSec() * 1000);
+    if (remaining <= 0 || !waitReceive(remaining))
+    {
+      return false;
+    }
+
+    int rc = recv(this->getSockHandle(), frame + received, GRIPPER_FRAME_SIZE - received, 0);
+    if (rc <= 0)
+    {
+      return false;
+    }
+    received += rc;
+  }
+  return true;
+}
+
+void GripperSocket::closeSocket()
+{
+  if (this->getSockHandle() >= 0)
+  {
+    close(this->getSockHandle());
+    this->setSockHandle(-1);
+  }
+}
+
+GripperLinkStatistics::GripperLinkStatistics() :
+    connected_(false),
+    connects_(0),
+    connect_failures_(0),
+    disconnects_(0),
+    requests_sent_(0),
+    replies_received_(0),
+    failure_replies_(0),
+    unmatched_replies_(0),
+    timeouts_(0),
+    bytes_out_(0),
+    bytes_in_(0),
+    rtt_count_(0),
+    rtt_sum_(0),
+    rtt_min_(0),
+    rtt_max_(0)
+{
+  std::fill(rtt_histogram_, rtt_histogram_ + RTT_HISTOGRAM_BUCKETS, 0);
+}
+
+void GripperLinkStatistics::addRtt(double seconds)
+{
+  int bucket = 0;
+  for (double bound = 0.001; bucket < RTT_HISTOGRAM_BUCKETS - 1 && seconds >= bound; bound *= 2)
+  {
+    bucket++;
+  }
+
+  rtt_histogram_[bucket]++;
+  rtt_min_ = rtt_count_ == 0 ? seconds : std::min(rtt_min_, seconds);
+  rtt_max_ = std::max(rtt_max_, seconds);
+  rtt_sum_ += seconds;
+  rtt_count_++;
+}
+
+double GripperLinkStatistics::rttPercentile(double fraction) const
+{
+  unsigned int target = static_cast<unsigned int>(fraction * rtt_count_);
+  unsigned int count = 0;
+  double bound = 1.0;
+  for (int i = 0; i < RTT_HISTOGRAM_BUCKETS - 1; i++, bound *= 2)
+  {
+    count += rtt_histogram_[i];
+    if (count > target)
+    {
+      return std::min(bound, rtt_max_ * 1000);
+    }
+  }
+  return rtt_max_ * 1000;
+}
+
+GripperLink::GripperLink() :
+    port_number_(0),
+    reconnect_min_delay_(DEFAULT_RECONNECT_MIN_DELAY),
+    reconnect_max_delay_(DEFAULT_RECONNECT_MAX_DELAY),
+    request_timeout_(DEFAULT_REQUEST_TIMEOUT),
+    max_outstanding_(DEFAULT_MAX_OUTSTANDING),
+    order_(ByteOrderTypes::NATIVE),
+    candidate_order_(ByteOrderTypes::NATIVE),
+    next_sequence_(1),
+    next_request_id_(1),
+    running_(false),
+    connected_(false),
+    receiving_(false)
+{
+}
+
+GripperLink::~GripperLink()
+{
+  stop();
+}
+
+void GripperLink::init(const std::string &ip_address, int port_number)
+{
+  ip_address_ = ip_address;
+  port_number_ = port_number;
+}
+
+void GripperLink::setReconnectDelays(double min_delay, double max_delay)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  reconnect_min_delay_ = min_delay;
+  reconnect_max_delay_ = std::max(min_delay, max_delay);
+}
+
+void GripperLink::setRequestTimeout(double timeout)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  request_timeout_ = timeout;
+}
+
+void GripperLink::setMaxOutstanding(int max_outstanding)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  max_outstanding_ = std::max(1, max_outstanding);
+}
+
+void GripperLink::setByteOrder(ByteOrderType order)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  order_ = order;
+  candidate_order_ = ByteOrderTypes::NATIVE;
+}
+
+ByteOrderType GripperLink::getByteOrder()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return order_;
+}
+
+void GripperLink::start()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (running_)
+  {
+    return;
+  }
+
+  running_ = true;
+  write_thread_ = boost::thread(boost::bind(&GripperLink::writeLoop, this));
+  read_thread_ = boost::thread(boost::bind(&GripperLink::readLoop, this));
+}
+
+void GripperLink::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+
+  if (read_thread_.joinable())
+  {
+    read_thread_.join();
+  }
+
+  if (write_thread_.joinable())
+  {
+    write_thread_.join();
+  }
+  client_.closeSocket();
+}
+
+GripperLink::RequestId GripperLink::post(GripperDeviceType device, GripperOperationType operation,
+                                         Completion completion)
+{
+  Request request;
+  request.device_ = device;
+  request.operation_ = operation;
+  request.completion_ = completion;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    request.id_ = next_request_id_++;
+    request.deadline_ = ros::WallTime::now() + ros::WallDuration(request_timeout_);
+    queue_.push_back(request);
+  }
+  condition_.notify_all();
+  return request.id_;
+}
+
+bool GripperLink::cancel(RequestId id)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for (std::deque<Request>::iterator i = queue_.begin(); i != queue_.end(); i++)
+    {
+      if (i->id_ == id)
+      {
+        // never sent, nothing to interrupt
+        queue_.erase(i);
+        return true;
+      }
+    }
+
+    std::map<shared_int, Request>::iterator j = outstanding_.begin();
+    while (j != outstanding_.end() && j->second.id_ != id)
+    {
+      j++;
+    }
+
+    if (j == outstanding_.end())
+    {
+      return false;
+    }
+
+    // the stop goes out before any queued request and frees the slot of the interrupted one
+    Request stop;
+    stop.id_ = next_request_id_++;
+    stop.device_ = j->second.device_;
+    stop.operation_ = GripperOperationTypes::STOP;
+    stop.deadline_ = ros::WallTime::now() + ros::WallDuration(request_timeout_);
+    queue_.push_front(stop);
+
+    cancelled_.insert(j->first);
+    outstanding_.erase(j);
+  }
+  condition_.notify_all();
+  return true;
+}
+
+bool GripperLink::isConnected()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return connected_;
+}
+
+void GripperLink::getStatistics(GripperLinkStatistics &stats)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  stats = stats_;
+  stats.connected_ = connected_;
+}
+
+void GripperLink::recordError(const std::string &error)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  stats_.last_error_ = error;
+  stats_.last_error_time_ = ros::WallTime::now();
+}
+
+bool GripperLink::connect()
+{
+  // the socket is recreated since a dropped connection leaves it unusable, the old one is
+  // closed first or every retry would leak a descriptor
+  client_.closeSocket();
+  client_.init(const_cast<char*>(ip_address_.c_str()), port_number_);
+  bool connected = client_.makeConnect() && negotiate();
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    connected_ = connected;
+    if (connected)
+    {
+      stats_.connects_++;
+    }
+    else
+    {
+      stats_.connect_failures_++;
+    }
+  }
+  condition_.notify_all();
+  return connected;
+}
+
+bool GripperLink::negotiate()
+{
+  ByteOrderType candidate;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (order_ != ByteOrderTypes::AUTO)
+    {
+      return true;
+    }
+    candidate = candidate_order_;
+
+    // a failed attempt moves on to the other order
+    candidate_order_ = candidate == ByteOrderTypes::NATIVE ? ByteOrderTypes::SWAPPED : ByteOrderTypes::NATIVE;
+  }
+
+  GripperMessage gMsg;
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  gMsg.init(GripperOperationTypes::INIT);
+  serializeGripperMessage(candidate, gMsg, frame);
+
+  bool sent = client_.sendFrame(frame);
+  bool received = sent && client_.receiveFrame(frame, NEGOTIATION_TIMEOUT);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stats_.bytes_out_ += sent ? GRIPPER_FRAME_SIZE : 0;
+    stats_.bytes_in_ += received ? GRIPPER_FRAME_SIZE : 0;
+  }
+
+  if (!received)
+  {
+    ROS_WARN_STREAM("Gripper link byte order negotiation failed ("<<(candidate == ByteOrderTypes::NATIVE ? "native" : "swapped")
+                    <<" order got no reply)");
+    recordError("byte order negotiation got no reply");
+    return false;
+  }
+
+  ByteOrderType detected = detectByteOrder(frame);
+  if (detected == ByteOrderTypes::AUTO)
+  {
+    ROS_WARN_STREAM("Gripper link byte order negotiation failed, the reply is not a gripper message");
+    recordError("byte order negotiation reply is not a gripper message");
+    return false;
+  }
+
+  ROS_INFO_STREAM("Gripper link negotiated "<<(detected == ByteOrderTypes::NATIVE ? "native" : "swapped")<<" byte order");
+  boost::mutex::scoped_lock lock(mutex_);
+  order_ = detected;
+  return true;
+}
+
+bool GripperLink::waitFor(double seconds)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(static_cast<long>(seconds * 1000));
+
+  // new requests also notify the condition, they don't cut the backoff short
+  while (running_ && condition_.timed_wait(lock, deadline))
+  {
+  }
+  return running_;
+}
+
+void GripperLink::expireRequests()
+{
+  std::vector<Completion> expired;
+  ros::WallTime now = ros::WallTime::now();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::deque<Request>::iterator i = queue_.begin();
+    while (i != queue_.end())
+    {
+      if (i->deadline_ < now)
+      {
+        expired.push_back(i->completion_);
+        i = queue_.erase(i);
+      }
+      else
+      {
+        i++;
+      }
+    }
+
+    std::map<shared_int, Request>::iterator j = outstanding_.begin();
+    while (j != outstanding_.end())
+    {
+      if (j->second.deadline_ < now)
+      {
+        // a late reply is discarded like the reply of a cancelled request
+        expired.push_back(j->second.completion_);
+        cancelled_.insert(j->first);
+        outstanding_.erase(j++);
+      }
+      else
+      {
+        j++;
+      }
+    }
+    stats_.timeouts_ += expired.size();
+  }
+
+  if (!expired.empty())
+  {
+    ROS_ERROR_STREAM("Gripper link: "<<expired.size()<<" request(s) timed out");
+    recordError("request timed out");
+    condition_.notify_all();
+  }
+
+  for (unsigned int i = 0; i < expired.size(); i++)
+  {
+    if (expired[i])
+    {
+      expired[i](false);
+    }
+  }
+}
+
+void GripperLink::requeueOutstanding()
+{
+  // open and close are idempotent, requests without a reply are sent again once reconnected
+  std::map<shared_int, Request>::reverse_iterator i;
+  for (i = outstanding_.rbegin(); i != outstanding_.rend(); i++)
+  {
+    queue_.push_front(i->second);
+  }
+  outstanding_.clear();
+
+  // replies of the old connection never arrive
+  cancelled_.clear();
+}
+
+void GripperLink::writeLoop()
+{
+  double delay;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    delay = reconnect_min_delay_;
+  }
+
+  while (true)
+  {
+    if (!isConnected())
+    {
+      {
+        // the reader must be done with the old socket before it is recreated
+        boost::mutex::scoped_lock lock(mutex_);
+        while (receiving_)
+        {
+          condition_.wait(lock);
+        }
+        requeueOutstanding();
+      }
+
+      if (!connect())
+      {
+        ROS_WARN_STREAM("Gripper link to "<<ip_address_<<":"<<port_number_<<" is down, retrying in "<<delay<<" s");
+        recordError("connection failed");
+        expireRequests();
+        if (!waitFor(delay))
+        {
+          break;
+        }
+
+        boost::mutex::scoped_lock lock(mutex_);
+        delay = std::min(delay * 2, reconnect_max_delay_);
+        continue;
+      }
+
+      ROS_INFO_STREAM("Gripper link connected to "<<ip_address_<<":"<<port_number_);
+      boost::mutex::scoped_lock lock(mutex_);
+      delay = reconnect_min_delay_;
+    }
+
+    expireRequests();
+
+    Request request;
+    shared_int sequence;
+    ByteOrderType order;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (running_ && connected_ && (queue_.empty() || (int)outstanding_.size() >= max_outstanding_))
+      {
+        // timed so that requests without a reply are expired
+        condition_.timed_wait(lock, boost::posix_time::milliseconds(RECEIVE_POLL_PERIOD));
+      }
+
+      if (!running_)
+      {
+        break;
+      }
+
+      if (!connected_ || queue_.empty() || (int)outstanding_.size() >= max_outstanding_)
+      {
+        continue;
+      }
+
+      request = queue_.front();
+      queue_.pop_front();
+
+      // registered before sending so that the reply can't arrive first
+      sequence = next_sequence_;
+      next_sequence_ = next_sequence_ % GRIPPER_MAX_SEQUENCE + 1;
+      request.sent_ = ros::WallTime::now();
+      outstanding_[sequence] = request;
+      order = order_;
+    }
+    condition_.notify_all();
+
+    GripperMessage gMsg;
+    boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+    gMsg.init(request.operation_, request.device_, sequence);
+    serializeGripperMessage(order, gMsg, frame);
+
+    if (client_.sendFrame(frame))
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stats_.requests_sent_++;
+      stats_.bytes_out_ += GRIPPER_FRAME_SIZE;
+      stats_.last_send_ = request.sent_;
+    }
+    else
+    {
+      ROS_WARN_STREAM("Gripper link lost while sending request, reconnecting");
+      recordError("connection lost while sending");
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        connected_ = false;
+        stats_.disconnects_++;
+      }
+      condition_.notify_all();
+    }
+  }
+
+  // failing whatever is left so that no goal is left hanging
+  std::deque<Request> remaining;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (receiving_)
+    {
+      condition_.wait(lock);
+    }
+    requeueOutstanding();
+    remaining.swap(queue_);
+  }
+
+  for (unsigned int i = 0; i < remaining.size(); i++)
+  {
+    if (remaining[i].completion_)
+    {
+      remaining[i].completion_(false);
+    }
+  }
+}
+
+void GripperLink::readLoop()
+{
+  ByteOrderType order;
+  while (true)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      // discarded replies are read too, they would otherwise be taken for the next reply
+      while (running_ && (!connected_ || (outstanding_.empty() && cancelled_.empty())))
+      {
+        condition_.wait(lock);
+      }
+
+      if (!running_)
+      {
+        break;
+      }
+      receiving_ = true;
+      order = order_;
+    }
+
+    // polling so that stop() is not held up by a controller that never replies
+    bool ready = client_.waitReceive(RECEIVE_POLL_PERIOD);
+    bool received = true;
+    boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+    if (ready)
+    {
+      received = client_.receiveFrame(frame);
+    }
+
+    Completion completion;
+    bool success = false;
+    bool matched = false;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      receiving_ = false;
+      if (!received)
+      {
+        // the writer may have noticed first, a partial frame also ends up here since the
+        // rest of the stream can't be framed any more
+        stats_.disconnects_ += connected_ ? 1 : 0;
+        connected_ = false;
+      }
+      else if (ready)
+      {
+        GripperMessage gMsg;
+        std::map<shared_int, Request>::iterator i;
+        ros::WallTime now = ros::WallTime::now();
+        stats_.bytes_in_ += GRIPPER_FRAME_SIZE;
+        stats_.last_receive_ = now;
+        if (deserializeGripperMessage(order, frame, gMsg)
+            && (i = outstanding_.find(gMsg.sequence_)) != outstanding_.end())
+        {
+          completion = i->second.completion_;
+          matched = true;
+          success = gMsg.reply_code_ == ReplyTypes::SUCCESS;
+          stats_.replies_received_++;
+          stats_.failure_replies_ += success ? 0 : 1;
+          stats_.addRtt((now - i->second.sent_).toSec());
+          outstanding_.erase(i);
+        }
+        else if (cancelled_.erase(gMsg.sequence_) > 0)
+        {
+          // reply of an interrupted request
+          matched = true;
+        }
+        else
+        {
+          stats_.unmatched_replies_++;
+        }
+      }
+    }
+    condition_.notify_all();
+
+    if (!received)
+    {
+      ROS_WARN_STREAM("Gripper link lost (or a reply was cut short) while waiting for a reply, reconnecting");
+      recordError("connection lost while receiving");
+    }
+    else if (ready && !matched)
+    {
+      ROS_WARN_STREAM("Gripper link received a reply that matches no request, ignoring it");
+      recordError("reply matches no request");
+    }
+
+    if (completion)
+    {
+      completion(success);
+    }
+  }
+}
+
+}
+}
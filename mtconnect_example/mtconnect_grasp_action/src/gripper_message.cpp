@@ -30,13 +30,10 @@
  */
 
 #include <mtconnect_grasp_action/gripper_message.h>
-#include "simple_message/byte_array.h"
-#include "simple_message/log_wrapper.h"
 
 
 
 using namespace industrial::shared_types;
-using namespace industrial::byte_array;
 using namespace industrial::simple_message;
 using namespace mtconnect_cnc_robot_example::gripper_message;
 
@@ -47,70 +44,97 @@ namespace gripper_message
 
 GripperMessage::GripperMessage(void)
 {
-  this->setMessageType(industrial::simple_message::StandardMsgTypes::SWRI_MSG_BEGIN);
   this->init();
 }
 
-GripperMessage::~GripperMessage(void)
+void GripperMessage::init(GripperOperationType operation)
 {
-
+  this->init(operation, GripperDeviceTypes::GRIPPER, 0);
 }
 
-bool GripperMessage::init(industrial::simple_message::SimpleMessage & msg)
+void GripperMessage::init(GripperOperationType operation, GripperDeviceType device, shared_int sequence)
 {
-  bool rtn = false;
-  ByteArray data = msg.getData();
+  this->operation_ = operation;
+  this->device_ = device;
+  this->sequence_ = sequence;
+  this->comm_type_ = CommTypes::SERVICE_REQUEST;
+  this->reply_code_ = ReplyTypes::INVALID;
+}
 
-  this->setMessageType(industrial::simple_message::StandardMsgTypes::SWRI_MSG_BEGIN);
-  this->unload(&msg.getData());
-  return rtn;
+void GripperMessage::init()
+{
+  this->init(GripperOperationTypes::INVALID);
+}
 
+void GripperMessage::setCommand(shared_int cmd)
+{
+  this->operation_ = (GripperOperationType)(cmd % GRIPPER_DEVICE_SCALE);
+  this->device_ = (GripperDeviceType)((cmd % GRIPPER_SEQUENCE_SCALE) / GRIPPER_DEVICE_SCALE);
+  this->sequence_ = cmd / GRIPPER_SEQUENCE_SCALE;
 }
 
-void GripperMessage::init(GripperOperationType operation)
+bool serializeGripperMessage(ByteOrderType order, const GripperMessage &msg, boost::uint8_t *frame)
 {
-  this->operation_ = operation;
+  switch (order)
+  {
+    case ByteOrderTypes::NATIVE:
+      GripperCodec<ByteOrderTypes::NATIVE>::serialize(msg, frame);
+      return true;
+    case ByteOrderTypes::SWAPPED:
+      GripperCodec<ByteOrderTypes::SWAPPED>::serialize(msg, frame);
+      return true;
+    default:
+      return false;
+  }
 }
 
-void GripperMessage::init()
+bool deserializeGripperMessage(ByteOrderType order, const boost::uint8_t *frame, GripperMessage &msg)
 {
-  this->operation_ = GripperOperationTypes::INVALID;
+  switch (order)
+  {
+    case ByteOrderTypes::NATIVE:
+      return GripperCodec<ByteOrderTypes::NATIVE>::deserialize(frame, msg);
+    case ByteOrderTypes::SWAPPED:
+      return GripperCodec<ByteOrderTypes::SWAPPED>::deserialize(frame, msg);
+    default:
+      return false;
+  }
 }
 
-bool GripperMessage::load(ByteArray *buffer)
+ByteOrderType detectByteOrder(const boost::uint8_t *frame)
 {
-  bool rtn = false;
-  LOG_COMM("Executing gripper message load");
-  if (buffer->load(this->operation_))
+  if (GripperCodec<ByteOrderTypes::NATIVE>::matches(frame))
   {
-    rtn = true;
+    return ByteOrderTypes::NATIVE;
   }
 
-  else
+  if (GripperCodec<ByteOrderTypes::SWAPPED>::matches(frame))
   {
-    rtn = false;
-    LOG_ERROR("Failed to load operation data");
+    return ByteOrderTypes::SWAPPED;
   }
-  return rtn;
+
+  return ByteOrderTypes::AUTO;
 }
 
-bool GripperMessage::unload(ByteArray *buffer)
+bool parseByteOrder(const std::string &str, ByteOrderType &order)
 {
-  bool rtn = false;
-  LOG_COMM("Executing gripper message unload");
-  shared_int op_int;
-
-  if (buffer->unload(op_int))
+  if (str == "native")
+  {
+    order = ByteOrderTypes::NATIVE;
+  }
+  else if (str == "swapped")
+  {
+    order = ByteOrderTypes::SWAPPED;
+  }
+  else if (str == "auto")
   {
-    this->operation_ = (GripperOperationType)op_int;
-    rtn = true;
+    order = ByteOrderTypes::AUTO;
   }
   else
   {
-    rtn = false;
-    LOG_ERROR("Failed to unload operation data");
+    return false;
   }
-  return rtn;
+  return true;
 }
 
 }
@@ -0,0 +1,602 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "mtconnect_grasp_action/gripper_message.h"
+#include "mtconnect_grasp_action/gripper_link.h"
+
+#include <gtest/gtest.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mtconnect_cnc_robot_example::gripper_message;
+using namespace industrial::simple_message;
+
+TEST(GripperCodec, native_round_trip)
+{
+  GripperMessage in, out;
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+
+  in.init(GripperOperationTypes::CLOSE, GripperDeviceTypes::VISE, 1234);
+  GripperCodec<ByteOrderTypes::NATIVE>::serialize(in, frame);
+  ASSERT_TRUE(GripperCodec<ByteOrderTypes::NATIVE>::deserialize(frame, out));
+
+  EXPECT_EQ(GripperOperationTypes::CLOSE, out.operation_);
+  EXPECT_EQ(GripperDeviceTypes::VISE, out.device_);
+  EXPECT_EQ(1234, out.sequence_);
+  EXPECT_EQ(CommTypes::SERVICE_REQUEST, out.comm_type_);
+}
+
+TEST(GripperCodec, swapped_is_reversed_native)
+{
+  GripperMessage msg, out;
+  boost::uint8_t native[GRIPPER_FRAME_SIZE];
+  boost::uint8_t swapped[GRIPPER_FRAME_SIZE];
+
+  msg.init(GripperOperationTypes::OPEN, GripperDeviceTypes::GRIPPER, 77);
+  GripperCodec<ByteOrderTypes::NATIVE>::serialize(msg, native);
+  GripperCodec<ByteOrderTypes::SWAPPED>::serialize(msg, swapped);
+
+  for (unsigned int i = 0; i < GRIPPER_FRAME_SIZE; i += 4)
+  {
+    for (unsigned int j = 0; j < 4; j++)
+    {
+      EXPECT_EQ(native[i + j], swapped[i + 3 - j]);
+    }
+  }
+
+  // a frame only decodes in the order it was written in
+  EXPECT_FALSE(GripperCodec<ByteOrderTypes::NATIVE>::deserialize(swapped, out));
+  ASSERT_TRUE(GripperCodec<ByteOrderTypes::SWAPPED>::deserialize(swapped, out));
+  EXPECT_EQ(77, out.sequence_);
+}
+
+TEST(GripperCodec, untagged_command_is_original_format)
+{
+  GripperMessage msg;
+  msg.init(GripperOperationTypes::CLOSE);
+  EXPECT_EQ(GripperOperationTypes::CLOSE, msg.getCommand());
+}
+
+TEST(GripperCodec, runtime_selection)
+{
+  GripperMessage msg, out;
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  msg.init(GripperOperationTypes::INIT);
+
+  ASSERT_TRUE(serializeGripperMessage(ByteOrderTypes::SWAPPED, msg, frame));
+  EXPECT_EQ(ByteOrderTypes::SWAPPED, detectByteOrder(frame));
+  EXPECT_TRUE(deserializeGripperMessage(ByteOrderTypes::SWAPPED, frame, out));
+
+  ASSERT_TRUE(serializeGripperMessage(ByteOrderTypes::NATIVE, msg, frame));
+  EXPECT_EQ(ByteOrderTypes::NATIVE, detectByteOrder(frame));
+
+  EXPECT_FALSE(serializeGripperMessage(ByteOrderTypes::AUTO, msg, frame));
+
+  frame[4] ^= 0xFF;
+  EXPECT_EQ(ByteOrderTypes::AUTO, detectByteOrder(frame));
+
+  ByteOrderType order;
+  EXPECT_TRUE(parseByteOrder("auto", order));
+  EXPECT_EQ(ByteOrderTypes::AUTO, order);
+  EXPECT_FALSE(parseByteOrder("big", order));
+}
+
+static bool equals(const GripperMessage &a, const GripperMessage &b)
+{
+  return a.operation_ == b.operation_ && a.device_ == b.device_ && a.sequence_ == b.sequence_
+      && a.comm_type_ == b.comm_type_ && a.reply_code_ == b.reply_code_;
+}
+
+// every operation, device and the sequence range survive a round trip
+template<ByteOrderType ORDER>
+static void expectRoundTrips()
+{
+  const industrial::shared_types::shared_int sequences[] = {0, 1, GRIPPER_MAX_SEQUENCE / 2, GRIPPER_MAX_SEQUENCE};
+  GripperMessage msg, out;
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+
+  for (int operation = GripperOperationTypes::INIT; operation <= GripperOperationTypes::STOP; operation++)
+  {
+    for (int device = GripperDeviceTypes::GRIPPER; device <= GripperDeviceTypes::VISE; device++)
+    {
+      for (unsigned int i = 0; i < sizeof(sequences) / sizeof(sequences[0]); i++)
+      {
+        msg.init((GripperOperationType)operation, (GripperDeviceType)device, sequences[i]);
+        GripperCodec<ORDER>::serialize(msg, frame);
+        ASSERT_TRUE(GripperCodec<ORDER>::deserialize(frame, out));
+        EXPECT_TRUE(equals(msg, out)) << "operation " << operation << ", device " << device
+            << ", sequence " << sequences[i];
+      }
+    }
+  }
+}
+
+TEST(GripperCodec, round_trip_all_commands)
+{
+  expectRoundTrips<ByteOrderTypes::NATIVE>();
+  expectRoundTrips<ByteOrderTypes::SWAPPED>();
+}
+
+TEST(GripperLinkStatistics, rtt_histogram)
+{
+  GripperLinkStatistics stats;
+  EXPECT_EQ(0, stats.rttPercentile(0.5));
+
+  for (int i = 0; i < 90; i++)
+  {
+    stats.addRtt(0.0005);
+  }
+  for (int i = 0; i < 10; i++)
+  {
+    stats.addRtt(0.3);
+  }
+
+  EXPECT_EQ(90u, stats.rtt_histogram_[0]);
+  EXPECT_EQ(10u, stats.rtt_histogram_[9]);  // 256 - 512 ms
+  EXPECT_EQ(100u, stats.rtt_count_);
+  EXPECT_DOUBLE_EQ(0.0005, stats.rtt_min_);
+  EXPECT_DOUBLE_EQ(0.3, stats.rtt_max_);
+  EXPECT_DOUBLE_EQ(1.0, stats.rttPercentile(0.5));
+  EXPECT_DOUBLE_EQ(300.0, stats.rttPercentile(0.99));
+
+  // anything beyond the last bound ends up in the last bucket
+  stats.addRtt(3600);
+  EXPECT_EQ(1u, stats.rtt_histogram_[RTT_HISTOGRAM_BUCKETS - 1]);
+}
+
+// returns a loopback port nothing listens on
+static int closedPort()
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (sockaddr*)&addr, sizeof(addr));
+  getsockname(fd, (sockaddr*)&addr, &length);
+  close(fd);
+  return ntohs(addr.sin_port);
+}
+
+static int countDescriptors()
+{
+  int count = 0;
+  DIR *dir = opendir("/proc/self/fd");
+  while (readdir(dir) != NULL)
+  {
+    count++;
+  }
+  closedir(dir);
+  return count;
+}
+
+TEST(GripperLink, reconnect_does_not_leak_sockets)
+{
+  GripperLink link;
+  link.init("127.0.0.1", closedPort());
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+  link.setReconnectDelays(0.001, 0.001);
+
+  int before = countDescriptors();
+  link.start();
+  GripperLinkStatistics stats;
+  for (int i = 0; i < 500 && stats.connect_failures_ < 50; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    link.getStatistics(stats);
+  }
+  ASSERT_GE(stats.connect_failures_, 50u);
+
+  // only the socket of the latest attempt is open
+  EXPECT_LE(countDescriptors(), before + 1);
+  link.stop();
+  EXPECT_EQ(before, countDescriptors());
+}
+
+static void recordCompletion(int *result, bool success)
+{
+  *result = success ? 1 : 0;
+}
+
+// listening loopback socket on a free port
+static int listenLoopback(int &port)
+{
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0)
+  {
+    close(listener);
+    return -1;
+  }
+  getsockname(listener, (sockaddr*)&addr, &length);
+  port = ntohs(addr.sin_port);
+  return listener;
+}
+
+// reads one request frame, returns false if the link went away
+static bool receiveRequest(int fd, GripperMessage &request)
+{
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  unsigned int received = 0;
+  while (fd >= 0 && received < GRIPPER_FRAME_SIZE)
+  {
+    int rc = recv(fd, frame + received, GRIPPER_FRAME_SIZE - received, 0);
+    if (rc <= 0)
+    {
+      return false;
+    }
+    received += rc;
+  }
+  return deserializeGripperMessage(ByteOrderTypes::NATIVE, frame, request);
+}
+
+// sends the reply to request, only the first size bytes of it
+static void sendReply(int fd, GripperMessage request, int reply_code,
+                      unsigned int size = GRIPPER_FRAME_SIZE)
+{
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  request.comm_type_ = CommTypes::SERVICE_REPLY;
+  request.reply_code_ = reply_code;
+  serializeGripperMessage(ByteOrderTypes::NATIVE, request, frame);
+  send(fd, frame, size, MSG_NOSIGNAL);
+}
+
+// controller that stalls half way through its reply
+static void stalledController(int listener)
+{
+  int fd = accept(listener, NULL, NULL);
+  GripperMessage request;
+  if (receiveRequest(fd, request))
+  {
+    sendReply(fd, request, ReplyTypes::SUCCESS, GRIPPER_FRAME_SIZE / 2);
+  }
+
+  // held open until the link gives up on the connection
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  while (recv(fd, frame, GRIPPER_FRAME_SIZE, 0) > 0)
+  {
+  }
+  close(fd);
+}
+
+TEST(GripperLink, partial_reply_drops_connection)
+{
+  int port;
+  int listener = listenLoopback(port);
+  ASSERT_GE(listener, 0);
+  boost::thread controller(boost::bind(&stalledController, listener));
+
+  GripperLink link;
+  link.init("127.0.0.1", port);
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+  link.start();
+
+  int result = -1;
+  link.post(GripperOperationTypes::CLOSE, boost::bind(&recordCompletion, &result, _1));
+
+  // the reader gives up on the frame instead of blocking on it
+  GripperLinkStatistics stats;
+  for (int i = 0; i < 300 && stats.disconnects_ == 0; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    link.getStatistics(stats);
+  }
+  EXPECT_EQ(1u, stats.disconnects_);
+  EXPECT_EQ(0u, stats.replies_received_);
+  EXPECT_EQ(-1, result);
+
+  // stop is not held up by the reader, the request still waiting fails
+  ros::WallTime start = ros::WallTime::now();
+  link.stop();
+  EXPECT_LT((ros::WallTime::now() - start).toSec(), FRAME_RECEIVE_TIMEOUT / 1000.0 + 0.5);
+  EXPECT_EQ(0, result);
+
+  controller.join();
+  close(listener);
+}
+
+// controller that reads two requests and answers them in reverse order, the gripper
+// request fails and the vise request succeeds
+static void reversingController(int listener, std::vector<GripperMessage> *requests)
+{
+  int fd = accept(listener, NULL, NULL);
+  GripperMessage first, second;
+  if (receiveRequest(fd, first) && receiveRequest(fd, second))
+  {
+    requests->push_back(first);
+    requests->push_back(second);
+    sendReply(fd, second, second.device_ == GripperDeviceTypes::VISE ? ReplyTypes::SUCCESS : ReplyTypes::FAILURE);
+    sendReply(fd, first, first.device_ == GripperDeviceTypes::VISE ? ReplyTypes::SUCCESS : ReplyTypes::FAILURE);
+  }
+
+  // held open until the link is stopped
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  recv(fd, frame, GRIPPER_FRAME_SIZE, 0);
+  close(fd);
+}
+
+TEST(GripperLink, out_of_order_replies_match_by_sequence)
+{
+  int port;
+  int listener = listenLoopback(port);
+  ASSERT_GE(listener, 0);
+  std::vector<GripperMessage> requests;
+  boost::thread controller(boost::bind(&reversingController, listener, &requests));
+
+  GripperLink link;
+  link.init("127.0.0.1", port);
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+
+  // both requests share the connection and are in flight at the same time
+  int gripper = -1, vise = -1;
+  link.post(GripperDeviceTypes::GRIPPER, GripperOperationTypes::CLOSE, boost::bind(&recordCompletion, &gripper, _1));
+  link.post(GripperDeviceTypes::VISE, GripperOperationTypes::CLOSE, boost::bind(&recordCompletion, &vise, _1));
+  link.start();
+
+  // completions run after the reply is accounted for, waiting on them instead
+  for (int i = 0; i < 200 && (gripper < 0 || vise < 0); i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  GripperLinkStatistics stats;
+  link.getStatistics(stats);
+
+  ASSERT_EQ(2u, requests.size());
+  EXPECT_EQ(GripperDeviceTypes::GRIPPER, requests[0].device_);
+  EXPECT_EQ(GripperDeviceTypes::VISE, requests[1].device_);
+  EXPECT_NE(requests[0].sequence_, requests[1].sequence_);
+
+  // the vise reply came first, each completion still got its own result
+  EXPECT_EQ(0, gripper);
+  EXPECT_EQ(1, vise);
+  EXPECT_EQ(2u, stats.replies_received_);
+  EXPECT_EQ(1u, stats.failure_replies_);
+  EXPECT_EQ(0u, stats.unmatched_replies_);
+
+  link.stop();
+  controller.join();
+  close(listener);
+}
+
+// controller that records every request and answers it with success
+static void answeringController(int listener, std::vector<GripperMessage> *requests)
+{
+  int fd = accept(listener, NULL, NULL);
+  GripperMessage request;
+  while (receiveRequest(fd, request))
+  {
+    requests->push_back(request);
+    sendReply(fd, request, ReplyTypes::SUCCESS);
+  }
+  close(fd);
+}
+
+TEST(GripperLink, cancel_queued_request_is_never_sent)
+{
+  int port;
+  int listener = listenLoopback(port);
+  ASSERT_GE(listener, 0);
+  std::vector<GripperMessage> requests;
+  boost::thread controller(boost::bind(&answeringController, listener, &requests));
+
+  GripperLink link;
+  link.init("127.0.0.1", port);
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+
+  // both are still queued, the link isn't started yet
+  int gripper = -1, vise = -1;
+  GripperLink::RequestId id = link.post(GripperDeviceTypes::GRIPPER, GripperOperationTypes::CLOSE,
+                                        boost::bind(&recordCompletion, &gripper, _1));
+  link.post(GripperDeviceTypes::VISE, GripperOperationTypes::OPEN, boost::bind(&recordCompletion, &vise, _1));
+  EXPECT_TRUE(link.cancel(id));
+  link.start();
+
+  for (int i = 0; i < 200 && vise < 0; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  GripperLinkStatistics stats;
+  link.getStatistics(stats);
+
+  EXPECT_EQ(1, vise);
+  EXPECT_EQ(-1, gripper);
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ(GripperDeviceTypes::VISE, requests[0].device_);
+  EXPECT_EQ(1u, stats.requests_sent_);
+  EXPECT_FALSE(link.cancel(id));
+
+  link.stop();
+  EXPECT_EQ(-1, gripper);
+  controller.join();
+  close(listener);
+}
+
+// controller that leaves the first request unanswered until the stop for it and the next
+// request came in, then answers the first request late
+static void interruptedController(int listener, std::vector<GripperMessage> *requests)
+{
+  int fd = accept(listener, NULL, NULL);
+  GripperMessage interrupted, stop, next;
+  if (receiveRequest(fd, interrupted) && receiveRequest(fd, stop))
+  {
+    requests->push_back(interrupted);
+    requests->push_back(stop);
+    sendReply(fd, stop, ReplyTypes::SUCCESS);
+    if (receiveRequest(fd, next))
+    {
+      requests->push_back(next);
+      sendReply(fd, interrupted, ReplyTypes::SUCCESS);
+      sendReply(fd, next, ReplyTypes::SUCCESS);
+    }
+  }
+
+  // held open until the link is stopped
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  recv(fd, frame, GRIPPER_FRAME_SIZE, 0);
+  close(fd);
+}
+
+TEST(GripperLink, cancel_outstanding_request_sends_stop)
+{
+  int port;
+  int listener = listenLoopback(port);
+  ASSERT_GE(listener, 0);
+  std::vector<GripperMessage> requests;
+  boost::thread controller(boost::bind(&interruptedController, listener, &requests));
+
+  GripperLink link;
+  link.init("127.0.0.1", port);
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+  link.setMaxOutstanding(1);
+
+  // the vise request waits for the slot held by the gripper request
+  int gripper = -1, vise = -1;
+  GripperLink::RequestId id = link.post(GripperDeviceTypes::GRIPPER, GripperOperationTypes::CLOSE,
+                                        boost::bind(&recordCompletion, &gripper, _1));
+  link.post(GripperDeviceTypes::VISE, GripperOperationTypes::CLOSE, boost::bind(&recordCompletion, &vise, _1));
+  link.start();
+
+  GripperLinkStatistics stats;
+  for (int i = 0; i < 200 && stats.requests_sent_ == 0; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    link.getStatistics(stats);
+  }
+  ASSERT_EQ(1u, stats.requests_sent_);
+  EXPECT_TRUE(link.cancel(id));
+
+  for (int i = 0; i < 200 && vise < 0; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  // the late reply to the gripper request is read before the vise reply
+  link.getStatistics(stats);
+
+  // the stop went out ahead of the queued vise request, which was admitted once the stop was answered
+  ASSERT_EQ(3u, requests.size());
+  EXPECT_EQ(GripperDeviceTypes::GRIPPER, requests[0].device_);
+  EXPECT_EQ(GripperOperationTypes::CLOSE, requests[0].operation_);
+  EXPECT_EQ(GripperDeviceTypes::GRIPPER, requests[1].device_);
+  EXPECT_EQ(GripperOperationTypes::STOP, requests[1].operation_);
+  EXPECT_EQ(GripperDeviceTypes::VISE, requests[2].device_);
+
+  // the late reply was discarded rather than delivered
+  EXPECT_EQ(1, vise);
+  EXPECT_EQ(-1, gripper);
+  EXPECT_EQ(2u, stats.replies_received_);
+  EXPECT_EQ(0u, stats.unmatched_replies_);
+  EXPECT_FALSE(link.cancel(id));
+
+  link.stop();
+  EXPECT_EQ(-1, gripper);
+  controller.join();
+  close(listener);
+}
+
+// controller that replies to the first request after a delay
+static void lateController(int listener, int delay_ms)
+{
+  int fd = accept(listener, NULL, NULL);
+  boost::uint8_t frame[GRIPPER_FRAME_SIZE];
+  unsigned int received = 0;
+  while (fd >= 0 && received < GRIPPER_FRAME_SIZE)
+  {
+    int rc = recv(fd, frame + received, GRIPPER_FRAME_SIZE - received, 0);
+    if (rc <= 0)
+    {
+      break;
+    }
+    received += rc;
+  }
+
+  GripperMessage reply;
+  if (received == GRIPPER_FRAME_SIZE && deserializeGripperMessage(ByteOrderTypes::NATIVE, frame, reply))
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(delay_ms));
+    reply.comm_type_ = CommTypes::SERVICE_REPLY;
+    reply.reply_code_ = ReplyTypes::SUCCESS;
+    serializeGripperMessage(ByteOrderTypes::NATIVE, reply, frame);
+    send(fd, frame, GRIPPER_FRAME_SIZE, MSG_NOSIGNAL);
+  }
+
+  // held open until the link is stopped
+  recv(fd, frame, GRIPPER_FRAME_SIZE, 0);
+  close(fd);
+}
+
+TEST(GripperLink, late_reply_after_timeout)
+{
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(0, bind(listener, (sockaddr*)&addr, sizeof(addr)));
+  ASSERT_EQ(0, listen(listener, 1));
+  getsockname(listener, (sockaddr*)&addr, &length);
+  boost::thread controller(boost::bind(&lateController, listener, 300));
+
+  GripperLink link;
+  link.init("127.0.0.1", ntohs(addr.sin_port));
+  link.setByteOrder(ByteOrderTypes::NATIVE);
+  link.setRequestTimeout(0.1);
+  link.start();
+
+  int result = -1;
+  link.post(GripperOperationTypes::CLOSE, boost::bind(&recordCompletion, &result, _1));
+
+  // waiting for the reply, it arrives after the request timed out
+  GripperLinkStatistics stats;
+  for (int i = 0; i < 200 && stats.bytes_in_ < GRIPPER_FRAME_SIZE; i++)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    link.getStatistics(stats);
+  }
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  link.getStatistics(stats);
+
+  EXPECT_EQ(0, result);
+  EXPECT_EQ(1u, stats.timeouts_);
+  EXPECT_EQ(GRIPPER_FRAME_SIZE, stats.bytes_in_);
+  EXPECT_EQ(0u, stats.unmatched_replies_);
+  EXPECT_EQ(0u, stats.replies_received_);
+  EXPECT_EQ("request timed out", stats.last_error_);
+
+  link.stop();
+  controller.join();
+  close(listener);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef CYCLE_PREDICTOR_H_
+#define CYCLE_PREDICTOR_H_
+
+#include <boost/thread/mutex.hpp>
+
+#include <mtconnect_state_machine/stream_client.h>
+
+namespace mtconnect_state_machine
+{
+
+static const double CYCLE_TIME_FILTER = 0.3; // weight of the newest cycle
+
+/**
+ * \brief Predicts when the CNC finishes its current program.
+ *
+ * Follows the controller execution state, a program runs from ACTIVE until it completes
+ * (PROGRAM_COMPLETED, or READY straight from ACTIVE) and its duration updates a filtered
+ * cycle time.  The remaining time is extrapolated from the reported program progress when
+ * there is one, otherwise from the cycle time.  While the program is interrupted or held
+ * there is no prediction, the held time doesn't count towards the cycle.  Updates come from
+ * the agent stream thread, times are in seconds (i.e. ros::Time::toSec()).
+ */
+class CyclePredictor
+{
+public:
+  CyclePredictor();
+
+  void setExecution(ExecutionState state, double now);
+
+  /**
+   * \brief Program progress of the running cycle, 0 to 1 (ignored while not running)
+   */
+  void setProgress(double progress, double now);
+
+  /**
+   * \brief Predicted time until the program completes, negative if overdue
+   *
+   * \return false if no program is running or the remaining time is unknown
+   */
+  bool getRemaining(double now, double &remaining);
+
+  /**
+   * \brief Filtered program duration (zero until a cycle completed)
+   */
+  double getCycleTime();
+
+  bool isRunning();
+
+  /**
+   * \brief True from the completion of a program until the next one starts (not if it was stopped)
+   */
+  bool isCompleted();
+
+  /**
+   * \brief Number of programs that started (used to stage once per cycle)
+   */
+  unsigned int getCycleCount();
+
+protected:
+  boost::mutex mutex_;
+  bool running_;
+  bool held_;
+  bool completed_;
+  double start_;
+  double held_start_;
+  double progress_;
+  double progress_stamp_;
+  double cycle_time_;
+  unsigned int cycles_;
+};
+
+}
+
+#endif /* CYCLE_PREDICTOR_H_ */
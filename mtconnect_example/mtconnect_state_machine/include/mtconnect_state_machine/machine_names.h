@@ -0,0 +1,86 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef MACHINE_NAMES_H_
+#define MACHINE_NAMES_H_
+
+#include <string>
+#include <vector>
+
+namespace mtconnect_state_machine
+{
+
+/**
+ * \brief Names of the tended machines and of their actions and task paths.
+ *
+ * In multi-machine mode every machine lives in its own namespace (i.e. cnc1/cnc_open_door_action)
+ * and may override any task path with a path of the same name in that namespace
+ * (i.e. cnc1/JM_HOME_TO_DOOR).  A single machine has an empty name and uses the global names.
+ */
+class MachineNames
+{
+public:
+  void add(const std::string &name);
+
+  void clear();
+
+  size_t size() const
+  {
+    return names_.size();
+  }
+
+  const std::string &getName(size_t machine) const
+  {
+    return names_[machine];
+  }
+
+  /**
+   * \brief Name of a machine's action (i.e. cnc1/material_load_action), absolute names
+   * stay absolute (i.e. /cnc1/MaterialLoad/set_mtconnect_state)
+   */
+  std::string getAction(size_t machine, const std::string &action) const;
+
+  /**
+   * \brief Splits a name returned by getAction, action is one of actions
+   *
+   * \return false if the name doesn't belong to any machine
+   */
+  bool findAction(const std::string &name, const std::vector<std::string> &actions, size_t &machine,
+                  std::string &action) const;
+
+  /**
+   * \brief Task path of a machine, the global path if the machine doesn't override it
+   *
+   * \param paths task paths by name (i.e. a std::map or std::set)
+   */
+  template<typename Paths>
+  std::string getPath(size_t machine, const std::string &path, const Paths &paths) const
+  {
+    std::string machine_path = getAction(machine, path);
+    if (paths.find(machine_path) != paths.end())
+    {
+      return machine_path;
+    }
+    return path;
+  }
+
+protected:
+  std::vector<std::string> names_;
+};
+
+} //mtconnect_state_machine
+
+#endif /* MACHINE_NAMES_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef RECOVERY_PLANNER_H_
+#define RECOVERY_PLANNER_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace mtconnect_state_machine
+{
+
+/**
+ * \brief Enumeration of the directions a path may be followed in during recovery
+ */
+namespace PathDirections
+{
+enum PathDirection
+{
+  BOTH = 0, FORWARD, REVERSE, NONE // none marks the whole path unsafe
+};
+}
+typedef PathDirections::PathDirection PathDirection;
+
+/**
+ * \brief Route from the current robot position back to home along a task path
+ */
+struct RecoveryPlan
+{
+  RecoveryPlan() : waypoint_(0), reverse_(false), distance_(0.0), length_(0.0) {}
+
+  std::string path_;     // task path the robot was found on
+  size_t waypoint_;      // nearest waypoint of that path
+  bool reverse_;         // true if the path is retraced back towards its start
+  double distance_;      // distance to the nearest waypoint
+  double length_;        // length of the route
+  std::vector<std::string> paths_;           // every path the route follows, in order
+  std::vector<std::vector<double> > points_; // current position, nearest waypoint, ... home
+};
+
+/**
+ * \brief Plans the recovery of a robot that stopped somewhere along a task path.
+ *
+ * The waypoints of every path are kept in one contiguous table (one row per waypoint), the
+ * nearest waypoint to the current position is found in a single pass over it.  The paths
+ * form a graph: neighbouring waypoints of a path are connected both ways and waypoints shared
+ * by several paths (the end of one path is usually the start of the next) join them.  The
+ * shortest route from the nearest waypoint to any waypoint at home is taken, so a robot
+ * stopped on a path that doesn't pass through home is brought back over the paths leading
+ * to it.  Paths are only ever retraced, the robot never moves through space the task doesn't
+ * already use, except for the move onto the nearest waypoint which must be within the max
+ * distance.  Distances are the largest joint deviation (radians), as in the home check.
+ * What the robot carries can make a path unsafe in one or both directions (i.e. a part in the
+ * gripper must not be pushed into the chuck), the route never follows a path against its
+ * allowed direction.
+ */
+class RecoveryPlanner
+{
+public:
+  RecoveryPlanner();
+
+  /**
+   * \param home home position, in path joint order
+   * \param tolerance largest joint deviation of a waypoint considered at home
+   */
+  void setHome(const std::vector<double> &home, double tolerance);
+
+  /**
+   * \brief Adds a task path, all paths share the joint order of home
+   *
+   * \return false if a waypoint doesn't have one value per joint
+   */
+  bool addPath(const std::string &name, const std::vector<std::vector<double> > &points);
+
+  void clear();
+
+  /**
+   * \brief Restricts the direction a path may be followed in, paths are added as BOTH
+   *
+   * \return false if there is no such path
+   */
+  bool setDirection(const std::string &name, PathDirection direction);
+
+  /**
+   * \brief Allows every path in both directions again
+   */
+  void resetDirections();
+
+  size_t getWaypointCount() const
+  {
+    return names_.size();
+  }
+
+  /**
+   * \brief Plans the route home from the current position
+   *
+   * \param max_distance largest distance to the nearest waypoint the robot may move directly
+   * \return false if no waypoint is close enough or no allowed route from it reaches home
+   */
+  bool plan(const std::vector<double> &position, double max_distance, RecoveryPlan &plan) const;
+
+  /**
+   * \brief Largest joint deviation between two positions
+   */
+  static double distance(const double *a, const double *b, size_t joints);
+
+protected:
+  /**
+   * \brief Fills the plan from the waypoints of a route, nearest waypoint first
+   */
+  void describe(const std::vector<size_t> &route, RecoveryPlan &plan) const;
+
+  /**
+   * \brief True if b follows a on the same path (either direction)
+   */
+  bool isNeighbour(size_t a, size_t b) const;
+
+  bool isHome(size_t waypoint) const;
+
+  /**
+   * \brief True if the path of a allows the move to its neighbour b
+   */
+  bool isAllowed(size_t a, size_t b) const;
+
+  size_t joints_;
+  std::vector<double> home_;
+  double tolerance_;
+
+  // one row of joint values per waypoint, paths are stored one after the other
+  std::vector<double> table_;
+  std::vector<std::string> names_;    // path of every waypoint
+  std::vector<size_t> first_;         // first waypoint of the path of every waypoint
+  std::vector<size_t> last_;          // last waypoint of the path of every waypoint
+  std::vector<PathDirection> directions_; // allowed direction of the path of every waypoint
+  std::vector<std::vector<size_t> > shared_; // waypoints of other paths at the same position
+};
+
+}
+
+#endif /* RECOVERY_PLANNER_H_ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef SHDR_ADAPTER_H_
+#define SHDR_ADAPTER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace mtconnect_state_machine
+{
+
+static const int DEFAULT_HEARTBEAT_INTERVAL = 10000; // milliseconds (same as mtconnect_adapter.py)
+
+/**
+ * \brief Embeddable MTConnect SHDR adapter.
+ *
+ * Serves the same protocol as the python mtconnect_adapter (which the ros bridge runs in a
+ * separate process) so that a host can feed the agent directly.  Data items are set by the
+ * host and sent by flush(), all items that changed since the last flush go out on a single
+ * line.  Agents connecting later receive every item.  Agents are served with TCP_NODELAY and
+ * their "* PING" heartbeats are answered from an internal thread.
+ *
+ * Sends never block the host, an agent that can't keep up is disconnected (it reconnects and
+ * gets the full state again).
+ */
+class ShdrAdapter
+{
+public:
+
+  ShdrAdapter();
+
+  ~ShdrAdapter();
+
+  /**
+   * \brief Starts listening for agents
+   *
+   * \param port TCP port the agent is configured to connect to
+   * \param heartbeat_interval (ms) advertised in the PONG replies
+   * \return true on success, false otherwise.
+   */
+  bool start(int port, int heartbeat_interval = DEFAULT_HEARTBEAT_INTERVAL);
+
+  void stop();
+
+  /**
+   * \brief Sets a data item value, it is sent on the next flush if it changed
+   */
+  void setValue(const std::string &key, const std::string &value);
+
+  /**
+   * \brief Sends all changed data items on one line
+   *
+   * \return number of items sent
+   */
+  int flush();
+
+  int getClientCount();
+
+  /**
+   * \brief Formats a SHDR line from a timestamp and key/value pairs
+   */
+  static std::string formatLine(const std::string &timestamp,
+                                const std::vector<std::pair<std::string, std::string> > &items);
+
+  /**
+   * \brief Returns the current UTC time as used in SHDR lines (ISO 8601, microseconds)
+   */
+  static std::string timestamp();
+
+protected:
+
+  struct DataItem
+  {
+    DataItem() : changed_(false) {}
+
+    std::string value_;
+    bool changed_;
+  };
+
+  /**
+   * \brief Accepts agents and answers their heartbeats
+   */
+  void serviceLoop();
+
+  /**
+   * \brief Sends a complete line to a client without blocking, expects the lock to be held
+   */
+  bool sendLine(int fd, const std::string &line);
+
+  /**
+   * \brief Answers the pings read from a client, returns false if it disconnected
+   */
+  bool readClient(int fd);
+
+  void closeClient(int fd);
+
+protected:
+
+  int listen_fd_;
+  int heartbeat_interval_;
+  bool running_;
+  boost::thread thread_;
+  boost::mutex mutex_;
+  std::vector<int> clients_;
+  std::map<std::string, DataItem> items_;  // ordered by key so that lines are reproducible
+};
+
+}
+
+#endif /* SHDR_ADAPTER_H_ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef STAGING_PLANNER_H_
+#define STAGING_PLANNER_H_
+
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+
+#include <mtconnect_state_machine/cycle_predictor.h>
+#include <mtconnect_state_machine/state_types.h>
+
+namespace mtconnect_state_machine
+{
+
+static const double DEFAULT_STAGING_TIMEOUT = 30.0; // seconds
+static const double DEFAULT_STREAM_STALE_TIMEOUT = 30.0; // seconds without an agent document
+
+/**
+ * \brief Decides when the robot stages in front of the door and how long it stays there.
+ *
+ * Staging is due when the cnc program is predicted to finish within the lead time, once per
+ * program and only while no material request waits.  The robot stays at the staging point
+ * until the unload request, for up to the staging timeout past the predicted program end.  A
+ * held, stopped or overdue program sends it home, as does a stale agent stream: the prediction
+ * is only as good as the stream, if no document (not even a heartbeat) arrived within the
+ * stale timeout the agent is considered gone.  Without any document staging is never due.
+ * Stream updates come from the agent stream thread, times are in seconds (i.e.
+ * ros::Time::toSec()).
+ */
+class StagingPlanner
+{
+public:
+  StagingPlanner();
+
+  /**
+   * \param lead staging lead time, zero disables staging
+   */
+  void setLead(double lead);
+
+  double getLead() const;
+
+  bool isEnabled() const
+  {
+    return getLead() > 0.0;
+  }
+
+  void setTimeout(double timeout);
+
+  double getTimeout() const;
+
+  void setStaleTimeout(double stale_timeout);
+
+  /**
+   * \brief Records a document received from the agent stream
+   */
+  void setStreamStamp(double now);
+
+  /**
+   * \brief True if no document was received yet or none within the stale timeout
+   */
+  bool isStreamStale(double now) const;
+
+  /**
+   * \brief Checks if staging is due, a due staging is recorded against the running program
+   *
+   * \param queue_empty no material request waits
+   * \param remaining predicted time until the program ends (if due)
+   */
+  bool isDue(CyclePredictor &predictor, bool queue_empty, double now, double &remaining);
+
+  /**
+   * \brief Next state at the staging point (MS_STAGED)
+   *
+   * \param unload_accepted the unload request of the staged machine was accepted
+   * \param reason why the robot returns home (if it does)
+   */
+  StateType poll(CyclePredictor &predictor, bool unload_accepted, double now, std::string &reason);
+
+  /**
+   * \brief Move started in a staging move state and the state that waits for it
+   *
+   * \return false if state isn't a staging move state
+   */
+  static bool getMove(StateType state, std::string &path, StateType &wait);
+
+  /**
+   * \brief State after the move of a staging wait state is done
+   */
+  static StateType getMoveDone(StateType wait);
+
+protected:
+  mutable boost::mutex mutex_;
+  double lead_;
+  double timeout_;
+  double stale_timeout_;
+  bool stream_seen_;
+  double stream_stamp_;
+  unsigned int staged_cycle_;
+  double deadline_;
+};
+
+} //mtconnect_state_machine
+
+#endif /* STAGING_PLANNER_H_ */
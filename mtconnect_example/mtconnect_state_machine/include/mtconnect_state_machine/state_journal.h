@@ -0,0 +1,140 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef STATE_JOURNAL_H_
+#define STATE_JOURNAL_H_
+
+#include <string>
+#include <map>
+#include <boost/assign/list_of.hpp>
+#include <boost/cstdint.hpp>
+
+namespace mtconnect_state_machine
+{
+
+static const size_t DEFAULT_JOURNAL_CAPACITY = 1024; // records
+
+/**
+ * \brief Enumeration of part locations (as far as the robot knows)
+ */
+namespace MaterialLocations
+{
+enum MaterialLocation
+{
+  UNKNOWN = 0, NONE, GRIPPER, CHUCK
+};
+
+static std::map<int, std::string> LOCATION_MAP =
+    boost::assign::map_list_of(UNKNOWN, "UNKNOWN")(NONE, "NONE")(GRIPPER, "GRIPPER")(CHUCK, "CHUCK");
+}
+typedef MaterialLocations::MaterialLocation MaterialLocation;
+
+/**
+ * \brief Enumeration of material goals the state machine may be executing
+ */
+namespace JournalGoals
+{
+enum JournalGoal
+{
+  NONE = 0, MATERIAL_LOAD, MATERIAL_UNLOAD
+};
+}
+typedef JournalGoals::JournalGoal JournalGoal;
+
+/**
+ * \brief What the journal records on every state transition
+ */
+struct JournalEntry
+{
+  JournalEntry() : state_(0), material_(MaterialLocations::UNKNOWN), goal_(JournalGoals::NONE), machine_(0),
+      stamp_(0.0) {}
+
+  boost::int32_t state_;
+  boost::int32_t material_;
+  boost::int32_t goal_;
+  boost::int32_t machine_;
+  double stamp_;
+};
+
+/**
+ * \brief Crash consistent journal of state machine transitions.
+ *
+ * The journal is a fixed size file mapped into memory, records are appended in a ring (the
+ * oldest record is overwritten once it is full) and carry a sequence number and a checksum.
+ * An append is a copy into the mapping and an asynchronous flush, the file is consistent as
+ * soon as the copy completes, even if the process dies right after.  A record that was only
+ * partially written fails its checksum and is ignored, the last complete record is replayed.
+ */
+class StateJournal
+{
+public:
+  StateJournal();
+
+  ~StateJournal();
+
+  /**
+   * \brief Opens (or creates) the journal, an existing journal is kept if its layout matches
+   *
+   * \return false if the file can't be created or mapped
+   */
+  bool open(const std::string &path, size_t capacity = DEFAULT_JOURNAL_CAPACITY);
+
+  void close();
+
+  bool isOpen() const
+  {
+    return records_ != NULL;
+  }
+
+  /**
+   * \brief Appends an entry, returns false if the journal isn't open
+   */
+  bool append(const JournalEntry &entry);
+
+  /**
+   * \brief Last complete entry written before the journal was opened
+   *
+   * \return false if the journal was empty
+   */
+  bool replay(JournalEntry &entry) const;
+
+  /**
+   * \brief Sequence number of the last entry (zero if none)
+   */
+  boost::uint32_t getSequence() const
+  {
+    return sequence_;
+  }
+
+protected:
+  struct Header;
+  struct Record;
+
+  static boost::uint32_t checksum(const Record &record);
+
+  int fd_;
+  void *map_;
+  size_t map_size_;
+  Record *records_;
+  size_t capacity_;
+  boost::uint32_t sequence_;
+  bool replayed_;
+  JournalEntry last_;
+};
+
+}
+
+#endif /* STATE_JOURNAL_H_ */
@@ -23,8 +23,12 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/assign/list_inserter.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <actionlib/client/simple_action_client.h>
 #include <actionlib/server/simple_action_server.h>
 
@@ -45,6 +49,7 @@
 
 #include <mtconnect_example_msgs/StateMachineCmd.h>
 #include <mtconnect_example_msgs/StateMachineStatus.h>
+#include <mtconnect_example_msgs/MaterialQueueStatus.h>
 
 #include <mtconnect_msgs/SetMTConnectState.h>
 
@@ -52,113 +57,21 @@
 
 #include <industrial_msgs/RobotStatus.h>
 
-namespace mtconnect_state_machine
-{
+#include <mtconnect_state_machine/shdr_adapter.h>
+#include <mtconnect_state_machine/stream_client.h>
+#include <mtconnect_example_utils/discovery_manager.h>
+#include <mtconnect_example_utils/material_request_queue.h>
+#include <mtconnect_state_machine/cycle_predictor.h>
+#include <mtconnect_state_machine/recovery_planner.h>
+#include <mtconnect_state_machine/state_journal.h>
+#include <mtconnect_state_machine/state_types.h>
+#include <mtconnect_state_machine/swap_cycle.h>
+#include <mtconnect_state_machine/machine_names.h>
+#include <mtconnect_state_machine/staging_planner.h>
+#include <mtconnect_example_utils/action_monitor.h>
 
-/**
- * \brief Enumeration of state machine states
- */
-namespace StateTypes
-{
-enum StateType
+namespace mtconnect_state_machine
 {
-  INVALID = 0, IDLE = 1,
-
-  INITING = 100,
-  CHECK_HOME, WAIT_FOR_ACTIONS, WAIT_FOR_SERVICES, SET_MAT_ACTIONS_READY,
-
-  CYCLE_BEGIN = 2000,
-  WAITING = 2001,
-  MATERIAL_LOADING = 2100,
-  ML_MOVE_PICK_APPROACH, ML_WAIT_MOVE_PICK_APPROACH, ML_MOVE_PICK,
-  ML_WAIT_MOVE_PICK, ML_PICK, ML_WAIT_PICK, ML_MOVE_CHUCK, ML_WAIT_MOVE_CHUCK,
-  ML_CLOSE_CHUCK, ML_WAIT_CLOSE_CHUCK, ML_RELEASE_PART, ML_WAIT_RELEASE_PART,
-  ML_MOVE_DOOR, ML_WAIT_MOVE_DOOR, ML_MOVE_HOME, ML_WAIT_MOVE_HOME,
-  MATERIAL_LOADED = 2199,
-
-
-  MATERIAL_UNLOADING = 2200,
-  MU_MOVE_DOOR, MU_WAIT_MOVE_DOOR, MU_MOVE_CHUCK, MU_WAIT_MOVE_CHUCK, MU_PICK_PART, MU_WAIT_PICK_PART,
-  MU_OPEN_CHUCK, MU_WAIT_OPEN_CHUCK, MU_MOVE_DROP, MU_WAIT_MOVE_DROP, MU_DROP, MU_WAIT_DROP,
-  MU_MOVE_HOME, MU_WAIT_MOVE_HOME,
-  MATERIAL_UNLOADED = 2299,
-  CYCLE_END = 2999,
-
-  STOPPING = 300,
-  S_SET_MAT_ACTIONS_NOT_READY,
-  STOPPED = 299,
-
-  ABORTING = 500,
-  ABORT_GOALS, CANCEL_REQUESTS,
-  ABORTED = 599,
-
-  RESETTING = 700,
-  R_WAIT_FOR_HOME, R_SET_MAT_ACTIONS_NOT_READY,
-  RESET = 799,
-
-};
-/**
- * \brief Map of states to state strings
- */
-static std::map<int, std::string> STATE_MAP =
-    boost::assign::map_list_of(INVALID, "INVALID")(IDLE, "IDLE")
-    (INITING, "INITING")
-    (CHECK_HOME, "CHECK_HOME")
-    (WAIT_FOR_ACTIONS, "WAIT_FOR_ACTIONS")
-    (WAIT_FOR_SERVICES, "WAIT_FOR_SERVICES")
-    (SET_MAT_ACTIONS_READY,"SET_MAT_ACTIONS_READY")
-    (WAITING, "WAITING")
-
-    (MATERIAL_LOADING, "MATERIAL_LOADING")
-    (ML_MOVE_PICK_APPROACH,"ML_MOVE_PICK_APPROACH")
-    (ML_WAIT_MOVE_PICK_APPROACH,"ML_WAIT_MOVE_PICK_APPROACH")
-    (ML_MOVE_PICK,"ML_MOVE_PICK")
-    (ML_WAIT_MOVE_PICK,"ML_WAIT_MOVE_PICK")
-    (ML_PICK,"ML_PICK")
-    (ML_WAIT_PICK,"ML_WAIT_PICK")
-    (ML_MOVE_CHUCK,"ML_MOVE_CHUCK")
-    (ML_WAIT_MOVE_CHUCK,"ML_WAIT_MOVE_CHUCK")
-    (ML_CLOSE_CHUCK,"ML_CLOSE_CHUCK")
-    (ML_WAIT_CLOSE_CHUCK, "ML_WAIT_CLOSE_CHUCK")
-    (ML_RELEASE_PART, "ML_RELEASE_PART")
-    (ML_WAIT_RELEASE_PART, "ML_WAIT_RELEASE_PART")
-    (ML_MOVE_DOOR, "ML_MOVE_DOOR")
-    (ML_WAIT_MOVE_DOOR, "ML_WAIT_MOVE_DOOR")
-    (ML_MOVE_HOME, "ML_MOVE_HOME")
-    (ML_WAIT_MOVE_HOME, "ML_WAIT_MOVE_HOME")
-    (MATERIAL_LOADED, "MATERIAL_LOADED")
-
-    (MATERIAL_UNLOADING, "MATERIAL_UNLOADING")
-    (MU_MOVE_DOOR, "MU_MOVE_DOOR")
-    (MU_WAIT_MOVE_DOOR, "MU_WAIT_MOVE_DOOR")
-    (MU_MOVE_CHUCK, "MU_MOVE_CHUCK")
-    (MU_WAIT_MOVE_CHUCK, "MU_WAIT_MOVE_CHUCK")
-    (MU_PICK_PART, "MU_PICK_PART")
-    (MU_WAIT_PICK_PART, "MU_WAIT_PICK_PART")
-    (MU_OPEN_CHUCK, "MU_OPEN_CHUCK")
-    (MU_WAIT_OPEN_CHUCK, "MU_WAIT_OPEN_CHUCK")
-    (MU_MOVE_DROP, "MU_MOVE_DROP")
-    (MU_WAIT_MOVE_DROP, "MU_WAIT_MOVE_DROP")
-    (MU_DROP, "MU_DROP")
-    (MU_WAIT_DROP, "MU_WAIT_DROP")
-    (MU_MOVE_HOME, "MU_MOVE_HOME")
-    (MU_WAIT_MOVE_HOME, "MU_WAIT_MOVE_HOME")
-    (MATERIAL_UNLOADED, "MATERIAL_UNLOADED")
-
-    (STOPPING, "STOPPING")
-    (S_SET_MAT_ACTIONS_NOT_READY, "S_SET_MAT_ACTIONS_NOT_READY")
-    (STOPPED, "STOPPED")
-
-    (ABORTING, "ABORTING")
-    (ABORT_GOALS, "ABORT_GOALS")(CANCEL_REQUESTS, "CANCEL_REQUESTS")
-    (ABORTED, "ABORTED")
-
-    (RESETTING, "RESETTING")
-    (R_WAIT_FOR_HOME, "R_WAIT_FOR_HOME")(R_SET_MAT_ACTIONS_NOT_READY, "SET_MAT_ACTIONS_NOT_READY")
-    (RESET, "RESETED");
-
-}
-typedef StateTypes::StateType StateType;
 
 // Typedefs
 typedef actionlib::SimpleActionClient<mtconnect_msgs::OpenDoorAction> CncOpenDoorClient;
@@ -179,16 +92,34 @@ typedef boost::shared_ptr<MaterialUnloadServer> MaterialUnloadServerPtr;
 typedef boost::shared_ptr<GraspActionClient> GraspActionClientPtr;
 typedef boost::shared_ptr<JointTractoryClient> JointTractoryClientPtr;
 
+/**
+ * \brief Action clients, servers and services of one tended CNC, resolved in the namespace of
+ * the machine (see MachineNames)
+ */
+struct CncMachine
+{
+  CncOpenDoorClientPtr open_door_client_ptr_;
+  CncCloseDoorClientPtr close_door_client_ptr_;
+  CncOpenChuckClientPtr open_chuck_client_ptr_;
+  CncCloseChuckClientPtr close_chuck_client_ptr_;
+  MaterialLoadServerPtr material_load_server_ptr_;
+  MaterialUnloadServerPtr material_unload_server_ptr_;
+  ros::ServiceClient material_load_set_state_client_;
+  ros::ServiceClient material_unload_set_state_client_;
+};
+typedef boost::shared_ptr<CncMachine> CncMachinePtr;
+
 class StateMachine
 {
 public:
 
 ///////General state
   /**
-   * \brief Default constructor (must call init function)
+   * \brief Constructor (must call init function), topics, actions and services are resolved in
+   * nh and the parameters are read from ph (i.e. the node handles of a nodelet)
    *
    */
-  StateMachine();
+  StateMachine(const ros::NodeHandle &nh = ros::NodeHandle(), const ros::NodeHandle &ph = ros::NodeHandle("~"));
 
   /**
    * \brief Deconstructor
@@ -206,7 +137,9 @@ public:
   /**
    * \brief Execute state machine (blocks permanently)
    *
-   * Executes the state machine.  Handles all transitions
+   * Executes the state machine.  Handles all transitions.  Sensor topics, action client feedback
+   * and external commands are served by a spinner thread each while running, the material
+   * action servers are served by the state machine loop (global queue).
    *
    */
   void run();
@@ -227,6 +160,7 @@ protected:
     ROS_INFO_STREAM("Changing state from: " << StateTypes::STATE_MAP[state_] << "(" << state_ << ")"
     " to " << StateTypes::STATE_MAP[state] << "(" << state << ")");
     state_ = state;
+    journalState();
   }
   ;
 
@@ -237,35 +171,77 @@ protected:
   ;
 
 //////MTConnect specific
+  /**
+   * \brief Callback queues of the state loop (material goals), the sensor topics, the action
+   * clients and the external commands
+   *
+   */
+  ros::CallbackQueue state_queue_;
+  ros::CallbackQueue sensor_queue_;
+  ros::CallbackQueue action_queue_;
+  ros::CallbackQueue command_queue_;
+
   /**
    * \brief Internal node handle
    *
    */
   ros::NodeHandle nh_;
+  ros::NodeHandle sensor_nh_;
+  ros::NodeHandle action_nh_;
+  ros::NodeHandle command_nh_;
+  ros::NodeHandle ph_;
+
+  /**
+   * \brief Held by the state machine loop and the external commands, both change the state
+   *
+   */
+  boost::mutex state_mutex_;
 
 // Callbacks
-  void materialLoadGoalCB(/*const MaterialLoadServer::GoalConstPtr &gh*/);
-  void materialUnloadGoalCB(/*const MaterialUnloadServer::GoalConstPtr &gh*/);
+  void materialLoadGoalCB(size_t machine);
+  void materialUnloadGoalCB(size_t machine);
   void robotStatusCB(const industrial_msgs::RobotStatusConstPtr &msg);
   void jointStatesCB(const sensor_msgs::JointStateConstPtr &msg);
+
+  /**
+   * \brief Door and chuck state from the agent stream (called from the stream client thread)
+   */
+  void doorStateCB(const std::string &name, CncState state);
+  void chuckStateCB(const std::string &name, CncState state);
+
+  /**
+   * \brief Controller execution and program progress from the agent stream (stream client thread)
+   */
+  void executionCB(const std::string &name, ExecutionState state);
+  void programProgressCB(const Observation &observation);
+  void streamDocumentCB();
   bool externalCommandCB(mtconnect_example_msgs::StateMachineCmd::Request &req,
                          mtconnect_example_msgs::StateMachineCmd::Response &res);
   /**
-   * \brief Checks remote action servers to see if they are ready
+   * \brief Checks remote action servers and services to see if they are ready (see DiscoveryManager)
    *
-   * \return true if all ready, otherwise false
+   * \return true if all ready, or if the discovery timeout expired with the required subsystems
+   * present (degraded mode), otherwise false
    *
    */
   bool areActionsReady();
 
   /**
-   * \brief Checks remote services to see if they are ready
+   * \brief Checks the services required to report material handling states
    *
    * \return true if all ready, otherwise false
    *
    */
   bool areServicesReady();
 
+  /**
+   * \brief Leaves degraded mode once every subsystem was found
+   *
+   * \return true if in degraded mode (some subsystems missing)
+   *
+   */
+  bool isDegraded();
+
   /**
    * \brief Aborts any server with active client requests
    *
@@ -278,6 +254,61 @@ protected:
    */
   void cancelActionClients();
 
+  /**
+   * \brief Makes a machine the target of the door, chuck and material actions
+   *
+   */
+  void selectMachine(size_t machine);
+
+  /**
+   * \brief Name of a machine's action (i.e. cnc1/material_load_action), used as the queue key
+   *
+   */
+  std::string getMachineAction(size_t machine, const std::string &action);
+
+  /**
+   * \brief Splits a name returned by getMachineAction
+   *
+   * \return false if the name doesn't belong to any machine
+   *
+   */
+  bool findMachineAction(const std::string &name, size_t &machine, std::string &action);
+
+  /**
+   * \brief Task path of the active machine, the global path if the machine doesn't override it
+   *
+   */
+  std::string getMachinePath(const std::string &path);
+
+  /**
+   * \brief Queues a material request that arrived while the robot was busy
+   *
+   * \return false if the request can't be queued (queue full or disabled)
+   *
+   */
+  bool queueMaterialRequest(const std::string &name);
+
+  /**
+   * \brief Accepts the next queued material request (highest priority first)
+   *
+   * \return true if a request was accepted and the state changed
+   *
+   */
+  bool admitMaterialRequest();
+
+  /**
+   * \brief Aborts the queued material requests (goals still pending in the servers)
+   *
+   */
+  void abortMaterialRequests();
+
+  /**
+   * \brief Checks if the cnc program is predicted to finish within the staging lead
+   * (once per program)
+   *
+   */
+  bool isStagingDue();
+
   /**
    * \brief Checks remote services to see if they are ready
    *
@@ -309,10 +340,38 @@ protected:
   void robotStatusPublisher();
   void robotSpindlePublisher();
   void stateMachineStatusPublisher();
+  void materialQueuePublisher();
+
+  /**
+   * \brief Sends the robot state and spindle data items straight to the agent (low latency mode)
+   *
+   */
+  void shdrAdapterPublisher();
 
   // Action wrappers
 
-  bool isActionComplete(int action_state);
+  /**
+   * \brief Checks an action goal, a goal that runs past its deadline (see ActionMonitor) is
+   * reported as a stall fault and the state machine aborts
+   *
+   */
+  bool isActionComplete(const std::string &action, int action_state);
+
+  /**
+   * \brief Sends an action goal timed by the action monitor, the latency is recorded from the
+   * goal's done callback whether or not the state machine polls the action
+   *
+   */
+  template<class Client, class Goal>
+  void sendGoal(const std::string &action, const boost::shared_ptr<Client> &client, const Goal &goal)
+  {
+    double start = ros::Time::now().toSec();
+    action_monitor_.start(action, start);
+    action_cancels_[action] = boost::bind(&Client::cancelGoal, client);
+    client->sendGoal(goal, boost::bind(&StateMachine::actionDoneCB, this, action, start, _1));
+  }
+  void actionDoneCB(const std::string &action, double start, const actionlib::SimpleClientGoalState &state);
+  void setFault(int fault, const std::string &action, double elapsed, double deadline);
   bool moveArm(const std::string & move_name);
   bool isMoveDone();
 
@@ -340,6 +399,33 @@ protected:
   // Home checking
   bool isHome();
 
+  /**
+   * \brief Plans the move home from the current position along the task paths (see RecoveryPlanner),
+   * the route is stored as the recovery path
+   *
+   * The paths are restricted by what the robot carries and the cnc state first: a part in the
+   * gripper is only carried away from the chuck and the pick station and the paths inside the
+   * machine are unsafe while the door is closed.
+   *
+   * \return false if the robot isn't close enough to any task path, no allowed route gets it home
+   * or the part may be held by both the gripper and the chuck
+   */
+  bool planRecovery();
+
+  /**
+   * \brief Records the state, part location and active material goal (if the journal is open)
+   *
+   */
+  void journalState();
+
+  /**
+   * \brief Restores the part location from the journal and picks the start state
+   *
+   * \return start state, ABORTED if the node restarted mid-cycle or the part location
+   * contradicts the material_state parameter, IDLE otherwise
+   */
+  StateType replayJournal();
+
 private:
 
 ///////General state
@@ -383,16 +469,54 @@ private:
      *
      */
   int material_load_state_;
+
+  /**
+   * \brief swap cycle, after an unload the robot waits at the drop for the next load request
+   * and goes straight to the pick (no home transit, the door stays open)
+   *
+   */
+  SwapCycle swap_;
+
+  /**
+   * \brief predictive staging, the robot moves to the staging point in front of the door when
+   * the cnc program is predicted to finish within the staging lead
+   *
+   */
+  StagingPlanner staging_;
 //////MTConnect specific
 
   std::map<std::string, trajectory_msgs::JointTrajectoryPtr> joint_paths_;
   boost::shared_ptr<mtconnect::JointPoint> home_;
 
-// action servers
+// fault recovery along the task paths, the largest move onto a path (radians, zero disables)
+  RecoveryPlanner recovery_planner_;
+  double recovery_distance_;
+  bool gripper_closed_; // last commanded, the grasp action doesn't report the gripper state
+
+// action deadlines and the last fault (reported in the status message until reset)
+  mtconnect_example_utils::ActionMonitor action_monitor_;
+  std::map<std::string, boost::function<void()> > action_cancels_;
+  std::string move_action_;
+  int fault_;
+  std::string fault_action_;
+  ros::Duration fault_elapsed_;
+  ros::Duration fault_deadline_;
+
+// state journal (closed unless enabled), replayed when the node restarts
+  StateJournal journal_;
+  MaterialLocation material_location_;
+
+// tended machines (one unless multi-machine mode), the active one is used by the cycle states
+  std::vector<CncMachinePtr> machines_;
+  MachineNames machine_names_;
+  size_t active_machine_;
+  ros::Time cycle_start_;
+
+// action servers (active machine)
   MaterialLoadServerPtr material_load_server_ptr_;
   MaterialUnloadServerPtr material_unload_server_ptr_;
 
-// action clients
+// action clients (cnc clients of the active machine)
   CncOpenDoorClientPtr open_door_client_ptr_;
   CncCloseDoorClientPtr close_door_client_ptr_;
   CncOpenChuckClientPtr open_chuck_client_ptr_;
@@ -405,6 +529,26 @@ private:
   ros::Publisher robot_states_pub_;
   ros::Publisher robot_spindle_pub_;
   ros::Publisher state_machine_pub_;
+  ros::Publisher material_queue_pub_;
+
+// embedded SHDR adapter (NULL unless enabled), runs alongside the ros bridge adapter
+  boost::shared_ptr<ShdrAdapter> shdr_adapter_;
+
+// concurrent discovery of the action servers and services, grouped by subsystem
+  mtconnect_example_utils::DiscoveryManager discovery_;
+  double discovery_timeout_;
+  ros::Time discovery_start_;
+  bool degraded_;
+
+// material requests received while busy, admitted once the robot is back to waiting
+  mtconnect_example_utils::MaterialRequestQueue material_queue_;
+
+// agent stream client (NULL unless enabled), confirms door and chuck moves ahead of the actions
+  boost::shared_ptr<StreamClient> stream_client_;
+  boost::mutex cnc_state_mutex_;
+  CncState door_state_;
+  CncState chuck_state_;
+  CyclePredictor cycle_predictor_;
 
 // topic subscribers
   ros::Subscriber robot_status_sub_;
@@ -414,16 +558,16 @@ private:
   ros::ServiceServer external_command_srv_;
 
 // server clients
-  ros::ServiceClient material_load_set_state_client_;
-  ros::ServiceClient material_unload_set_state_client_;
   ros::ServiceClient trajectory_filter_client_;
 
 // pub messages
   mtconnect_msgs::RobotStates robot_state_msg_;
   mtconnect_msgs::RobotSpindle robot_spindle_msg_;
   mtconnect_example_msgs::StateMachineStatus state_machine_stat_msg_;
+  mtconnect_example_msgs::MaterialQueueStatus material_queue_msg_;
 
-// sub messages
+// sub messages (sensor queue thread)
+  boost::mutex sensor_mutex_;
   sensor_msgs::JointState joint_state_msg_;
   industrial_msgs::RobotStatus robot_status_msg_;
 
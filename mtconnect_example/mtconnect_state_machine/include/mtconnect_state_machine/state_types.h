@@ -0,0 +1,182 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef STATE_TYPES_H_
+#define STATE_TYPES_H_
+
+#include <string>
+#include <map>
+
+#include <boost/assign/list_of.hpp>
+
+namespace mtconnect_state_machine
+{
+
+/**
+ * \brief Enumeration of state machine states
+ */
+namespace StateTypes
+{
+enum StateType
+{
+  INVALID = 0, IDLE = 1,
+
+  INITING = 100,
+  CHECK_HOME, WAIT_FOR_ACTIONS, WAIT_FOR_SERVICES, SET_MAT_ACTIONS_READY,
+
+  CYCLE_BEGIN = 2000,
+  WAITING = 2001,
+  MATERIAL_LOADING = 2100,
+  ML_MOVE_PICK_APPROACH, ML_WAIT_MOVE_PICK_APPROACH, ML_MOVE_PICK,
+  ML_WAIT_MOVE_PICK, ML_PICK, ML_WAIT_PICK, ML_MOVE_CHUCK, ML_WAIT_MOVE_CHUCK,
+  ML_CLOSE_CHUCK, ML_WAIT_CLOSE_CHUCK, ML_RELEASE_PART, ML_WAIT_RELEASE_PART,
+  ML_MOVE_DOOR, ML_WAIT_MOVE_DOOR, ML_MOVE_HOME, ML_WAIT_MOVE_HOME,
+  MATERIAL_LOADED = 2199,
+
+
+  MATERIAL_UNLOADING = 2200,
+  MU_MOVE_DOOR, MU_WAIT_MOVE_DOOR, MU_MOVE_CHUCK, MU_WAIT_MOVE_CHUCK, MU_PICK_PART, MU_WAIT_PICK_PART,
+  MU_OPEN_CHUCK, MU_WAIT_OPEN_CHUCK, MU_MOVE_DROP, MU_WAIT_MOVE_DROP, MU_DROP, MU_WAIT_DROP,
+  MU_MOVE_HOME, MU_WAIT_MOVE_HOME,
+  MATERIAL_UNLOADED = 2299,
+
+  MATERIAL_SWAPPING = 2300,
+  SW_WAIT_LOAD_REQUEST, SW_MOVE_PICK_APPROACH, SW_WAIT_MOVE_PICK_APPROACH, SW_MOVE_HOME, SW_WAIT_MOVE_HOME,
+
+  MATERIAL_STAGING = 2400,
+  MS_WAIT_MOVE_STAGE, MS_STAGED, MS_MOVE_DOOR, MS_MOVE_HOME, MS_WAIT_MOVE_HOME,
+  CYCLE_END = 2999,
+
+  STOPPING = 300,
+  S_SET_MAT_ACTIONS_NOT_READY,
+  STOPPED = 299,
+
+  ABORTING = 500,
+  ABORT_GOALS, CANCEL_REQUESTS,
+  ABORTED = 599,
+
+  RESETTING = 700,
+  R_WAIT_FOR_HOME, R_SET_MAT_ACTIONS_NOT_READY, R_PLAN_RECOVERY, R_WAIT_MOVE_RECOVERY,
+  RESET = 799,
+
+};
+/**
+ * \brief Map of states to state strings
+ */
+static std::map<int, std::string> STATE_MAP =
+    boost::assign::map_list_of(INVALID, "INVALID")(IDLE, "IDLE")
+    (INITING, "INITING")
+    (CHECK_HOME, "CHECK_HOME")
+    (WAIT_FOR_ACTIONS, "WAIT_FOR_ACTIONS")
+    (WAIT_FOR_SERVICES, "WAIT_FOR_SERVICES")
+    (SET_MAT_ACTIONS_READY,"SET_MAT_ACTIONS_READY")
+    (WAITING, "WAITING")
+
+    (MATERIAL_LOADING, "MATERIAL_LOADING")
+    (ML_MOVE_PICK_APPROACH,"ML_MOVE_PICK_APPROACH")
+    (ML_WAIT_MOVE_PICK_APPROACH,"ML_WAIT_MOVE_PICK_APPROACH")
+    (ML_MOVE_PICK,"ML_MOVE_PICK")
+    (ML_WAIT_MOVE_PICK,"ML_WAIT_MOVE_PICK")
+    (ML_PICK,"ML_PICK")
+    (ML_WAIT_PICK,"ML_WAIT_PICK")
+    (ML_MOVE_CHUCK,"ML_MOVE_CHUCK")
+    (ML_WAIT_MOVE_CHUCK,"ML_WAIT_MOVE_CHUCK")
+    (ML_CLOSE_CHUCK,"ML_CLOSE_CHUCK")
+    (ML_WAIT_CLOSE_CHUCK, "ML_WAIT_CLOSE_CHUCK")
+    (ML_RELEASE_PART, "ML_RELEASE_PART")
+    (ML_WAIT_RELEASE_PART, "ML_WAIT_RELEASE_PART")
+    (ML_MOVE_DOOR, "ML_MOVE_DOOR")
+    (ML_WAIT_MOVE_DOOR, "ML_WAIT_MOVE_DOOR")
+    (ML_MOVE_HOME, "ML_MOVE_HOME")
+    (ML_WAIT_MOVE_HOME, "ML_WAIT_MOVE_HOME")
+    (MATERIAL_LOADED, "MATERIAL_LOADED")
+
+    (MATERIAL_UNLOADING, "MATERIAL_UNLOADING")
+    (MU_MOVE_DOOR, "MU_MOVE_DOOR")
+    (MU_WAIT_MOVE_DOOR, "MU_WAIT_MOVE_DOOR")
+    (MU_MOVE_CHUCK, "MU_MOVE_CHUCK")
+    (MU_WAIT_MOVE_CHUCK, "MU_WAIT_MOVE_CHUCK")
+    (MU_PICK_PART, "MU_PICK_PART")
+    (MU_WAIT_PICK_PART, "MU_WAIT_PICK_PART")
+    (MU_OPEN_CHUCK, "MU_OPEN_CHUCK")
+    (MU_WAIT_OPEN_CHUCK, "MU_WAIT_OPEN_CHUCK")
+    (MU_MOVE_DROP, "MU_MOVE_DROP")
+    (MU_WAIT_MOVE_DROP, "MU_WAIT_MOVE_DROP")
+    (MU_DROP, "MU_DROP")
+    (MU_WAIT_DROP, "MU_WAIT_DROP")
+    (MU_MOVE_HOME, "MU_MOVE_HOME")
+    (MU_WAIT_MOVE_HOME, "MU_WAIT_MOVE_HOME")
+    (MATERIAL_UNLOADED, "MATERIAL_UNLOADED")
+
+    (MATERIAL_SWAPPING, "MATERIAL_SWAPPING")
+    (SW_WAIT_LOAD_REQUEST, "SW_WAIT_LOAD_REQUEST")
+    (SW_MOVE_PICK_APPROACH, "SW_MOVE_PICK_APPROACH")
+    (SW_WAIT_MOVE_PICK_APPROACH, "SW_WAIT_MOVE_PICK_APPROACH")
+    (SW_MOVE_HOME, "SW_MOVE_HOME")
+    (SW_WAIT_MOVE_HOME, "SW_WAIT_MOVE_HOME")
+
+    (MATERIAL_STAGING, "MATERIAL_STAGING")
+    (MS_WAIT_MOVE_STAGE, "MS_WAIT_MOVE_STAGE")
+    (MS_STAGED, "MS_STAGED")
+    (MS_MOVE_DOOR, "MS_MOVE_DOOR")
+    (MS_MOVE_HOME, "MS_MOVE_HOME")
+    (MS_WAIT_MOVE_HOME, "MS_WAIT_MOVE_HOME")
+
+    (STOPPING, "STOPPING")
+    (S_SET_MAT_ACTIONS_NOT_READY, "S_SET_MAT_ACTIONS_NOT_READY")
+    (STOPPED, "STOPPED")
+
+    (ABORTING, "ABORTING")
+    (ABORT_GOALS, "ABORT_GOALS")(CANCEL_REQUESTS, "CANCEL_REQUESTS")
+    (ABORTED, "ABORTED")
+
+    (RESETTING, "RESETTING")
+    (R_WAIT_FOR_HOME, "R_WAIT_FOR_HOME")(R_SET_MAT_ACTIONS_NOT_READY, "SET_MAT_ACTIONS_NOT_READY")
+    (R_PLAN_RECOVERY, "R_PLAN_RECOVERY")(R_WAIT_MOVE_RECOVERY, "R_WAIT_MOVE_RECOVERY")
+    (RESET, "RESETED");
+
+}
+typedef StateTypes::StateType StateType;
+
+// Task description paths moved along by the states
+
+// Material load moves
+static const std::string KEY_JM_HOME_TO_APPROACH = "JM_HOME_TO_APPROACH";
+static const std::string KEY_JM_APPROACH_TO_PICK = "JM_APPROACH_TO_PICK";
+static const std::string KEY_JM_PICK_TO_CHUCK = "JM_PICK_TO_CHUCK";
+static const std::string KEY_JM_CHUCK_TO_DOOR = "JM_CHUCK_TO_DOOR";
+static const std::string KEY_JM_DOOR_TO_HOME = "JM_DOOR_TO_HOME";
+
+// Material unload moves
+static const std::string KEY_JM_HOME_TO_DOOR = "JM_HOME_TO_DOOR";
+static const std::string KEY_JM_DOOR_TO_CHUCK = "JM_DOOR_TO_CHUCK";
+static const std::string KEY_JM_CHUCK_TO_DROP = "JM_CHUCK_TO_DROP";
+static const std::string KEY_JM_DROP_TO_HOME = "JM_DROP_TO_HOME";
+
+// Material swap moves (unload followed by load)
+static const std::string KEY_JM_DROP_TO_APPROACH = "JM_DROP_TO_APPROACH";
+
+// Staging paths (pre-door staging point)
+static const std::string KEY_JM_HOME_TO_STAGE = "JM_HOME_TO_STAGE";
+static const std::string KEY_JM_STAGE_TO_DOOR = "JM_STAGE_TO_DOOR";
+static const std::string KEY_JM_STAGE_TO_HOME = "JM_STAGE_TO_HOME";
+
+// Fault recovery path (planned on reset, not part of the task description)
+static const std::string KEY_JM_RECOVERY = "JM_RECOVERY";
+
+} //mtconnect_state_machine
+
+#endif /* STATE_TYPES_H_ */
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef STREAM_CLIENT_H_
+#define STREAM_CLIENT_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace mtconnect_state_machine
+{
+
+static const int DEFAULT_STREAM_INTERVAL = 100; // milliseconds
+static const int DEFAULT_STREAM_COUNT = 1000;
+
+/**
+ * \brief Enumeration of door and chuck states (DOOR_STATE, CHUCK_STATE data items)
+ */
+namespace CncStates
+{
+enum CncState
+{
+  UNAVAILABLE = 0, OPEN, CLOSED, UNLATCHED
+};
+}
+typedef CncStates::CncState CncState;
+
+/**
+ * \brief Enumeration of controller execution states (EXECUTION data item)
+ */
+namespace ExecutionStates
+{
+enum ExecutionState
+{
+  UNAVAILABLE = 0, READY, ACTIVE, INTERRUPTED, FEED_HOLD, STOPPED, OPTIONAL_STOP, PROGRAM_STOPPED,
+  PROGRAM_COMPLETED
+};
+}
+typedef ExecutionStates::ExecutionState ExecutionState;
+
+CncState toCncState(const std::string &value);
+
+ExecutionState toExecutionState(const std::string &value);
+
+/**
+ * \brief A single sample, event or condition of a streams document
+ */
+struct Observation
+{
+  Observation() : sequence_(0) {}
+
+  std::string type_;          // element name, i.e. DoorState
+  std::string name_;          // data item name, i.e. door_state
+  std::string data_item_id_;
+  std::string timestamp_;
+  std::string value_;
+  unsigned long long sequence_;
+};
+
+/**
+ * \brief Header attributes of a streams document used for sequence tracking
+ */
+struct StreamHeader
+{
+  StreamHeader() : instance_id_(0), first_sequence_(0), next_sequence_(0) {}
+
+  unsigned long long instance_id_;
+  unsigned long long first_sequence_;
+  unsigned long long next_sequence_;
+};
+
+/**
+ * \brief Incremental HTTP chunked transfer decoder, data may be split anywhere
+ */
+class ChunkDecoder
+{
+public:
+  ChunkDecoder();
+
+  void reset();
+
+  /**
+   * \brief Appends the payload carried by data to out
+   *
+   * \return false on a framing error (the stream can't be recovered)
+   */
+  bool decode(const char *data, size_t size, std::string &out);
+
+  /**
+   * \brief True once the terminating (zero size) chunk was read
+   */
+  bool isDone() const
+  {
+    return state_ == DONE;
+  }
+
+protected:
+  enum State
+  {
+    SIZE, EXTENSION, SIZE_LF, DATA, DATA_CR, DATA_LF, DONE
+  };
+
+  State state_;
+  size_t remaining_;
+  int digits_;
+};
+
+/**
+ * \brief Splits a multipart/x-mixed-replace body into documents
+ */
+class MultipartReader
+{
+public:
+  void setBoundary(const std::string &boundary);
+
+  void append(const std::string &data)
+  {
+    buffer_ += data;
+  }
+
+  /**
+   * \brief Extracts the next complete document
+   *
+   * \return false if no complete document is buffered, or on a framing error (see isValid)
+   */
+  bool next(std::string &document);
+
+  bool isValid() const
+  {
+    return valid_;
+  }
+
+  void clear();
+
+protected:
+  std::string boundary_;
+  std::string buffer_;
+  bool valid_;
+};
+
+/**
+ * \brief Minimal pull parser for MTConnect documents.
+ *
+ * Walks the elements in document order without building a tree.  Only what the streams
+ * documents need is supported: attributes, character data of leaf elements and the
+ * predefined entities.  Comments, processing instructions and declarations are skipped.
+ */
+class XmlPullParser
+{
+public:
+  XmlPullParser(const std::string &xml);
+
+  /**
+   * \brief Advances to the next start tag
+   *
+   * \return false at the end of the document
+   */
+  bool next();
+
+  const std::string &getName() const
+  {
+    return name_;
+  }
+
+  /**
+   * \brief Character data up to the next tag (leaf elements only)
+   */
+  const std::string &getText() const
+  {
+    return text_;
+  }
+
+  /**
+   * \brief Returns an attribute value, empty if the element doesn't have it
+   */
+  std::string getAttribute(const std::string &name) const;
+
+  static std::string unescape(const std::string &text);
+
+protected:
+  const std::string &xml_;
+  size_t pos_;
+  std::string name_;
+  std::string text_;
+  std::vector<std::pair<std::string, std::string> > attributes_;
+};
+
+/**
+ * \brief Parses a streams document, returns false if it isn't one
+ */
+bool parseStreams(const std::string &xml, StreamHeader &header, std::vector<Observation> &observations);
+
+/**
+ * \brief Streaming MTConnect agent client.
+ *
+ * Reads the current state of a device, then follows the agent's sample stream from the
+ * sequence that followed it, calling back for every observation on the client thread.  The
+ * sequence is tracked from the document headers, if the agent dropped observations before
+ * they were streamed (or restarted) the gap is reported and the client resynchronizes from
+ * the current state.
+ */
+class StreamClient
+{
+public:
+  typedef boost::function<void(const Observation&)> ObservationCallback;
+  typedef boost::function<void(const std::string&, CncState)> CncStateCallback;
+  typedef boost::function<void(const std::string&, ExecutionState)> ExecutionCallback;
+
+  /**
+   * \brief Called with the expected and the first available sequence
+   */
+  typedef boost::function<void(unsigned long long, unsigned long long)> GapCallback;
+
+  /**
+   * \brief Called for every streams document without a gap, heartbeats included
+   */
+  typedef boost::function<void()> DocumentCallback;
+
+  StreamClient();
+
+  ~StreamClient();
+
+  /**
+   * \brief Sets the agent connection, the client is not started until start() is called
+   *
+   * \param device path prefix of the device on the agent (i.e. "/cnc"), empty for all devices
+   */
+  void init(const std::string &host, int port, const std::string &device,
+            int interval = DEFAULT_STREAM_INTERVAL);
+
+  /**
+   * \brief Calls back for observations of the given type (element name, i.e. "DoorState")
+   */
+  void subscribe(const std::string &type, ObservationCallback callback);
+
+  /**
+   * \brief Calls back for door states
+   *
+   * \param name data item name or id to follow (i.e. "door_state"), empty for every door
+   */
+  void subscribeDoorState(CncStateCallback callback, const std::string &name = std::string());
+
+  /**
+   * \brief Calls back for chuck states
+   *
+   * \param name data item name or id to follow (i.e. "chuck_state"), empty for every chuck
+   */
+  void subscribeChuckState(CncStateCallback callback, const std::string &name = std::string());
+
+  void subscribeExecution(ExecutionCallback callback);
+
+  void setGapCallback(GapCallback callback);
+
+  void setDocumentCallback(DocumentCallback callback);
+
+  void start();
+
+  void stop();
+
+  /**
+   * \brief Dispatches the observations of a streams document (called by the client thread)
+   *
+   * \return false if the document reveals a sequence gap
+   */
+  bool processDocument(const std::string &xml);
+
+  /**
+   * \brief Starts sequence tracking over (i.e. after a resynchronization)
+   */
+  void resetSequence();
+
+  unsigned long long getNextSequence();
+
+  unsigned int getGapCount();
+
+protected:
+
+  void run();
+
+  /**
+   * \brief Connects and sends a GET request, returns the socket (-1 on failure)
+   */
+  int request(const std::string &path);
+
+  /**
+   * \brief Reads the response headers, returns false on errors or a status other than 200
+   */
+  bool readHeaders(int fd, std::map<std::string, std::string> &headers, std::string &rest);
+
+  /**
+   * \brief Reads some bytes, returns -1 on errors or when stopped, 0 if nothing arrived
+   */
+  int receive(int fd, char *buffer, size_t size);
+
+  bool readCurrent();
+
+  /**
+   * \brief Follows the sample stream, returns true if it stopped on a sequence gap
+   */
+  bool readStream();
+
+  bool isRunning();
+
+protected:
+  std::string host_;
+  int port_;
+  std::string device_;
+  int interval_;
+
+  boost::thread thread_;
+  boost::mutex mutex_;
+  bool running_;
+
+  std::map<std::string, std::vector<ObservationCallback> > subscribers_;
+  GapCallback gap_callback_;
+  DocumentCallback document_callback_;
+  unsigned long long instance_id_;
+  unsigned long long next_sequence_;
+  unsigned int gaps_;
+};
+
+}
+
+#endif /* STREAM_CLIENT_H_ */
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef SWAP_CYCLE_H_
+#define SWAP_CYCLE_H_
+
+#include <string>
+
+#include <mtconnect_state_machine/state_types.h>
+
+namespace mtconnect_state_machine
+{
+
+static const double DEFAULT_SWAP_WAIT = 2.0; // seconds
+
+/**
+ * \brief Sequences the swap cycle, an unload followed by a load without returning home.
+ *
+ * Once the finished part is dropped the robot waits at the drop for the load request of the
+ * same machine, for up to the swap wait.  A load request takes it from the drop straight to
+ * the pick approach (the gripper is open and the door still is) and on into the load
+ * sequence at ML_MOVE_PICK.  No request in time, or requests of other machines waiting to be
+ * scheduled, send it home.  Times are in seconds (i.e. ros::Time::toSec()).
+ */
+class SwapCycle
+{
+public:
+  SwapCycle();
+
+  void setEnabled(bool enabled)
+  {
+    enabled_ = enabled;
+  }
+
+  bool isEnabled() const
+  {
+    return enabled_;
+  }
+
+  void setWait(double wait)
+  {
+    wait_ = wait;
+  }
+
+  double getWait() const
+  {
+    return wait_;
+  }
+
+  /**
+   * \brief State after the finished part is dropped (MATERIAL_SWAPPING if enabled)
+   */
+  StateType getDropDone() const;
+
+  /**
+   * \brief Starts waiting at the drop for a load request
+   */
+  void begin(double now);
+
+  /**
+   * \brief Next state while waiting at the drop (SW_WAIT_LOAD_REQUEST)
+   *
+   * \param load_accepted a load request of the tended machine was accepted
+   * \param others_queued requests of other machines are queued
+   */
+  StateType poll(bool load_accepted, bool others_queued, double now) const;
+
+  /**
+   * \brief Move started in a swap move state (SW_MOVE_*) and the state that waits for it
+   *
+   * \return false if state isn't a swap move state
+   */
+  static bool getMove(StateType state, std::string &path, StateType &wait);
+
+  /**
+   * \brief State after the move of a swap wait state (SW_WAIT_MOVE_*) is done
+   */
+  static StateType getMoveDone(StateType wait);
+
+protected:
+  bool enabled_;
+  double wait_;
+  double start_;
+};
+
+} //mtconnect_state_machine
+
+#endif /* SWAP_CYCLE_H_ */
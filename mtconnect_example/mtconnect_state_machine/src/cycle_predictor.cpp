@@ -0,0 +1,137 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/cycle_predictor.h>
+
+using namespace mtconnect_state_machine;
+
+CyclePredictor::CyclePredictor() :
+    running_(false), held_(false), completed_(false), start_(0.0), held_start_(0.0), progress_(0.0),
+    progress_stamp_(0.0), cycle_time_(0.0), cycles_(0)
+{
+}
+
+void CyclePredictor::setExecution(ExecutionState state, double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  switch (state)
+  {
+    case ExecutionStates::ACTIVE:
+      if (!running_)
+      {
+        running_ = true;
+        held_ = false;
+        completed_ = false;
+        start_ = now;
+        progress_ = 0.0;
+        cycles_++;
+      }
+      else if (held_)
+      {
+        // the held time is not part of the cycle
+        held_ = false;
+        start_ += now - held_start_;
+        progress_stamp_ += now - held_start_;
+      }
+      break;
+
+    case ExecutionStates::INTERRUPTED:
+    case ExecutionStates::FEED_HOLD:
+    case ExecutionStates::OPTIONAL_STOP:
+    case ExecutionStates::PROGRAM_STOPPED:
+      if (running_ && !held_)
+      {
+        held_ = true;
+        held_start_ = now;
+      }
+      break;
+
+    case ExecutionStates::PROGRAM_COMPLETED:
+    case ExecutionStates::READY:
+      if (running_ && !held_)
+      {
+        double duration = now - start_;
+        cycle_time_ = cycle_time_ > 0.0 ? cycle_time_ + CYCLE_TIME_FILTER * (duration - cycle_time_) : duration;
+        completed_ = true;
+      }
+      running_ = false;
+      break;
+
+    default:
+      // stopped or unavailable, the cycle was not completed
+      running_ = false;
+      completed_ = false;
+      break;
+  }
+}
+
+void CyclePredictor::setProgress(double progress, double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (running_ && !held_)
+  {
+    progress_ = progress;
+    progress_stamp_ = now;
+  }
+}
+
+bool CyclePredictor::getRemaining(double now, double &remaining)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!running_ || held_)
+  {
+    return false;
+  }
+
+  if (progress_ > 0.0 && progress_ <= 1.0)
+  {
+    // duration extrapolated from the progress at the time it was reported
+    remaining = start_ + (progress_stamp_ - start_) / progress_ - now;
+    return true;
+  }
+
+  if (cycle_time_ > 0.0)
+  {
+    remaining = start_ + cycle_time_ - now;
+    return true;
+  }
+
+  return false;
+}
+
+double CyclePredictor::getCycleTime()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return cycle_time_;
+}
+
+bool CyclePredictor::isRunning()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return running_;
+}
+
+bool CyclePredictor::isCompleted()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return completed_;
+}
+
+unsigned int CyclePredictor::getCycleCount()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return cycles_;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/machine_names.h>
+
+using namespace mtconnect_state_machine;
+
+void MachineNames::add(const std::string &name)
+{
+  names_.push_back(name);
+}
+
+void MachineNames::clear()
+{
+  names_.clear();
+}
+
+std::string MachineNames::getAction(size_t machine, const std::string &action) const
+{
+  const std::string &name = names_[machine];
+  if (name.empty())
+  {
+    return action;
+  }
+  return action[0] == '/' ? "/" + name + action : name + "/" + action;
+}
+
+bool MachineNames::findAction(const std::string &name, const std::vector<std::string> &actions, size_t &machine,
+                              std::string &action) const
+{
+  for (size_t i = 0; i < names_.size(); i++)
+  {
+    for (size_t j = 0; j < actions.size(); j++)
+    {
+      if (name == getAction(i, actions[j]))
+      {
+        machine = i;
+        action = actions[j];
+        return true;
+      }
+    }
+  }
+  return false;
+}
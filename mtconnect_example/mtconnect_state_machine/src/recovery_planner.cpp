@@ -0,0 +1,273 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/recovery_planner.h>
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace mtconnect_state_machine;
+
+// waypoints this much further than the nearest one are just as near (shared waypoints)
+static const double NEAREST_EPSILON = 1e-6;
+
+RecoveryPlanner::RecoveryPlanner() :
+    joints_(0), tolerance_(0.0)
+{
+}
+
+void RecoveryPlanner::setHome(const std::vector<double> &home, double tolerance)
+{
+  home_ = home;
+  tolerance_ = tolerance;
+  joints_ = home.size();
+}
+
+bool RecoveryPlanner::addPath(const std::string &name, const std::vector<std::vector<double> > &points)
+{
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    if (points[i].size() != joints_)
+    {
+      return false;
+    }
+  }
+
+  if (points.empty())
+  {
+    return true;
+  }
+
+  size_t first = names_.size();
+  size_t last = first + points.size() - 1;
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    table_.insert(table_.end(), points[i].begin(), points[i].end());
+    names_.push_back(name);
+    first_.push_back(first);
+    last_.push_back(last);
+    directions_.push_back(PathDirections::BOTH);
+    shared_.push_back(std::vector<size_t>());
+  }
+
+  // joining the new path to the ones it shares waypoints with
+  for (size_t i = first; i <= last; i++)
+  {
+    for (size_t j = 0; j < first; j++)
+    {
+      if (distance(&table_[i * joints_], &table_[j * joints_], joints_) <= NEAREST_EPSILON)
+      {
+        shared_[i].push_back(j);
+        shared_[j].push_back(i);
+      }
+    }
+  }
+  return true;
+}
+
+void RecoveryPlanner::clear()
+{
+  table_.clear();
+  names_.clear();
+  first_.clear();
+  last_.clear();
+  directions_.clear();
+  shared_.clear();
+}
+
+bool RecoveryPlanner::setDirection(const std::string &name, PathDirection direction)
+{
+  bool found = false;
+  for (size_t i = 0; i < names_.size(); i++)
+  {
+    if (names_[i] == name)
+    {
+      directions_[i] = direction;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void RecoveryPlanner::resetDirections()
+{
+  directions_.assign(directions_.size(), PathDirections::BOTH);
+}
+
+bool RecoveryPlanner::plan(const std::vector<double> &position, double max_distance, RecoveryPlan &plan) const
+{
+  size_t count = names_.size();
+  if (count == 0 || position.size() != joints_)
+  {
+    return false;
+  }
+
+  // one pass over the waypoint table, the inner loop runs over contiguous joint values
+  std::vector<double> distances(count);
+  const double *row = &table_[0];
+  for (size_t i = 0; i < count; i++, row += joints_)
+  {
+    distances[i] = distance(row, &position[0], joints_);
+  }
+
+  double nearest = distances[0];
+  for (size_t i = 1; i < count; i++)
+  {
+    if (distances[i] < nearest)
+    {
+      nearest = distances[i];
+    }
+  }
+  if (nearest > max_distance)
+  {
+    return false;
+  }
+
+  // shortest route over the path graph, starting from every waypoint that is (equally) nearest
+  typedef std::pair<double, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+  std::vector<double> cost(count, std::numeric_limits<double>::infinity());
+  std::vector<size_t> previous(count, count);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (distances[i] <= nearest + NEAREST_EPSILON)
+    {
+      cost[i] = distances[i];
+      open.push(Entry(cost[i], i));
+    }
+  }
+
+  size_t goal = count;
+  while (!open.empty())
+  {
+    Entry entry = open.top();
+    open.pop();
+    size_t i = entry.second;
+    if (entry.first > cost[i])
+    {
+      continue;
+    }
+    if (isHome(i))
+    {
+      goal = i;
+      break;
+    }
+
+    // changing paths at a shared waypoint doesn't move the robot, it's always allowed
+    std::vector<size_t> next(shared_[i]);
+    if (i > first_[i] && isAllowed(i, i - 1))
+    {
+      next.push_back(i - 1);
+    }
+    if (i < last_[i] && isAllowed(i, i + 1))
+    {
+      next.push_back(i + 1);
+    }
+    for (size_t n = 0; n < next.size(); n++)
+    {
+      double c = cost[i] + distance(&table_[i * joints_], &table_[next[n] * joints_], joints_);
+      if (c < cost[next[n]])
+      {
+        cost[next[n]] = c;
+        previous[next[n]] = i;
+        open.push(Entry(c, next[n]));
+      }
+    }
+  }
+
+  if (goal == count)
+  {
+    return false;
+  }
+
+  std::vector<size_t> route;
+  for (size_t i = goal; i != count; i = previous[i])
+  {
+    route.insert(route.begin(), i);
+  }
+  plan = RecoveryPlan();
+  plan.distance_ = distances[route.front()];
+  plan.length_ = cost[goal];
+  describe(route, plan);
+  plan.points_.insert(plan.points_.begin(), position);
+  return true;
+}
+
+double RecoveryPlanner::distance(const double *a, const double *b, size_t joints)
+{
+  double rtn = 0.0;
+  for (size_t j = 0; j < joints; j++)
+  {
+    double d = std::fabs(a[j] - b[j]);
+    rtn = d > rtn ? d : rtn;
+  }
+  return rtn;
+}
+
+void RecoveryPlanner::describe(const std::vector<size_t> &route, RecoveryPlan &plan) const
+{
+  // the route starts on the path of its first move, a shared waypoint may hand it over first
+  size_t start = 0;
+  while (start + 1 < route.size() && !isNeighbour(route[start], route[start + 1]))
+  {
+    start++;
+  }
+  plan.path_ = names_[route[start]];
+  plan.waypoint_ = route[start] - first_[route[start]];
+  plan.reverse_ = start + 1 < route.size() && route[start + 1] < route[start];
+
+  for (size_t k = 0; k < route.size(); k++)
+  {
+    size_t i = route[k];
+    if (k + 1 < route.size() && isNeighbour(i, route[k + 1])
+        && (plan.paths_.empty() || plan.paths_.back() != names_[i]))
+    {
+      plan.paths_.push_back(names_[i]);
+    }
+    if (k > 0 && !isNeighbour(route[k - 1], i))
+    {
+      continue; // same position on another path
+    }
+    plan.points_.push_back(std::vector<double>(table_.begin() + i * joints_, table_.begin() + (i + 1) * joints_));
+  }
+}
+
+bool RecoveryPlanner::isNeighbour(size_t a, size_t b) const
+{
+  return first_[a] == first_[b] && (a + 1 == b || b + 1 == a);
+}
+
+bool RecoveryPlanner::isAllowed(size_t a, size_t b) const
+{
+  switch (directions_[a])
+  {
+    case PathDirections::BOTH:
+      return true;
+    case PathDirections::FORWARD:
+      return b > a;
+    case PathDirections::REVERSE:
+      return b < a;
+    default:
+      return false;
+  }
+}
+
+bool RecoveryPlanner::isHome(size_t waypoint) const
+{
+  return distance(&table_[waypoint * joints_], &home_[0], joints_) <= tolerance_;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/shdr_adapter.h>
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace mtconnect_state_machine;
+
+static const int SERVICE_POLL_PERIOD = 100; // milliseconds
+static const int RECEIVE_BUFFER_SIZE = 256;
+static const char PING[] = "* PING";
+
+ShdrAdapter::ShdrAdapter() :
+    listen_fd_(-1), heartbeat_interval_(DEFAULT_HEARTBEAT_INTERVAL), running_(false)
+{
+}
+
+ShdrAdapter::~ShdrAdapter()
+{
+  stop();
+}
+
+bool ShdrAdapter::start(int port, int heartbeat_interval)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (running_)
+  {
+    return true;
+  }
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0)
+  {
+    ROS_ERROR_STREAM("SHDR adapter failed to create a socket");
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 4) != 0)
+  {
+    ROS_ERROR_STREAM("SHDR adapter failed to listen on port " << port);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  heartbeat_interval_ = heartbeat_interval;
+  running_ = true;
+  thread_ = boost::thread(boost::bind(&ShdrAdapter::serviceLoop, this));
+  ROS_INFO_STREAM("SHDR adapter listening on port " << port);
+  return true;
+}
+
+void ShdrAdapter::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+  }
+
+  if (thread_.joinable())
+  {
+    thread_.join();
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  for (unsigned int i = 0; i < clients_.size(); i++)
+  {
+    close(clients_[i]);
+  }
+  clients_.clear();
+
+  if (listen_fd_ >= 0)
+  {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+void ShdrAdapter::setValue(const std::string &key, const std::string &value)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  DataItem &item = items_[key];
+  if (item.value_ != value)
+  {
+    item.value_ = value;
+    item.changed_ = true;
+  }
+}
+
+int ShdrAdapter::flush()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::vector<std::pair<std::string, std::string> > changed;
+  for (std::map<std::string, DataItem>::iterator i = items_.begin(); i != items_.end(); i++)
+  {
+    if (i->second.changed_)
+    {
+      changed.push_back(std::make_pair(i->first, i->second.value_));
+      i->second.changed_ = false;
+    }
+  }
+
+  if (changed.empty())
+  {
+    return 0;
+  }
+
+  std::string line = formatLine(timestamp(), changed);
+  for (unsigned int i = 0; i < clients_.size(); i++)
+  {
+    sendLine(clients_[i], line);
+  }
+  return changed.size();
+}
+
+int ShdrAdapter::getClientCount()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return clients_.size();
+}
+
+std::string ShdrAdapter::formatLine(const std::string &timestamp,
+                                    const std::vector<std::pair<std::string, std::string> > &items)
+{
+  std::string line = timestamp;
+  for (unsigned int i = 0; i < items.size(); i++)
+  {
+    line += "|" + items[i].first + "|" + items[i].second;
+  }
+  return line + "\n";
+}
+
+std::string ShdrAdapter::timestamp()
+{
+  return boost::posix_time::to_iso_extended_string(boost::posix_time::microsec_clock::universal_time()) + "Z";
+}
+
+bool ShdrAdapter::sendLine(int fd, const std::string &line)
+{
+  int sent = send(fd, line.c_str(), line.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (sent != (int)line.size())
+  {
+    // a partial line would corrupt the stream, the service thread closes the client
+    ROS_WARN_STREAM("SHDR adapter dropping an agent that can't keep up");
+    shutdown(fd, SHUT_RDWR);
+    return false;
+  }
+  return true;
+}
+
+bool ShdrAdapter::readClient(int fd)
+{
+  char buffer[RECEIVE_BUFFER_SIZE + 1];
+  int received = recv(fd, buffer, RECEIVE_BUFFER_SIZE, 0);
+  if (received <= 0)
+  {
+    return false;
+  }
+  buffer[received] = '\0';
+
+  if (strncmp(buffer, PING, strlen(PING)) != 0)
+  {
+    ROS_WARN_STREAM("SHDR adapter received unexpected data from an agent, disconnecting");
+    return false;
+  }
+
+  std::stringstream pong;
+  pong << "* PONG " << heartbeat_interval_ << "\n";
+  boost::mutex::scoped_lock lock(mutex_);
+  return sendLine(fd, pong.str());
+}
+
+void ShdrAdapter::closeClient(int fd)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    clients_.erase(std::remove(clients_.begin(), clients_.end(), fd), clients_.end());
+  }
+  close(fd);
+  ROS_INFO_STREAM("SHDR adapter agent disconnected");
+}
+
+void ShdrAdapter::serviceLoop()
+{
+  std::vector<struct pollfd> fds;
+  while (true)
+  {
+    // clients are only added and closed by this thread
+    fds.resize(1);
+    fds[0].fd = listen_fd_;
+    fds[0].events = POLLIN;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!running_)
+      {
+        break;
+      }
+
+      for (unsigned int i = 0; i < clients_.size(); i++)
+      {
+        struct pollfd client;
+        client.fd = clients_[i];
+        client.events = POLLIN;
+        fds.push_back(client);
+      }
+    }
+
+    if (poll(&fds[0], fds.size(), SERVICE_POLL_PERIOD) <= 0)
+    {
+      continue;
+    }
+
+    for (unsigned int i = 1; i < fds.size(); i++)
+    {
+      if (fds[i].revents != 0 && !readClient(fds[i].fd))
+      {
+        closeClient(fds[i].fd);
+      }
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      int fd = accept(listen_fd_, NULL, NULL);
+      if (fd < 0)
+      {
+        continue;
+      }
+
+      int nodelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+      // a new agent gets every item, the others only see changes
+      boost::mutex::scoped_lock lock(mutex_);
+      std::vector<std::pair<std::string, std::string> > all;
+      for (std::map<std::string, DataItem>::iterator j = items_.begin(); j != items_.end(); j++)
+      {
+        all.push_back(std::make_pair(j->first, j->second.value_));
+      }
+
+      if (all.empty() || sendLine(fd, formatLine(timestamp(), all)))
+      {
+        clients_.push_back(fd);
+        ROS_INFO_STREAM("SHDR adapter agent connected");
+      }
+      else
+      {
+        close(fd);
+      }
+    }
+  }
+}
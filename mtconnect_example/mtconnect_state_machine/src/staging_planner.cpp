@@ -0,0 +1,173 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/staging_planner.h>
+
+#include <algorithm>
+#include <sstream>
+
+using namespace mtconnect_state_machine;
+
+StagingPlanner::StagingPlanner() :
+    lead_(0.0), timeout_(DEFAULT_STAGING_TIMEOUT), stale_timeout_(DEFAULT_STREAM_STALE_TIMEOUT),
+    stream_seen_(false), stream_stamp_(0.0), staged_cycle_(0), deadline_(0.0)
+{
+}
+
+void StagingPlanner::setLead(double lead)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  lead_ = lead;
+}
+
+double StagingPlanner::getLead() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return lead_;
+}
+
+void StagingPlanner::setTimeout(double timeout)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  timeout_ = timeout;
+}
+
+double StagingPlanner::getTimeout() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return timeout_;
+}
+
+void StagingPlanner::setStaleTimeout(double stale_timeout)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  stale_timeout_ = stale_timeout;
+}
+
+void StagingPlanner::setStreamStamp(double now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  stream_seen_ = true;
+  stream_stamp_ = now;
+}
+
+bool StagingPlanner::isStreamStale(double now) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return !stream_seen_ || now - stream_stamp_ > stale_timeout_;
+}
+
+bool StagingPlanner::isDue(CyclePredictor &predictor, bool queue_empty, double now, double &remaining)
+{
+  if (!isEnabled() || !queue_empty || isStreamStale(now))
+  {
+    return false;
+  }
+
+  // staged once per program, a canceled staging waits for the next one
+  boost::mutex::scoped_lock lock(mutex_);
+  unsigned int cycle = predictor.getCycleCount();
+  if (cycle == staged_cycle_ || !predictor.getRemaining(now, remaining) || remaining > lead_)
+  {
+    return false;
+  }
+
+  staged_cycle_ = cycle;
+  deadline_ = now + std::max(remaining, 0.0) + timeout_;
+  return true;
+}
+
+StateType StagingPlanner::poll(CyclePredictor &predictor, bool unload_accepted, double now, std::string &reason)
+{
+  if (unload_accepted)
+  {
+    return StateTypes::MS_MOVE_DOOR;
+  }
+
+  // prediction was wrong (held, stopped or overdue) or can't be trusted anymore
+  if (isStreamStale(now))
+  {
+    reason = "Agent stream stale";
+    return StateTypes::MS_MOVE_HOME;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  double remaining;
+  bool running = predictor.isRunning();
+  if (running && !predictor.getRemaining(now, remaining))
+  {
+    reason = "CNC program held";
+    return StateTypes::MS_MOVE_HOME;
+  }
+  if (!running && !predictor.isCompleted())
+  {
+    reason = "CNC program stopped";
+    return StateTypes::MS_MOVE_HOME;
+  }
+  if (now > deadline_)
+  {
+    std::stringstream ss;
+    ss << "No material unload request " << timeout_ << " sec after the predicted program end";
+    reason = ss.str();
+    return StateTypes::MS_MOVE_HOME;
+  }
+  if (running)
+  {
+    // the prediction improves as the program progresses
+    deadline_ = now + std::max(remaining, 0.0) + timeout_;
+  }
+  return StateTypes::MS_STAGED;
+}
+
+bool StagingPlanner::getMove(StateType state, std::string &path, StateType &wait)
+{
+  switch (state)
+  {
+    case StateTypes::MATERIAL_STAGING:
+      path = KEY_JM_HOME_TO_STAGE;
+      wait = StateTypes::MS_WAIT_MOVE_STAGE;
+      return true;
+
+    case StateTypes::MS_MOVE_DOOR:
+      // the unload sequence takes over at the door
+      path = KEY_JM_STAGE_TO_DOOR;
+      wait = StateTypes::MU_WAIT_MOVE_DOOR;
+      return true;
+
+    case StateTypes::MS_MOVE_HOME:
+      path = KEY_JM_STAGE_TO_HOME;
+      wait = StateTypes::MS_WAIT_MOVE_HOME;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+StateType StagingPlanner::getMoveDone(StateType wait)
+{
+  switch (wait)
+  {
+    case StateTypes::MS_WAIT_MOVE_STAGE:
+      return StateTypes::MS_STAGED;
+
+    case StateTypes::MS_WAIT_MOVE_HOME:
+      return StateTypes::WAITING;
+
+    default:
+      return StateTypes::INVALID;
+  }
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/state_journal.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mtconnect_state_machine;
+
+static const boost::uint32_t JOURNAL_MAGIC = 0x4d43534a; // "JSCM"
+static const boost::uint32_t JOURNAL_VERSION = 1;
+
+struct StateJournal::Header
+{
+  boost::uint32_t magic_;
+  boost::uint32_t version_;
+  boost::uint32_t capacity_;
+  boost::uint32_t record_size_;
+  boost::uint32_t reserved_[4];
+};
+
+/*
+ * An empty slot has a zero sequence, the checksum covers everything else
+ */
+struct StateJournal::Record
+{
+  boost::uint32_t sequence_;
+  boost::uint32_t checksum_;
+  JournalEntry entry_;
+};
+
+StateJournal::StateJournal() :
+    fd_(-1), map_(NULL), map_size_(0), records_(NULL), capacity_(0), sequence_(0), replayed_(false)
+{
+}
+
+StateJournal::~StateJournal()
+{
+  close();
+}
+
+bool StateJournal::open(const std::string &path, size_t capacity)
+{
+  close();
+
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0)
+  {
+    return false;
+  }
+
+  // a journal of another size is started over
+  map_size_ = sizeof(Header) + capacity * sizeof(Record);
+  struct stat st;
+  if (fstat(fd_, &st) != 0
+      || (static_cast<size_t>(st.st_size) != map_size_
+          && (ftruncate(fd_, 0) != 0 || ftruncate(fd_, map_size_) != 0)))
+  {
+    close();
+    return false;
+  }
+
+  map_ = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED)
+  {
+    map_ = NULL;
+    close();
+    return false;
+  }
+
+  Header *header = static_cast<Header*>(map_);
+  Record *records = reinterpret_cast<Record*>(static_cast<char*>(map_) + sizeof(Header));
+  if (header->magic_ != JOURNAL_MAGIC || header->version_ != JOURNAL_VERSION || header->capacity_ != capacity
+      || header->record_size_ != sizeof(Record))
+  {
+    std::memset(map_, 0, map_size_);
+    header->magic_ = JOURNAL_MAGIC;
+    header->version_ = JOURNAL_VERSION;
+    header->capacity_ = capacity;
+    header->record_size_ = sizeof(Record);
+    msync(map_, map_size_, MS_SYNC);
+  }
+
+  // the newest complete record, torn records fail the checksum
+  sequence_ = 0;
+  replayed_ = false;
+  for (size_t i = 0; i < capacity; i++)
+  {
+    if (records[i].sequence_ > sequence_ && records[i].checksum_ == checksum(records[i]))
+    {
+      sequence_ = records[i].sequence_;
+      last_ = records[i].entry_;
+      replayed_ = true;
+    }
+  }
+
+  records_ = records;
+  capacity_ = capacity;
+  return true;
+}
+
+void StateJournal::close()
+{
+  if (map_)
+  {
+    msync(map_, map_size_, MS_SYNC);
+    munmap(map_, map_size_);
+    map_ = NULL;
+  }
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  records_ = NULL;
+}
+
+bool StateJournal::append(const JournalEntry &entry)
+{
+  if (!records_)
+  {
+    return false;
+  }
+
+  // the checksum goes last, an interrupted write leaves an invalid record behind
+  boost::uint32_t sequence = sequence_ + 1;
+  Record &record = records_[(sequence - 1) % capacity_];
+  record.sequence_ = sequence;
+  record.entry_ = entry;
+  record.checksum_ = checksum(record);
+  sequence_ = sequence;
+
+  // the page cache outlives the process, the flush only guards against power loss
+  long page = sysconf(_SC_PAGESIZE);
+  char *start = reinterpret_cast<char*>(&record);
+  char *page_start = static_cast<char*>(map_) + (start - static_cast<char*>(map_)) / page * page;
+  msync(page_start, start + sizeof(Record) - page_start, MS_ASYNC);
+  return true;
+}
+
+bool StateJournal::replay(JournalEntry &entry) const
+{
+  if (replayed_)
+  {
+    entry = last_;
+  }
+  return replayed_;
+}
+
+boost::uint32_t StateJournal::checksum(const Record &record)
+{
+  // FNV-1a over the sequence and the entry
+  boost::uint32_t hash = 2166136261u;
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&record.sequence_);
+  for (size_t i = 0; i < sizeof(record.sequence_); i++)
+  {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  bytes = reinterpret_cast<const unsigned char*>(&record.entry_);
+  for (size_t i = 0; i < sizeof(record.entry_); i++)
+  {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
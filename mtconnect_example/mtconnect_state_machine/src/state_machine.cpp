@@ -17,6 +17,8 @@
 #include <mtconnect_state_machine/state_machine.h>
 #include <mtconnect_state_machine/utilities.h>
 #include <industrial_robot_client/utils.h>
+#include <sstream>
+#include <algorithm>
 
 using namespace mtconnect_state_machine;
 
@@ -27,25 +29,39 @@ static const std::string PARAM_LOOP_RATE = "loop_rate";
 static const std::string PARAM_CHECK_ENABLED = "home_check";
 static const std::string PARAM_HOME_TOL = "home_tol";
 static const std::string PARAM_MAT_STATE = "material_state";
+static const std::string PARAM_SHDR_ADAPTER_PORT = "shdr_adapter_port";
+static const std::string PARAM_AGENT_HOST = "agent_host";
+static const std::string PARAM_AGENT_PORT = "agent_port";
+static const std::string PARAM_AGENT_DEVICE = "agent_device";
+static const std::string PARAM_AGENT_INTERVAL = "agent_interval";
+static const std::string PARAM_AGENT_DOOR_ITEM = "agent_door_item";
+static const std::string PARAM_AGENT_CHUCK_ITEM = "agent_chuck_item";
+static const std::string PARAM_DISCOVERY_TIMEOUT = "discovery_timeout";
+static const std::string PARAM_MATERIAL_QUEUE_DEPTH = "material_queue_depth";
+static const std::string PARAM_MATERIAL_LOAD_PRIORITY = "material_load_priority";
+static const std::string PARAM_MATERIAL_UNLOAD_PRIORITY = "material_unload_priority";
+static const std::string PARAM_SWAP_CYCLE = "swap_cycle";
+static const std::string PARAM_SWAP_WAIT = "swap_wait";
+static const std::string PARAM_MACHINES = "machines";
+static const std::string PARAM_MATERIAL_MAX_WAIT = "material_max_wait";
+static const std::string PARAM_STAGING_LEAD = "staging_lead";
+static const std::string PARAM_STAGING_TIMEOUT = "staging_timeout";
+static const std::string PARAM_STAGING_PROGRESS = "staging_progress";
+static const std::string PARAM_STREAM_STALE_TIMEOUT = "stream_stale_timeout";
+static const std::string PARAM_RECOVERY_DISTANCE = "recovery_distance";
+static const std::string PARAM_JOURNAL = "journal";
+static const std::string PARAM_ACTION_DEADLINE_FACTOR = "action_deadline_factor";
+static const std::string PARAM_ACTION_DEADLINE_DEFAULT = "action_deadline_default";
+static const std::string PARAM_ACTION_DEADLINE_SAMPLES = "action_deadline_samples";
 static const std::string KEY_HOME_POSITION = "home";
 
-// Material load moves
-static const std::string KEY_JM_HOME_TO_APPROACH = "JM_HOME_TO_APPROACH";
-static const std::string KEY_JM_APPROACH_TO_PICK = "JM_APPROACH_TO_PICK";
-static const std::string KEY_JM_PICK_TO_CHUCK = "JM_PICK_TO_CHUCK";
-static const std::string KEY_JM_CHUCK_TO_DOOR = "JM_CHUCK_TO_DOOR";
-static const std::string KEY_JM_DOOR_TO_HOME = "JM_DOOR_TO_HOME";
-
-// Material unload moves
-static const std::string KEY_JM_HOME_TO_DOOR = "JM_HOME_TO_DOOR";
-static const std::string KEY_JM_DOOR_TO_CHUCK = "JM_DOOR_TO_CHUCK";
-static const std::string KEY_JM_CHUCK_TO_DROP = "JM_CHUCK_TO_DROP";
-static const std::string KEY_JM_DROP_TO_HOME = "JM_DROP_TO_HOME";
 
 static const std::string DEFAULT_GRASP_ACTION = "gripper_action_service";
 static const std::string DEFAULT_VISE_ACTION = "vise_action_service";
 static const std::string DEFAULT_MATERIAL_LOAD_ACTION = "material_load_action";
 static const std::string DEFAULT_MATERIAL_UNLOAD_ACTION = "material_unload_action";
+static const std::vector<std::string> MATERIAL_ACTIONS =
+    boost::assign::list_of(DEFAULT_MATERIAL_LOAD_ACTION)(DEFAULT_MATERIAL_UNLOAD_ACTION);
 static const std::string DEFAULT_CNC_OPEN_DOOR_ACTION = "cnc_open_door_action";
 static const std::string DEFAULT_CNC_CLOSE_DOOR_ACTION = "cnc_close_door_action";
 static const std::string DEFAULT_CNC_OPEN_CHUCK_ACTION = "cnc_open_chuck_action";
@@ -56,6 +72,7 @@ static const std::string DEFAULT_ROBOT_SPINDLE_TOPIC = "robot_spindle";
 static const std::string DEFAULT_ROBOT_STATUS_TOPIC = "robot_status";
 static const std::string DEFAULT_JOINT_STATE_TOPIC = "joint_states";
 static const std::string DEFAULT_SM_STATUS_TOPIC = "state_machine_status";
+static const std::string DEFAULT_MATERIAL_QUEUE_TOPIC = "material_queue_status";
 static const std::string DEFAULT_EXTERNAL_COMMAND_SERVICE = "external_command";
 static const std::string DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE = "/MaterialLoad/set_mtconnect_state";
 static const std::string DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE = "/MaterialUnload/set_mtconnect_state";
@@ -63,12 +80,34 @@ static const std::string DEFAULT_TRAJECTORY_FILTER_SERVICE = "filter_trajectory_
 
 static const std::string MTCONNECT_ACTION_ACTIVE_FLAG = "ACTIVE";
 
+// discovery subsystems, the robot and the mtconnect services are required to reach the ready state
+static const std::string SUBSYSTEM_ROBOT = "robot";
+static const std::string SUBSYSTEM_MTCONNECT = "mtconnect";
+static const std::string SUBSYSTEM_CNC = "cnc";
+static const std::string SUBSYSTEM_GRIPPER = "gripper";
+static const std::string SUBSYSTEM_VISE = "vise";
+
+// data items and values served by the embedded SHDR adapter (as mapped in bridge_subscriber_config.yaml)
+static const std::string SHDR_AVAIL = "avail";
+static const std::string SHDR_MODE = "mode";
+static const std::string SHDR_REXEC = "rexec";
+static const std::string SHDR_C_UNCLAMP = "c_unclamp";
+static const std::string SHDR_S_INTER = "s_inter";
+static const std::string SHDR_UNAVAILABLE = "UNAVAILABLE";
+
 //convienence typdef for getting to mtconnect state (i.e. ready, not, ready, etc...)
 typedef mtconnect_msgs::SetMTConnectState::Request MtConnectState;
 
-StateMachine::StateMachine() :
-    nh_()
+StateMachine::StateMachine(const ros::NodeHandle &nh, const ros::NodeHandle &ph) :
+    nh_(nh), sensor_nh_(nh), action_nh_(nh), command_nh_(nh), ph_(ph)
 {
+  // high rate topics and action feedback don't wait behind each other or the state logic, the
+  // material goals are served by the state loop (i.e. never by a nodelet manager's spinner)
+  nh_.setCallbackQueue(&state_queue_);
+  sensor_nh_.setCallbackQueue(&sensor_queue_);
+  action_nh_.setCallbackQueue(&action_queue_);
+  command_nh_.setCallbackQueue(&command_queue_);
+
   // Setting default class values
   state_ = StateTypes::INVALID;
   loop_rate_ = 0;
@@ -77,34 +116,109 @@ StateMachine::StateMachine() :
   cycle_stop_req_= false;
   material_state_ = false;
   material_load_state_ = mtconnect_msgs::SetMTConnectState::Request::NOT_READY;
+  door_state_ = CncStates::UNAVAILABLE;
+  chuck_state_ = CncStates::UNAVAILABLE;
+  discovery_timeout_ = 0.0;
+  degraded_ = false;
+  recovery_distance_ = 0.0;
+  gripper_closed_ = true;
+  material_location_ = MaterialLocations::UNKNOWN;
+  fault_ = mtconnect_example_msgs::StateMachineStatus::NO_FAULT;
+  active_machine_ = 0;
 }
 
 StateMachine::~StateMachine()
 {
-
+  discovery_.stop();
+  if (stream_client_)
+  {
+    stream_client_->stop();
+  }
 }
 
 bool StateMachine::init()
 {
-  ros::NodeHandle ph("~");
   std::string task_desc;
 
-  if (!ph.getParam(PARAM_LOOP_RATE, loop_rate_))
+  if (!ph_.getParam(PARAM_LOOP_RATE, loop_rate_))
   {
     ROS_WARN_STREAM("Param: " << PARAM_LOOP_RATE << " not set, using default");
     loop_rate_ = 10;
   }
-  if (!ph.getParam(PARAM_CHECK_ENABLED, home_check_))
+  if (!ph_.getParam(PARAM_CHECK_ENABLED, home_check_))
   {
     ROS_WARN_STREAM("Param: " << PARAM_CHECK_ENABLED << "not set, setting enabled");
     home_check_ = true;
   }
-  if (!ph.getParam(PARAM_HOME_TOL, home_tol_))
+  if (!ph_.getParam(PARAM_HOME_TOL, home_tol_))
   {
     ROS_WARN_STREAM("Param: " << PARAM_HOME_TOL << " not set, using default");
     home_tol_ = 0.1; //radians
   }
-  if (!ph.getParam(PARAM_TASK_DESCRIPTION, task_desc))
+  ph_.param(PARAM_DISCOVERY_TIMEOUT, discovery_timeout_, 0.0);
+  bool swap_cycle;
+  double swap_wait;
+  ph_.param(PARAM_SWAP_CYCLE, swap_cycle, false);
+  ph_.param(PARAM_SWAP_WAIT, swap_wait, DEFAULT_SWAP_WAIT);
+  swap_.setEnabled(swap_cycle);
+  swap_.setWait(swap_wait);
+  double staging_lead, staging_timeout, stale_timeout;
+  ph_.param(PARAM_STAGING_LEAD, staging_lead, 0.0);
+  ph_.param(PARAM_STAGING_TIMEOUT, staging_timeout, DEFAULT_STAGING_TIMEOUT);
+  ph_.param(PARAM_STREAM_STALE_TIMEOUT, stale_timeout, DEFAULT_STREAM_STALE_TIMEOUT);
+  staging_.setLead(staging_lead);
+  staging_.setTimeout(staging_timeout);
+  staging_.setStaleTimeout(stale_timeout);
+  ph_.param(PARAM_RECOVERY_DISTANCE, recovery_distance_, 0.0);
+
+  // action deadlines, the default applies until enough latencies are known (zero disables)
+  double deadline_factor, deadline_default;
+  int deadline_samples;
+  ph_.param(PARAM_ACTION_DEADLINE_FACTOR, deadline_factor, mtconnect_example_utils::DEFAULT_DEADLINE_FACTOR);
+  ph_.param(PARAM_ACTION_DEADLINE_DEFAULT, deadline_default, mtconnect_example_utils::DEFAULT_ACTION_DEADLINE);
+  ph_.param(PARAM_ACTION_DEADLINE_SAMPLES, deadline_samples, mtconnect_example_utils::DEFAULT_DEADLINE_SAMPLES);
+  action_monitor_.setDeadlineFactor(deadline_factor);
+  action_monitor_.setDefaultDeadline(deadline_default);
+  action_monitor_.setMinSamples(deadline_samples);
+
+  // multi-machine mode, space separated machine namespaces (i.e. "cnc1 cnc2")
+  std::string machine_names;
+  ph_.param(PARAM_MACHINES, machine_names, std::string());
+  std::stringstream machine_ss(machine_names);
+  std::string machine_name;
+  while (machine_ss >> machine_name)
+  {
+    machine_names_.add(machine_name);
+    machines_.push_back(CncMachinePtr(new CncMachine()));
+  }
+  if (machines_.empty())
+  {
+    machine_names_.add("");
+    machines_.push_back(CncMachinePtr(new CncMachine()));
+  }
+  if (machines_.size() > 1)
+  {
+    // both follow the execution of a single cnc, the agent stream has no machine namespaces
+    ROS_WARN_STREAM("Tending " << machines_.size() << " machines (" << machine_names
+                    << "), the agent stream and staging are disabled in multi-machine mode");
+    staging_.setLead(0.0);
+  }
+
+  // unloading first by default, the machine has to be emptied before it can be loaded again
+  int queue_depth, load_priority, unload_priority;
+  double max_wait;
+  ph_.param(PARAM_MATERIAL_QUEUE_DEPTH, queue_depth, mtconnect_example_utils::DEFAULT_MATERIAL_QUEUE_DEPTH);
+  ph_.param(PARAM_MATERIAL_LOAD_PRIORITY, load_priority, 0);
+  ph_.param(PARAM_MATERIAL_UNLOAD_PRIORITY, unload_priority, 1);
+  ph_.param(PARAM_MATERIAL_MAX_WAIT, max_wait, mtconnect_example_utils::DEFAULT_MATERIAL_MAX_WAIT);
+  material_queue_.setMaxDepth(queue_depth * machines_.size());
+  material_queue_.setMaxWait(max_wait);
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    material_queue_.setPriority(getMachineAction(i, DEFAULT_MATERIAL_LOAD_ACTION), load_priority);
+    material_queue_.setPriority(getMachineAction(i, DEFAULT_MATERIAL_UNLOAD_ACTION), unload_priority);
+  }
+  if (!ph_.getParam(PARAM_TASK_DESCRIPTION, task_desc))
   {
     ROS_ERROR("Failed to load task description parameter");
     return false;
@@ -123,6 +237,12 @@ bool StateMachine::init()
     return false;
   }
 
+  if (swap_.isEnabled() && joint_paths_.find(KEY_JM_DROP_TO_APPROACH) == joint_paths_.end())
+  {
+    ROS_WARN_STREAM("Task description has no " << KEY_JM_DROP_TO_APPROACH << " path, swap cycle disabled");
+    swap_.setEnabled(false);
+  }
+
   ROS_INFO_STREAM("Adding home position from task description");
   home_ = points[KEY_HOME_POSITION];
   if (home_->values_.empty())
@@ -131,49 +251,173 @@ bool StateMachine::init()
     return false;
   }
 
-  // initializing action service servers
-  material_load_server_ptr_ = MaterialLoadServerPtr(new MaterialLoadServer(nh_, DEFAULT_MATERIAL_LOAD_ACTION, false));
-  material_load_server_ptr_->registerGoalCallback(boost::bind(&StateMachine::materialLoadGoalCB, this));
-  material_unload_server_ptr_ = MaterialUnloadServerPtr(
-      new MaterialUnloadServer(nh_, DEFAULT_MATERIAL_UNLOAD_ACTION, false));
-  material_unload_server_ptr_->registerGoalCallback(boost::bind(&StateMachine::materialUnloadGoalCB, this));
+  // every task path can be retraced on fault recovery, paths must be in the home joint order
+  recovery_planner_.setHome(home_->values_, home_tol_);
+  for (std::map<std::string, trajectory_msgs::JointTrajectoryPtr>::iterator iter = joint_paths_.begin();
+      iter != joint_paths_.end(); ++iter)
+  {
+    std::vector<std::vector<double> > points;
+    for (size_t i = 0; i < iter->second->points.size(); i++)
+    {
+      points.push_back(iter->second->points[i].positions);
+    }
+    if (iter->second->joint_names != home_->group_->joint_names_ || !recovery_planner_.addPath(iter->first, points))
+    {
+      ROS_WARN_STREAM("Path " << iter->first << " doesn't match the home joints, not used for recovery");
+    }
+  }
 
-  // initializing action service clients
-  open_door_client_ptr_ = CncOpenDoorClientPtr(new CncOpenDoorClient(DEFAULT_CNC_OPEN_DOOR_ACTION, false));
-  close_door_client_ptr_ = CncCloseDoorClientPtr(new CncCloseDoorClient(DEFAULT_CNC_CLOSE_DOOR_ACTION, false));
-  open_chuck_client_ptr_ = CncOpenChuckClientPtr(new CncOpenChuckClient(DEFAULT_CNC_OPEN_CHUCK_ACTION, false));
-  close_chuck_client_ptr_ = CncCloseChuckClientPtr(new CncCloseChuckClient(DEFAULT_CNC_CLOSE_CHUCK_ACTION, false));
-  grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(DEFAULT_GRASP_ACTION, false));
-  vise_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(DEFAULT_VISE_ACTION, false));
-  joint_traj_client_ptr_ = JointTractoryClientPtr(new JointTractoryClient(DEFAULT_JOINT_TRAJ_ACTION, false));
+  // initializing action service servers and clients of every machine
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    CncMachine &machine = *machines_[i];
+    machine.material_load_server_ptr_ = MaterialLoadServerPtr(
+        new MaterialLoadServer(nh_, getMachineAction(i, DEFAULT_MATERIAL_LOAD_ACTION), false));
+    machine.material_load_server_ptr_->registerGoalCallback(boost::bind(&StateMachine::materialLoadGoalCB, this, i));
+    machine.material_unload_server_ptr_ = MaterialUnloadServerPtr(
+        new MaterialUnloadServer(nh_, getMachineAction(i, DEFAULT_MATERIAL_UNLOAD_ACTION), false));
+    machine.material_unload_server_ptr_->registerGoalCallback(
+        boost::bind(&StateMachine::materialUnloadGoalCB, this, i));
+
+    machine.open_door_client_ptr_ = CncOpenDoorClientPtr(
+        new CncOpenDoorClient(action_nh_, getMachineAction(i, DEFAULT_CNC_OPEN_DOOR_ACTION), false));
+    machine.close_door_client_ptr_ = CncCloseDoorClientPtr(
+        new CncCloseDoorClient(action_nh_, getMachineAction(i, DEFAULT_CNC_CLOSE_DOOR_ACTION), false));
+    machine.open_chuck_client_ptr_ = CncOpenChuckClientPtr(
+        new CncOpenChuckClient(action_nh_, getMachineAction(i, DEFAULT_CNC_OPEN_CHUCK_ACTION), false));
+    machine.close_chuck_client_ptr_ = CncCloseChuckClientPtr(
+        new CncCloseChuckClient(action_nh_, getMachineAction(i, DEFAULT_CNC_CLOSE_CHUCK_ACTION), false));
+  }
+  selectMachine(0);
+  grasp_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(action_nh_, DEFAULT_GRASP_ACTION, false));
+  vise_action_client_ptr_ = GraspActionClientPtr(new GraspActionClient(action_nh_, DEFAULT_VISE_ACTION, false));
+  joint_traj_client_ptr_ = JointTractoryClientPtr(
+      new JointTractoryClient(action_nh_, DEFAULT_JOINT_TRAJ_ACTION, false));
 
   // initializing publishers
+  // optional in process adapter, the ros bridge keeps serving its own port
+  int shdr_adapter_port = 0;
+  ph_.param(PARAM_SHDR_ADAPTER_PORT, shdr_adapter_port, 0);
+  if (shdr_adapter_port > 0)
+  {
+    shdr_adapter_.reset(new ShdrAdapter());
+    if (!shdr_adapter_->start(shdr_adapter_port))
+    {
+      ROS_ERROR_STREAM("Failed to start the SHDR adapter on port " << shdr_adapter_port);
+      return false;
+    }
+  }
+
+  // optional agent stream, the cnc actions still run through the ros bridge
+  std::string agent_host;
+  ph_.param(PARAM_AGENT_HOST, agent_host, std::string());
+  if (!agent_host.empty() && machines_.size() == 1)
+  {
+    int agent_port, agent_interval;
+    std::string agent_device, door_item, chuck_item;
+    ph_.param(PARAM_AGENT_PORT, agent_port, 5000);
+    ph_.param(PARAM_AGENT_DEVICE, agent_device, std::string("/cnc"));
+    ph_.param(PARAM_AGENT_INTERVAL, agent_interval, DEFAULT_STREAM_INTERVAL);
+    ph_.param(PARAM_AGENT_DOOR_ITEM, door_item, std::string());
+    ph_.param(PARAM_AGENT_CHUCK_ITEM, chuck_item, std::string());
+
+    stream_client_.reset(new StreamClient());
+    stream_client_->init(agent_host, agent_port, agent_device, agent_interval);
+    stream_client_->subscribeDoorState(boost::bind(&StateMachine::doorStateCB, this, _1, _2), door_item);
+    stream_client_->subscribeChuckState(boost::bind(&StateMachine::chuckStateCB, this, _1, _2), chuck_item);
+    stream_client_->subscribeExecution(boost::bind(&StateMachine::executionCB, this, _1, _2));
+    stream_client_->setDocumentCallback(boost::bind(&StateMachine::streamDocumentCB, this));
+
+    // program progress in percent, the standard has no such data item (i.e. a custom sample)
+    std::string progress_type;
+    ph_.param(PARAM_STAGING_PROGRESS, progress_type, std::string());
+    if (!progress_type.empty())
+    {
+      stream_client_->subscribe(progress_type, boost::bind(&StateMachine::programProgressCB, this, _1));
+    }
+    stream_client_->start();
+  }
+
+  // staging follows the program execution, only the agent stream reports it
+  if (staging_.isEnabled() && !stream_client_)
+  {
+    ROS_WARN_STREAM("Staging requires the agent stream (" << PARAM_AGENT_HOST << "), staging disabled");
+    staging_.setLead(0.0);
+  }
+  if (staging_.isEnabled()
+      && (joint_paths_.find(KEY_JM_HOME_TO_STAGE) == joint_paths_.end()
+          || joint_paths_.find(KEY_JM_STAGE_TO_DOOR) == joint_paths_.end()
+          || joint_paths_.find(KEY_JM_STAGE_TO_HOME) == joint_paths_.end()))
+  {
+    ROS_WARN_STREAM("Task description has no staging paths, staging disabled");
+    staging_.setLead(0.0);
+  }
+
   robot_states_pub_ = nh_.advertise<mtconnect_msgs::RobotStates>(DEFAULT_ROBOT_STATES_TOPIC, 1);
   robot_spindle_pub_ = nh_.advertise<mtconnect_msgs::RobotSpindle>(DEFAULT_ROBOT_SPINDLE_TOPIC, 1);
   state_machine_pub_ = nh_.advertise<mtconnect_example_msgs::StateMachineStatus>(DEFAULT_SM_STATUS_TOPIC, 1);
+  material_queue_pub_ = nh_.advertise<mtconnect_example_msgs::MaterialQueueStatus>(DEFAULT_MATERIAL_QUEUE_TOPIC, 1);
 
   // initializing subscribers
-  robot_status_sub_ = nh_.subscribe(DEFAULT_ROBOT_STATUS_TOPIC, 1, &StateMachine::robotStatusCB, this);
-  joint_states_sub_ = nh_.subscribe(DEFAULT_JOINT_STATE_TOPIC, 1, &StateMachine::jointStatesCB, this);
+  robot_status_sub_ = sensor_nh_.subscribe(DEFAULT_ROBOT_STATUS_TOPIC, 1, &StateMachine::robotStatusCB, this);
+  joint_states_sub_ = sensor_nh_.subscribe(DEFAULT_JOINT_STATE_TOPIC, 1, &StateMachine::jointStatesCB, this);
 
   // initializing servers
-  external_command_srv_ = nh_.advertiseService(DEFAULT_EXTERNAL_COMMAND_SERVICE, &StateMachine::externalCommandCB,
-                                               this);
+  external_command_srv_ = command_nh_.advertiseService(DEFAULT_EXTERNAL_COMMAND_SERVICE,
+                                                       &StateMachine::externalCommandCB, this);
 
   // initializing clients
-  material_load_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(
-      DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE);
-  material_unload_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(
-      DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE);
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    machines_[i]->material_load_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(
+        getMachineAction(i, DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE));
+    machines_[i]->material_unload_set_state_client_ = nh_.serviceClient<mtconnect_msgs::SetMTConnectState>(
+        getMachineAction(i, DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE));
+  }
 
   trajectory_filter_client_ = nh_.serviceClient<arm_navigation_msgs::FilterJointTrajectoryWithConstraints>(
       DEFAULT_TRAJECTORY_FILTER_SERVICE);
 
+  // discovering all servers at once, the run loop spins the client callbacks
+  discovery_.addAction(DEFAULT_JOINT_TRAJ_ACTION, SUBSYSTEM_ROBOT, joint_traj_client_ptr_);
+  discovery_.addService(DEFAULT_TRAJECTORY_FILTER_SERVICE, SUBSYSTEM_ROBOT, trajectory_filter_client_);
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    const CncMachine &machine = *machines_[i];
+    discovery_.addService(getMachineAction(i, DEFAULT_MATERIAL_LOAD_SET_STATE_SERVICE), SUBSYSTEM_MTCONNECT,
+                          machine.material_load_set_state_client_);
+    discovery_.addService(getMachineAction(i, DEFAULT_MATERIAL_UNLOAD_SET_STATE_SERVICE), SUBSYSTEM_MTCONNECT,
+                          machine.material_unload_set_state_client_);
+    discovery_.addAction(getMachineAction(i, DEFAULT_CNC_OPEN_DOOR_ACTION), SUBSYSTEM_CNC,
+                         machine.open_door_client_ptr_);
+    discovery_.addAction(getMachineAction(i, DEFAULT_CNC_CLOSE_DOOR_ACTION), SUBSYSTEM_CNC,
+                         machine.close_door_client_ptr_);
+    discovery_.addAction(getMachineAction(i, DEFAULT_CNC_OPEN_CHUCK_ACTION), SUBSYSTEM_CNC,
+                         machine.open_chuck_client_ptr_);
+    discovery_.addAction(getMachineAction(i, DEFAULT_CNC_CLOSE_CHUCK_ACTION), SUBSYSTEM_CNC,
+                         machine.close_chuck_client_ptr_);
+  }
+  discovery_.addAction(DEFAULT_GRASP_ACTION, SUBSYSTEM_GRIPPER, grasp_action_client_ptr_);
+  discovery_.addAction(DEFAULT_VISE_ACTION, SUBSYSTEM_VISE, vise_action_client_ptr_);
+  discovery_.start();
+
   // starting action servers
-  material_load_server_ptr_->start();
-  material_unload_server_ptr_->start();
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    machines_[i]->material_load_server_ptr_->start();
+    machines_[i]->material_unload_server_ptr_->start();
+  }
+
+  // journal of every transition, a restart picks up where the last run stopped
+  std::string journal_path;
+  ph_.param(PARAM_JOURNAL, journal_path, std::string());
+  if (!journal_path.empty() && !journal_.open(journal_path))
+  {
+    ROS_ERROR_STREAM("Failed to open state journal: " << journal_path);
+    return false;
+  }
 
-  setState(StateTypes::IDLE);
+  setState(replayJournal());
 
   return true;
 
@@ -182,17 +426,30 @@ bool StateMachine::init()
 void StateMachine::run()
 {
   ROS_INFO_STREAM("Entering blocking run");
+
+  // one thread per queue, stopped when the loop exits
+  ros::AsyncSpinner sensor_spinner(1, &sensor_queue_);
+  ros::AsyncSpinner action_spinner(1, &action_queue_);
+  ros::AsyncSpinner command_spinner(1, &command_queue_);
+  sensor_spinner.start();
+  action_spinner.start();
+  command_spinner.start();
+
   ros::Rate r(loop_rate_);
   while (ros::ok())
   {
-    //ROS_INFO_STREAM_THROTTLE(5, "Begin blocking run loop, state: " << state_);
-    runOnce();
-    callPublishers();
-    ros::spinOnce();
-    errorChecks();
-    overrideChecks();
-    //ROS_INFO_STREAM_THROTTLE(5, "End blocking run loop, state: " << state_);
+    {
+      boost::mutex::scoped_lock lock(state_mutex_);
+      //ROS_INFO_STREAM_THROTTLE(5, "Begin blocking run loop, state: " << state_);
+      runOnce();
+      callPublishers();
+      state_queue_.callAvailable();
+      errorChecks();
+      overrideChecks();
+      //ROS_INFO_STREAM_THROTTLE(5, "End blocking run loop, state: " << state_);
+    }
     r.sleep();
+    boost::this_thread::interruption_point();
   }
 
 }
@@ -216,6 +473,7 @@ void StateMachine::runOnce()
       if ( isHome())
       {
         ROS_INFO_STREAM("Robot start home check passed");
+        discovery_start_ = ros::Time::now();
         setState(StateTypes::WAIT_FOR_ACTIONS);
       }
       else
@@ -232,7 +490,7 @@ void StateMachine::runOnce()
       }
       else
       {
-        ROS_INFO_STREAM_THROTTLE(20, "Waiting for actions to be ready");
+        ROS_INFO_STREAM_THROTTLE(20, "Waiting for actions to be ready, missing: " << discovery_.getMissingString());
       }
       break;
 
@@ -248,7 +506,13 @@ void StateMachine::runOnce()
       break;
 
     case StateTypes::SET_MAT_ACTIONS_READY:
-      if (setMatActionsReady())
+      if (isDegraded())
+      {
+        // material handling is only offered to the cnc once every subsystem is present
+        setMatActionsNotReady();
+        setState(StateTypes::WAITING);
+      }
+      else if (setMatActionsReady())
       {
         setState(StateTypes::WAITING);
       }
@@ -266,6 +530,15 @@ void StateMachine::runOnce()
         cycle_stop_req_ = false;
         setState(StateTypes::STOPPING);
       }
+      if (degraded_)
+      {
+        if (isDegraded())
+        {
+          ROS_WARN_STREAM_THROTTLE(20, "Degraded mode, missing: " << discovery_.getMissingString());
+          break;
+        }
+        setMatActionsReady();
+      }
       if(material_state_)
       {
         if(material_load_state_ != mtconnect_msgs::SetMTConnectState::Request::READY)
@@ -282,10 +555,15 @@ void StateMachine::runOnce()
           setMatLoad(mtconnect_msgs::SetMTConnectState::Request::NOT_READY);
         }
       }
+      if (state_ == StateTypes::WAITING && !admitMaterialRequest() && isStagingDue())
+      {
+        setState(StateTypes::MATERIAL_STAGING);
+      }
       break;
 
     case StateTypes::MATERIAL_LOADING:
       ROS_INFO_STREAM("++++++++++++++++++++++++ LOADING MATERIAL ++++++++++++++++++++++++");
+      cycle_start_ = ros::Time::now();
       setState(StateTypes::ML_MOVE_PICK_APPROACH);
       break;
 
@@ -331,6 +609,7 @@ void StateMachine::runOnce()
     case StateTypes::ML_WAIT_PICK:
       if (isGripperClosed() && isDoorOpened())
       {
+        material_location_ = MaterialLocations::GRIPPER;
         setState(StateTypes::ML_MOVE_CHUCK);
       }
       break;
@@ -367,6 +646,7 @@ void StateMachine::runOnce()
     case StateTypes::ML_WAIT_RELEASE_PART:
       if (isGripperOpened())
       {
+        material_location_ = MaterialLocations::CHUCK;
         setState(StateTypes::ML_MOVE_DOOR);
       }
       break;
@@ -398,6 +678,8 @@ void StateMachine::runOnce()
 
     case StateTypes::MATERIAL_LOADED:
       ROS_INFO_STREAM("Material loaded");
+      material_queue_.recordServiceTime(getMachineAction(active_machine_, DEFAULT_MATERIAL_LOAD_ACTION),
+                                        (ros::Time::now() - cycle_start_).toSec());
       load_res.load_state = "Succeeded";
       material_load_server_ptr_->setSucceeded(load_res);
       setState(StateTypes::WAITING);
@@ -408,6 +690,7 @@ void StateMachine::runOnce()
 
     case StateTypes::MATERIAL_UNLOADING:
       ROS_INFO_STREAM("++++++++++++++++++++++++ UNLOADING MATERIAL ++++++++++++++++++++++++");
+      cycle_start_ = ros::Time::now();
       setState(StateTypes::MU_MOVE_DOOR);
       break;
 
@@ -456,6 +739,7 @@ void StateMachine::runOnce()
     case StateTypes::MU_WAIT_OPEN_CHUCK:
       if(isChuckOpened())
       {
+        material_location_ = MaterialLocations::GRIPPER;
         setState(StateTypes::MU_MOVE_DROP);
       }
       break;
@@ -480,7 +764,8 @@ void StateMachine::runOnce()
     case StateTypes::MU_WAIT_DROP:
       if(isGripperOpened())
       {
-        setState(StateTypes::MU_MOVE_HOME);
+        material_location_ = MaterialLocations::NONE;
+        setState(swap_.getDropDone());
       }
       break;
 
@@ -498,6 +783,8 @@ void StateMachine::runOnce()
 
     case StateTypes::MATERIAL_UNLOADED:
       ROS_INFO_STREAM("Material unloaded");
+      material_queue_.recordServiceTime(getMachineAction(active_machine_, DEFAULT_MATERIAL_UNLOAD_ACTION),
+                                        (ros::Time::now() - cycle_start_).toSec());
       unload_res.unload_state = "Succeeded";
       material_unload_server_ptr_->setSucceeded(unload_res);
       setState(StateTypes::WAITING);
@@ -505,6 +792,143 @@ void StateMachine::runOnce()
 
 
 
+    case StateTypes::MATERIAL_SWAPPING:
+      // the finished part is out, the cnc sends its load request while the robot waits at the drop
+      ROS_INFO_STREAM("++++++++++++++++++++++++ SWAPPING MATERIAL ++++++++++++++++++++++++");
+      material_queue_.recordServiceTime(getMachineAction(active_machine_, DEFAULT_MATERIAL_UNLOAD_ACTION),
+                                        (ros::Time::now() - cycle_start_).toSec());
+      unload_res.unload_state = "Succeeded";
+      material_unload_server_ptr_->setSucceeded(unload_res);
+      swap_.begin(ros::Time::now().toSec());
+      setState(StateTypes::SW_WAIT_LOAD_REQUEST);
+      break;
+
+    case StateTypes::SW_WAIT_LOAD_REQUEST:
+    {
+      // a load request queued during the unload is taken right away, new ones in materialLoadGoalCB
+      bool accepted = false;
+      if (material_queue_.remove(getMachineAction(active_machine_, DEFAULT_MATERIAL_LOAD_ACTION))
+          && material_load_server_ptr_->isNewGoalAvailable())
+      {
+        material_load_server_ptr_->acceptNewGoal();
+        if (material_load_server_ptr_->isPreemptRequested())
+        {
+          ROS_INFO_STREAM("Queued material load request was canceled");
+          material_load_server_ptr_->setPreempted();
+          break;
+        }
+        ROS_INFO_STREAM("Accepting queued material load request, swapping without returning home");
+        cycle_start_ = ros::Time::now();
+        accepted = true;
+      }
+
+      StateType next = swap_.poll(accepted, !material_queue_.empty(), ros::Time::now().toSec());
+      if (next == StateTypes::SW_MOVE_HOME)
+      {
+        if (material_queue_.empty())
+        {
+          ROS_INFO_STREAM("No material load request after " << swap_.getWait() << " sec, returning home");
+        }
+        else
+        {
+          ROS_INFO_STREAM("Other material requests queued, returning home");
+        }
+      }
+      if (next != state_)
+      {
+        setState(next);
+      }
+      break;
+    }
+
+    // towards the pick the gripper is open from the drop and the door still open from the unload
+    case StateTypes::SW_MOVE_PICK_APPROACH:
+    case StateTypes::SW_MOVE_HOME:
+    {
+      std::string path;
+      StateType wait;
+      SwapCycle::getMove(state_, path, wait);
+      moveArm(path);
+      setState(wait);
+      break;
+    }
+
+    case StateTypes::SW_WAIT_MOVE_PICK_APPROACH:
+    case StateTypes::SW_WAIT_MOVE_HOME:
+      if (isMoveDone())
+      {
+        setState(SwapCycle::getMoveDone(state_));
+      }
+      break;
+
+    case StateTypes::MATERIAL_STAGING:
+      ROS_INFO_STREAM("++++++++++++++++++++++++ STAGING AT DOOR ++++++++++++++++++++++++");
+      // no break, moving to the staging point
+    case StateTypes::MS_MOVE_DOOR:
+    case StateTypes::MS_MOVE_HOME:
+    {
+      std::string path;
+      StateType wait;
+      StagingPlanner::getMove(state_, path, wait);
+      moveArm(path);
+      if (state_ == StateTypes::MS_MOVE_DOOR)
+      {
+        openDoor();
+      }
+      setState(wait);
+      break;
+    }
+
+    case StateTypes::MS_WAIT_MOVE_STAGE:
+    case StateTypes::MS_WAIT_MOVE_HOME:
+      if (isMoveDone())
+      {
+        setState(StagingPlanner::getMoveDone(state_));
+      }
+      break;
+
+    case StateTypes::MS_STAGED:
+    {
+      // an unload queued during the staging move is taken right away, new ones in materialUnloadGoalCB
+      bool accepted = false;
+      if (material_queue_.remove(getMachineAction(active_machine_, DEFAULT_MATERIAL_UNLOAD_ACTION))
+          && material_unload_server_ptr_->isNewGoalAvailable())
+      {
+        material_unload_server_ptr_->acceptNewGoal();
+        if (material_unload_server_ptr_->isPreemptRequested())
+        {
+          ROS_INFO_STREAM("Queued material unload request was canceled");
+          material_unload_server_ptr_->setPreempted();
+          break;
+        }
+        ROS_INFO_STREAM("Accepting queued material unload request at the staging point");
+        cycle_start_ = ros::Time::now();
+        accepted = true;
+      }
+
+      // the robot is needed elsewhere
+      if (!accepted && (cycle_stop_req_ || !material_queue_.empty()))
+      {
+        ROS_INFO_STREAM("Staging canceled, returning home");
+        setState(StateTypes::MS_MOVE_HOME);
+        break;
+      }
+
+      std::string reason;
+      StateType next = staging_.poll(cycle_predictor_, accepted, ros::Time::now().toSec(), reason);
+      if (next == StateTypes::MS_MOVE_HOME)
+      {
+        ROS_WARN_STREAM(reason << ", returning home");
+      }
+      if (next != state_)
+      {
+        setState(next);
+      }
+      break;
+    }
+
+
+
     case StateTypes::ABORTING:
       ROS_ERROR("Entering state machine abort sequence");
       setState(StateTypes::ABORT_GOALS);
@@ -528,6 +952,7 @@ void StateMachine::runOnce()
 
     case StateTypes::STOPPING:
       ROS_INFO_STREAM("Beginning system stop");
+      abortMaterialRequests();
       setState(StateTypes::S_SET_MAT_ACTIONS_NOT_READY);
       break;
 
@@ -542,6 +967,7 @@ void StateMachine::runOnce()
       break;
 
     case StateTypes::RESETTING:
+      setFault(mtconnect_example_msgs::StateMachineStatus::NO_FAULT, std::string(), 0.0, 0.0);
       setState(StateTypes::R_WAIT_FOR_HOME);
       break;
 
@@ -550,6 +976,10 @@ void StateMachine::runOnce()
       {
         setState(StateTypes::R_SET_MAT_ACTIONS_NOT_READY);
       }
+      else if (recovery_distance_ > 0.0)
+      {
+        setState(StateTypes::R_PLAN_RECOVERY);
+      }
       else
       {
         ROS_ERROR_STREAM("Robot not in home state for FAULT RESET");
@@ -557,6 +987,35 @@ void StateMachine::runOnce()
       }
       break;
 
+    case StateTypes::R_PLAN_RECOVERY:
+      if (planRecovery())
+      {
+        moveArm(KEY_JM_RECOVERY);
+        setState(StateTypes::R_WAIT_MOVE_RECOVERY);
+      }
+      else
+      {
+        ROS_ERROR_STREAM("No safe recovery route for FAULT RESET, robot must be moved home");
+        setState(StateTypes::ABORTING);
+      }
+      break;
+
+    case StateTypes::R_WAIT_MOVE_RECOVERY:
+      if (isMoveDone())
+      {
+        if (isHome())
+        {
+          ROS_INFO_STREAM("Robot recovered to home");
+          setState(StateTypes::R_SET_MAT_ACTIONS_NOT_READY);
+        }
+        else
+        {
+          ROS_ERROR_STREAM("Robot not in home state after recovery");
+          setState(StateTypes::ABORTING);
+        }
+      }
+      break;
+
     case StateTypes::R_SET_MAT_ACTIONS_NOT_READY:
       setMatActionsNotReady();
       setState(StateTypes::IDLE);
@@ -571,37 +1030,70 @@ void StateMachine::runOnce()
 
 bool StateMachine::areActionsReady()
 {
-  return open_door_client_ptr_->isServerConnected() && close_door_client_ptr_->isServerConnected()
-      && open_chuck_client_ptr_->isServerConnected() && close_chuck_client_ptr_->isServerConnected()
-      && grasp_action_client_ptr_->isServerConnected() && vise_action_client_ptr_->isServerConnected()
-      && joint_traj_client_ptr_->isServerConnected();
+  if (discovery_.isAllFound())
+  {
+    degraded_ = false;
+    return true;
+  }
+
+  if (discovery_timeout_ > 0.0 && (ros::Time::now() - discovery_start_).toSec() > discovery_timeout_
+      && discovery_.isSubsystemFound(SUBSYSTEM_ROBOT) && discovery_.isSubsystemFound(SUBSYSTEM_MTCONNECT))
+  {
+    ROS_WARN_STREAM("Discovery timed out, entering degraded mode, missing: " << discovery_.getMissingString());
+    degraded_ = true;
+    return true;
+  }
+
+  return false;
 }
 
 bool StateMachine::areServicesReady()
 {
-  return material_load_set_state_client_.exists() && material_unload_set_state_client_.exists()
-      && trajectory_filter_client_.exists();
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    if (!machines_[i]->material_load_set_state_client_.exists()
+        || !machines_[i]->material_unload_set_state_client_.exists())
+    {
+      return false;
+    }
+  }
+  return trajectory_filter_client_.exists();
 }
 
-void StateMachine::abortActionServers()
+bool StateMachine::isDegraded()
 {
-  ROS_INFO_STREAM("Checking material load action server");
-  if (material_load_server_ptr_->isActive())
+  if (degraded_ && discovery_.isAllFound())
   {
-    MaterialLoadServer::Result res;
-    res.load_state = "Failed";
-    material_load_server_ptr_->setAborted(res);
-    ROS_INFO_STREAM("Material Load goal aborted");
+    ROS_INFO_STREAM("All subsystems discovered, leaving degraded mode");
+    degraded_ = false;
   }
+  return degraded_;
+}
 
-  ROS_INFO_STREAM("Checking material unload action server");
-  if (material_unload_server_ptr_->isActive())
+void StateMachine::abortActionServers()
+{
+  for (size_t i = 0; i < machines_.size(); i++)
   {
-    MaterialUnloadServer::Result res;
-    res.unload_state = "Failed";
-    material_unload_server_ptr_->setAborted(res);
-    ROS_INFO_STREAM("Material Unload goal aborted");
+    ROS_INFO_STREAM("Checking material load action server");
+    if (machines_[i]->material_load_server_ptr_->isActive())
+    {
+      MaterialLoadServer::Result res;
+      res.load_state = "Failed";
+      machines_[i]->material_load_server_ptr_->setAborted(res);
+      ROS_INFO_STREAM("Material Load goal aborted");
+    }
+
+    ROS_INFO_STREAM("Checking material unload action server");
+    if (machines_[i]->material_unload_server_ptr_->isActive())
+    {
+      MaterialUnloadServer::Result res;
+      res.unload_state = "Failed";
+      machines_[i]->material_unload_server_ptr_->setAborted(res);
+      ROS_INFO_STREAM("Material Unload goal aborted");
+    }
   }
+
+  abortMaterialRequests();
 }
 
 void StateMachine::cancelActionClients()
@@ -609,15 +1101,130 @@ void StateMachine::cancelActionClients()
   ROS_INFO_STREAM("Canceling all action clients");
   joint_traj_client_ptr_->cancelAllGoals();
 
-  open_door_client_ptr_->cancelAllGoals();
-  open_chuck_client_ptr_->cancelAllGoals();
-  close_door_client_ptr_->cancelAllGoals();
-  close_chuck_client_ptr_->cancelAllGoals();
+  for (size_t i = 0; i < machines_.size(); i++)
+  {
+    machines_[i]->open_door_client_ptr_->cancelAllGoals();
+    machines_[i]->open_chuck_client_ptr_->cancelAllGoals();
+    machines_[i]->close_door_client_ptr_->cancelAllGoals();
+    machines_[i]->close_chuck_client_ptr_->cancelAllGoals();
+  }
 
   grasp_action_client_ptr_->cancelAllGoals();
   vise_action_client_ptr_->cancelAllGoals();
 }
 
+bool StateMachine::queueMaterialRequest(const std::string &name)
+{
+  // only requests that arrive during a cycle are held, the robot returns to waiting on its own
+  if (state_ <= StateTypes::CYCLE_BEGIN || state_ >= StateTypes::CYCLE_END)
+  {
+    return false;
+  }
+
+  if (!material_queue_.push(name, ros::Time::now().toSec()))
+  {
+    ROS_WARN_STREAM("Material request queue full (" << material_queue_.getMaxDepth() << "), rejecting " << name);
+    return false;
+  }
+
+  ROS_INFO_STREAM("Queued " << name << " request, queue depth: " << material_queue_.size());
+  return true;
+}
+
+bool StateMachine::admitMaterialRequest()
+{
+  std::string name;
+  std::string action;
+  size_t machine;
+  double waited;
+  while (material_queue_.pop(ros::Time::now().toSec(), name, waited))
+  {
+    if (!findMachineAction(name, machine, action))
+    {
+      ROS_WARN_STREAM("Queued " << name << " request has no machine, dropping it");
+      continue;
+    }
+    const MaterialLoadServerPtr &load_server = machines_[machine]->material_load_server_ptr_;
+    const MaterialUnloadServerPtr &unload_server = machines_[machine]->material_unload_server_ptr_;
+    if (action == DEFAULT_MATERIAL_LOAD_ACTION && load_server->isNewGoalAvailable())
+    {
+      load_server->acceptNewGoal();
+      if (load_server->isPreemptRequested())
+      {
+        ROS_INFO_STREAM("Queued material load request was canceled");
+        load_server->setPreempted();
+        continue;
+      }
+      ROS_INFO_STREAM("Accepting queued " << name << " request, waited " << waited << " sec");
+      selectMachine(machine);
+      setState(StateTypes::MATERIAL_LOADING);
+      return true;
+    }
+    if (action == DEFAULT_MATERIAL_UNLOAD_ACTION && unload_server->isNewGoalAvailable())
+    {
+      unload_server->acceptNewGoal();
+      if (unload_server->isPreemptRequested())
+      {
+        ROS_INFO_STREAM("Queued material unload request was canceled");
+        unload_server->setPreempted();
+        continue;
+      }
+      ROS_INFO_STREAM("Accepting queued " << name << " request, waited " << waited << " sec");
+      selectMachine(machine);
+      setState(StateTypes::MATERIAL_UNLOADING);
+      return true;
+    }
+    ROS_WARN_STREAM("Queued " << name << " request no longer pending, dropping it");
+  }
+  return false;
+}
+
+void StateMachine::abortMaterialRequests()
+{
+  // queued goals are still pending, they must be accepted before they can be aborted
+  std::string name;
+  std::string action;
+  size_t machine;
+  double waited;
+  while (material_queue_.pop(ros::Time::now().toSec(), name, waited))
+  {
+    if (!findMachineAction(name, machine, action))
+    {
+      continue;
+    }
+    const MaterialLoadServerPtr &load_server = machines_[machine]->material_load_server_ptr_;
+    const MaterialUnloadServerPtr &unload_server = machines_[machine]->material_unload_server_ptr_;
+    if (action == DEFAULT_MATERIAL_LOAD_ACTION && load_server->isNewGoalAvailable())
+    {
+      MaterialLoadServer::Result res;
+      res.load_state = "Failed";
+      load_server->acceptNewGoal();
+      load_server->setAborted(res);
+      ROS_INFO_STREAM("Queued " << name << " goal aborted");
+    }
+    else if (action == DEFAULT_MATERIAL_UNLOAD_ACTION && unload_server->isNewGoalAvailable())
+    {
+      MaterialUnloadServer::Result res;
+      res.unload_state = "Failed";
+      unload_server->acceptNewGoal();
+      unload_server->setAborted(res);
+      ROS_INFO_STREAM("Queued " << name << " goal aborted");
+    }
+  }
+}
+
+bool StateMachine::isStagingDue()
+{
+  double remaining;
+  if (!staging_.isDue(cycle_predictor_, material_queue_.empty(), ros::Time::now().toSec(), remaining))
+  {
+    return false;
+  }
+
+  ROS_INFO_STREAM("CNC program predicted to finish in " << remaining << " sec, staging");
+  return true;
+}
+
 bool StateMachine::setMatActionsReady()
 {
   return setMatLoad(mtconnect_msgs::SetMTConnectState::Request::READY)
@@ -632,27 +1239,34 @@ bool StateMachine::setMatActionsNotReady()
 
 bool StateMachine::setMatLoad(int state)
 {
-  bool rtn = false;
+  bool rtn = true;
   mat_load_set_state_.request.state_flag = state;
 
-  if (material_load_set_state_client_.call(mat_load_set_state_))
+  // every tended machine advertises the same robot readiness
+  for (size_t i = 0; i < machines_.size(); i++)
   {
-    if (mat_load_set_state_.response.accepted)
+    if (machines_[i]->material_load_set_state_client_.call(mat_load_set_state_))
     {
-      material_load_state_ = state;
-      ROS_INFO_STREAM("Material load set to: " << state);
-      rtn = true;
+      if (mat_load_set_state_.response.accepted)
+      {
+        ROS_INFO_STREAM("Material load set to: " << state);
+      }
+      else
+      {
+        ROS_WARN_STREAM("Material load failed to set to: " << state);
+        rtn = false;
+      }
     }
     else
     {
-      ROS_WARN_STREAM("Material load failed to set to: " << state);
+      ROS_WARN_STREAM("Material load service call failed");
       rtn = false;
     }
   }
-  else
+
+  if (rtn)
   {
-    ROS_WARN_STREAM("Material load service call failed");
-    rtn = false;
+    material_load_state_ = state;
   }
 
   return rtn;
@@ -660,27 +1274,29 @@ bool StateMachine::setMatLoad(int state)
 
 bool StateMachine::setMatUnload(int state)
 {
-  bool rtn = false;
+  bool rtn = true;
   mat_unload_set_state_.request.state_flag = state;
 
-  if (material_unload_set_state_client_.call(mat_unload_set_state_))
+  for (size_t i = 0; i < machines_.size(); i++)
   {
-    if (mat_unload_set_state_.response.accepted)
+    if (machines_[i]->material_unload_set_state_client_.call(mat_unload_set_state_))
     {
-      ROS_INFO_STREAM("Material unload set to: " << state);
-      rtn = true;
+      if (mat_unload_set_state_.response.accepted)
+      {
+        ROS_INFO_STREAM("Material unload set to: " << state);
+      }
+      else
+      {
+        ROS_WARN_STREAM("Material unload failed to set to: " << state);
+        rtn = false;
+      }
     }
     else
     {
-      ROS_WARN_STREAM("Material unload failed to set to: " << state);
+      ROS_WARN_STREAM("Material unload service call failed");
       rtn = false;
     }
   }
-  else
-  {
-    ROS_WARN_STREAM("Material unload service call failed");
-    rtn = false;
-  }
 
   return rtn;
 }
@@ -690,14 +1306,19 @@ void StateMachine::errorChecks()
   using namespace industrial_msgs;
   bool error = false;
 
-  if (robot_status_msg_.e_stopped.val == TriState::TRUE)
+  industrial_msgs::RobotStatus robot_status;
   {
-    ROS_ERROR_STREAM_THROTTLE(5, "Robot estopped(" << robot_status_msg_.e_stopped << " aborting");
+    boost::mutex::scoped_lock lock(sensor_mutex_);
+    robot_status = robot_status_msg_;
+  }
+  if (robot_status.e_stopped.val == TriState::TRUE)
+  {
+    ROS_ERROR_STREAM_THROTTLE(5, "Robot estopped(" << robot_status.e_stopped << " aborting");
     error = true;
   }
-  if (robot_status_msg_.in_error.val == TriState::TRUE)
+  if (robot_status.in_error.val == TriState::TRUE)
   {
-    ROS_ERROR_STREAM_THROTTLE(5, "General robot error(" << robot_status_msg_.in_error << " aborting");
+    ROS_ERROR_STREAM_THROTTLE(5, "General robot error(" << robot_status.in_error << " aborting");
     error = true;
   }
 
@@ -710,29 +1331,28 @@ void StateMachine::errorChecks()
 
 void StateMachine::overrideChecks()
 {
-  ros::NodeHandle ph("~");
   int state_override = StateTypes::INVALID;
-  ph.getParamCached(PARAM_STATE_OVERRIDE, state_override);
+  ph_.getParamCached(PARAM_STATE_OVERRIDE, state_override);
 
   int force_fault_state = StateTypes::INVALID;
-  ph.getParamCached(PARAM_FORCE_FAULT_STATE, force_fault_state);
+  ph_.getParamCached(PARAM_FORCE_FAULT_STATE, force_fault_state);
 
   if (state_override != StateTypes::INVALID)
   {
     ROS_WARN_STREAM("Overriding state to: " << StateTypes::STATE_MAP[state_override]);
     setState(StateType(state_override));
-    ph.setParam(PARAM_STATE_OVERRIDE, StateTypes::INVALID);
+    ph_.setParam(PARAM_STATE_OVERRIDE, StateTypes::INVALID);
   }
   if (state_ == force_fault_state)
   {
     ROS_ERROR_STREAM("Forcing fault from state: "<< StateTypes::STATE_MAP[state_]);
     setState(StateTypes::ABORTING);
-    ph.setParam(PARAM_FORCE_FAULT_STATE, StateTypes::INVALID);
+    ph_.setParam(PARAM_FORCE_FAULT_STATE, StateTypes::INVALID);
   }
 
   // Material state override (defaults to not having material, ie false)
   bool mat_param_state = false;
-  ph.getParamCached(PARAM_MAT_STATE, mat_param_state);
+  ph_.getParamCached(PARAM_MAT_STATE, mat_param_state);
 
   if (material_state_ != mat_param_state)
   {
@@ -747,6 +1367,62 @@ void StateMachine::callPublishers()
   robotStatusPublisher();
   robotSpindlePublisher();
   stateMachineStatusPublisher();
+  materialQueuePublisher();
+  shdrAdapterPublisher();
+}
+
+static std::string toShdrActive(int tri_state)
+{
+  using namespace industrial_msgs;
+  switch (tri_state)
+  {
+    case TriState::ENABLED:
+      return "ACTIVE";
+    case TriState::DISABLED:
+      return "NOT_READY";
+    default:
+      return SHDR_UNAVAILABLE;
+  }
+}
+
+void StateMachine::shdrAdapterPublisher()
+{
+  using namespace industrial_msgs;
+  if (!shdr_adapter_)
+  {
+    return;
+  }
+
+  switch (robot_state_msg_.avail.val)
+  {
+    case TriState::ENABLED:
+      shdr_adapter_->setValue(SHDR_AVAIL, "AVAILABLE");
+      break;
+    case TriState::DISABLED:
+      shdr_adapter_->setValue(SHDR_AVAIL, "NOT_READY");
+      break;
+    default:
+      shdr_adapter_->setValue(SHDR_AVAIL, SHDR_UNAVAILABLE);
+  }
+
+  switch (robot_state_msg_.mode.val)
+  {
+    case RobotMode::AUTO:
+      shdr_adapter_->setValue(SHDR_MODE, "AUTOMATIC");
+      break;
+    case RobotMode::MANUAL:
+      shdr_adapter_->setValue(SHDR_MODE, "MANUAL");
+      break;
+    default:
+      shdr_adapter_->setValue(SHDR_MODE, SHDR_UNAVAILABLE);
+  }
+
+  shdr_adapter_->setValue(SHDR_REXEC, toShdrActive(robot_state_msg_.rexec.val));
+  shdr_adapter_->setValue(SHDR_C_UNCLAMP, toShdrActive(robot_spindle_msg_.c_unclamp.val));
+  shdr_adapter_->setValue(SHDR_S_INTER, toShdrActive(robot_spindle_msg_.s_inter.val));
+
+  // whatever changed this cycle goes out on one line
+  shdr_adapter_->flush();
 }
 void StateMachine::robotStatusPublisher()
 {
@@ -796,65 +1472,185 @@ void StateMachine::stateMachineStatusPublisher()
   state_machine_stat_msg_.header.stamp = ros::Time::now();
   state_machine_stat_msg_.state = state_;
   state_machine_stat_msg_.state_name = StateTypes::STATE_MAP[state_];
+  state_machine_stat_msg_.machine = machine_names_.getName(active_machine_);
+  state_machine_stat_msg_.material_location = MaterialLocations::LOCATION_MAP[material_location_];
+  state_machine_stat_msg_.fault = fault_;
+  state_machine_stat_msg_.fault_action = fault_action_;
+  state_machine_stat_msg_.fault_elapsed = fault_elapsed_;
+  state_machine_stat_msg_.fault_deadline = fault_deadline_;
 
   state_machine_pub_.publish(state_machine_stat_msg_);
 }
 
+void StateMachine::materialQueuePublisher()
+{
+  ros::Time now = ros::Time::now();
+  material_queue_msg_.header.stamp = now;
+  material_queue_msg_.depth = material_queue_.size();
+  material_queue_msg_.max_depth = material_queue_.getMaxDepth();
+  material_queue_msg_.requests = material_queue_.getNames(now.toSec());
+  material_queue_msg_.oldest_wait = ros::Duration(material_queue_.getOldestWait(now.toSec()));
+  material_queue_msg_.last_wait = ros::Duration(material_queue_.getLastWait());
+
+  material_queue_pub_.publish(material_queue_msg_);
+}
+
 
 //Callbacks
-void StateMachine::materialLoadGoalCB(/*const MaterialLoadServer::GoalConstPtr &gh*/)
+void StateMachine::materialLoadGoalCB(size_t machine)
 {
+  const MaterialLoadServerPtr &server = machines_[machine]->material_load_server_ptr_;
+  const std::string name = getMachineAction(machine, DEFAULT_MATERIAL_LOAD_ACTION);
   switch (state_)
   {
     case StateTypes::WAITING:
-      ROS_INFO_STREAM("Accepting material load request");
-      material_load_server_ptr_->acceptNewGoal();
-      //setMatUnload(MtConnectState::NOT_READY);
-      setState(StateTypes::MATERIAL_LOADING);
+      if (degraded_ && !discovery_.isAllFound())
+      {
+        ROS_WARN_STREAM("Rejecting material load request, missing: " << discovery_.getMissingString());
+        MaterialLoadServer::Result res;
+        res.load_state = "Failed";
+        server->acceptNewGoal();
+        server->setAborted(res);
+        break;
+      }
+      if (material_queue_.empty())
+      {
+        ROS_INFO_STREAM("Accepting material load request: " << name);
+        selectMachine(machine);
+        server->acceptNewGoal();
+        //setMatUnload(MtConnectState::NOT_READY);
+        setState(StateTypes::MATERIAL_LOADING);
+        break;
+      }
+      // other requests are waiting, the scheduler picks from all of them
+      queueMaterialRequest(name);
       break;
+    case StateTypes::SW_WAIT_LOAD_REQUEST:
+      if (machine == active_machine_)
+      {
+        ROS_INFO_STREAM("Accepting material load request, swapping without returning home");
+        server->acceptNewGoal();
+        cycle_start_ = ros::Time::now();
+        setState(StateTypes::SW_MOVE_PICK_APPROACH);
+        break;
+      }
+      // no break, other machines are queued
     default:
+      if (queueMaterialRequest(name))
+      {
+        break;
+      }
       ROS_WARN_STREAM("Material load request received in wrong state: " << state_);
       MaterialLoadServer::Result res;
       res.load_state = "Failed";
-      material_load_server_ptr_->acceptNewGoal();
-      material_load_server_ptr_->setAborted(res);
+      server->acceptNewGoal();
+      server->setAborted(res);
       break;
   }
 }
-void StateMachine::materialUnloadGoalCB(/*const MaterialUnloadServer::GoalConstPtr &gh*/)
+void StateMachine::materialUnloadGoalCB(size_t machine)
 {
+  const MaterialUnloadServerPtr &server = machines_[machine]->material_unload_server_ptr_;
+  const std::string name = getMachineAction(machine, DEFAULT_MATERIAL_UNLOAD_ACTION);
   switch (state_)
   {
     case StateTypes::WAITING:
-      ROS_INFO_STREAM("Accepting material unload request");
-      material_unload_server_ptr_->acceptNewGoal();
-      //setMatLoad(MtConnectState::NOT_READY);
-      setState(StateTypes::MATERIAL_UNLOADING);
+      if (degraded_ && !discovery_.isAllFound())
+      {
+        ROS_WARN_STREAM("Rejecting material unload request, missing: " << discovery_.getMissingString());
+        MaterialUnloadServer::Result res;
+        res.unload_state = "Failed";
+        server->acceptNewGoal();
+        server->setAborted(res);
+        break;
+      }
+      if (material_queue_.empty())
+      {
+        ROS_INFO_STREAM("Accepting material unload request: " << name);
+        selectMachine(machine);
+        server->acceptNewGoal();
+        //setMatLoad(MtConnectState::NOT_READY);
+        setState(StateTypes::MATERIAL_UNLOADING);
+        break;
+      }
+      // other requests are waiting, the scheduler picks from all of them
+      queueMaterialRequest(name);
       break;
+    case StateTypes::MS_STAGED:
+      if (machine == active_machine_)
+      {
+        ROS_INFO_STREAM("Accepting material unload request at the staging point");
+        server->acceptNewGoal();
+        cycle_start_ = ros::Time::now();
+        setState(StateTypes::MS_MOVE_DOOR);
+        break;
+      }
+      // no break, other machines are queued
     default:
+      if (queueMaterialRequest(name))
+      {
+        break;
+      }
       ROS_WARN_STREAM("Material unload request received in wrong state: " << state_);
       MaterialUnloadServer::Result res;
       res.unload_state = "Failed";
-      material_unload_server_ptr_->acceptNewGoal();
-      material_unload_server_ptr_->setAborted(res);
+      server->acceptNewGoal();
+      server->setAborted(res);
       break;
   }
 }
 void StateMachine::robotStatusCB(const industrial_msgs::RobotStatusConstPtr &msg)
 {
+  boost::mutex::scoped_lock lock(sensor_mutex_);
   robot_status_msg_ = *msg;
 }
 
 void StateMachine::jointStatesCB(const sensor_msgs::JointStateConstPtr &msg)
 {
+  boost::mutex::scoped_lock lock(sensor_mutex_);
   joint_state_msg_ = *msg;
 }
 
+void StateMachine::doorStateCB(const std::string &name, CncState state)
+{
+  ROS_DEBUG_STREAM("Agent door state " << name << ": " << state);
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  door_state_ = state;
+}
+
+void StateMachine::chuckStateCB(const std::string &name, CncState state)
+{
+  ROS_DEBUG_STREAM("Agent chuck state " << name << ": " << state);
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  chuck_state_ = state;
+}
+
+void StateMachine::executionCB(const std::string &name, ExecutionState state)
+{
+  cycle_predictor_.setExecution(state, ros::Time::now().toSec());
+}
+
+void StateMachine::programProgressCB(const Observation &observation)
+{
+  double percent;
+  std::istringstream iss(observation.value_);
+  if (iss >> percent)
+  {
+    cycle_predictor_.setProgress(percent / 100.0, ros::Time::now().toSec());
+  }
+}
+
+void StateMachine::streamDocumentCB()
+{
+  staging_.setStreamStamp(ros::Time::now().toSec());
+}
+
 bool StateMachine::externalCommandCB(mtconnect_example_msgs::StateMachineCmd::Request &req,
                                      mtconnect_example_msgs::StateMachineCmd::Response &res)
 {
   using namespace mtconnect_example_msgs;
 
+  boost::mutex::scoped_lock lock(state_mutex_);
   switch (req.command)
   {
     case StateMachineCmd::Request::STOP:
@@ -906,20 +1702,34 @@ bool StateMachine::externalCommandCB(mtconnect_example_msgs::StateMachineCmd::Re
   return true;
 }
 
-bool StateMachine::isActionComplete(int action_state)
+bool StateMachine::isActionComplete(const std::string &action, int action_state)
 {
   bool rtn = false;
+  double now = ros::Time::now().toSec();
   switch (action_state)
   {
     case actionlib::SimpleClientGoalState::PENDING:
-      //ROS_INFO_STREAM_THROTTLE(1, "Action request is pending");
-      break;
-
     case actionlib::SimpleClientGoalState::ACTIVE:
-      //ROS_INFO_STREAM_THROTTLE(1, "Action request is active");
+      // a goal that never completes would hold the state machine forever
+      if (action_monitor_.isExpired(action, now))
+      {
+        double elapsed = action_monitor_.getElapsed(action, now);
+        double deadline = action_monitor_.getDeadline(action);
+        ROS_ERROR_STREAM("Action " << action << " stalled, no result after " << elapsed << " s (deadline: "
+            << deadline << " s, samples: " << action_monitor_.getSampleCount(action) << ")");
+        // the goal itself is cancelled right away, not only when aborting cancels the requests
+        if (action_cancels_.count(action))
+        {
+          action_cancels_[action]();
+        }
+        action_monitor_.cancel(action);
+        setFault(mtconnect_example_msgs::StateMachineStatus::ACTION_STALLED, action, elapsed, deadline);
+        setState(StateTypes::ABORTING);
+      }
       break;
 
     case actionlib::SimpleClientGoalState::SUCCEEDED:
+      // the latency was recorded by the done callback
       rtn = true;
       break;
 
@@ -928,12 +1738,18 @@ bool StateMachine::isActionComplete(int action_state)
     case actionlib::SimpleClientGoalState::REJECTED:
     case actionlib::SimpleClientGoalState::ABORTED:
       // These states indicate something bad happened
-      ROS_ERROR_STREAM("Bad action state: " << action_state);
+      ROS_ERROR_STREAM("Bad action state: " << action_state << ", action: " << action);
+      setFault(mtconnect_example_msgs::StateMachineStatus::ACTION_FAILED, action,
+               action_monitor_.getElapsed(action, now), action_monitor_.getDeadline(action));
+      action_monitor_.cancel(action);
       setState(StateTypes::ABORTING);
       break;
 
     default:
-      ROS_ERROR_STREAM("Unrecognized action state: " << action_state);
+      ROS_ERROR_STREAM("Unrecognized action state: " << action_state << ", action: " << action);
+      setFault(mtconnect_example_msgs::StateMachineStatus::ACTION_FAILED, action,
+               action_monitor_.getElapsed(action, now), action_monitor_.getDeadline(action));
+      action_monitor_.cancel(action);
       setState(StateTypes::ABORTING);
       break;
   }
@@ -941,9 +1757,62 @@ bool StateMachine::isActionComplete(int action_state)
   return rtn;
 }
 
+void StateMachine::actionDoneCB(const std::string &action, double start,
+                                const actionlib::SimpleClientGoalState &state)
+{
+  // runs on the action queue, the monitor is thread safe
+  if (state == actionlib::SimpleClientGoalState::SUCCEEDED)
+  {
+    double latency = action_monitor_.finish(action, start, ros::Time::now().toSec());
+    ROS_DEBUG_STREAM("Action " << action << " completed in " << latency << " s");
+  }
+}
+
+void StateMachine::setFault(int fault, const std::string &action, double elapsed, double deadline)
+{
+  fault_ = fault;
+  fault_action_ = action;
+  fault_elapsed_ = ros::Duration(elapsed);
+  fault_deadline_ = ros::Duration(deadline);
+}
+
+void StateMachine::selectMachine(size_t machine)
+{
+  if (machine != active_machine_)
+  {
+    ROS_INFO_STREAM("Tending machine: " << machine_names_.getName(machine));
+  }
+  active_machine_ = machine;
+  const CncMachinePtr &cnc = machines_[machine];
+  open_door_client_ptr_ = cnc->open_door_client_ptr_;
+  close_door_client_ptr_ = cnc->close_door_client_ptr_;
+  open_chuck_client_ptr_ = cnc->open_chuck_client_ptr_;
+  close_chuck_client_ptr_ = cnc->close_chuck_client_ptr_;
+  material_load_server_ptr_ = cnc->material_load_server_ptr_;
+  material_unload_server_ptr_ = cnc->material_unload_server_ptr_;
+}
+
+std::string StateMachine::getMachineAction(size_t machine, const std::string &action)
+{
+  return machine_names_.getAction(machine, action);
+}
+
+bool StateMachine::findMachineAction(const std::string &name, size_t &machine, std::string &action)
+{
+  return machine_names_.findAction(name, MATERIAL_ACTIONS, machine, action);
+}
+
+std::string StateMachine::getMachinePath(const std::string &path)
+{
+  // machine specific paths (i.e. cnc1/JM_HOME_TO_DOOR) override the shared ones
+  return machine_names_.getPath(active_machine_, path, joint_paths_);
+}
+
 bool StateMachine::moveArm(const std::string & move_name)
 {
-  joint_traj_goal_.trajectory = *joint_paths_[move_name];
+  // moves are timed per path, their durations differ too much to share a deadline
+  move_action_ = getMachinePath(move_name);
+  joint_traj_goal_.trajectory = *joint_paths_[move_action_];
   //ROS_INFO_STREAM("Filtering a joint trajectory with " << joint_traj_goal_.trajectory.points.size() << "points");
   trajectory_filter_.request.trajectory = joint_traj_goal_.trajectory;
   if (!joint_traj_goal_.trajectory.points.empty())
@@ -956,7 +1825,7 @@ bool StateMachine::moveArm(const std::string & move_name)
         //ROS_INFO("Trajectory successfully filtered...sending goal");
         joint_traj_goal_.trajectory = trajectory_filter_.response.trajectory;
         //ROS_INFO_STREAM("Sending a joint trajectory with " << joint_traj_goal_.trajectory.points.size() << "points");
-        joint_traj_client_ptr_->sendGoal(joint_traj_goal_);
+        sendGoal(move_action_, joint_traj_client_ptr_, joint_traj_goal_);
       }
       else
       {
@@ -982,7 +1851,7 @@ bool StateMachine::moveArm(const std::string & move_name)
 
 bool StateMachine::isMoveDone()
 {
-  return isActionComplete(joint_traj_client_ptr_->getState().state_);
+  return isActionComplete(move_action_, joint_traj_client_ptr_->getState().state_);
 }
 
 void StateMachine::openDoor()
@@ -990,12 +1859,24 @@ void StateMachine::openDoor()
   ROS_INFO_STREAM("======================== OPENING DOOR ========================");
   mtconnect_msgs::OpenDoorGoal goal;
   goal.open_door = MTCONNECT_ACTION_ACTIVE_FLAG;
-  open_door_client_ptr_->sendGoal(goal);
+  sendGoal(getMachineAction(active_machine_, DEFAULT_CNC_OPEN_DOOR_ACTION), open_door_client_ptr_, goal);
+
+  // only a state streamed after the command counts
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  door_state_ = CncStates::UNAVAILABLE;
 }
 
 bool StateMachine::isDoorOpened()
 {
-  return isActionComplete(open_door_client_ptr_->getState().state_);
+  {
+    boost::mutex::scoped_lock lock(cnc_state_mutex_);
+    if (door_state_ == CncStates::OPEN)
+    {
+      return true;
+    }
+  }
+  return isActionComplete(getMachineAction(active_machine_, DEFAULT_CNC_OPEN_DOOR_ACTION),
+                          open_door_client_ptr_->getState().state_);
 }
 
 void StateMachine::closeDoor()
@@ -1003,12 +1884,23 @@ void StateMachine::closeDoor()
   ROS_INFO_STREAM("======================== CLOSING_DOOR ========================");
   mtconnect_msgs::CloseDoorGoal goal;
   goal.close_door = MTCONNECT_ACTION_ACTIVE_FLAG;
-  close_door_client_ptr_->sendGoal(goal);
+  sendGoal(getMachineAction(active_machine_, DEFAULT_CNC_CLOSE_DOOR_ACTION), close_door_client_ptr_, goal);
+
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  door_state_ = CncStates::UNAVAILABLE;
 }
 
 bool StateMachine::isDoorClosed()
 {
-  return isActionComplete(close_door_client_ptr_->getState().state_);
+  {
+    boost::mutex::scoped_lock lock(cnc_state_mutex_);
+    if (door_state_ == CncStates::CLOSED)
+    {
+      return true;
+    }
+  }
+  return isActionComplete(getMachineAction(active_machine_, DEFAULT_CNC_CLOSE_DOOR_ACTION),
+                          close_door_client_ptr_->getState().state_);
 }
 
 void StateMachine::openChuck()
@@ -1017,17 +1909,28 @@ void StateMachine::openChuck()
   // Actual chuck
   mtconnect_msgs::OpenChuckGoal chuck_goal;
   chuck_goal.open_chuck = MTCONNECT_ACTION_ACTIVE_FLAG;
-  open_chuck_client_ptr_->sendGoal(chuck_goal);
+  sendGoal(getMachineAction(active_machine_, DEFAULT_CNC_OPEN_CHUCK_ACTION), open_chuck_client_ptr_, chuck_goal);
 
   // Simulated chuck
   object_manipulation_msgs::GraspHandPostureExecutionGoal vise_goal;
   vise_goal.goal = object_manipulation_msgs::GraspHandPostureExecutionGoal::RELEASE;
   vise_action_client_ptr_->sendGoal(vise_goal);
+
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  chuck_state_ = CncStates::UNAVAILABLE;
 }
 
 bool StateMachine::isChuckOpened()
 {
-  return isActionComplete(open_chuck_client_ptr_->getState().state_);
+  {
+    boost::mutex::scoped_lock lock(cnc_state_mutex_);
+    if (chuck_state_ == CncStates::OPEN)
+    {
+      return true;
+    }
+  }
+  return isActionComplete(getMachineAction(active_machine_, DEFAULT_CNC_OPEN_CHUCK_ACTION),
+                          open_chuck_client_ptr_->getState().state_);
 }
 
 void StateMachine::closeChuck()
@@ -1036,18 +1939,28 @@ void StateMachine::closeChuck()
   // Actual chuck
   mtconnect_msgs::CloseChuckGoal chuck_goal;
   chuck_goal.close_chuck = MTCONNECT_ACTION_ACTIVE_FLAG;
-  close_chuck_client_ptr_->sendGoal(chuck_goal);
+  sendGoal(getMachineAction(active_machine_, DEFAULT_CNC_CLOSE_CHUCK_ACTION), close_chuck_client_ptr_, chuck_goal);
 
   // Simulated chuck
   object_manipulation_msgs::GraspHandPostureExecutionGoal vise_goal;
   vise_goal.goal = object_manipulation_msgs::GraspHandPostureExecutionGoal::GRASP;
   vise_action_client_ptr_->sendGoal(vise_goal);
+
+  boost::mutex::scoped_lock lock(cnc_state_mutex_);
+  chuck_state_ = CncStates::UNAVAILABLE;
 }
 
 bool StateMachine::isChuckClosed()
 {
-  return isActionComplete(close_chuck_client_ptr_->getState().state_)
-      && isActionComplete(grasp_action_client_ptr_->getState().state_);
+  bool closed;
+  {
+    boost::mutex::scoped_lock lock(cnc_state_mutex_);
+    closed = chuck_state_ == CncStates::CLOSED;
+  }
+  return (closed
+      || isActionComplete(getMachineAction(active_machine_, DEFAULT_CNC_CLOSE_CHUCK_ACTION),
+                          close_chuck_client_ptr_->getState().state_))
+      && isActionComplete(DEFAULT_GRASP_ACTION, grasp_action_client_ptr_->getState().state_);
 }
 
 void StateMachine::openGripper()
@@ -1055,12 +1968,13 @@ void StateMachine::openGripper()
   ROS_INFO_STREAM("======================== OPENING GRIPPER ========================");
   object_manipulation_msgs::GraspHandPostureExecutionGoal goal;
   goal.goal = object_manipulation_msgs::GraspHandPostureExecutionGoal::RELEASE;
-  grasp_action_client_ptr_->sendGoal(goal);
+  sendGoal(DEFAULT_GRASP_ACTION, grasp_action_client_ptr_, goal);
+  gripper_closed_ = false;
 }
 
 bool StateMachine::isGripperOpened()
 {
-  return isActionComplete(grasp_action_client_ptr_->getState().state_);
+  return isActionComplete(DEFAULT_GRASP_ACTION, grasp_action_client_ptr_->getState().state_);
 }
 
 void StateMachine::closeGripper()
@@ -1068,12 +1982,13 @@ void StateMachine::closeGripper()
   ROS_INFO_STREAM("======================== CLOSING GRIPPER ========================");
   object_manipulation_msgs::GraspHandPostureExecutionGoal goal;
   goal.goal = object_manipulation_msgs::GraspHandPostureExecutionGoal::GRASP;
-  grasp_action_client_ptr_->sendGoal(goal);
+  sendGoal(DEFAULT_GRASP_ACTION, grasp_action_client_ptr_, goal);
+  gripper_closed_ = true;
 }
 
 bool StateMachine::isGripperClosed()
 {
-  return isActionComplete(grasp_action_client_ptr_->getState().state_);
+  return isActionComplete(DEFAULT_GRASP_ACTION, grasp_action_client_ptr_->getState().state_);
 }
 
 bool StateMachine::isHome()
@@ -1083,6 +1998,7 @@ bool StateMachine::isHome()
   if( home_check_ )
   {
     ROS_INFO_STREAM("Home checking ENABLED, returning range check");
+    boost::mutex::scoped_lock lock(sensor_mutex_);
     rtn = industrial_robot_client::utils::isWithinRange(home_->group_->joint_names_, home_->values_,
                                                       joint_state_msg_.name, joint_state_msg_.position, home_tol_);
   }
@@ -1094,3 +2010,160 @@ bool StateMachine::isHome()
 
   return rtn;
 }
+
+bool StateMachine::planRecovery()
+{
+  const std::vector<std::string> &joint_names = home_->group_->joint_names_;
+  sensor_msgs::JointState joint_state;
+  {
+    boost::mutex::scoped_lock lock(sensor_mutex_);
+    joint_state = joint_state_msg_;
+  }
+  std::vector<double> position;
+  for (size_t i = 0; i < joint_names.size(); i++)
+  {
+    std::vector<std::string>::const_iterator it = std::find(joint_state.name.begin(),
+                                                            joint_state.name.end(), joint_names[i]);
+    if (it == joint_state.name.end()
+        || static_cast<size_t>(it - joint_state.name.begin()) >= joint_state.position.size())
+    {
+      ROS_ERROR_STREAM("Joint state of " << joint_names[i] << " unknown, can't plan recovery");
+      return false;
+    }
+    position.push_back(joint_state.position[it - joint_state.name.begin()]);
+  }
+
+  CncState door_state, chuck_state;
+  {
+    boost::mutex::scoped_lock lock(cnc_state_mutex_);
+    door_state = door_state_;
+    chuck_state = chuck_state_;
+  }
+
+  // a part in the gripper (or one that may be) isn't pushed into the chuck or the pick station,
+  // it's only taken back to the pick station when that is empty
+  recovery_planner_.resetDirections();
+  bool holding = material_location_ == MaterialLocations::GRIPPER || material_location_ == MaterialLocations::UNKNOWN;
+  if (holding)
+  {
+    recovery_planner_.setDirection(KEY_JM_APPROACH_TO_PICK, PathDirections::REVERSE);
+    recovery_planner_.setDirection(KEY_JM_PICK_TO_CHUCK, material_state_ ? PathDirections::NONE : PathDirections::REVERSE);
+    recovery_planner_.setDirection(KEY_JM_DOOR_TO_CHUCK, PathDirections::REVERSE);
+    recovery_planner_.setDirection(KEY_JM_CHUCK_TO_DOOR, PathDirections::FORWARD);
+    recovery_planner_.setDirection(KEY_JM_CHUCK_TO_DROP, PathDirections::FORWARD);
+  }
+
+  // the paths inside the machine pass the door
+  if (door_state == CncStates::CLOSED)
+  {
+    recovery_planner_.setDirection(KEY_JM_PICK_TO_CHUCK, PathDirections::NONE);
+    recovery_planner_.setDirection(KEY_JM_DOOR_TO_CHUCK, PathDirections::NONE);
+    recovery_planner_.setDirection(KEY_JM_CHUCK_TO_DOOR, PathDirections::NONE);
+    recovery_planner_.setDirection(KEY_JM_CHUCK_TO_DROP, PathDirections::NONE);
+  }
+
+  RecoveryPlan plan;
+  if (!recovery_planner_.plan(position, recovery_distance_, plan))
+  {
+    ROS_ERROR_STREAM("No recovery route with the part location " << MaterialLocations::LOCATION_MAP[material_location_]
+                     << (door_state == CncStates::CLOSED ? " and the door closed" : ""));
+    return false;
+  }
+
+  // any move tears out a part the gripper may still be holding while the chuck isn't open
+  bool chuck_end = plan.path_ == KEY_JM_CHUCK_TO_DOOR || plan.path_ == KEY_JM_CHUCK_TO_DROP
+      ? plan.waypoint_ == 0
+      : (plan.path_ == KEY_JM_PICK_TO_CHUCK || plan.path_ == KEY_JM_DOOR_TO_CHUCK)
+          && plan.waypoint_ + 1 == joint_paths_[plan.path_]->points.size();
+  if (chuck_end && gripper_closed_ && chuck_state != CncStates::OPEN
+      && (holding || material_location_ == MaterialLocations::CHUCK))
+  {
+    ROS_ERROR_STREAM("Part may be held by both the gripper and the chuck, it must be released for FAULT RESET");
+    return false;
+  }
+  ROS_INFO_STREAM("Recovering " << plan.distance_ << " rad from waypoint " << plan.waypoint_ << " of "
+                  << plan.path_ << (plan.reverse_ ? ", retracing it" : ", completing it") << " home over "
+                  << plan.paths_.size() << " path(s)");
+
+  trajectory_msgs::JointTrajectoryPtr recovery(new trajectory_msgs::JointTrajectory());
+  recovery->joint_names = joint_names;
+  for (size_t i = 0; i < plan.points_.size(); i++)
+  {
+    trajectory_msgs::JointTrajectoryPoint point;
+    point.positions = plan.points_[i];
+    recovery->points.push_back(point);
+  }
+  joint_paths_[KEY_JM_RECOVERY] = recovery;
+  return true;
+}
+
+void StateMachine::journalState()
+{
+  if (!journal_.isOpen())
+  {
+    return;
+  }
+
+  JournalEntry entry;
+  entry.state_ = state_;
+  entry.material_ = material_location_;
+  entry.machine_ = active_machine_;
+  entry.stamp_ = ros::Time::now().toSec();
+  if (material_load_server_ptr_ && material_load_server_ptr_->isActive())
+  {
+    entry.goal_ = JournalGoals::MATERIAL_LOAD;
+  }
+  else if (material_unload_server_ptr_ && material_unload_server_ptr_->isActive())
+  {
+    entry.goal_ = JournalGoals::MATERIAL_UNLOAD;
+  }
+  journal_.append(entry);
+}
+
+StateType StateMachine::replayJournal()
+{
+  JournalEntry last;
+  if (!journal_.replay(last))
+  {
+    return StateTypes::IDLE;
+  }
+
+  StateType state = static_cast<StateType>(last.state_);
+  material_location_ = static_cast<MaterialLocation>(last.material_);
+  if (last.machine_ >= 0 && static_cast<size_t>(last.machine_) < machines_.size())
+  {
+    selectMachine(last.machine_);
+  }
+  ROS_WARN_STREAM("Restarted, last state: " << StateTypes::STATE_MAP[state] << ", part location: "
+                  << MaterialLocations::LOCATION_MAP[material_location_]);
+
+  // the run loop hasn't read the material parameter yet, the journal is checked against it here.
+  // A part in the gripper was taken from the pick station, the station can't report it as present.
+  ph_.param(PARAM_MAT_STATE, material_state_, false);
+  if (material_location_ == MaterialLocations::GRIPPER && material_state_)
+  {
+    ROS_ERROR_STREAM("Journal has the part in the gripper but " << PARAM_MAT_STATE
+                     << " reports it at the pick station, the part must be located before a fault reset");
+    return StateTypes::ABORTED;
+  }
+
+  if (state == StateTypes::WAITING)
+  {
+    // nothing was in progress, production resumes once the operator starts it again
+    return StateTypes::IDLE;
+  }
+
+  if ((state > StateTypes::CYCLE_BEGIN && state < StateTypes::CYCLE_END)
+      || (state >= StateTypes::ABORTING && state <= StateTypes::ABORTED))
+  {
+    // the robot stopped mid-move and the goal died with the node, a fault reset recovers it
+    if (last.goal_ != JournalGoals::NONE)
+    {
+      ROS_ERROR_STREAM("Material " << (last.goal_ == JournalGoals::MATERIAL_LOAD ? "load" : "unload")
+                       << " interrupted by the restart");
+    }
+    return StateTypes::ABORTED;
+  }
+
+  return StateTypes::IDLE;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/thread/thread.hpp>
+#include <mtconnect_state_machine/state_machine.h>
+
+namespace mtconnect_state_machine
+{
+
+/**
+ * \brief Loads the state machine into a nodelet manager (same as state_machine_node).
+ *
+ * init() and the blocking run() execute on a thread of their own.  The state machine spins
+ * its own callback queues (the manager's spinner never runs its callbacks) and reads its
+ * parameters from the private namespace of the nodelet.
+ */
+class StateMachineNodelet : public nodelet::Nodelet
+{
+public:
+  virtual ~StateMachineNodelet()
+  {
+    if (thread_)
+    {
+      thread_->interrupt();
+      thread_->join();
+    }
+  }
+
+protected:
+  virtual void onInit()
+  {
+    state_machine_ = boost::shared_ptr<StateMachine>(new StateMachine(getNodeHandle(), getPrivateNodeHandle()));
+    thread_ = boost::shared_ptr<boost::thread>(
+        new boost::thread(boost::bind(&StateMachineNodelet::run, this)));
+  }
+
+  void run()
+  {
+    if (state_machine_->init())
+    {
+      state_machine_->run();
+    }
+    else
+    {
+      NODELET_ERROR_STREAM("State machine failed to initialize");
+    }
+  }
+
+  boost::shared_ptr<StateMachine> state_machine_;
+  boost::shared_ptr<boost::thread> thread_;
+};
+
+}
+
+PLUGINLIB_DECLARE_CLASS(mtconnect_state_machine, StateMachineNodelet,
+                        mtconnect_state_machine::StateMachineNodelet, nodelet::Nodelet)
@@ -0,0 +1,858 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/stream_client.h>
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+#include <boost/assign/list_of.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace mtconnect_state_machine;
+
+static const int RECEIVE_POLL_PERIOD = 100; // milliseconds
+static const int RECEIVE_BUFFER_SIZE = 65536;
+static const double RECONNECT_DELAY = 1.0f; // seconds
+static const size_t MAX_CHUNK_DIGITS = 15;
+
+static const std::map<std::string, CncState> CNC_STATE_MAP = boost::assign::map_list_of
+    ("OPEN", CncStates::OPEN)("CLOSED", CncStates::CLOSED)("UNLATCHED", CncStates::UNLATCHED);
+
+static const std::map<std::string, ExecutionState> EXECUTION_MAP = boost::assign::map_list_of
+    ("READY", ExecutionStates::READY)("ACTIVE", ExecutionStates::ACTIVE)
+    ("INTERRUPTED", ExecutionStates::INTERRUPTED)("FEED_HOLD", ExecutionStates::FEED_HOLD)
+    ("STOPPED", ExecutionStates::STOPPED)("OPTIONAL_STOP", ExecutionStates::OPTIONAL_STOP)
+    ("PROGRAM_STOPPED", ExecutionStates::PROGRAM_STOPPED)
+    ("PROGRAM_COMPLETED", ExecutionStates::PROGRAM_COMPLETED);
+
+CncState mtconnect_state_machine::toCncState(const std::string &value)
+{
+  std::map<std::string, CncState>::const_iterator i = CNC_STATE_MAP.find(value);
+  return i == CNC_STATE_MAP.end() ? CncStates::UNAVAILABLE : i->second;
+}
+
+ExecutionState mtconnect_state_machine::toExecutionState(const std::string &value)
+{
+  std::map<std::string, ExecutionState>::const_iterator i = EXECUTION_MAP.find(value);
+  return i == EXECUTION_MAP.end() ? ExecutionStates::UNAVAILABLE : i->second;
+}
+
+static std::string toLower(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+  return text;
+}
+
+// ChunkDecoder
+
+ChunkDecoder::ChunkDecoder()
+{
+  reset();
+}
+
+void ChunkDecoder::reset()
+{
+  state_ = SIZE;
+  remaining_ = 0;
+  digits_ = 0;
+}
+
+bool ChunkDecoder::decode(const char *data, size_t size, std::string &out)
+{
+  size_t i = 0;
+  while (i < size && state_ != DONE)
+  {
+    char c = data[i];
+    switch (state_)
+    {
+      case SIZE:
+        if (isxdigit(c))
+        {
+          remaining_ = remaining_ * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+          if (++digits_ > (int)MAX_CHUNK_DIGITS)
+          {
+            return false;
+          }
+        }
+        else if (c == ';' || c == ' ' || c == '\t')
+        {
+          state_ = EXTENSION;
+        }
+        else if (c == '\r')
+        {
+          state_ = SIZE_LF;
+        }
+        else
+        {
+          return false;
+        }
+        i++;
+        break;
+
+      case EXTENSION:
+        // chunk extensions are ignored
+        state_ = c == '\r' ? SIZE_LF : EXTENSION;
+        i++;
+        break;
+
+      case SIZE_LF:
+        if (c != '\n' || digits_ == 0)
+        {
+          return false;
+        }
+        state_ = remaining_ == 0 ? DONE : DATA;
+        i++;
+        break;
+
+      case DATA:
+      {
+        // payload is copied in bulk, not byte by byte
+        size_t n = std::min(remaining_, size - i);
+        out.append(data + i, n);
+        i += n;
+        remaining_ -= n;
+        if (remaining_ == 0)
+        {
+          state_ = DATA_CR;
+        }
+        break;
+      }
+
+      case DATA_CR:
+        if (c != '\r')
+        {
+          return false;
+        }
+        state_ = DATA_LF;
+        i++;
+        break;
+
+      case DATA_LF:
+        if (c != '\n')
+        {
+          return false;
+        }
+        state_ = SIZE;
+        digits_ = 0;
+        i++;
+        break;
+
+      case DONE:
+        break;
+    }
+  }
+  return true;
+}
+
+// MultipartReader
+
+void MultipartReader::setBoundary(const std::string &boundary)
+{
+  boundary_ = "--" + boundary;
+  clear();
+}
+
+void MultipartReader::clear()
+{
+  buffer_.clear();
+  valid_ = true;
+}
+
+bool MultipartReader::next(std::string &document)
+{
+  if (!valid_)
+  {
+    return false;
+  }
+
+  size_t start = buffer_.find(boundary_);
+  if (start == std::string::npos)
+  {
+    return false;
+  }
+
+  // only line breaks may separate the parts
+  if (buffer_.find_first_not_of("\r\n") < start)
+  {
+    ROS_ERROR_STREAM("Stream framing error, data outside of a part");
+    valid_ = false;
+    return false;
+  }
+
+  size_t header_end = buffer_.find("\r\n\r\n", start);
+  if (header_end == std::string::npos)
+  {
+    return false;
+  }
+
+  std::string headers = toLower(buffer_.substr(start, header_end - start));
+  size_t length_pos = headers.find("content-length:");
+  if (length_pos == std::string::npos)
+  {
+    ROS_ERROR_STREAM("Stream framing error, part without a content length");
+    valid_ = false;
+    return false;
+  }
+
+  size_t length = strtoul(headers.c_str() + length_pos + strlen("content-length:"), NULL, 10);
+  size_t body = header_end + 4;
+  if (buffer_.size() < body + length)
+  {
+    return false;
+  }
+
+  document = buffer_.substr(body, length);
+  buffer_.erase(0, body + length);
+  return true;
+}
+
+// XmlPullParser
+
+XmlPullParser::XmlPullParser(const std::string &xml) :
+    xml_(xml), pos_(0)
+{
+}
+
+std::string XmlPullParser::getAttribute(const std::string &name) const
+{
+  for (unsigned int i = 0; i < attributes_.size(); i++)
+  {
+    if (attributes_[i].first == name)
+    {
+      return attributes_[i].second;
+    }
+  }
+  return std::string();
+}
+
+std::string XmlPullParser::unescape(const std::string &text)
+{
+  if (text.find('&') == std::string::npos)
+  {
+    return text;
+  }
+
+  std::string out;
+  size_t i = 0;
+  while (i < text.size())
+  {
+    size_t semi = text[i] == '&' ? text.find(';', i) : std::string::npos;
+    if (semi == std::string::npos)
+    {
+      out += text[i++];
+      continue;
+    }
+
+    std::string entity = text.substr(i + 1, semi - i - 1);
+    if (entity == "lt")
+      out += '<';
+    else if (entity == "gt")
+      out += '>';
+    else if (entity == "amp")
+      out += '&';
+    else if (entity == "quot")
+      out += '"';
+    else if (entity == "apos")
+      out += '\'';
+    else if (entity.size() > 1 && entity[0] == '#')
+      out += (char)strtol(entity.c_str() + (entity[1] == 'x' ? 2 : 1), NULL, entity[1] == 'x' ? 16 : 10);
+    else
+      out += "&" + entity + ";";
+    i = semi + 1;
+  }
+  return out;
+}
+
+bool XmlPullParser::next()
+{
+  while (true)
+  {
+    size_t lt = xml_.find('<', pos_);
+    if (lt == std::string::npos || lt + 1 >= xml_.size())
+    {
+      return false;
+    }
+
+    // comments, declarations, processing instructions and end tags
+    if (xml_.compare(lt, 4, "<!--") == 0)
+    {
+      size_t end = xml_.find("-->", lt);
+      pos_ = end == std::string::npos ? xml_.size() : end + 3;
+      continue;
+    }
+
+    if (xml_[lt + 1] == '?' || xml_[lt + 1] == '!' || xml_[lt + 1] == '/')
+    {
+      size_t end = xml_.find('>', lt);
+      pos_ = end == std::string::npos ? xml_.size() : end + 1;
+      continue;
+    }
+
+    size_t i = lt + 1;
+    size_t name_end = xml_.find_first_of(" \t\r\n/>", i);
+    if (name_end == std::string::npos)
+    {
+      return false;
+    }
+    name_ = xml_.substr(i, name_end - i);
+    attributes_.clear();
+    text_.clear();
+
+    // namespace prefixes are not needed for streams documents
+    size_t colon = name_.find(':');
+    if (colon != std::string::npos)
+    {
+      name_ = name_.substr(colon + 1);
+    }
+
+    i = name_end;
+    bool closed = false;
+    while (true)
+    {
+      i = xml_.find_first_not_of(" \t\r\n", i);
+      if (i == std::string::npos)
+      {
+        return false;
+      }
+
+      if (xml_[i] == '>')
+      {
+        i++;
+        break;
+      }
+
+      if (xml_.compare(i, 2, "/>") == 0)
+      {
+        closed = true;
+        i += 2;
+        break;
+      }
+
+      size_t eq = xml_.find('=', i);
+      if (eq == std::string::npos || eq + 1 >= xml_.size())
+      {
+        return false;
+      }
+      std::string key = xml_.substr(i, eq - i);
+      key.erase(key.find_last_not_of(" \t\r\n") + 1);
+
+      size_t quote = xml_.find_first_of("\"'", eq + 1);
+      if (quote == std::string::npos)
+      {
+        return false;
+      }
+      size_t value_end = xml_.find(xml_[quote], quote + 1);
+      if (value_end == std::string::npos)
+      {
+        return false;
+      }
+
+      attributes_.push_back(std::make_pair(key, unescape(xml_.substr(quote + 1, value_end - quote - 1))));
+      i = value_end + 1;
+    }
+    pos_ = i;
+
+    // leaf elements carry the value
+    if (!closed)
+    {
+      size_t next_lt = xml_.find('<', pos_);
+      if (next_lt != std::string::npos && xml_.compare(next_lt, 2, "</") == 0)
+      {
+        text_ = unescape(xml_.substr(pos_, next_lt - pos_));
+      }
+    }
+    return true;
+  }
+}
+
+bool mtconnect_state_machine::parseStreams(const std::string &xml, StreamHeader &header,
+                                           std::vector<Observation> &observations)
+{
+  XmlPullParser parser(xml);
+  bool streams = false;
+  while (parser.next())
+  {
+    const std::string &name = parser.getName();
+    if (name == "MTConnectStreams")
+    {
+      streams = true;
+    }
+    else if (name == "Header")
+    {
+      header.instance_id_ = strtoull(parser.getAttribute("instanceId").c_str(), NULL, 10);
+      header.first_sequence_ = strtoull(parser.getAttribute("firstSequence").c_str(), NULL, 10);
+      header.next_sequence_ = strtoull(parser.getAttribute("nextSequence").c_str(), NULL, 10);
+    }
+    else if (streams)
+    {
+      std::string sequence = parser.getAttribute("sequence");
+      if (sequence.empty())
+      {
+        continue;
+      }
+
+      Observation observation;
+      observation.type_ = name;
+      observation.name_ = parser.getAttribute("name");
+      observation.data_item_id_ = parser.getAttribute("dataItemId");
+      observation.timestamp_ = parser.getAttribute("timestamp");
+      observation.value_ = parser.getText();
+      observation.sequence_ = strtoull(sequence.c_str(), NULL, 10);
+      observations.push_back(observation);
+    }
+  }
+  return streams;
+}
+
+// StreamClient
+
+static void dispatchCncState(StreamClient::CncStateCallback callback, const std::string &name,
+                             const Observation &observation)
+{
+  // a device may have several doors or chucks, only the configured data item is followed
+  if (!name.empty() && observation.name_ != name && observation.data_item_id_ != name)
+  {
+    return;
+  }
+  callback(observation.name_, toCncState(observation.value_));
+}
+
+static void dispatchExecution(StreamClient::ExecutionCallback callback, const Observation &observation)
+{
+  callback(observation.name_, toExecutionState(observation.value_));
+}
+
+StreamClient::StreamClient() :
+    port_(0), interval_(DEFAULT_STREAM_INTERVAL), running_(false), instance_id_(0), next_sequence_(0), gaps_(0)
+{
+}
+
+StreamClient::~StreamClient()
+{
+  stop();
+}
+
+void StreamClient::init(const std::string &host, int port, const std::string &device, int interval)
+{
+  host_ = host;
+  port_ = port;
+  device_ = device;
+  interval_ = interval;
+}
+
+void StreamClient::subscribe(const std::string &type, ObservationCallback callback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  subscribers_[type].push_back(callback);
+}
+
+void StreamClient::subscribeDoorState(CncStateCallback callback, const std::string &name)
+{
+  subscribe("DoorState", boost::bind(&dispatchCncState, callback, name, _1));
+}
+
+void StreamClient::subscribeChuckState(CncStateCallback callback, const std::string &name)
+{
+  subscribe("ChuckState", boost::bind(&dispatchCncState, callback, name, _1));
+}
+
+void StreamClient::subscribeExecution(ExecutionCallback callback)
+{
+  subscribe("Execution", boost::bind(&dispatchExecution, callback, _1));
+}
+
+void StreamClient::setGapCallback(GapCallback callback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  gap_callback_ = callback;
+}
+
+void StreamClient::setDocumentCallback(DocumentCallback callback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  document_callback_ = callback;
+}
+
+void StreamClient::start()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!running_)
+  {
+    running_ = true;
+    thread_ = boost::thread(boost::bind(&StreamClient::run, this));
+  }
+}
+
+void StreamClient::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+  }
+
+  if (thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+bool StreamClient::isRunning()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return running_;
+}
+
+void StreamClient::resetSequence()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  next_sequence_ = 0;
+}
+
+unsigned long long StreamClient::getNextSequence()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return next_sequence_;
+}
+
+unsigned int StreamClient::getGapCount()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return gaps_;
+}
+
+bool StreamClient::processDocument(const std::string &xml)
+{
+  StreamHeader header;
+  std::vector<Observation> observations;
+  if (!parseStreams(xml, header, observations))
+  {
+    // i.e. an MTConnectError for a sequence the agent no longer has
+    ROS_WARN_STREAM("Agent stream returned a document that is not a streams document");
+    return false;
+  }
+
+  unsigned long long expected;
+  bool gap;
+  GapCallback gap_callback;
+  DocumentCallback document_callback;
+  std::map<std::string, std::vector<ObservationCallback> > subscribers;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    expected = next_sequence_;
+    gap = expected != 0 && (header.instance_id_ != instance_id_ || header.first_sequence_ > expected);
+    instance_id_ = header.instance_id_;
+    if (gap)
+    {
+      gaps_++;
+      gap_callback = gap_callback_;
+    }
+    else
+    {
+      next_sequence_ = std::max(next_sequence_, header.next_sequence_);
+      document_callback = document_callback_;
+      subscribers = subscribers_;
+    }
+  }
+
+  if (gap)
+  {
+    ROS_WARN_STREAM("Agent stream gap, expected sequence " << expected << " but the agent starts at "
+                    << header.first_sequence_ << ", resynchronizing");
+    if (gap_callback)
+    {
+      gap_callback(expected, header.first_sequence_);
+    }
+    return false;
+  }
+
+  if (document_callback)
+  {
+    document_callback();
+  }
+
+  for (unsigned int i = 0; i < observations.size(); i++)
+  {
+    // observations already seen before a reconnect are skipped
+    if (observations[i].sequence_ < expected)
+    {
+      continue;
+    }
+
+    std::map<std::string, std::vector<ObservationCallback> >::iterator s = subscribers.find(observations[i].type_);
+    if (s != subscribers.end())
+    {
+      for (unsigned int j = 0; j < s->second.size(); j++)
+      {
+        s->second[j](observations[i]);
+      }
+    }
+  }
+  return true;
+}
+
+int StreamClient::request(const std::string &path)
+{
+  struct addrinfo hints;
+  struct addrinfo *result = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  std::stringstream port;
+  port << port_;
+  if (getaddrinfo(host_.c_str(), port.str().c_str(), &hints, &result) != 0 || result == NULL)
+  {
+    ROS_WARN_STREAM("Failed to resolve agent host " << host_);
+    return -1;
+  }
+
+  int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+  if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+
+  if (fd < 0)
+  {
+    ROS_WARN_STREAM("Failed to connect to the agent at " << host_ << ":" << port_);
+    return -1;
+  }
+
+  std::stringstream ss;
+  ss << "GET " << path << " HTTP/1.1\r\n" << "Host: " << host_ << ":" << port_ << "\r\n" << "Accept: */*\r\n\r\n";
+  std::string text = ss.str();
+  if (send(fd, text.c_str(), text.size(), MSG_NOSIGNAL) != (int)text.size())
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int StreamClient::receive(int fd, char *buffer, size_t size)
+{
+  struct pollfd fds;
+  fds.fd = fd;
+  fds.events = POLLIN;
+  int ready = poll(&fds, 1, RECEIVE_POLL_PERIOD);
+  if (!isRunning() || ready < 0)
+  {
+    return -1;
+  }
+
+  if (ready == 0)
+  {
+    return 0;
+  }
+
+  int received = recv(fd, buffer, size, 0);
+  return received > 0 ? received : -1;
+}
+
+bool StreamClient::readHeaders(int fd, std::map<std::string, std::string> &headers, std::string &rest)
+{
+  std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+  std::string text;
+  size_t end;
+  while ((end = text.find("\r\n\r\n")) == std::string::npos)
+  {
+    int received = receive(fd, &buffer[0], buffer.size());
+    if (received < 0)
+    {
+      return false;
+    }
+    text.append(&buffer[0], received);
+  }
+  rest = text.substr(end + 4);
+
+  std::stringstream lines(text.substr(0, end));
+  std::string line;
+  std::getline(lines, line);
+  if (line.find(" 200") == std::string::npos)
+  {
+    ROS_WARN_STREAM("Agent request failed: " << line);
+    return false;
+  }
+
+  while (std::getline(lines, line))
+  {
+    size_t colon = line.find(':');
+    if (colon != std::string::npos)
+    {
+      std::string value = line.substr(colon + 1);
+      value.erase(0, value.find_first_not_of(" \t"));
+      value.erase(value.find_last_not_of(" \t\r") + 1);
+      headers[toLower(line.substr(0, colon))] = value;
+    }
+  }
+  return true;
+}
+
+bool StreamClient::readCurrent()
+{
+  int fd = request(device_ + "/current");
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  std::map<std::string, std::string> headers;
+  std::string rest;
+  bool ok = readHeaders(fd, headers, rest);
+
+  std::string body;
+  ChunkDecoder decoder;
+  bool chunked = toLower(headers["transfer-encoding"]) == "chunked";
+  size_t length = headers.count("content-length") ? strtoul(headers["content-length"].c_str(), NULL, 10) : 0;
+  if (chunked)
+  {
+    ok = ok && decoder.decode(rest.c_str(), rest.size(), body);
+  }
+  else
+  {
+    body = rest;
+  }
+
+  std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+  while (ok && (chunked ? !decoder.isDone() : body.size() < length))
+  {
+    int received = receive(fd, &buffer[0], buffer.size());
+    if (received < 0)
+    {
+      ok = false;
+    }
+    else if (chunked)
+    {
+      ok = decoder.decode(&buffer[0], received, body);
+    }
+    else
+    {
+      body.append(&buffer[0], received);
+    }
+  }
+  close(fd);
+
+  // the current state is dispatched as is, the sample stream continues after it
+  resetSequence();
+  return ok && processDocument(body);
+}
+
+bool StreamClient::readStream()
+{
+  std::stringstream path;
+  path << device_ << "/sample?interval=" << interval_ << "&count=" << DEFAULT_STREAM_COUNT << "&from="
+      << getNextSequence();
+
+  int fd = request(path.str());
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  std::map<std::string, std::string> headers;
+  std::string rest;
+  if (!readHeaders(fd, headers, rest))
+  {
+    close(fd);
+    return false;
+  }
+
+  std::string content_type = headers["content-type"];
+  size_t boundary_pos = content_type.find("boundary=");
+  if (boundary_pos == std::string::npos)
+  {
+    ROS_ERROR_STREAM("Agent stream without a multipart boundary: " << content_type);
+    close(fd);
+    return false;
+  }
+  std::string boundary = content_type.substr(boundary_pos + strlen("boundary="));
+  boundary = boundary.substr(0, boundary.find(';'));
+  boundary.erase(std::remove(boundary.begin(), boundary.end(), '"'), boundary.end());
+
+  ChunkDecoder decoder;
+  MultipartReader reader;
+  reader.setBoundary(boundary);
+  bool chunked = toLower(headers["transfer-encoding"]) == "chunked";
+
+  std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+  std::string decoded;
+  std::string document;
+  bool ok = true;
+  const char *data = rest.c_str();
+  int size = rest.size();
+  while (ok && size >= 0)
+  {
+    decoded.clear();
+    if (chunked)
+    {
+      ok = decoder.decode(data, size, decoded);
+    }
+    else
+    {
+      decoded.assign(data, size);
+    }
+    reader.append(decoded);
+
+    while (ok && reader.next(document))
+    {
+      if (!processDocument(document))
+      {
+        close(fd);
+        return true;
+      }
+    }
+    ok = ok && reader.isValid() && !decoder.isDone();
+
+    data = &buffer[0];
+    size = ok ? receive(fd, &buffer[0], buffer.size()) : -1;
+  }
+
+  close(fd);
+  return false;
+}
+
+void StreamClient::run()
+{
+  ROS_INFO_STREAM("Streaming " << device_ << " from the agent at " << host_ << ":" << port_);
+  while (isRunning())
+  {
+    // a gap resynchronizes right away, connection errors wait for the agent
+    if (readCurrent() && readStream())
+    {
+      continue;
+    }
+
+    if (!isRunning())
+    {
+      break;
+    }
+
+    // short reconnect delay, the stream is what the state machine waits for
+    for (int i = 0; i < RECONNECT_DELAY * 1000 / RECEIVE_POLL_PERIOD && isRunning(); i++)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(RECEIVE_POLL_PERIOD));
+    }
+  }
+}
@@ -0,0 +1,489 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Serves a stand-in MTConnect agent for the cnc device and toggles its door state, then
+ * measures how long each change takes to reach the in process stream client and (when the
+ * ros bridge publisher is pointed at the same agent) the CncResponseTopic published by the
+ * python path.  Both are reported as latency percentiles from the time the agent had the
+ * change.
+ */
+
+#include <mtconnect_state_machine/stream_client.h>
+#include <ros/ros.h>
+#include <mtconnect_msgs/CncStatus.h>
+#include <industrial_msgs/TriState.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace mtconnect_state_machine;
+
+static const std::string PARAM_AGENT_PORT = "agent_port";
+static const std::string PARAM_SAMPLES = "samples";
+static const std::string PARAM_TOGGLE_PERIOD = "toggle_period";
+static const std::string PARAM_INTERVAL = "interval";
+static const std::string PARAM_STARTUP_DELAY = "startup_delay";
+
+static const std::string DEFAULT_CNC_RESPONSE_TOPIC = "CncResponseTopic";
+static const int DEFAULT_AGENT_PORT = 5000;
+static const int DEFAULT_SAMPLES = 50;
+static const double DEFAULT_TOGGLE_PERIOD = 2.0f; // seconds, longer than the python publisher needs
+static const double DEFAULT_STARTUP_DELAY = 5.0f; // seconds, lets the ros bridge connect
+
+static const std::string DEVICE = "/cnc";
+static const std::string BOUNDARY = "7b3e9c1a5f20d4e8"; // long_pull.py only accepts hex boundaries
+static const int HEARTBEAT = 1000; // milliseconds
+static const int SERVICE_POLL_PERIOD = 100; // milliseconds
+
+static std::string timestamp()
+{
+  return boost::posix_time::to_iso_extended_string(boost::posix_time::microsec_clock::universal_time()) + "Z";
+}
+
+/**
+ * \brief Minimal agent serving /current and chunked multipart /sample streams of one device.
+ *
+ * Every observation is kept so that the sequence never leaves the buffer, and the sample stream
+ * honours the requested interval between documents like the agent does.
+ */
+class StandInAgent
+{
+public:
+  StandInAgent() :
+      listen_fd_(-1), running_(false), instance_id_(time(NULL)), next_sequence_(1)
+  {
+  }
+
+  ~StandInAgent()
+  {
+    stop();
+  }
+
+  bool start(int port)
+  {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 4) != 0)
+    {
+      ROS_ERROR_STREAM("Stand-in agent failed to listen on port " << port);
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+
+    // the data items the ros bridge publisher checks for
+    setValue("OpenDoor", "open_door", "READY");
+    setValue("CloseDoor", "close_door", "READY");
+    setValue("DoorState", "door_state", "CLOSED");
+    setValue("OpenChuck", "open_chuck", "READY");
+    setValue("CloseChuck", "close_chuck", "READY");
+    setValue("ChuckState", "chuck_state", "CLOSED");
+    setValue("MaterialLoad", "material_load", "READY");
+    setValue("MaterialUnload", "material_unload", "READY");
+
+    running_ = true;
+    accept_thread_ = boost::thread(boost::bind(&StandInAgent::acceptLoop, this));
+    ROS_INFO_STREAM("Stand-in agent serving " << DEVICE << " on port " << port);
+    return true;
+  }
+
+  void stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      running_ = false;
+      condition_.notify_all();
+    }
+    accept_thread_.join();
+    clients_.join_all();
+
+    if (listen_fd_ >= 0)
+    {
+      close(listen_fd_);
+      listen_fd_ = -1;
+    }
+  }
+
+  /**
+   * \brief Adds an observation, returns its sequence
+   */
+  unsigned long long setValue(const std::string &type, const std::string &name, const std::string &value)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    Observation observation;
+    observation.type_ = type;
+    observation.name_ = name;
+    observation.data_item_id_ = "cnc_" + name;
+    observation.value_ = value;
+    observation.timestamp_ = timestamp();
+    observation.sequence_ = next_sequence_++;
+    observations_.push_back(observation);
+    condition_.notify_all();
+    return observation.sequence_;
+  }
+
+protected:
+
+  std::string document(unsigned long long from, bool current)
+  {
+    std::stringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<MTConnectStreams xmlns=\"urn:mtconnect.org:MTConnectStreams:1.2\">\n"
+        << "  <Header creationTime=\"" << timestamp() << "\" sender=\"benchmark\" instanceId=\""
+        << instance_id_ << "\" version=\"1.2\" bufferSize=\"131072\" firstSequence=\"1\" lastSequence=\""
+        << next_sequence_ - 1 << "\" nextSequence=\"" << next_sequence_ << "\"/>\n"
+        << "  <Streams><DeviceStream name=\"cnc\" uuid=\"cnc\"><ComponentStream component=\"Device\" name=\"cnc\">"
+        << "<Events>\n";
+    for (unsigned int i = 0; i < observations_.size(); i++)
+    {
+      const Observation &o = observations_[i];
+      bool latest = true;
+      for (unsigned int j = i + 1; current && j < observations_.size() && latest; j++)
+      {
+        latest = observations_[j].type_ != o.type_;
+      }
+
+      if (o.sequence_ >= from && latest)
+      {
+        ss << "    <" << o.type_ << " dataItemId=\"" << o.data_item_id_ << "\" name=\"" << o.name_ << "\" sequence=\""
+            << o.sequence_ << "\" timestamp=\"" << o.timestamp_ << "\">" << o.value_ << "</" << o.type_ << ">\n";
+      }
+    }
+    ss << "  </Events></ComponentStream></DeviceStream></Streams>\n</MTConnectStreams>\n";
+    return ss.str();
+  }
+
+  bool sendAll(int fd, const std::string &data)
+  {
+    return send(fd, data.c_str(), data.size(), MSG_NOSIGNAL) == (int)data.size();
+  }
+
+  void acceptLoop()
+  {
+    struct pollfd fds;
+    fds.fd = listen_fd_;
+    fds.events = POLLIN;
+    while (isRunning())
+    {
+      if (poll(&fds, 1, SERVICE_POLL_PERIOD) > 0)
+      {
+        int fd = accept(listen_fd_, NULL, NULL);
+        if (fd >= 0)
+        {
+          int nodelay = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+          clients_.create_thread(boost::bind(&StandInAgent::serve, this, fd));
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief Answers requests on one (keep alive) connection
+   */
+  void serve(int fd)
+  {
+    std::string request;
+    char buffer[1024];
+    while (isRunning())
+    {
+      size_t end = request.find("\r\n\r\n");
+      if (end == std::string::npos)
+      {
+        struct pollfd fds;
+        fds.fd = fd;
+        fds.events = POLLIN;
+        if (poll(&fds, 1, SERVICE_POLL_PERIOD) == 0)
+        {
+          continue;
+        }
+
+        int received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+          break;
+        }
+        request.append(buffer, received);
+        continue;
+      }
+
+      std::string line = request.substr(0, request.find("\r\n"));
+      request.erase(0, end + 4);
+
+      size_t path_start = line.find(' ') + 1;
+      std::string path = line.substr(path_start, line.find(' ', path_start) - path_start);
+      if (path.find(DEVICE + "/current") == 0)
+      {
+        std::string body;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          body = document(0, true);
+        }
+        std::stringstream ss;
+        ss << "HTTP/1.1 200 OK\r\nContent-Type: text/xml\r\nContent-Length: " << body.size() << "\r\n\r\n" << body;
+        if (!sendAll(fd, ss.str()))
+        {
+          break;
+        }
+      }
+      else if (path.find(DEVICE + "/sample") == 0)
+      {
+        stream(fd, path);
+        break;
+      }
+      else
+      {
+        sendAll(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+      }
+    }
+    close(fd);
+  }
+
+  static unsigned long long queryValue(const std::string &path, const std::string &key, unsigned long long value)
+  {
+    size_t pos = path.find(key + "=");
+    return pos == std::string::npos ? value : strtoull(path.c_str() + pos + key.size() + 1, NULL, 10);
+  }
+
+  void stream(int fd, const std::string &path)
+  {
+    unsigned long long from = queryValue(path, "from", 0);
+    int interval = queryValue(path, "interval", 0);
+    if (!sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace;boundary=" + BOUNDARY
+        + "\r\nTransfer-Encoding: chunked\r\n\r\n"))
+    {
+      return;
+    }
+
+    while (true)
+    {
+      std::string body;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(HEARTBEAT);
+        while (running_ && next_sequence_ <= from && condition_.timed_wait(lock, timeout))
+        {
+        }
+
+        if (!running_)
+        {
+          return;
+        }
+        body = document(from, false);
+        from = next_sequence_;
+      }
+
+      std::stringstream part;
+      part << "--" << BOUNDARY << "\r\nContent-type: text/xml\r\nContent-length: " << body.size() << "\r\n\r\n"
+          << body;
+      std::stringstream chunk;
+      chunk << std::hex << part.str().size() << "\r\n" << part.str() << "\r\n";
+      if (!sendAll(fd, chunk.str()))
+      {
+        return;
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(interval));
+    }
+  }
+
+  bool isRunning()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return running_;
+  }
+
+protected:
+
+  int listen_fd_;
+  bool running_;
+  unsigned long long instance_id_;
+  unsigned long long next_sequence_;
+  std::vector<Observation> observations_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  boost::thread accept_thread_;
+  boost::thread_group clients_;
+};
+
+class StreamClientBenchmark
+{
+public:
+  StreamClientBenchmark(ros::NodeHandle &nh, StandInAgent &agent) :
+      agent_(agent)
+  {
+    response_sub_ = nh.subscribe(DEFAULT_CNC_RESPONSE_TOPIC, 10, &StreamClientBenchmark::cncResponseCB, this);
+  }
+
+  void observationCB(const Observation &observation)
+  {
+    ros::WallTime now = ros::WallTime::now();
+    boost::mutex::scoped_lock lock(mutex_);
+    for (unsigned int i = 0; i < toggles_.size(); i++)
+    {
+      if (toggles_[i].sequence_ == observation.sequence_)
+      {
+        cpp_latencies_.push_back((now - toggles_[i].time_).toSec());
+      }
+    }
+  }
+
+  void cncResponseCB(const mtconnect_msgs::CncStatusConstPtr &msg)
+  {
+    // the python publisher repeats the last state at 10 Hz, only the first one after a toggle counts
+    ros::WallTime now = ros::WallTime::now();
+    boost::mutex::scoped_lock lock(mutex_);
+    if (toggles_.empty() || toggles_.back().python_seen_)
+    {
+      return;
+    }
+
+    Toggle &toggle = toggles_.back();
+    if (msg->door_state.val == (toggle.open_ ? industrial_msgs::TriState::OPEN : industrial_msgs::TriState::CLOSED))
+    {
+      python_latencies_.push_back((now - toggle.time_).toSec());
+      toggle.python_seen_ = true;
+    }
+  }
+
+  void run(int samples, double period)
+  {
+    bool open = false;
+    for (int i = 0; i < samples && ros::ok(); i++)
+    {
+      open = !open;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        Toggle toggle;
+        toggle.open_ = open;
+        toggle.time_ = ros::WallTime::now();
+        toggle.sequence_ = agent_.setValue("DoorState", "door_state", open ? "OPEN" : "CLOSED");
+        toggle.python_seen_ = false;
+        toggles_.push_back(toggle);
+      }
+      ros::WallDuration(period).sleep();
+    }
+  }
+
+  void report()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::stringstream ss;
+    ss << "Stream client benchmark, " << toggles_.size() << " door state changes";
+    report(ss, "stream client (c++)", cpp_latencies_);
+    report(ss, "ros bridge (python) CncResponseTopic", python_latencies_);
+    ROS_INFO_STREAM(ss.str());
+  }
+
+protected:
+
+  struct Toggle
+  {
+    bool open_;
+    ros::WallTime time_;
+    unsigned long long sequence_;
+    bool python_seen_;
+  };
+
+  void report(std::stringstream &ss, const std::string &path, std::vector<double> latencies)
+  {
+    ss << "\n\t" << path << ": " << latencies.size() << " received";
+    if (latencies.empty())
+    {
+      return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    ss << ", latency (ms): p50 " << percentile(latencies, 0.5) * 1000 << ", p90 " << percentile(latencies, 0.9) * 1000
+        << ", p99 " << percentile(latencies, 0.99) * 1000 << ", max " << latencies.back() * 1000;
+  }
+
+  static double percentile(const std::vector<double> &sorted, double p)
+  {
+    unsigned int index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+  }
+
+protected:
+
+  StandInAgent &agent_;
+  ros::Subscriber response_sub_;
+  boost::mutex mutex_;
+  std::vector<Toggle> toggles_;
+  std::vector<double> cpp_latencies_;
+  std::vector<double> python_latencies_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "stream_client_benchmark");
+  ros::NodeHandle nh;
+  ros::NodeHandle ph("~");
+  int port, samples, interval;
+  double period, startup_delay;
+
+  ph.param(PARAM_AGENT_PORT, port, DEFAULT_AGENT_PORT);
+  ph.param(PARAM_SAMPLES, samples, DEFAULT_SAMPLES);
+  ph.param(PARAM_TOGGLE_PERIOD, period, DEFAULT_TOGGLE_PERIOD);
+  ph.param(PARAM_INTERVAL, interval, DEFAULT_STREAM_INTERVAL);
+  ph.param(PARAM_STARTUP_DELAY, startup_delay, DEFAULT_STARTUP_DELAY);
+
+  StandInAgent agent;
+  if (!agent.start(port))
+  {
+    return 1;
+  }
+
+  StreamClientBenchmark benchmark(nh, agent);
+  StreamClient client;
+  client.init("127.0.0.1", port, DEVICE, interval);
+  client.subscribe("DoorState", boost::bind(&StreamClientBenchmark::observationCB, &benchmark, _1));
+  client.start();
+
+  // topic callbacks run on the spinner while the main thread drives the agent
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  ros::WallDuration(startup_delay).sleep();
+  benchmark.run(samples, period);
+  benchmark.report();
+
+  spinner.stop();
+  client.stop();
+  agent.stop();
+  return 0;
+}
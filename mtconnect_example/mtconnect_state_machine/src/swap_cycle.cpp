@@ -0,0 +1,83 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <mtconnect_state_machine/swap_cycle.h>
+
+using namespace mtconnect_state_machine;
+
+SwapCycle::SwapCycle() :
+    enabled_(false), wait_(DEFAULT_SWAP_WAIT), start_(0.0)
+{
+}
+
+StateType SwapCycle::getDropDone() const
+{
+  return enabled_ ? StateTypes::MATERIAL_SWAPPING : StateTypes::MU_MOVE_HOME;
+}
+
+void SwapCycle::begin(double now)
+{
+  start_ = now;
+}
+
+StateType SwapCycle::poll(bool load_accepted, bool others_queued, double now) const
+{
+  if (load_accepted)
+  {
+    return StateTypes::SW_MOVE_PICK_APPROACH;
+  }
+
+  // other machines are scheduled from home
+  if (others_queued || now - start_ > wait_)
+  {
+    return StateTypes::SW_MOVE_HOME;
+  }
+  return StateTypes::SW_WAIT_LOAD_REQUEST;
+}
+
+bool SwapCycle::getMove(StateType state, std::string &path, StateType &wait)
+{
+  switch (state)
+  {
+    case StateTypes::SW_MOVE_PICK_APPROACH:
+      path = KEY_JM_DROP_TO_APPROACH;
+      wait = StateTypes::SW_WAIT_MOVE_PICK_APPROACH;
+      return true;
+
+    case StateTypes::SW_MOVE_HOME:
+      path = KEY_JM_DROP_TO_HOME;
+      wait = StateTypes::SW_WAIT_MOVE_HOME;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+StateType SwapCycle::getMoveDone(StateType wait)
+{
+  switch (wait)
+  {
+    case StateTypes::SW_WAIT_MOVE_PICK_APPROACH:
+      return StateTypes::ML_MOVE_PICK;
+
+    case StateTypes::SW_WAIT_MOVE_HOME:
+      return StateTypes::WAITING;
+
+    default:
+      return StateTypes::INVALID;
+  }
+}
@@ -0,0 +1,784 @@
+/*
+ * Copyright 2013 Southwest Research Institute
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "mtconnect_state_machine/shdr_adapter.h"
+#include "mtconnect_state_machine/stream_client.h"
+#include "mtconnect_state_machine/cycle_predictor.h"
+#include "mtconnect_state_machine/recovery_planner.h"
+#include "mtconnect_state_machine/state_journal.h"
+#include "mtconnect_state_machine/swap_cycle.h"
+#include "mtconnect_state_machine/machine_names.h"
+#include "mtconnect_state_machine/staging_planner.h"
+#include "mtconnect_example_utils/material_request_queue.h"
+
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace mtconnect_state_machine;
+
+static const int TEST_PORT = 17878;
+
+/*
+ * Connects like an agent would
+ */
+static int connectAgent()
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons(TEST_PORT);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Reads one line (without the timestamp), empty if nothing arrives within a second
+ */
+static std::string readLine(int fd)
+{
+  std::string line;
+  char c;
+  struct pollfd fds;
+  fds.fd = fd;
+  fds.events = POLLIN;
+  while (poll(&fds, 1, 1000) > 0 && recv(fd, &c, 1, 0) == 1 && c != '\n')
+  {
+    line += c;
+  }
+
+  // the pong has no timestamp
+  std::string::size_type bar = line.find('|');
+  return bar == std::string::npos ? line : line.substr(bar);
+}
+
+TEST(ShdrAdapter, format_line)
+{
+  std::vector<std::pair<std::string, std::string> > items;
+  items.push_back(std::make_pair("avail", "AVAILABLE"));
+  items.push_back(std::make_pair("mode", "AUTOMATIC"));
+
+  EXPECT_EQ("2013-01-01T00:00:00.000000Z|avail|AVAILABLE|mode|AUTOMATIC\n",
+            ShdrAdapter::formatLine("2013-01-01T00:00:00.000000Z", items));
+  EXPECT_EQ('Z', ShdrAdapter::timestamp()[ShdrAdapter::timestamp().size() - 1]);
+}
+
+TEST(ShdrAdapter, changed_items_and_heartbeat)
+{
+  ShdrAdapter adapter;
+  adapter.setValue("avail", "AVAILABLE");
+  adapter.setValue("mode", "MANUAL");
+  ASSERT_TRUE(adapter.start(TEST_PORT, 5000));
+  EXPECT_EQ(2, adapter.flush());
+
+  int fd = connectAgent();
+  ASSERT_GE(fd, 0);
+
+  // a new agent gets every item on one line
+  EXPECT_EQ("|avail|AVAILABLE|mode|MANUAL", readLine(fd));
+
+  // only changes are sent afterwards, batched
+  adapter.setValue("avail", "AVAILABLE");
+  EXPECT_EQ(0, adapter.flush());
+  adapter.setValue("mode", "AUTOMATIC");
+  adapter.setValue("rexec", "ACTIVE");
+  EXPECT_EQ(2, adapter.flush());
+  EXPECT_EQ("|mode|AUTOMATIC|rexec|ACTIVE", readLine(fd));
+
+  ASSERT_EQ(7, send(fd, "* PING\n", 7, 0));
+  EXPECT_EQ("* PONG 5000", readLine(fd));
+  EXPECT_EQ(1, adapter.getClientCount());
+
+  close(fd);
+  adapter.stop();
+  EXPECT_EQ(0, adapter.getClientCount());
+}
+
+static std::string streamsDocument(unsigned long long instance, unsigned long long first,
+                                   unsigned long long next, const std::string &events)
+{
+  std::stringstream ss;
+  ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<MTConnectStreams xmlns=\"urn:mtconnect.org:MTConnectStreams:1.2\">"
+      << "<Header creationTime=\"2013-01-01T00:00:00Z\" instanceId=\"" << instance << "\" firstSequence=\""
+      << first << "\" nextSequence=\"" << next << "\" lastSequence=\"" << next - 1 << "\"/>"
+      << "<Streams><DeviceStream name=\"cnc\" uuid=\"cnc\"><ComponentStream component=\"Door\" name=\"door\">"
+      << "<Events>" << events << "</Events></ComponentStream></DeviceStream></Streams></MTConnectStreams>";
+  return ss.str();
+}
+
+static std::string doorState(unsigned long long sequence, const std::string &value)
+{
+  std::stringstream ss;
+  ss << "<DoorState dataItemId=\"cnc_door_state\" name=\"door_state\" sequence=\"" << sequence
+      << "\" timestamp=\"2013-01-01T00:00:00.000000Z\">" << value << "</DoorState>";
+  return ss.str();
+}
+
+TEST(StreamClient, chunk_decoder)
+{
+  const std::string encoded = "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\n\r\n";
+
+  // every split point must decode the same
+  for (unsigned int split = 0; split <= encoded.size(); split++)
+  {
+    ChunkDecoder decoder;
+    std::string out;
+    EXPECT_TRUE(decoder.decode(encoded.c_str(), split, out));
+    EXPECT_TRUE(decoder.decode(encoded.c_str() + split, encoded.size() - split, out));
+    EXPECT_EQ("hello, world", out);
+    EXPECT_TRUE(decoder.isDone());
+  }
+
+  ChunkDecoder decoder;
+  std::string out;
+  EXPECT_FALSE(decoder.decode("5\r\nhelloXX", 10, out));
+}
+
+TEST(StreamClient, multipart_reader)
+{
+  MultipartReader reader;
+  reader.setBoundary("abc");
+
+  std::string document;
+  reader.append("\r\n--abc\r\nContent-type: text/xml\r\nContent-length: 5\r\n\r\nfir");
+  EXPECT_FALSE(reader.next(document));
+  reader.append("st\r\n--abc\r\nContent-length: 6\r\n\r\nsecond\r\n");
+  ASSERT_TRUE(reader.next(document));
+  EXPECT_EQ("first", document);
+  ASSERT_TRUE(reader.next(document));
+  EXPECT_EQ("second", document);
+  EXPECT_FALSE(reader.next(document));
+  EXPECT_TRUE(reader.isValid());
+
+  reader.append("garbage--abc\r\nContent-length: 1\r\n\r\nx");
+  EXPECT_FALSE(reader.next(document));
+  EXPECT_FALSE(reader.isValid());
+}
+
+TEST(StreamClient, parse_streams)
+{
+  StreamHeader header;
+  std::vector<Observation> observations;
+  std::string xml = streamsDocument(7, 10, 13, doorState(11, "OPEN")
+      + "<!-- comment --><ChuckState dataItemId=\"cnc_chuck_state\" name=\"chuck_state\" sequence=\"12\""
+      + " timestamp=\"2013-01-01T00:00:00.000000Z\">UNLATCHED</ChuckState>"
+      + "<Block dataItemId=\"b\" name=\"block\" sequence=\"12\" timestamp=\"t\">G01 X&lt;1&amp;</Block>");
+
+  ASSERT_TRUE(parseStreams(xml, header, observations));
+  EXPECT_EQ(7u, header.instance_id_);
+  EXPECT_EQ(10u, header.first_sequence_);
+  EXPECT_EQ(13u, header.next_sequence_);
+  ASSERT_EQ(3u, observations.size());
+  EXPECT_EQ("DoorState", observations[0].type_);
+  EXPECT_EQ("door_state", observations[0].name_);
+  EXPECT_EQ("cnc_door_state", observations[0].data_item_id_);
+  EXPECT_EQ(11u, observations[0].sequence_);
+  EXPECT_EQ(CncStates::OPEN, toCncState(observations[0].value_));
+  EXPECT_EQ(CncStates::UNLATCHED, toCncState(observations[1].value_));
+  EXPECT_EQ("G01 X<1&", observations[2].value_);
+  EXPECT_EQ(CncStates::UNAVAILABLE, toCncState("UNAVAILABLE"));
+  EXPECT_EQ(ExecutionStates::FEED_HOLD, toExecutionState("FEED_HOLD"));
+
+  EXPECT_FALSE(parseStreams("<MTConnectError><Errors/></MTConnectError>", header, observations));
+}
+
+static void recordDoor(std::vector<CncState> *states, const std::string &/*name*/,
+                       CncState state)
+{
+  states->push_back(state);
+}
+
+static void recordGap(unsigned long long *gap, unsigned long long expected, unsigned long long /*first*/)
+{
+  *gap = expected;
+}
+
+static void countDocument(unsigned int *documents)
+{
+  (*documents)++;
+}
+
+TEST(StreamClient, sequence_gaps)
+{
+  std::vector<CncState> states;
+  unsigned long long gap = 0;
+  unsigned int documents = 0;
+  StreamClient client;
+  client.subscribeDoorState(boost::bind(&recordDoor, &states, _1, _2));
+  client.setGapCallback(boost::bind(&recordGap, &gap, _1, _2));
+  client.setDocumentCallback(boost::bind(&countDocument, &documents));
+
+  // current
+  EXPECT_TRUE(client.processDocument(streamsDocument(1, 1, 10, doorState(5, "CLOSED"))));
+  EXPECT_EQ(10u, client.getNextSequence());
+
+  // samples, repeated observations (i.e. after a reconnect) are dropped
+  EXPECT_TRUE(client.processDocument(streamsDocument(1, 1, 12, doorState(9, "OPEN") + doorState(11, "OPEN"))));
+  EXPECT_TRUE(client.processDocument(streamsDocument(1, 1, 12, "")));
+  EXPECT_EQ(12u, client.getNextSequence());
+  ASSERT_EQ(2u, states.size());
+  EXPECT_EQ(CncStates::CLOSED, states[0]);
+  EXPECT_EQ(CncStates::OPEN, states[1]);
+
+  // heartbeats (documents without observations) count, documents with gaps don't
+  EXPECT_EQ(3u, documents);
+
+  // the agent buffer moved past the expected sequence
+  EXPECT_FALSE(client.processDocument(streamsDocument(1, 20, 30, doorState(25, "CLOSED"))));
+  EXPECT_EQ(12u, gap);
+  EXPECT_EQ(1u, client.getGapCount());
+  EXPECT_EQ(2u, states.size());
+
+  // agent restart
+  EXPECT_FALSE(client.processDocument(streamsDocument(2, 1, 13, "")));
+  EXPECT_EQ(2u, client.getGapCount());
+  EXPECT_EQ(3u, documents);
+
+  client.resetSequence();
+  EXPECT_TRUE(client.processDocument(streamsDocument(2, 1, 13, doorState(3, "CLOSED"))));
+  EXPECT_EQ(3u, states.size());
+}
+
+TEST(StreamClient, door_data_item_filter)
+{
+  std::vector<CncState> states;
+  StreamClient client;
+  client.subscribeDoorState(boost::bind(&recordDoor, &states, _1, _2), "door_state");
+
+  // the bar feeder door of the same device is ignored, the id matches as well as the name
+  std::string feeder_door = "<DoorState dataItemId=\"cnc_feeder_door\" name=\"feeder_door\" sequence=\"6\""
+      " timestamp=\"2013-01-01T00:00:00.000000Z\">OPEN</DoorState>";
+  EXPECT_TRUE(client.processDocument(streamsDocument(1, 1, 10, doorState(5, "CLOSED") + feeder_door)));
+  ASSERT_EQ(1u, states.size());
+  EXPECT_EQ(CncStates::CLOSED, states[0]);
+
+  StreamClient by_id;
+  by_id.subscribeDoorState(boost::bind(&recordDoor, &states, _1, _2), "cnc_feeder_door");
+  EXPECT_TRUE(by_id.processDocument(streamsDocument(1, 1, 10, doorState(5, "CLOSED") + feeder_door)));
+  ASSERT_EQ(2u, states.size());
+  EXPECT_EQ(CncStates::OPEN, states[1]);
+}
+
+TEST(CyclePredictor, cycle_time_and_progress)
+{
+  CyclePredictor predictor;
+  double remaining;
+
+  // nothing is known before the first cycle completes
+  EXPECT_FALSE(predictor.getRemaining(0.0, remaining));
+  predictor.setExecution(ExecutionStates::ACTIVE, 0.0);
+  EXPECT_TRUE(predictor.isRunning());
+  EXPECT_FALSE(predictor.getRemaining(10.0, remaining));
+  predictor.setExecution(ExecutionStates::PROGRAM_COMPLETED, 100.0);
+  EXPECT_DOUBLE_EQ(100.0, predictor.getCycleTime());
+  EXPECT_FALSE(predictor.getRemaining(110.0, remaining));
+
+  // repeated active states don't restart the cycle, the cycle time predicts the end
+  predictor.setExecution(ExecutionStates::ACTIVE, 200.0);
+  predictor.setExecution(ExecutionStates::ACTIVE, 210.0);
+  EXPECT_EQ(2u, predictor.getCycleCount());
+  ASSERT_TRUE(predictor.getRemaining(230.0, remaining));
+  EXPECT_DOUBLE_EQ(70.0, remaining);
+
+  // reported progress takes over, 40% after 40 sec finishes at 300
+  predictor.setProgress(0.4, 240.0);
+  ASSERT_TRUE(predictor.getRemaining(250.0, remaining));
+  EXPECT_DOUBLE_EQ(50.0, remaining);
+
+  // held time is not predicted and pushes the end out
+  predictor.setExecution(ExecutionStates::FEED_HOLD, 250.0);
+  EXPECT_FALSE(predictor.getRemaining(260.0, remaining));
+  predictor.setExecution(ExecutionStates::ACTIVE, 270.0);
+  ASSERT_TRUE(predictor.getRemaining(270.0, remaining));
+  EXPECT_DOUBLE_EQ(50.0, remaining);
+
+  // completing the cycle filters the cycle time (120 sec without the hold)
+  predictor.setExecution(ExecutionStates::PROGRAM_COMPLETED, 340.0);
+  EXPECT_TRUE(predictor.isCompleted());
+  EXPECT_DOUBLE_EQ(100.0 + CYCLE_TIME_FILTER * 20.0, predictor.getCycleTime());
+
+  // a stopped program is not a cycle
+  predictor.setExecution(ExecutionStates::ACTIVE, 400.0);
+  predictor.setExecution(ExecutionStates::STOPPED, 410.0);
+  EXPECT_FALSE(predictor.isRunning());
+  EXPECT_FALSE(predictor.isCompleted());
+  EXPECT_DOUBLE_EQ(100.0 + CYCLE_TIME_FILTER * 20.0, predictor.getCycleTime());
+}
+
+/*
+ * Predictor with a 100 sec cycle and the next program started at start
+ */
+static void runCycle(CyclePredictor &predictor, double start)
+{
+  predictor.setExecution(ExecutionStates::ACTIVE, start - 200.0);
+  predictor.setExecution(ExecutionStates::PROGRAM_COMPLETED, start - 100.0);
+  predictor.setExecution(ExecutionStates::ACTIVE, start);
+}
+
+TEST(StagingPlanner, stages_and_hands_over_to_unload)
+{
+  CyclePredictor predictor;
+  runCycle(predictor, 200.0);
+  StagingPlanner staging;
+  staging.setLead(20.0);
+  staging.setTimeout(30.0);
+  staging.setStaleTimeout(30.0);
+  double remaining;
+
+  // no document from the agent yet, the prediction isn't trusted
+  EXPECT_TRUE(staging.isStreamStale(285.0));
+  EXPECT_FALSE(staging.isDue(predictor, true, 285.0, remaining));
+
+  // due within the lead only, once per program, and not while requests wait
+  staging.setStreamStamp(280.0);
+  EXPECT_FALSE(staging.isDue(predictor, true, 270.0, remaining));
+  EXPECT_FALSE(staging.isDue(predictor, false, 285.0, remaining));
+  ASSERT_TRUE(staging.isDue(predictor, true, 285.0, remaining));
+  EXPECT_DOUBLE_EQ(15.0, remaining);
+  EXPECT_FALSE(staging.isDue(predictor, true, 286.0, remaining));
+
+  // home to the staging point
+  std::string path;
+  StateType wait;
+  ASSERT_TRUE(StagingPlanner::getMove(StateTypes::MATERIAL_STAGING, path, wait));
+  EXPECT_EQ(KEY_JM_HOME_TO_STAGE, path);
+  EXPECT_EQ(StateTypes::MS_WAIT_MOVE_STAGE, wait);
+  EXPECT_EQ(StateTypes::MS_STAGED, StagingPlanner::getMoveDone(wait));
+
+  // staying until the unload request, which the unload sequence takes over at the door
+  std::string reason;
+  EXPECT_EQ(StateTypes::MS_STAGED, staging.poll(predictor, false, 290.0, reason));
+  StateType state = staging.poll(predictor, true, 295.0, reason);
+  ASSERT_EQ(StateTypes::MS_MOVE_DOOR, state);
+  ASSERT_TRUE(StagingPlanner::getMove(state, path, wait));
+  EXPECT_EQ(KEY_JM_STAGE_TO_DOOR, path);
+  EXPECT_EQ(StateTypes::MU_WAIT_MOVE_DOOR, wait);
+  EXPECT_FALSE(StagingPlanner::getMove(StateTypes::MS_STAGED, path, wait));
+}
+
+/*
+ * Stages 15 sec before the end of a program started at 200, the stream is fresh until 280
+ */
+static void stage(CyclePredictor &predictor, StagingPlanner &staging)
+{
+  runCycle(predictor, 200.0);
+  staging.setLead(20.0);
+  staging.setTimeout(30.0);
+  staging.setStaleTimeout(30.0);
+  staging.setStreamStamp(280.0);
+  double remaining;
+  ASSERT_TRUE(staging.isDue(predictor, true, 285.0, remaining));
+}
+
+TEST(StagingPlanner, returns_home)
+{
+  std::string reason;
+  std::string path;
+  StateType wait;
+  double remaining;
+
+  // the agent went quiet while staged
+  {
+    CyclePredictor predictor;
+    StagingPlanner staging;
+    stage(predictor, staging);
+    StateType state = staging.poll(predictor, false, 311.0, reason);
+    ASSERT_EQ(StateTypes::MS_MOVE_HOME, state);
+    EXPECT_EQ("Agent stream stale", reason);
+    ASSERT_TRUE(StagingPlanner::getMove(state, path, wait));
+    EXPECT_EQ(KEY_JM_STAGE_TO_HOME, path);
+    EXPECT_EQ(StateTypes::MS_WAIT_MOVE_HOME, wait);
+    EXPECT_EQ(StateTypes::WAITING, StagingPlanner::getMoveDone(wait));
+
+    // a stale stream doesn't stage the next program either
+    predictor.setExecution(ExecutionStates::PROGRAM_COMPLETED, 300.0);
+    predictor.setExecution(ExecutionStates::ACTIVE, 400.0);
+    EXPECT_FALSE(staging.isDue(predictor, true, 485.0, remaining));
+    staging.setStreamStamp(484.0);
+    EXPECT_TRUE(staging.isDue(predictor, true, 485.0, remaining));
+  }
+
+  // held program
+  {
+    CyclePredictor predictor;
+    StagingPlanner staging;
+    stage(predictor, staging);
+    predictor.setExecution(ExecutionStates::FEED_HOLD, 290.0);
+    EXPECT_EQ(StateTypes::MS_MOVE_HOME, staging.poll(predictor, false, 291.0, reason));
+    EXPECT_EQ("CNC program held", reason);
+  }
+
+  // stopped program
+  {
+    CyclePredictor predictor;
+    StagingPlanner staging;
+    stage(predictor, staging);
+    predictor.setExecution(ExecutionStates::STOPPED, 290.0);
+    EXPECT_EQ(StateTypes::MS_MOVE_HOME, staging.poll(predictor, false, 291.0, reason));
+    EXPECT_EQ("CNC program stopped", reason);
+  }
+
+  // completed without an unload request within the timeout past the predicted end (at 300)
+  {
+    CyclePredictor predictor;
+    StagingPlanner staging;
+    stage(predictor, staging);
+    predictor.setExecution(ExecutionStates::PROGRAM_COMPLETED, 300.0);
+    staging.setStreamStamp(325.0);
+    EXPECT_EQ(StateTypes::MS_STAGED, staging.poll(predictor, false, 329.0, reason));
+    EXPECT_EQ(StateTypes::MS_MOVE_HOME, staging.poll(predictor, false, 331.0, reason));
+  }
+}
+
+/*
+ * Two joint positions for the recovery tests
+ */
+static std::vector<double> jointPoint(double j1, double j2)
+{
+  std::vector<double> point;
+  point.push_back(j1);
+  point.push_back(j2);
+  return point;
+}
+
+TEST(RecoveryPlanner, nearest_waypoint_routes)
+{
+  RecoveryPlanner planner;
+  planner.setHome(jointPoint(0.0, 0.0), 0.01);
+
+  // home -> door -> chuck and back, the pick path passes through home
+  std::vector<std::vector<double> > to_chuck, to_home, pick;
+  to_chuck.push_back(jointPoint(0.0, 0.0));
+  to_chuck.push_back(jointPoint(1.0, 0.0));
+  to_chuck.push_back(jointPoint(2.0, 0.5));
+  to_home.push_back(jointPoint(2.0, 0.5));
+  to_home.push_back(jointPoint(1.0, 0.0));
+  to_home.push_back(jointPoint(0.0, 0.0));
+  pick.push_back(jointPoint(-1.0, 1.0));
+  pick.push_back(jointPoint(-0.5, 0.5));
+  pick.push_back(jointPoint(0.0, 0.0));
+  pick.push_back(jointPoint(1.0, 0.0));
+  ASSERT_TRUE(planner.addPath("JM_HOME_TO_CHUCK", to_chuck));
+  ASSERT_TRUE(planner.addPath("JM_CHUCK_TO_HOME", to_home));
+  ASSERT_TRUE(planner.addPath("JM_PICK_TO_DOOR", pick));
+  EXPECT_FALSE(planner.addPath("bad", std::vector<std::vector<double> >(1, std::vector<double>(3, 0.0))));
+  EXPECT_EQ(10u, planner.getWaypointCount());
+
+  // stopped near the chuck, retraced over the door back home
+  RecoveryPlan plan;
+  ASSERT_TRUE(planner.plan(jointPoint(1.9, 0.45), 0.2, plan));
+  EXPECT_NEAR(0.1, plan.distance_, 1e-9);
+  EXPECT_NEAR(0.1 + 1.0 + 1.0, plan.length_, 1e-9);
+  ASSERT_EQ(4u, plan.points_.size());
+  EXPECT_DOUBLE_EQ(1.9, plan.points_[0][0]);
+  EXPECT_DOUBLE_EQ(2.0, plan.points_[1][0]);
+  EXPECT_DOUBLE_EQ(0.0, plan.points_[3][0]);
+
+  // on the pick path home is ahead, going back would never reach it
+  ASSERT_TRUE(planner.plan(jointPoint(-0.9, 0.9), 0.2, plan));
+  EXPECT_EQ("JM_PICK_TO_DOOR", plan.path_);
+  EXPECT_EQ(0u, plan.waypoint_);
+  EXPECT_FALSE(plan.reverse_);
+  EXPECT_EQ(4u, plan.points_.size());
+
+  // too far from any waypoint for a direct move
+  EXPECT_FALSE(planner.plan(jointPoint(3.0, 3.0), 0.2, plan));
+  EXPECT_FALSE(planner.plan(std::vector<double>(1, 0.0), 0.2, plan));
+}
+
+TEST(RecoveryPlanner, routes_over_shared_waypoints)
+{
+  RecoveryPlanner planner;
+  planner.setHome(jointPoint(0.0, 0.0), 0.01);
+
+  // only the first path touches home, the chuck is reached over the door
+  std::vector<std::vector<double> > to_door, to_chuck, pick;
+  to_door.push_back(jointPoint(0.0, 0.0));
+  to_door.push_back(jointPoint(1.0, 0.0));
+  to_chuck.push_back(jointPoint(1.0, 0.0));
+  to_chuck.push_back(jointPoint(1.5, 0.5));
+  to_chuck.push_back(jointPoint(2.0, 1.0));
+  pick.push_back(jointPoint(-1.0, -1.0));
+  pick.push_back(jointPoint(-2.0, -1.0));
+  ASSERT_TRUE(planner.addPath("JM_HOME_TO_DOOR", to_door));
+  ASSERT_TRUE(planner.addPath("JM_DOOR_TO_CHUCK", to_chuck));
+  ASSERT_TRUE(planner.addPath("JM_APPROACH_TO_PICK", pick));
+
+  // inside the chuck, back out to the door and from there home
+  RecoveryPlan plan;
+  ASSERT_TRUE(planner.plan(jointPoint(1.9, 0.95), 0.2, plan));
+  EXPECT_EQ("JM_DOOR_TO_CHUCK", plan.path_);
+  EXPECT_EQ(2u, plan.waypoint_);
+  EXPECT_TRUE(plan.reverse_);
+  EXPECT_NEAR(0.1, plan.distance_, 1e-9);
+  EXPECT_NEAR(0.1 + 0.5 + 0.5 + 1.0, plan.length_, 1e-9);
+  ASSERT_EQ(2u, plan.paths_.size());
+  EXPECT_EQ("JM_DOOR_TO_CHUCK", plan.paths_[0]);
+  EXPECT_EQ("JM_HOME_TO_DOOR", plan.paths_[1]);
+
+  // the shared door waypoint is passed once
+  ASSERT_EQ(5u, plan.points_.size());
+  EXPECT_DOUBLE_EQ(2.0, plan.points_[1][0]);
+  EXPECT_DOUBLE_EQ(1.5, plan.points_[2][0]);
+  EXPECT_DOUBLE_EQ(1.0, plan.points_[3][0]);
+  EXPECT_DOUBLE_EQ(0.0, plan.points_[4][0]);
+
+  // a path that shares no waypoint with the others never gets home
+  EXPECT_FALSE(planner.plan(jointPoint(-1.9, -0.95), 0.2, plan));
+}
+
+TEST(RecoveryPlanner, unsafe_directions_are_not_followed)
+{
+  RecoveryPlanner planner;
+  planner.setHome(jointPoint(0.0, 0.0), 0.01);
+
+  // home -> door -> chuck and back, the pick path passes through home and the door
+  std::vector<std::vector<double> > to_chuck, to_home, pick;
+  to_chuck.push_back(jointPoint(0.0, 0.0));
+  to_chuck.push_back(jointPoint(1.0, 0.0));
+  to_chuck.push_back(jointPoint(2.0, 0.5));
+  to_home.push_back(jointPoint(2.0, 0.5));
+  to_home.push_back(jointPoint(1.0, 0.0));
+  to_home.push_back(jointPoint(0.0, 0.0));
+  pick.push_back(jointPoint(-1.0, 1.0));
+  pick.push_back(jointPoint(-0.5, 0.5));
+  pick.push_back(jointPoint(0.0, 0.0));
+  pick.push_back(jointPoint(1.0, 0.0));
+  ASSERT_TRUE(planner.addPath("JM_HOME_TO_CHUCK", to_chuck));
+  ASSERT_TRUE(planner.addPath("JM_CHUCK_TO_HOME", to_home));
+  ASSERT_TRUE(planner.addPath("JM_PICK_TO_DOOR", pick));
+  EXPECT_FALSE(planner.setDirection("JM_UNKNOWN", PathDirections::NONE));
+
+  // the path into the chuck is unsafe, the robot leaves the chuck on the way out only
+  RecoveryPlan plan;
+  ASSERT_TRUE(planner.setDirection("JM_HOME_TO_CHUCK", PathDirections::NONE));
+  ASSERT_TRUE(planner.setDirection("JM_CHUCK_TO_HOME", PathDirections::FORWARD));
+  ASSERT_TRUE(planner.plan(jointPoint(1.9, 0.45), 0.2, plan));
+  ASSERT_EQ(1u, plan.paths_.size());
+  EXPECT_EQ("JM_CHUCK_TO_HOME", plan.paths_[0]);
+  EXPECT_FALSE(plan.reverse_);
+
+  // with both paths of the chuck unsafe it can't be left, near the door the pick path is taken home
+  ASSERT_TRUE(planner.setDirection("JM_CHUCK_TO_HOME", PathDirections::NONE));
+  EXPECT_FALSE(planner.plan(jointPoint(1.9, 0.45), 0.2, plan));
+  ASSERT_TRUE(planner.plan(jointPoint(1.05, 0.0), 0.2, plan));
+  ASSERT_EQ(1u, plan.paths_.size());
+  EXPECT_EQ("JM_PICK_TO_DOOR", plan.paths_[0]);
+  EXPECT_TRUE(plan.reverse_);
+
+  // the pick path only forward, away from home
+  ASSERT_TRUE(planner.setDirection("JM_PICK_TO_DOOR", PathDirections::FORWARD));
+  EXPECT_FALSE(planner.plan(jointPoint(1.05, 0.0), 0.2, plan));
+
+  planner.resetDirections();
+  EXPECT_TRUE(planner.plan(jointPoint(1.9, 0.45), 0.2, plan));
+  EXPECT_TRUE(planner.plan(jointPoint(1.05, 0.0), 0.2, plan));
+}
+
+TEST(SwapCycle, load_request_at_the_drop)
+{
+  SwapCycle swap;
+  EXPECT_EQ(StateTypes::MU_MOVE_HOME, swap.getDropDone());
+  swap.setEnabled(true);
+  swap.setWait(2.0);
+
+  // unload done, waiting at the drop for the load request
+  EXPECT_EQ(StateTypes::MATERIAL_SWAPPING, swap.getDropDone());
+  swap.begin(100.0);
+  EXPECT_EQ(StateTypes::SW_WAIT_LOAD_REQUEST, swap.poll(false, false, 100.0));
+  EXPECT_EQ(StateTypes::SW_WAIT_LOAD_REQUEST, swap.poll(false, false, 101.9));
+
+  // the request arrives within the wait, straight to the pick approach and on to the pick
+  StateType state = swap.poll(true, false, 101.9);
+  ASSERT_EQ(StateTypes::SW_MOVE_PICK_APPROACH, state);
+  std::string path;
+  StateType wait;
+  ASSERT_TRUE(SwapCycle::getMove(state, path, wait));
+  EXPECT_EQ(KEY_JM_DROP_TO_APPROACH, path);
+  EXPECT_EQ(StateTypes::SW_WAIT_MOVE_PICK_APPROACH, wait);
+  EXPECT_EQ(StateTypes::ML_MOVE_PICK, SwapCycle::getMoveDone(wait));
+
+  EXPECT_FALSE(SwapCycle::getMove(StateTypes::SW_WAIT_LOAD_REQUEST, path, wait));
+}
+
+TEST(SwapCycle, returns_home_without_load_request)
+{
+  SwapCycle swap;
+  swap.setEnabled(true);
+  swap.setWait(2.0);
+  swap.begin(100.0);
+
+  // nothing queued once the wait expires
+  StateType state = swap.poll(false, false, 102.1);
+  ASSERT_EQ(StateTypes::SW_MOVE_HOME, state);
+  std::string path;
+  StateType wait;
+  ASSERT_TRUE(SwapCycle::getMove(state, path, wait));
+  EXPECT_EQ(KEY_JM_DROP_TO_HOME, path);
+  EXPECT_EQ(StateTypes::SW_WAIT_MOVE_HOME, wait);
+  EXPECT_EQ(StateTypes::WAITING, SwapCycle::getMoveDone(wait));
+
+  // other machines waiting are scheduled from home without waiting out the swap
+  swap.begin(200.0);
+  EXPECT_EQ(StateTypes::SW_MOVE_HOME, swap.poll(false, true, 200.0));
+}
+
+TEST(MachineNames, machine_path_overrides)
+{
+  std::set<std::string> paths;
+  paths.insert("JM_HOME_TO_DOOR");
+  paths.insert("JM_DOOR_TO_CHUCK");
+  paths.insert("cnc2/JM_HOME_TO_DOOR");
+
+  // a single machine uses the global names
+  MachineNames single;
+  single.add("");
+  EXPECT_EQ("material_load_action", single.getAction(0, "material_load_action"));
+  EXPECT_EQ("JM_HOME_TO_DOOR", single.getPath(0, "JM_HOME_TO_DOOR", paths));
+
+  MachineNames names;
+  names.add("cnc1");
+  names.add("cnc2");
+  EXPECT_EQ("cnc1/cnc_open_door_action", names.getAction(0, "cnc_open_door_action"));
+  EXPECT_EQ("/cnc2/MaterialLoad/set_mtconnect_state", names.getAction(1, "/MaterialLoad/set_mtconnect_state"));
+
+  // only cnc2 has a door path of its own, the chuck path is shared
+  EXPECT_EQ("JM_HOME_TO_DOOR", names.getPath(0, "JM_HOME_TO_DOOR", paths));
+  EXPECT_EQ("cnc2/JM_HOME_TO_DOOR", names.getPath(1, "JM_HOME_TO_DOOR", paths));
+  EXPECT_EQ("JM_DOOR_TO_CHUCK", names.getPath(1, "JM_DOOR_TO_CHUCK", paths));
+}
+
+TEST(MachineNames, queue_dispatch_across_machines)
+{
+  MachineNames names;
+  names.add("cnc1");
+  names.add("cnc2");
+  std::vector<std::string> actions;
+  actions.push_back("material_load_action");
+  actions.push_back("material_unload_action");
+
+  // keyed and prioritized per machine action like the state machine does, unloads first
+  mtconnect_example_utils::MaterialRequestQueue queue;
+  queue.setMaxDepth(mtconnect_example_utils::DEFAULT_MATERIAL_QUEUE_DEPTH * names.size());
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    queue.setPriority(names.getAction(i, "material_load_action"), 0);
+    queue.setPriority(names.getAction(i, "material_unload_action"), 1);
+  }
+  ASSERT_TRUE(queue.push(names.getAction(0, "material_load_action"), 10.0));
+  ASSERT_TRUE(queue.push(names.getAction(1, "material_unload_action"), 11.0));
+  ASSERT_TRUE(queue.push(names.getAction(0, "material_unload_action"), 12.0));
+
+  std::string name, action;
+  size_t machine;
+  double waited;
+  ASSERT_TRUE(queue.pop(13.0, name, waited));
+  ASSERT_TRUE(names.findAction(name, actions, machine, action));
+  EXPECT_EQ(1u, machine);
+  EXPECT_EQ("material_unload_action", action);
+  EXPECT_DOUBLE_EQ(2.0, waited);
+
+  ASSERT_TRUE(queue.pop(13.0, name, waited));
+  ASSERT_TRUE(names.findAction(name, actions, machine, action));
+  EXPECT_EQ(0u, machine);
+  EXPECT_EQ("material_unload_action", action);
+
+  ASSERT_TRUE(queue.pop(13.0, name, waited));
+  ASSERT_TRUE(names.findAction(name, actions, machine, action));
+  EXPECT_EQ(0u, machine);
+  EXPECT_EQ("material_load_action", action);
+  EXPECT_FALSE(queue.pop(13.0, name, waited));
+
+  // names of other machines or actions don't resolve
+  EXPECT_FALSE(names.findAction("cnc3/material_load_action", actions, machine, action));
+  EXPECT_FALSE(names.findAction("cnc1/cnc_open_door_action", actions, machine, action));
+}
+
+TEST(StateJournal, replay_and_torn_records)
+{
+  char path[] = "/tmp/utest_state_journal_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  StateJournal journal;
+  JournalEntry entry;
+  ASSERT_TRUE(journal.open(path, 4));
+  EXPECT_FALSE(journal.replay(entry));
+
+  // six entries wrap the four record ring
+  for (int i = 1; i <= 6; i++)
+  {
+    entry.state_ = 2100 + i;
+    entry.material_ = MaterialLocations::GRIPPER;
+    entry.goal_ = JournalGoals::MATERIAL_LOAD;
+    entry.stamp_ = i;
+    ASSERT_TRUE(journal.append(entry));
+  }
+  EXPECT_EQ(6u, journal.getSequence());
+  journal.close();
+  EXPECT_FALSE(journal.append(entry));
+
+  ASSERT_TRUE(journal.open(path, 4));
+  JournalEntry last;
+  ASSERT_TRUE(journal.replay(last));
+  EXPECT_EQ(2106, last.state_);
+  EXPECT_EQ(MaterialLocations::GRIPPER, last.material_);
+  EXPECT_EQ(JournalGoals::MATERIAL_LOAD, last.goal_);
+  EXPECT_DOUBLE_EQ(6.0, last.stamp_);
+  EXPECT_EQ(6u, journal.getSequence());
+  journal.close();
+
+  // a torn write of the newest record (slot 1, after the 32 byte header) falls back to the previous one
+  fd = open(path, O_RDWR);
+  ASSERT_GE(fd, 0);
+  char garbage = 0x5a;
+  ASSERT_EQ(1, pwrite(fd, &garbage, 1, 32 + 32 + 8));
+  close(fd);
+  ASSERT_TRUE(journal.open(path, 4));
+  ASSERT_TRUE(journal.replay(last));
+  EXPECT_EQ(2105, last.state_);
+  journal.close();
+
+  // another layout starts over
+  ASSERT_TRUE(journal.open(path, 8));
+  EXPECT_FALSE(journal.replay(last));
+  EXPECT_EQ(0u, journal.getSequence());
+  journal.close();
+  unlink(path);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}